@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2024 Giannuzzi Riccardo, Biribo' Francesco, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+
+// Richieste inviate di seguito prima di leggerne le risposte
+#define BATCH_WINDOW 64
+
+/**
+ * Esegue senza menu le operazioni lette da input, una per riga, sulla connessione clientFD
+ * e scrive su output una riga di risultato per ogni riga di input, nello stesso ordine
+ *
+ * Le righe hanno i campi separati da virgole, come la rubrica del server (i campi vuoti non limitano la ricerca):
+ *  auth,utente,password - Credenziali usate anche da add, del e mod delle righe successive (rubrica personale solo con setPersonalBook)
+ *  read,nome,cognome,numero[,indice] - Lettura (indice della corrispondenza, 1 se manca)
+ *  iread,nome,cognome,numero[,indice] - Lettura senza distinzione di maiuscole e accenti
+ *  sread,nome,cognome,cifre[,indice] - Come iread, con le ultime cifre del numero
+ *  fread,nome,cognome,numero,distanza[,indice] - Lettura che tollera errori di battitura
+ *  count,nome,cognome,numero - Numero di corrispondenze
+ *  add,nome,cognome,numero - Aggiunta
+ *  del,nome,cognome,numero - Cancellazione
+ *  mod,nome,cognome,numero,nuovoNome,nuovoCognome,nuovoNumero - Modifica
+ * Le righe vuote e quelle che iniziano con # vengono ignorate
+ *
+ * I risultati hanno la forma riga,operazione,ESITO[,dati]: i dati sono il contatto trovato dalle letture,
+ * il conteggio di count e l'indirizzo del primario per REDIRECT
+ * Gli esiti sono OK, MISSING, ERROR, CREDENTIALS_EXPIRED, ALREADY_MODIFIED, ALREADY_EXISTS, REDIRECT,
+ * INVALID_PACKET e INVALID_INPUT (riga non valida, non inviata); BUSY se il server rifiuta la connessione
+ *
+ * Le richieste vengono inviate a gruppi di BATCH_WINDOW con una sola scrittura, e poi ne vengono lette
+ * le risposte: il tempo di andata e ritorno si paga una volta per gruppo invece che per richiesta
+ *
+ * Restituisce 1 se tutte le righe sono state eseguite, 0 in caso di errore di comunicazione
+ */
+int runBatch(int clientFD, FILE *input, FILE *output);
@@ -34,7 +34,18 @@
 #define DEL '-'
 #define MODIFY 'm'
 #define INT 'x'
+#define FUZZY_READ 'f'
+#define INSENSITIVE_READ 'i'
+#define SUFFIX_READ 'p'
+#define ORDERED_READ 'o'
+#define COUNT 'c'
+#define SUBSCRIBE 's'
+#define SYNC_SINCE 'y'
 #define INVALID_PACKET 'e'
+
+// Valore di newName in AUTH per passare alla rubrica personale dell'utente (vedi serverPacket)
+#define PERSONAL_BOOK 'u'
+
 // Errori server
 #define SERVER_ERROR '0'
 #define OPERATION_SUCCESS '1'
@@ -42,6 +53,10 @@
 #define CREDENTIALS_EXPIRED '3'
 #define CONTACT_ALREADY_MODIFIED '4'
 #define CONTACT_ALREADY_EXISTS '5'
+#define CHANGES_LOST '6'
+#define NOT_MODIFIED '7'
+#define REDIRECT '8'
+#define SERVER_BUSY '9'
 
 /**
  * Rappresenta la struttura dei messaggi di comunicazione tra client e server
@@ -58,6 +73,40 @@
  *  newName - Nuovo nome del contatto (da usare per la modifica)
  *  newSurname - Nuovo cognome del contatto (da usare per la modifica)
  *  newPhoneNumber - Nuovo numero di telefono del contatto (da usare per la modifica)
+ *
+ * Le operazioni di lettura non usano i campi new*, che vengono quindi
+ * riutilizzati per i parametri aggiuntivi della ricerca:
+ *  FUZZY_READ - newName contiene la distanza di modifica massima ammessa
+ *  ORDERED_READ - newName, newSurname e newPhoneNumber contengono l'ultimo contatto dell'intervallo richiesto
+ *  COUNT - newName contiene l'operazione di lettura di cui usare i criteri, la risposta contiene il conteggio in matchIndex
+ *  AUTH - newName contiene PERSONAL_BOOK per usare la rubrica personale dell'utente
+ *
+ * In SUFFIX_READ il campo phoneNumber contiene solo le ultime cifre del numero cercato
+ *
+ * Nelle risposte a READ e INSENSITIVE_READ newPhoneNumber contiene la versione della rubrica
+ * a cui si riferisce il risultato: il client puo' rimandarla nella stessa richiesta e, se nessuna
+ * modifica successiva coinvolge i criteri di ricerca, il server risponde NOT_MODIFIED senza contatto
+ *
+ * Dopo una richiesta SUBSCRIBE il server invia un pacchetto per ogni modifica della rubrica:
+ * operation e' ADD, DEL o MODIFY, matchIndex il numero progressivo della modifica,
+ * name, surname e phoneNumber il contatto aggiunto, rimosso o modificato e new* il nuovo contatto
+ * Se il client non legge abbastanza in fretta e alcune modifiche vengono perse riceve invece
+ * un pacchetto SUBSCRIBE con esito CHANGES_LOST, e riprende dalla modifica indicata in matchIndex
+ * L'iscrizione termina quando il client invia un altro pacchetto SUBSCRIBE: il server risponde
+ * con un pacchetto SUBSCRIBE con esito OPERATION_SUCCESS (matchIndex e' il numero dell'ultima modifica inviata)
+ * Se il server viene riavviato (SIGHUP) chiude invece l'iscrizione con un pacchetto SUBSCRIBE con esito
+ * SERVER_BUSY e chiude la connessione: il client si ricollega e si iscrive di nuovo
+ *
+ * In SYNC_SINCE il client indica in matchIndex la versione della rubrica che possiede (0 se nessuna):
+ * il server invia le modifiche successive con gli stessi pacchetti di SUBSCRIBE oppure, se non le ha
+ * piu' tutte, un pacchetto SYNC_SINCE con esito CHANGES_LOST seguito da un ADD per ogni contatto
+ * La risposta finale e' un pacchetto SYNC_SINCE con la versione raggiunta in matchIndex
+ *
+ * Le sessioni usano la rubrica condivisa, anche dopo un AUTH: solo un AUTH con PERSONAL_BOOK
+ * in newName porta la sessione sulla rubrica personale dell'utente (da quel momento ADD, DEL e MODIFY
+ * usano quella delle credenziali inviate), e un AUTH successivo senza PERSONAL_BOOK la riporta su quella condivisa
+ * SUBSCRIBE, SYNC_SINCE e le letture condizionate sono disponibili solo per la rubrica condivisa:
+ * con una rubrica personale SUBSCRIBE e SYNC_SINCE rispondono SERVER_ERROR
  */
 typedef struct{
     char operation;
@@ -83,13 +132,102 @@ typedef struct{
  * Restituisce l'esito dell'operazione
  */
 int readContact(int clientFD, Contact *toRead,int matchIndex, Contact *serverRead);
+/**
+ * Variante di readContact che tollera errori di battitura: nome e cognome
+ * del contatto trovato possono differire da quelli di toRead di al massimo
+ * maxDistance modifiche (inserimenti, cancellazioni o sostituzioni di caratteri)
+ * 
+ * Restituisce l'esito dell'operazione
+ */
+int fuzzyReadContact(int clientFD, Contact *toRead, int maxDistance, int matchIndex, Contact *serverRead);
+/**
+ * Variante di readContact che confronta nome e cognome ignorando
+ * maiuscole e accenti ("rossi" trova "Rossi", "nicolo" trova "Nicolò")
+ * 
+ * Restituisce l'esito dell'operazione
+ */
+int insensitiveReadContact(int clientFD, Contact *toRead, int matchIndex, Contact *serverRead);
+/**
+ * Variante di insensitiveReadContact in cui il numero di telefono di toRead
+ * contiene solo le ultime cifre del numero da cercare
+ * 
+ * Restituisce l'esito dell'operazione
+ */
+int suffixReadContact(int clientFD, Contact *toRead, int matchIndex, Contact *serverRead);
+/**
+ * Legge la rubrica in ordine alfabetico per cognome, nome e numero di telefono,
+ * restituendo in serverRead il matchIndex-esimo contatto compreso tra from e to
+ * (estremi inclusi, i campi vuoti non limitano l'intervallo)
+ * 
+ * Per leggere il contatto successivo a uno gia' ricevuto basta usarlo come from con matchIndex 2,
+ * se nel frattempo non e' stato cancellato (con matchIndex 1 si ottiene lui stesso solo se c'e' ancora)
+ * 
+ * Restituisce l'esito dell'operazione
+ */
+int orderedReadContact(int clientFD, Contact *from, Contact *to, int matchIndex, Contact *serverRead);
+/**
+ * Chiede al server quanti contatti corrispondono ai parametri di toRead,
+ * con i criteri dell'operazione di lettura readOperation (READ, INSENSITIVE_READ o SUFFIX_READ)
+ * Il risultato viene salvato in count
+ * 
+ * Restituisce 1 in caso di successo, 0 altrimenti
+ */
+int countContacts(int clientFD, char readOperation, Contact *toRead, int *count);
+/**
+ * Lettura condizionata con i criteri dell'operazione readOperation (READ o INSENSITIVE_READ)
+ * In version va indicata la versione del risultato gia' in possesso (0 se non c'e'),
+ * dopo la chiamata contiene la versione a cui si riferisce la risposta
+ * 
+ * Restituisce 1 se il contatto e' stato trovato (salvato in serverRead), 2 se non ci sono
+ * corrispondenze, 3 se il risultato gia' in possesso e' ancora valido, 0 in caso di errore
+ */
+int conditionalReadContact(int clientFD, char readOperation, Contact *toRead, int matchIndex, unsigned int *version, Contact *serverRead);
+/**
+ * Iscrive il client alle modifiche della rubrica fatte da qualsiasi sessione
+ * In version viene salvato il numero dell'ultima modifica gia' avvenuta
+ * 
+ * Restituisce 1 in caso di successo, 0 altrimenti
+ */
+int subscribeChanges(int clientFD, unsigned int *version);
+/**
+ * Chiede al server di chiudere l'iscrizione
+ * Le modifiche gia' in viaggio vanno comunque lette con readChange, fino alla chiusura
+ */
+void unsubscribeChanges(int clientFD);
+/**
+ * Chiede al server le modifiche avvenute dopo la versione version della rubrica (0 se non se ne possiede nessuna)
+ * Le modifiche vanno poi lette con readChange, fino alla fine della sincronizzazione
+ */
+void requestChangesSince(int clientFD, unsigned int version);
+/**
+ * Attende la prossima notifica dell'iscrizione (o della sincronizzazione)
+ * Per le modifiche salva in operation ADD, DEL o MODIFY, in old il contatto aggiunto, rimosso
+ * o modificato, in new il nuovo contatto (solo per MODIFY) e in version il numero della modifica
+ * 
+ * Restituisce 1 per una modifica, 2 se alcune modifiche sono state perse (version indica
+ * da dove riprendono, in una sincronizzazione seguono tutti i contatti della rubrica),
+ * 3 se l'iscrizione o la sincronizzazione sono terminate (version indica l'ultima modifica),
+ * 4 se il server e' stato riavviato e ha chiuso l'iscrizione (va ripetuta con subscribeChanges,
+ * che ripristina la connessione), 0 in caso di errore
+ */
+int readChange(int clientFD, char *operation, Contact *old, Contact *new, unsigned int *version);
 /**
  * Invia alla socket clientFD una richiesta di autenticazione
  * utilizzando le credenziali username e password
+ * La sessione resta sulla rubrica condivisa, a meno che non sia stata scelta quella personale con setPersonalBook
  * 
- * Restituisce l'esito dell'operazione
+ * Restituisce l'esito dell'operazione (8 se il server e' una replica, vedi getPrimaryAddress)
  */
 int authenticate(int clientFD, char *username, char *password);
+/**
+ * Con personal uguale a 1 le autenticazioni successive (anche quelle ripetute dopo una riconnessione)
+ * chiedono al server la rubrica personale dell'utente, con 0 (impostazione iniziale) quella condivisa
+ */
+void setPersonalBook(int personal);
+/**
+ * Restituisce 1 se le autenticazioni chiedono la rubrica personale (vedi setPersonalBook), 0 altrimenti
+ */
+int usesPersonalBook(void);
 /**
  * Invia alla socket clientFD una richiesta di aggiunta del contatto
  * doAdd nella rubrica del server
@@ -113,6 +251,61 @@ int deleteContact(int clientFD, char *username, char *password, Contact *toDelet
  * Restituisce l'esito dell'operazione
  */
 int modifyContact(int clientFD, char *username, char *password, Contact *toModify, Contact *modifiedContact);
+/**
+ * Le repliche rispondono alle richieste di autenticazione, aggiunta, cancellazione
+ * e modifica con REDIRECT (esito 8 delle funzioni): copia in host e port
+ * l'indirizzo del primario indicato dall'ultima di queste risposte
+ */
+void getPrimaryAddress(char *host, int *port);
+
+/*
+ * Esito di addContact, deleteContact e modifyContact quando la connessione si interrompe
+ * dopo l'invio della richiesta: la modifica potrebbe essere stata eseguita o no
+ */
+#define CONNECTION_LOST 10
+
+/**
+ * Imposta la funzione handler che, quando la comunicazione con il server si interrompe,
+ * riapre la connessione sullo stesso descrittore clientFD (restituendo 1) o rinuncia (restituendo 0)
+ * Dopo la riconnessione viene ripetuta l'ultima autenticazione riuscita e, se la richiesta
+ * interrotta e' una lettura o non era ancora arrivata al server, la richiesta stessa
+ *
+ * Senza handler (impostazione iniziale) un errore di comunicazione termina il client
+ * L'invio delle modifiche (readChange, dopo subscribeChanges o requestChangesSince) non viene ripreso:
+ * un'interruzione durante l'iscrizione o la sincronizzazione termina il client
+ */
+void setReconnectHandler(int (*handler)(int clientFD));
+
+/*
+ * Richieste inviate in anticipo (pipeline): vengono scritte subito sulla socket e il server
+ * le esegue mentre il client fa altro, la risposta viene letta solo quando serve
+ * Prima di ogni altra richiesta le risposte ancora in arrivo vengono lette e conservate,
+ * cosi' le funzioni di questo file possono continuare ad attendere la propria risposta
+ * Le modifiche e l'autenticazione scartano tutte le richieste anticipate, come una riconnessione
+ */
+#define MAX_PIPELINED 16 // Richieste anticipate in attesa di essere consumate
+
+/**
+ * Invia la richiesta toSend alla socket clientFD senza attenderne la risposta
+ *
+ * Restituisce 1 se e' stata inviata, 0 se ci sono gia' MAX_PIPELINED richieste anticipate,
+ * se la stessa richiesta e' gia' stata anticipata o in caso di errore di comunicazione
+ */
+int pipelineRequest(int clientFD, serverPacket toSend);
+/**
+ * Restituisce 1 se la richiesta request e' stata anticipata e la risposta non e' ancora stata consumata
+ */
+int pipelineContains(serverPacket request);
+/**
+ * Consuma la risposta alla richiesta anticipata request salvandola in received, attendendola se non e' ancora arrivata
+ *
+ * Restituisce 1 in caso di successo, 0 se la richiesta non era stata anticipata o la connessione si e' interrotta
+ */
+int pipelineResponse(int clientFD, serverPacket request, serverPacket *received);
+/**
+ * Scarta tutte le richieste anticipate: le risposte ancora in arrivo verranno lette e ignorate
+ */
+void pipelineDiscard(void);
 
 
 
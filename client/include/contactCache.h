@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) 2024 Giannuzzi Riccardo, Biribo' Francesco, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Numero massimo di letture conservate nella cache del client
+#define CONTACT_CACHE_SIZE 64
+
+/**
+ * Variante di insensitiveReadContact (o di readContact, secondo readOperation)
+ * che conserva le risposte del server in una cache LRU di CONTACT_CACHE_SIZE letture
+ * 
+ * Se la lettura e' gia' in cache viene inviata una lettura condizionata con la sua versione:
+ * se il risultato e' ancora valido il server risponde senza cercare nella rubrica
+ * e il contatto viene preso dalla cache
+ * 
+ * Restituisce l'esito dell'operazione, come insensitiveReadContact
+ */
+int cachedReadContact(int clientFD, char readOperation, Contact *toRead, int matchIndex, Contact *serverRead);
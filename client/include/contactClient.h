@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2024 Giannuzzi Riccardo, Biribo' Francesco, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * libcontactclient - Accesso asincrono alla rubrica da altri programmi
+ *
+ * Un contactClient mantiene un insieme di connessioni verso uno o piu' server e vi distribuisce
+ * le richieste, ognuna con la propria funzione di risposta. Nessuna funzione si blocca: il programma
+ * che usa la libreria inserisce i descrittori restituiti da ccPollFds nel proprio ciclo di poll
+ * e chiama ccProcess quando sono pronti (oppure chiama ccRun, che fa entrambe le cose)
+ *
+ * Ogni connessione tiene fino a CC_MAX_IN_FLIGHT richieste inviate in attesa di risposta: il server
+ * le serve una alla volta, nell'ordine di arrivo, quindi le risposte vengono abbinate in ordine
+ * Quando una connessione si interrompe viene riaperta, con un'attesa crescente se i tentativi falliscono:
+ *  - le richieste non ancora inviate e le letture (READ, COUNT, ...) vengono ripetute su un'altra connessione
+ *  - ADD, DEL e MODIFY gia' inviati potrebbero essere stati eseguiti, e vengono restituiti con CC_DISCONNECTED
+ *
+ * Le funzioni di risposta vengono chiamate solo da ccProcess, ccRun e ccDestroy, e possono inviare
+ * nuove richieste con ccSubmit (ma non chiamare ccDestroy)
+ */
+
+#include <poll.h>
+#include "connection.h"
+
+#define CC_MAX_IN_FLIGHT 32 // Richieste inviate su una connessione in attesa di risposta
+#define CC_INITIAL_DELAY_MS 100 // Attesa dopo il primo tentativo di connessione fallito
+#define CC_MAX_DELAY_MS 10000 // Attesa massima tra due tentativi
+#define CC_MAX_FAILURES 8 // Tentativi falliti su tutte le connessioni dopo cui le richieste in coda vengono scartate
+
+// Esiti restituiti alle funzioni di risposta
+#define CC_RESPONSE 1 // Risposta del server ricevuta (l'esito dell'operazione e' in response->outcome)
+#define CC_DISCONNECTED 2 // Connessione interrotta dopo l'invio di una modifica, che potrebbe essere stata eseguita
+#define CC_UNAVAILABLE 3 // Nessun server raggiungibile (per le modifiche, nessun server che non sia una replica)
+#define CC_AUTH_FAILED 4 // Le credenziali del client sono state rifiutate
+#define CC_CLOSED 5 // Client chiuso con ccDestroy prima della risposta
+
+typedef struct contactClient contactClient;
+
+/**
+ * Funzione chiamata al termine di una richiesta, con il context passato a ccSubmit,
+ * uno degli esiti CC_* e, solo con CC_RESPONSE, il pacchetto di risposta (valido durante la chiamata)
+ */
+typedef void (*contactCallback)(void *context, int status, const serverPacket *response);
+
+/**
+ * Crea un client con connectionsPerServer connessioni verso ognuno dei serverCount server indicati
+ * Gli indirizzi hanno la forma indirizzo:porta (localhost o IPv4) oppure sono il percorso di una socket locale
+ *
+ * Con username e password (anche NULL) ogni connessione si autentica appena aperta, sulla rubrica
+ * condivisa, e le credenziali vengono aggiunte a ADD, DEL e MODIFY che non le contengono
+ * Le modifiche vengono inviate solo sulle connessioni autenticate: i server che rispondono REDIRECT
+ * all'autenticazione (repliche) ricevono solo letture, e se tutti i server sono repliche le modifiche
+ * terminano con CC_UNAVAILABLE
+ *
+ * Le connessioni vengono aperte subito, senza attendere
+ *
+ * Restituisce il client, NULL se un indirizzo non e' valido o manca memoria
+ */
+contactClient *ccCreate(const char **servers, int serverCount, int connectionsPerServer, const char *username, const char *password);
+
+/**
+ * Accoda la richiesta request: callback verra' chiamata una volta sola con il risultato
+ * Sono ammesse le letture (READ, INSENSITIVE_READ, SUFFIX_READ, FUZZY_READ, ORDERED_READ, COUNT)
+ * e le modifiche (ADD, DEL, MODIFY); AUTH viene gestito dal client, SUBSCRIBE e SYNC_SINCE non sono supportati
+ *
+ * Restituisce 1 se la richiesta e' stata accodata, 0 se l'operazione non e' ammessa o le credenziali sono state rifiutate
+ */
+int ccSubmit(contactClient *client, const serverPacket *request, contactCallback callback, void *context);
+
+/**
+ * Scrive in fds (al massimo size elementi) i descrittori da controllare con poll e i relativi eventi
+ *
+ * Restituisce il numero di elementi scritti
+ */
+int ccPollFds(contactClient *client, struct pollfd *fds, int size);
+
+/**
+ * Restituisce il tempo massimo in millisecondi da attendere in poll prima di chiamare ccProcess
+ * (0 se ci sono richieste da inviare subito, -1 se basta attendere i descrittori)
+ */
+int ccPollTimeout(contactClient *client);
+
+/**
+ * Esegue le letture e le scritture pronte secondo il risultato del poll (fds, count), chiama
+ * le funzioni di risposta delle richieste concluse, riapre le connessioni e invia le richieste in coda
+ */
+void ccProcess(contactClient *client, const struct pollfd *fds, int count);
+
+/**
+ * Attende al massimo timeout millisecondi (-1 senza limite) che ci sia qualcosa da fare ed esegue ccProcess,
+ * per i programmi che non hanno un proprio ciclo di poll
+ *
+ * Restituisce il numero di richieste ancora in attesa di risultato, -1 in caso di errore di poll
+ */
+int ccRun(contactClient *client, int timeout);
+
+/**
+ * Restituisce il numero di richieste accodate o inviate ancora in attesa di risultato
+ */
+int ccPending(contactClient *client);
+
+/**
+ * Chiude le connessioni e libera il client: le richieste ancora in attesa terminano con CC_CLOSED
+ */
+void ccDestroy(contactClient *client);
@@ -0,0 +1,24 @@
+/*
+ * Copyright (c) 2024 Giannuzzi Riccardo, Biribo' Francesco, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// File in cui il client conserva la propria copia della rubrica
+#define LOCAL_COPY_PATH "rubrica_locale.txt"
+
+/**
+ * Aggiorna la copia locale della rubrica salvata nel file path
+ * 
+ * La prima riga del file contiene la versione della rubrica a cui si riferisce la copia,
+ * le successive i contatti nel formato della rubrica del server (nome,cognome,numero)
+ * Al server vengono chieste solo le modifiche successive a quella versione (SYNC_SINCE),
+ * se non le ha piu' tutte invia la rubrica completa che sostituisce la copia
+ * 
+ * In changes viene salvato il numero di modifiche ricevute, in total il numero di contatti della copia
+ * 
+ * Restituisce 1 in caso di successo, 0 altrimenti (la copia resta quella precedente)
+ */
+int syncLocalCopy(int clientFD, const char *path, int *changes, int *total);
@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2024 Giannuzzi Riccardo, Biribo' Francesco, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Corrispondenze successive richieste in anticipo mentre l'utente guarda quella attuale
+#define DEFAULT_PREFETCH_WINDOW 3
+
+/**
+ * Imposta quante corrispondenze successive richiedere in anticipo (0 per non anticiparne nessuna),
+ * al massimo MAX_PIPELINED
+ */
+void setPrefetchWindow(int window);
+
+/**
+ * Da chiamare dopo aver mostrato la corrispondenza numero matchIndex della ricerca (readOperation, toRead):
+ * invia al server, senza attendere le risposte, le letture delle corrispondenze successive
+ * che non sono gia' state richieste, in modo che il server le cerchi mentre l'utente legge
+ * maxDistance e' la distanza massima per FUZZY_READ, ignorata dalle altre letture
+ *
+ * Le letture anticipate di una ricerca precedente vengono scartate
+ */
+void prefetchMatches(int clientFD, char readOperation, Contact *toRead, int maxDistance, int matchIndex);
+
+/**
+ * Scarta le letture anticipate ancora in attesa, da chiamare quando una ricerca ricomincia
+ * dalla prima corrispondenza o si esce dalla lettura: le risposte gia' ricevute potrebbero
+ * non descrivere piu' la rubrica quando la stessa ricerca verra' ripetuta
+ */
+void resetPrefetch(void);
+
+/**
+ * Legge la corrispondenza numero matchIndex della ricerca (readOperation, toRead): se e' stata
+ * anticipata con prefetchMatches usa quella risposta, altrimenti la chiede al server con la
+ * funzione di lettura corrispondente (cachedReadContact, fuzzyReadContact o suffixReadContact)
+ *
+ * Restituisce l'esito dell'operazione, come le funzioni di lettura
+ */
+int pagedReadContact(int clientFD, char readOperation, Contact *toRead, int maxDistance, int matchIndex, Contact *serverRead);
@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2024 Giannuzzi Riccardo, Biribo' Francesco, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/socket.h>
+
+#define MAX_CONNECTION_ATTEMPTS 5 // Numero massimo di tentativi di connessione
+#define INITIAL_DELAY 2 // Tempo di attesa iniziale dopo un tentativo di connessione
+#define MAX_DELAY 30 // Tempo di attesa massimo dopo un tentativo di connessione
+
+/**
+ * Restituisce i secondi da attendere dopo il tentativo di connessione fallito numero attempt (da 1):
+ * il tempo raddoppia a ogni tentativo fino a MAX_DELAY, e viene ridotto a caso fino a meta'
+ * in modo che i client scollegati dallo stesso riavvio del server non ritentino tutti insieme
+ */
+int backoffDelay(int attempt);
+
+/**
+ * Salva l'indirizzo del server (address, lungo length) a cui riconnettersi
+ */
+void setServerAddress(const struct sockaddr *address, socklen_t length);
+
+/**
+ * Riapre la connessione al server sul descrittore clientFD, con al massimo MAX_CONNECTION_ATTEMPTS
+ * tentativi distanziati da backoffDelay, mostrando all'utente l'attesa
+ * Da registrare con setReconnectHandler (connection.h)
+ *
+ * Restituisce 1 se la connessione e' stata ristabilita, 0 altrimenti
+ */
+int reconnectToServer(int clientFD);
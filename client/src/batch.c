@@ -0,0 +1,360 @@
+/*
+ * Copyright (c) 2024 Giannuzzi Riccardo, Biribo' Francesco, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "./../include/connection.h"
+#include "./../include/batch.h"
+
+#define BATCH_LINE_LENGTH 256 // Righe piu' lunghe non sono valide
+#define BATCH_MAX_FIELDS 8
+
+/**
+ * Operazione del batch
+ *
+ * Campi:
+ *  name - Nome usato nelle righe
+ *  operation - Operazione del protocollo
+ *  minFields, maxFields - Numero di campi ammessi dopo il nome
+ */
+typedef struct {
+    const char *name;
+    char operation;
+    int minFields;
+    int maxFields;
+} batchCommand;
+
+static const batchCommand commands[] = {
+    {"auth", AUTH, 2, 2},
+    {"read", READ, 3, 4},
+    {"iread", INSENSITIVE_READ, 3, 4},
+    {"sread", SUFFIX_READ, 3, 4},
+    {"fread", FUZZY_READ, 4, 5},
+    {"count", COUNT, 3, 3},
+    {"add", ADD, 3, 3},
+    {"del", DEL, 3, 3},
+    {"mod", MODIFY, 6, 6},
+};
+
+/**
+ * Riga in attesa di risultato
+ *
+ * Campi:
+ *  line - Numero della riga nell'input
+ *  command - Operazione della riga, NULL se il nome non e' valido
+ *  sent - 1 se la richiesta e' stata inviata, 0 se la riga non era valida
+ */
+typedef struct {
+    unsigned long line;
+    const batchCommand *command;
+    int sent;
+} pendingLine;
+
+/**
+ * Divide line nei campi separati da virgole, tenendo quelli vuoti (a differenza di strtok)
+ *
+ * Restituisce il numero di campi, -1 se sono piu' di BATCH_MAX_FIELDS
+ */
+static int splitFields(char *line, char **fields) {
+    int count = 0;
+    char *cursor = line;
+    while(count < BATCH_MAX_FIELDS) {
+        fields[count++] = cursor;
+        char *comma = strchr(cursor, ',');
+        if(comma == NULL)
+            return count;
+        *comma = '\0';
+        cursor = comma + 1;
+    }
+    return -1;
+}
+
+/**
+ * Controlla che nome, cognome e numero siano validi per una ricerca (vuoti oppure validi)
+ * o, se complete vale 1, per un contatto da inviare (tutti presenti e validi)
+ * Con suffix il numero puo' essere solo una parte finale, di sole cifre
+ */
+static int validContact(char *name, char *surname, char *phoneNumber, int complete, int suffix) {
+    if(strlen(name) > CONTACT_PARAM_LENGTH || strlen(surname) > CONTACT_PARAM_LENGTH || strlen(phoneNumber) > CONTACT_PARAM_LENGTH)
+        return 0;
+    if(complete)
+        return isNameValidAndNotEmpty(name) && isSurnameValidAndNotEmpty(surname) && isPhoneNumberValidAndNotEmpty(phoneNumber);
+    if(suffix) {
+        for(int i = 0; phoneNumber[i] != '\0'; i++) {
+            if(!isDigit(phoneNumber[i]))
+                return 0;
+        }
+        return isNameValid(name) && isSurnameValid(surname);
+    }
+    return isNameValid(name) && isSurnameValid(surname) && isPhoneNumberValid(phoneNumber);
+}
+
+/**
+ * Legge un numero intero positivo (o zero, se zero vale 1) da text
+ *
+ * Restituisce il numero, -1 se non e' valido
+ */
+static long parseNumber(const char *text, int zero) {
+    char *end;
+    long value = strtol(text, &end, 10);
+    if(*text == '\0' || *end != '\0' || value < (zero ? 0 : 1) || value > 1000000000L)
+        return -1;
+    return value;
+}
+
+/**
+ * Prepara in packet la richiesta della riga line, gia' privata del fine riga
+ * Le credenziali di una riga auth vengono salvate in username e password, e usate da add, del e mod
+ *
+ * Restituisce l'operazione della riga (NULL se il nome non e' valido) in *command
+ * e 1 se la richiesta e' valida e va inviata, 0 altrimenti
+ */
+static int buildRequest(char *line, serverPacket *packet, char *username, char *password, const batchCommand **command) {
+    char *fields[BATCH_MAX_FIELDS];
+    int count = splitFields(line, fields);
+    *command = NULL;
+    if(count < 1)
+        return 0;
+    for(size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+        if(strcmp(fields[0], commands[i].name) == 0)
+            *command = &commands[i];
+    }
+    if(*command == NULL || count - 1 < (*command)->minFields || count - 1 > (*command)->maxFields)
+        return 0;
+
+    memset(packet, 0, sizeof(serverPacket));
+    packet->operation = (*command)->operation;
+    char **args = fields + 1;
+    switch(packet->operation) {
+        case AUTH:
+            if(!isUsernameValidAndNotEmpty(args[0]) || strlen(args[0]) > AUTH_PARAM_LENGTH || !isPasswordValid(args[1]) || strlen(args[1]) > AUTH_PARAM_LENGTH)
+                return 0;
+            strcpy(username, args[0]);
+            strcpy(password, args[1]);
+            strcpy(packet->username, username);
+            strcpy(packet->password, password);
+            if(usesPersonalBook())
+                packet->newName[0] = PERSONAL_BOOK;
+            return 1;
+        case READ:
+        case INSENSITIVE_READ:
+        case SUFFIX_READ:
+        case FUZZY_READ:
+        case COUNT: {
+            if(!validContact(args[0], args[1], args[2], 0, packet->operation == SUFFIX_READ))
+                return 0;
+            long matchIndex = 1;
+            int indexField = packet->operation == FUZZY_READ ? 4 : 3;
+            if(packet->operation == FUZZY_READ) {
+                long distance = parseNumber(args[3], 1);
+                if(distance < 0)
+                    return 0;
+
+                // Oltre la lunghezza dei campi ogni contatto corrisponde, e il server la limita comunque
+                int maxDistance = distance > CONTACT_PARAM_LENGTH ? CONTACT_PARAM_LENGTH : (int)distance;
+                snprintf(packet->newName, sizeof(packet->newName), "%d", maxDistance);
+            } else if(packet->operation == COUNT) {
+                packet->newName[0] = READ; // Il conteggio usa i criteri della lettura esatta
+            }
+            if(count - 1 > indexField && (matchIndex = parseNumber(args[indexField], 0)) < 0)
+                return 0;
+            packet->matchIndex = (unsigned int)matchIndex;
+            break;
+        }
+        case MODIFY:
+            if(!validContact(args[3], args[4], args[5], 1, 0))
+                return 0;
+            strcpy(packet->newName, args[3]);
+            strcpy(packet->newSurname, args[4]);
+            strcpy(packet->newPhoneNumber, args[5]);
+            // Prosegue come ADD e DEL per il contatto originale e le credenziali
+            /* fall through */
+        default: // ADD, DEL
+            if(!validContact(args[0], args[1], args[2], 1, 0))
+                return 0;
+            strcpy(packet->username, username);
+            strcpy(packet->password, password);
+            break;
+    }
+    strcpy(packet->name, args[0]);
+    strcpy(packet->surname, args[1]);
+    strcpy(packet->phoneNumber, args[2]);
+    return 1;
+}
+
+/**
+ * Restituisce il nome dell'esito outcome usato nei risultati
+ */
+static const char *outcomeName(char outcome) {
+    switch(outcome) {
+        case OPERATION_SUCCESS: return "OK";
+        case READ_CONTACT_MISSING: return "MISSING";
+        case CREDENTIALS_EXPIRED: return "CREDENTIALS_EXPIRED";
+        case CONTACT_ALREADY_MODIFIED: return "ALREADY_MODIFIED";
+        case CONTACT_ALREADY_EXISTS: return "ALREADY_EXISTS";
+        case CHANGES_LOST: return "CHANGES_LOST";
+        case NOT_MODIFIED: return "NOT_MODIFIED";
+        case REDIRECT: return "REDIRECT";
+        case SERVER_BUSY: return "BUSY";
+        case INVALID_PACKET: return "INVALID_PACKET";
+        default: return "ERROR";
+    }
+}
+
+/**
+ * Scrive su output il risultato della riga pending, con la risposta response (NULL se non e' stata inviata)
+ */
+static void printResult(FILE *output, const pendingLine *pending, const serverPacket *response) {
+    const char *name = pending->command != NULL ? pending->command->name : "?";
+    if(response == NULL) {
+        fprintf(output, "%lu,%s,INVALID_INPUT\n", pending->line, name);
+        return;
+    }
+    fprintf(output, "%lu,%s,%s", pending->line, name, outcomeName(response->outcome));
+    if(response->outcome == OPERATION_SUCCESS) {
+        char operation = pending->command->operation;
+        if(operation == COUNT)
+            fprintf(output, ",%u", response->matchIndex);
+        else if(operation == READ || operation == INSENSITIVE_READ || operation == SUFFIX_READ || operation == FUZZY_READ)
+            fprintf(output, ",%s,%s,%s", response->name, response->surname, response->phoneNumber);
+    } else if(response->outcome == REDIRECT) {
+        fprintf(output, ",%s:%u", response->username, response->matchIndex);
+    }
+    fprintf(output, "\n");
+}
+
+/**
+ * Scrive sulla socket fd i length byte di buffer, anche in piu' write
+ *
+ * Restituisce 1 in caso di successo, 0 altrimenti
+ */
+static int writeAll(int fd, const char *buffer, size_t length) {
+    size_t done = 0;
+    while(done < length) {
+        ssize_t written = write(fd, buffer + done, length - done);
+        if(written < 0 && errno == EINTR)
+            continue;
+        if(written <= 0)
+            return 0;
+        done += written;
+    }
+    return 1;
+}
+
+/**
+ * Legge dalla socket fd esattamente length byte in buffer, anche in piu' read
+ *
+ * Restituisce 1 in caso di successo, 0 se la connessione si interrompe prima
+ */
+static int readAll(int fd, char *buffer, size_t length) {
+    size_t done = 0;
+    while(done < length) {
+        ssize_t received = read(fd, buffer + done, length - done);
+        if(received < 0 && errno == EINTR)
+            continue;
+        if(received <= 0)
+            return 0;
+        done += received;
+    }
+    return 1;
+}
+
+int runBatch(int clientFD, FILE *input, FILE *output) {
+    char line[BATCH_LINE_LENGTH + 2];
+    char username[AUTH_PARAM_LENGTH + 1] = "", password[AUTH_PARAM_LENGTH + 1] = "";
+    char requests[BATCH_WINDOW * PACKET_LENGTH], received[PACKET_LENGTH];
+    pendingLine pending[BATCH_WINDOW];
+    unsigned long lineNumber = 0, sentTotal = 0, succeeded = 0, invalid = 0;
+    int finished = 0, ok = 1;
+
+    while(!finished && ok) {
+
+        // Prepariamo fino a BATCH_WINDOW righe (valide o no, i risultati escono nell'ordine dell'input)
+        int lines = 0, sent = 0;
+        while(lines < BATCH_WINDOW) {
+            if(fgets(line, sizeof(line), input) == NULL) {
+                finished = 1;
+                break;
+            }
+            lineNumber++;
+
+            // Una riga troppo lunga viene scartata fino alla fine
+            size_t length = strlen(line);
+            int tooLong = length > 0 && line[length - 1] != '\n' && !feof(input);
+            if(tooLong) {
+                int chr;
+                while((chr = fgetc(input)) != EOF && chr != '\n');
+            }
+            line[strcspn(line, "\r\n")] = '\0';
+            if(!tooLong && (line[0] == '\0' || line[0] == '#'))
+                continue;
+
+            serverPacket packet;
+            pending[lines].line = lineNumber;
+            pending[lines].sent = !tooLong && buildRequest(line, &packet, username, password, &pending[lines].command);
+            if(pending[lines].sent) {
+                buildMessage(requests + sent * PACKET_LENGTH, packet);
+                sent++;
+            } else {
+                if(tooLong)
+                    pending[lines].command = NULL;
+                invalid++;
+            }
+            lines++;
+        }
+
+        /*
+         * Tutte le richieste del gruppo partono con una sola scrittura, poi arrivano le risposte nello stesso ordine
+         * Le risposte si leggono una alla volta: un server occupato invia un solo SERVER_BUSY e chiude
+         * senza leggere le richieste, e la scrittura stessa puo' fallire dopo il suo arrivo
+         */
+        if(sent > 0)
+            writeAll(clientFD, requests, sent * PACKET_LENGTH);
+        for(int i = 0; i < lines && ok; i++) {
+            if(!pending[i].sent) {
+                printResult(output, &pending[i], NULL);
+                continue;
+            }
+            if(!readAll(clientFD, received, PACKET_LENGTH)) {
+                fprintf(stderr, "Impossibile comunicare con il server, interrotto alla riga %lu\n", pending[i].line);
+                ok = 0;
+                break;
+            }
+            serverPacket response;
+            buildEmptyPacket(&response);
+            parseMessage(received, &response);
+            printResult(output, &pending[i], &response);
+            if(response.outcome == OPERATION_SUCCESS)
+                succeeded++;
+
+            // Dopo SERVER_BUSY il server ha gia' chiuso la connessione
+            if(response.outcome == SERVER_BUSY) {
+                fprintf(stderr, "Il server e' occupato, riprova piu' tardi\n");
+                ok = 0;
+            }
+        }
+        sentTotal += sent;
+    }
+
+    // Chiusura della sessione (pacchetto INT), senza stampare nulla: l'output contiene solo i risultati
+    if(ok) {
+        char closing[PACKET_LENGTH];
+        memset(closing, '\0', PACKET_LENGTH);
+        closing[OPERATION_INDEX] = INT;
+        if(writeAll(clientFD, closing, PACKET_LENGTH))
+            readAll(clientFD, closing, PACKET_LENGTH);
+    }
+    close(clientFD);
+    fflush(output);
+
+    fprintf(stderr, "Batch: %lu richieste inviate, %lu con esito OK, %lu righe non valide\n", sentTotal, succeeded, invalid);
+    return ok;
+}
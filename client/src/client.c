@@ -12,20 +12,27 @@
 #include <string.h>
 #include <time.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <signal.h>
 #include <netinet/in.h>
 #include <termios.h>
 #include <arpa/inet.h>
+#include <poll.h>
 #include "./../include/connection.h"
+#include "./../include/contactCache.h"
+#include "./../include/localCopy.h"
+#include "./../include/batch.h"
+#include "./../include/reconnect.h"
+#include "./../include/prefetch.h"
 
 #define DEFAULT_PORT 50000 // Porta default
-#define MAX_CONNECTION_ATTEMPTS 5 // Numero massimo di tentativi di connessione
-#define INITIAL_DELAY 2 // Tempo di attesa iniziale dopo un tentativo di connessione
-#define MAX_DELAY 30 // Tempo di attesa massimo dopo un tentativo di connessione
 
 #define MAX_AUTH_ATTEMPTS 3 // Numero massimo di tentativi di autenticazione falliti
 #define AUTH_COOLDOWN_TIME 60 // Tempo di attesa dopo un che l'utente supera il massimo di tentativi di autenticazione falliti
 
+#define FUZZY_DISTANCE 2 // Numero massimo di errori di battitura tollerati nella ricerca approssimata
+#define LIST_PAGE_SIZE 5 // Numero di contatti mostrati per pagina nell'elenco alfabetico
+
 /*
  * clientFd - FD della socket usata per comunicare con il server, ottenuta tramite accept
  * 
@@ -45,21 +52,35 @@ void ctrlc_handler(int sig) {
 }
 
 /*
- * Gestiamo il segnale SIGPIPE
- * Vogliamo gestire la chiusura improvvisa della socket del server
- * Chiudendo correttamente la socket
+ * Chiede al server quanti contatti corrispondono in totale ai parametri
+ * di toRead, con i criteri di readOperation, e li mostra all'utente
+ * Un solo scambio di pacchetti, invece di leggere le corrispondenze una per una
  */
-void sigpipe_handler(int sig) {
-    close(clientFD);
-    printf("Connessione chiusa");
-    exit(EXIT_FAILURE);
+void printMatchCount(char readOperation, Contact *toRead) {
+    int count;
+    if(countContacts(clientFD, readOperation, toRead, &count))
+        printf("Corrispondenze totali: " BMAGENTA "%d" RESET_COLOR "\n\n", count);
+}
+
+/*
+ * Il server e' una replica in sola lettura: indica all'utente
+ * il primario a cui collegarsi per autenticarsi e modificare la rubrica
+ */
+void printRedirect(void) {
+    char host[AUTH_PARAM_LENGTH + 1], message[100];
+    int port;
+    getPrimaryAddress(host, &port);
+    sprintf(message, "Il server e' una replica in sola lettura, per le modifiche collegarsi a %s %d", host, port);
+    printCommunication(message, YELLOW);
 }
 
 int main(int argc, char** argv) {
 
 	/* Inizializzazione strutture dati e collegamento al server */
     struct sockaddr_in serverAddress;
+    struct sockaddr_un localAddress;
     struct sockaddr* serverAddressPtr;
+    socklen_t addressLength = sizeof(serverAddress);
     serverAddressPtr = (struct sockaddr*) &serverAddress;
     serverAddress.sin_family = AF_INET;
     int port;
@@ -72,8 +93,41 @@ int main(int argc, char** argv) {
      *   ./client - In automatico cerca di collegarsi un server Locale sulla porta 50000
      *   ./client localhost 50000 o ./client 127.0.0.1 50000 - Stesso effetto della riga soprastante
      *   ./client 54.23.132.12 54434 - Cerca di collegarsi ad un server all'IP 54.23.132.12 al numero di porta 54434
+     *   ./client /tmp/rubrica.sock - Si collega alla socket locale di un server sulla stessa macchina (avviato con -u)
+     *   ./client -b operazioni.txt [indirizzo porta | socket] - Esegue senza menu le operazioni del file (- per lo standard input)
+     *   ./client -w 5 [indirizzo porta | socket] - Durante la lettura anticipa 5 corrispondenze successive (0 per nessuna)
+     *   ./client -l [indirizzo porta | socket] - Dopo l'autenticazione usa la rubrica personale dell'utente invece di quella condivisa
      */
-    if(argc == 3) { // Se sono sufficienti i parametri
+    const char *batchPath = NULL;
+    while(argc >= 2) {
+        if(strcmp(argv[1], "-l") == 0) {
+            setPersonalBook(1);
+            argv++;
+            argc--;
+        } else if(argc >= 3 && (strcmp(argv[1], "-b") == 0 || strcmp(argv[1], "-w") == 0)) {
+            if(argv[1][1] == 'b')
+                batchPath = argv[2];
+            else
+                setPrefetchWindow(atoi(argv[2]));
+            argv += 2;
+            argc -= 2;
+        } else {
+            break;
+        }
+    }
+    if(argc == 2) { // Socket locale, senza passare dallo stack di rete
+
+        // Il percorso deve entrare nell'indirizzo della socket
+        if(strlen(argv[1]) >= sizeof(localAddress.sun_path)) {
+            exit(EXIT_FAILURE);
+        }
+        memset(&localAddress, 0, sizeof(localAddress));
+        localAddress.sun_family = AF_UNIX;
+        strcpy(localAddress.sun_path, argv[1]);
+        serverAddressPtr = (struct sockaddr*) &localAddress;
+        addressLength = sizeof(localAddress);
+        port = 0;
+    } else if(argc == 3) { // Se sono sufficienti i parametri
 
         /*
          * Trasformiamo la stringa contente l'indirizzo IP in
@@ -104,7 +158,7 @@ int main(int argc, char** argv) {
     serverAddress.sin_port = htons(port);
 
     // Proviamo ad aprire la socket
-    clientFD = socket(AF_INET, SOCK_STREAM, 0);
+    clientFD = socket(serverAddressPtr->sa_family, SOCK_STREAM, 0);
     if(clientFD < 0) {
         perror("socket");
         exit(EXIT_FAILURE);
@@ -112,30 +166,46 @@ int main(int argc, char** argv) {
     
     int result;
     // Proviamo a connetterci al server
-    result = connect(clientFD, serverAddressPtr, sizeof(serverAddress));
+    result = connect(clientFD, serverAddressPtr, addressLength);
+
+    /*
+     * In modalita' batch (script, cron) non ci sono schermate ne' nuovi tentativi di connessione:
+     * un errore viene segnalato dal codice di uscita, e una scrittura su socket chiusa
+     * viene gestita da runBatch invece di terminare con SIGPIPE
+     */
+    if(batchPath != NULL) {
+        if(result == -1) {
+            perror("connect");
+            exit(EXIT_FAILURE);
+        }
+        signal(SIGPIPE, SIG_IGN);
+        FILE *input = strcmp(batchPath, "-") == 0 ? stdin : fopen(batchPath, "r");
+        if(input == NULL) {
+            perror(batchPath);
+            close(clientFD);
+            exit(EXIT_FAILURE);
+        }
+        exit(runBatch(clientFD, input, stdout) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
     
     /*
      * Gestione dei SIGPIPE
-     * Vogliamo limitare le interruzioni della connessione al server il piu' possibile
-     * perlomeno controllando la scrittura su socket chiusa
-     * 
-     * Gestiamo SIGPIPE
+     * Vogliamo limitare le interruzioni della connessione al server il piu' possibile:
+     * una scrittura su socket chiusa non termina il client ma fallisce, e la connessione
+     * viene ristabilita da reconnectToServer (vedi setReconnectHandler)
      */
-    signal(SIGPIPE, sigpipe_handler);
+    signal(SIGPIPE, SIG_IGN);
+    setServerAddress(serverAddressPtr, addressLength);
 
     /*
      * Non proviamo a connetterci al server una volta soltanto, in quanto potrebbe non funzionare subito al primo tentativo
      * Per questo proviamo piu' tentativi di connessione, aumentando ogni volta l'intervallo tra un tentativo e l'altro
      */
-    int delay = INITIAL_DELAY, attempt = 1;
+    int attempt = 1;
     while(result == -1 && attempt < MAX_CONNECTION_ATTEMPTS) { // Finchè non siamo connessi e abbiamo tentativi a disposizione
         
-        // Aumenta il tempo che intercorre per il prossimo tentativo
-        int delay = INITIAL_DELAY * ((attempt-1) * (attempt-1) + 1); // backoff esponenziale
-
-        // Non superiamo comunque un tempo massimo di intervallo di attesa
-        if(delay > MAX_DELAY)
-            delay = MAX_DELAY;
+        // Aumenta il tempo che intercorre per il prossimo tentativo (backoff esponenziale con variazione casuale)
+        int delay = backoffDelay(attempt);
 
         // Decrementiamo un secondo alla volta per comunicare in modo più preciso i secondi mancanti all'utente
         while (delay >0){
@@ -146,7 +216,7 @@ int main(int argc, char** argv) {
             delay--;
         }
         
-        result = connect(clientFD, serverAddressPtr, sizeof(serverAddress));
+        result = connect(clientFD, serverAddressPtr, addressLength);
         attempt++;
     }
 
@@ -170,9 +240,10 @@ int main(int argc, char** argv) {
         printf(RED "\nImpossibile stabilire una connessione con il server\n" RESET_COLOR);
     
     } else {
-        // Connessi
+        // Connessi, da ora le interruzioni della connessione vengono gestite riconnettendosi
         printf(CLEAR);
         connected = 1;
+        setReconnectHandler(reconnectToServer);
         printf(GREEN "\nConnessione con il server stabilita con successo\n" RESET_COLOR);
         sleep(1);
         printf(CLEAR);
@@ -192,6 +263,9 @@ int main(int argc, char** argv) {
         printTitle("       GESTIONE RUBRICA       ");
         printf("[" BCYAN "1" RESET_COLOR "] Leggere rubrica\n");
         printf(authenticated ? "["BCYAN "2" RESET_COLOR "] Modificare rubrica\n" : "[" BCYAN "2" RESET_COLOR "] Autenticati\n");
+        printf("[" BCYAN "3" RESET_COLOR "] Elencare la rubrica in ordine alfabetico\n");
+        printf("[" BCYAN "4" RESET_COLOR "] Seguire le modifiche alla rubrica\n");
+        printf("[" BCYAN "5" RESET_COLOR "] Sincronizzare la copia locale della rubrica\n");
         printf("[" BRED "x" RESET_COLOR "] Terminare sessione\n\n");
         printf("Selezionare un'opzione: " CYAN); // Per rendere il colore del testo digitato dall'utente ciano
         operation = getSingleChar();
@@ -207,14 +281,16 @@ int main(int argc, char** argv) {
                 getOptionalContact(toReadPtr, "       ACQUISIZIONE DATI LETTURA       ");
 
                 Contact serverContact;
-                // Richiesta di lettura al server
-                int outcome = readContact(clientFD,toReadPtr,matchIndex,&serverContact);
+                // Richiesta di lettura al server, che ricomincia dalla prima corrispondenza
+                resetPrefetch();
+                int outcome = cachedReadContact(clientFD,INSENSITIVE_READ,toReadPtr,matchIndex,&serverContact);
 
-                int reading = 1, matchedContact = 1;
+                int reading = 1, matchedContact = 1, fuzzy = 0, suffix = 0;
                 // Controlliamo il risultato dell'operazione sul server
                 if(outcome == 1) { // Lettura avvenuta con successo
                     // Mostriamo il contatto trovato, quello che è stato letto
                     printCommunication("Individuata corrispondenza con successo",GREEN);
+                    printMatchCount(INSENSITIVE_READ, toReadPtr);
                     printContactIndex(serverContact, matchIndex);
                 
                 } else if(outcome == 2) { // Non sono state trovate corrispondenze
@@ -234,10 +310,23 @@ int main(int argc, char** argv) {
                 */
                 char readOption;
                 while(reading) {
+
+                    /*
+                     * Mentre l'utente legge il contatto mostrato il server cerca gia' le corrispondenze successive:
+                     * alla richiesta della successiva la risposta e' spesso gia' arrivata
+                     */
+                    char readMode = fuzzy ? FUZZY_READ : (suffix ? SUFFIX_READ : INSENSITIVE_READ);
+                    if(matchedContact)
+                        prefetchMatches(clientFD, readMode, &toRead, FUZZY_DISTANCE, matchIndex);
+
                     printTitle("       MENU DI LETTURA       ");
                     printf("[" BCYAN "1" RESET_COLOR "] Inserire dei dati da cercare differenti\n");
                     if(matchedContact)
                         printf("[" BCYAN "2" RESET_COLOR "] Leggere corrispondenza successiva con gli stessi dati\n");
+                    if(!fuzzy)
+                        printf("[" BCYAN "3" RESET_COLOR "] Cercare gli stessi dati tollerando errori di battitura\n");
+                    if(!suffix && toRead.phoneNumber[0] != '\0')
+                        printf("[" BCYAN "4" RESET_COLOR "] Cercare i numeri che terminano con le cifre inserite\n");
                     printf("[" BRED "x" RESET_COLOR "] Terminare la lettura\n\n");
                     printf("Selezionare un'opzione: " CYAN);
                     readOption = getSingleChar();
@@ -248,16 +337,20 @@ int main(int argc, char** argv) {
                         
                         case '1': // Modificare i criteri di ricerca
                             matchIndex = 1;
+                            fuzzy = 0;
+                            suffix = 0;
                             
                             // Acquisisce i dati diversi per cercare il record
                             getOptionalContact(toReadPtr, "       ACQUISIZIONE DATI LETTURA       ");
                             
                             // Richiesta al server
-                            outcome = readContact(clientFD,&toRead,matchIndex,&serverContact);
+                            resetPrefetch();
+                            outcome = cachedReadContact(clientFD,INSENSITIVE_READ,&toRead,matchIndex,&serverContact);
                             
                             // Lettura avvenuta con successo
                             if(outcome == 1) {
                                 printCommunication("Individuata corrispondenza con successo",GREEN);
+                                printMatchCount(INSENSITIVE_READ, &toRead);
                                 printContactIndex(serverContact, matchIndex);
                                 matchedContact = 1;
                             
@@ -280,8 +373,8 @@ int main(int argc, char** argv) {
                                 // Richiede al server il record successivo
                                 matchIndex++;
 
-                                // Richiesta al server
-                                outcome = readContact(clientFD,&toRead,matchIndex,&serverContact);
+                                // Richiesta al server (o risposta gia' anticipata), con la stessa modalita' di ricerca usata finora
+                                outcome = pagedReadContact(clientFD,readMode,&toRead,FUZZY_DISTANCE,matchIndex,&serverContact);
                                 
                                 // Lettura avvenuta con successo
                                 if(outcome == 1) {
@@ -304,6 +397,71 @@ int main(int argc, char** argv) {
                             }
                             break;
 
+                        case '3': // Ripetiamo la ricerca con gli stessi criteri tollerando errori di battitura
+                            if(!fuzzy) {
+                                fuzzy = 1;
+                                suffix = 0;
+                                matchIndex = 1;
+
+                                // Richiesta al server
+                                resetPrefetch();
+                                outcome = fuzzyReadContact(clientFD,&toRead,FUZZY_DISTANCE,matchIndex,&serverContact);
+
+                                // Lettura avvenuta con successo
+                                if(outcome == 1) {
+                                    printCommunication("Individuata corrispondenza approssimata con successo",GREEN);
+                                    printContactIndex(serverContact, matchIndex);
+                                    matchedContact = 1;
+
+                                // Nessun contatto trovato
+                                } else if(outcome == 2) {
+                                    printCommunication( "Non sono state individuate corrispondenze nemmeno tollerando errori di battitura", YELLOW);
+                                    matchedContact = 0;
+
+                                // Errore lato server
+                                } else {
+                                    printCommunication("Il server ha riscontrato un errore, operazione annullata", RED);
+                                    reading = 0;
+                                }
+
+                            } else { // La ricerca e' gia' approssimata
+                                printCommunication("Operazione selezionata non valida", RED);
+                            }
+                            break;
+
+                        case '4': // Ripetiamo la ricerca usando il numero inserito come ultime cifre
+                            if(!suffix && toRead.phoneNumber[0] != '\0') {
+                                suffix = 1;
+                                fuzzy = 0;
+                                matchIndex = 1;
+
+                                // Richiesta al server
+                                resetPrefetch();
+                                outcome = suffixReadContact(clientFD,&toRead,matchIndex,&serverContact);
+
+                                // Lettura avvenuta con successo
+                                if(outcome == 1) {
+                                    printCommunication("Individuata corrispondenza con successo",GREEN);
+                                    printMatchCount(SUFFIX_READ, &toRead);
+                                    printContactIndex(serverContact, matchIndex);
+                                    matchedContact = 1;
+
+                                // Nessun contatto trovato
+                                } else if(outcome == 2) {
+                                    printCommunication( "Nessun numero termina con le cifre inserite", YELLOW);
+                                    matchedContact = 0;
+
+                                // Errore lato server
+                                } else {
+                                    printCommunication("Il server ha riscontrato un errore, operazione annullata", RED);
+                                    reading = 0;
+                                }
+
+                            } else { // La ricerca e' gia' per ultime cifre, o non e' stato inserito un numero
+                                printCommunication("Operazione selezionata non valida", RED);
+                            }
+                            break;
+
                         // Interrompiamo la lettura (usciamo anche dal sottomenu)
                         case 'x':
                         case 'X':
@@ -317,6 +475,9 @@ int main(int argc, char** argv) {
                             break;
                     }
                 }
+
+                // Le corrispondenze anticipate non servono piu' fuori dal menu di lettura
+                resetPrefetch();
                 break;
                 
             case '2':
@@ -380,6 +541,12 @@ int main(int argc, char** argv) {
                                                 printCommunication("Impossibile aggiungere il nuovo contatto, è già presente un contatto identico", RED);
                                                 authenticated = 0;
                                             }
+                                            else if(outcome == 8) { // Il server non accetta modifiche
+                                                printRedirect();
+                                                modifying = 0;
+                                            }
+                                            else if(outcome == CONNECTION_LOST) // Risposta persa con la connessione
+                                                printCommunication("Connessione interrotta prima della risposta, verificare in rubrica se il contatto e' stato aggiunto", YELLOW);
                                             else // Errore lato server
                                                 printCommunication("Il server ha riscontrato un errore, operazione annullata", RED);
                                             adding = 0;
@@ -531,6 +698,13 @@ int main(int argc, char** argv) {
                                                    
                                                     } else if(outcome == 4) { // Il contatto è stato gia' cancellato 
                                                         printCommunication("Eliminazione fallita, il contatto è già stato eliminato", RED);
+                                                    }
+                                                    else if(outcome == 8) { // Il server non accetta modifiche
+                                                        printRedirect();
+                                                        modifying = 0;
+                                                    }
+                                                    else if(outcome == CONNECTION_LOST) { // Risposta persa con la connessione
+                                                        printCommunication("Connessione interrotta prima della risposta, verificare in rubrica se il contatto e' stato eliminato", YELLOW);
                                                     }
                                                      else { // Errore lato server
                                                         printCommunication("Il server ha riscontrato un errore, operazione annullata", RED);
@@ -695,7 +869,17 @@ int main(int argc, char** argv) {
                                                     } else if(outcome == 4) { // Contatto non piu' presente in rubrica
                                                         printCommunication("Modifica fallita, il contatto da modificare non è più in rubrica", RED);
                                                     
-                                                    } else // Errore lato server
+                                                    } else if(outcome == 5) { // Il contatto modificato era gia' presente in rubrica
+                                                        printCommunication("Modifica fallita, il contatto modificato è già presente in rubrica", RED);
+
+                                                    } else if(outcome == 8) { // Il server non accetta modifiche
+                                                        printRedirect();
+                                                        modifying = 0;
+
+                                                    } else if(outcome == CONNECTION_LOST) // Risposta persa con la connessione
+                                                        printCommunication("Connessione interrotta prima della risposta, verificare in rubrica se il contatto e' stato modificato", YELLOW);
+                                                    
+                                                    else // Errore lato server
                                                         printCommunication("Il server ha riscontrato un errore, operazione annullata", RED);
                                                     modifyingContact = 0;
                                                 
@@ -777,12 +961,17 @@ int main(int argc, char** argv) {
                                 outcome = authenticate(clientFD, username, password);
                             
                             // Controlliamo la risposta del server
-                            if(outcome) { // Autenticazione avvenuta con successo
+                            if(outcome == 1) { // Autenticazione avvenuta con successo
                                 authenticated = 1;
                                 authenticating = 0;
                                 authAttempts = 0; // azzeriamo i tentativi effettuati
                                 printCommunication("Autenticato con successo",GREEN);
                            
+                            } else if(outcome == 8) { // Le credenziali vanno inviate al primario, il tentativo non conta
+                                authenticating = 0;
+                                authAttempts--;
+                                printRedirect();
+
                             } else { // Autenticazione fallita
                                 // Sottomenu per chiedere all'utente se vuole ritentare l'autenticazione
                                 if(authAttempts < MAX_AUTH_ATTEMPTS) { // Controlliamo se l'utente ha superato i tentativi massimi di autenticazione
@@ -810,6 +999,125 @@ int main(int argc, char** argv) {
                 }
                 break;
             
+            case '3': // Elenco della rubrica in ordine alfabetico, a pagine
+                {
+                    /*
+                     * Ogni contatto viene cercato a partire dall'ultimo mostrato (from), il server
+                     * non deve quindi scorrere le pagine gia' lette
+                     * La prima corrispondenza e' from stesso, e va saltata, solo se nel frattempo
+                     * nessun'altra sessione l'ha cancellato: altrimenti e' gia' il contatto successivo
+                     */
+                    Contact from, to, listed;
+                    memset(&from, '\0', sizeof(Contact));
+                    memset(&to, '\0', sizeof(Contact));
+                    int listing = 1, listIndex = 0, listOutcome = 1;
+
+                    while(listing) {
+                        printTitle("       RUBRICA IN ORDINE ALFABETICO       ");
+
+                        // Leggiamo una pagina di contatti
+                        int shown = 0;
+                        while(shown < LIST_PAGE_SIZE) {
+                            listOutcome = orderedReadContact(clientFD, &from, &to, 1, &listed);
+                            if(listOutcome == 1 && listIndex > 0 && strcmp(listed.name, from.name) == 0 &&
+                               strcmp(listed.surname, from.surname) == 0 && strcmp(listed.phoneNumber, from.phoneNumber) == 0)
+                                listOutcome = orderedReadContact(clientFD, &from, &to, 2, &listed);
+                            if(listOutcome != 1)
+                                break;
+                            printContactIndex(listed, ++listIndex);
+                            from = listed;
+                            shown++;
+                        }
+
+                        if(listOutcome == 0) { // Errore lato server
+                            printCommunication("Il server ha riscontrato un errore, operazione annullata", RED);
+                            listing = 0;
+                        } else if(listOutcome == 2) { // Abbiamo raggiunto la fine della rubrica
+                            if(listIndex == 0)
+                                printCommunication("La rubrica e' vuota", YELLOW);
+                            else
+                                printCommunication("Fine della rubrica", YELLOW);
+                            listing = 0;
+                        } else {
+                            printf("[" BCYAN "1" RESET_COLOR "] Pagina successiva\n");
+                            printf("[" BRED "x" RESET_COLOR "] Terminare l'elenco\n\n");
+                            printf("Selezionare un'opzione: " CYAN);
+                            char listOption = getSingleChar();
+                            printf(RESET_COLOR);
+                            printf(CLEAR);
+                            if(listOption != '1')
+                                listing = 0;
+                        }
+                    }
+                }
+                break;
+
+            case '4': // Modifiche alla rubrica fatte da tutti gli utenti, mostrate appena avvengono
+                {
+                    unsigned int version;
+                    if(!subscribeChanges(clientFD, &version)) {
+                        printCommunication("Il server non supporta le notifiche delle modifiche", RED);
+                        break;
+                    }
+                    printTitle("       MODIFICHE ALLA RUBRICA       ");
+                    printf("In attesa di modifiche, premere " WHITEBG " ENTER " RESET_COLOR " per tornare al menu\n\n");
+
+                    /*
+                     * Aspettiamo contemporaneamente le notifiche del server e l'utente:
+                     * quando l'utente preme invio chiudiamo l'iscrizione, ma continuiamo
+                     * a mostrare le modifiche gia' inviate fino alla conferma di chiusura
+                     */
+                    struct pollfd sources[2] = {{clientFD, POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}};
+                    int following = 1, closing = 0;
+                    while(following) {
+                        if(poll(sources, closing ? 1 : 2, -1) < 0)
+                            continue;
+                        if(!closing && (sources[1].revents & POLLIN)) {
+                            getSingleChar();
+                            unsubscribeChanges(clientFD);
+                            closing = 1;
+                        }
+                        if(sources[0].revents & (POLLIN | POLLHUP)) {
+                            char changeOperation;
+                            Contact old, new;
+                            int changeOutcome = readChange(clientFD, &changeOperation, &old, &new, &version);
+                            if(changeOutcome == 1 && changeOperation == ADD)
+                                printf("[" BCYAN "%u" RESET_COLOR "] " GREEN "Aggiunto " RESET_COLOR "%s %s %s\n", version, old.name, old.surname, old.phoneNumber);
+                            else if(changeOutcome == 1 && changeOperation == DEL)
+                                printf("[" BCYAN "%u" RESET_COLOR "] " RED "Rimosso " RESET_COLOR "%s %s %s\n", version, old.name, old.surname, old.phoneNumber);
+                            else if(changeOutcome == 1)
+                                printf("[" BCYAN "%u" RESET_COLOR "] " YELLOW "Modificato " RESET_COLOR "%s %s %s -> %s %s %s\n", version, old.name, old.surname, old.phoneNumber, new.name, new.surname, new.phoneNumber);
+                            else if(changeOutcome == 2)
+                                printf(YELLOW "Alcune modifiche non sono state ricevute, rileggere la rubrica\n" RESET_COLOR);
+                            else if(changeOutcome == 3)
+                                following = 0;
+                            else if(changeOutcome == 4 && closing) // L'iscrizione era gia' stata chiusa dall'utente
+                                following = 0;
+                            else if(changeOutcome == 4 && subscribeChanges(clientFD, &version)) // Server riavviato, ci iscriviamo al nuovo
+                                printf(YELLOW "Server riavviato, iscrizione ripristinata alla modifica %u\n" RESET_COLOR, version);
+                            else if(changeOutcome == 4) {
+                                printf(RED "Server riavviato, impossibile ripristinare l'iscrizione\n" RESET_COLOR);
+                                following = 0;
+                            }
+                        }
+                    }
+                    printf(CLEAR);
+                }
+                break;
+
+            case '5': // Aggiornamento della copia locale con le sole modifiche avvenute dall'ultima sincronizzazione
+                {
+                    int changes, total;
+                    char message[100];
+                    if(syncLocalCopy(clientFD, LOCAL_COPY_PATH, &changes, &total)) {
+                        sprintf(message, "Copia locale aggiornata: %d modifiche ricevute, %d contatti", changes, total);
+                        printCommunication(message, GREEN);
+                    } else {
+                        printCommunication("Impossibile aggiornare la copia locale della rubrica", RED);
+                    }
+                }
+                break;
+
             // Usciamo dal menu principale e terminiamo la sessione chiudendo la connessione con il server
             case 'x':
             case 'X':
@@ -10,40 +10,326 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
 #include "./../include/connection.h"
 
+#define MAX_RESTORE_ATTEMPTS 3 // Riconnessioni di seguito per la stessa richiesta prima di arrendersi
+/**
+ * Se il server ha rifiutato la connessione perche' occupato (received ha esito SERVER_BUSY)
+ * lo comunica all'utente e termina il client, come per gli altri errori di comunicazione
+ * Un pacchetto SUBSCRIBE con esito SERVER_BUSY chiude invece l'iscrizione per un riavvio del server (vedi readChange)
+ */
+static void checkServerBusy(serverPacket received) {
+    if (received.outcome == SERVER_BUSY && received.operation != SUBSCRIBE) {
+        printf(CLEAR);
+        printf(RESET_COLOR "Il server e' occupato, riprova piu' tardi\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Funzione che ripristina una connessione interrotta, NULL per terminare il client
+static int (*reconnectHandler)(int clientFD) = NULL;
+
+// Credenziali dell'ultima autenticazione riuscita, ripetuta dopo ogni riconnessione
+static char sessionUsername[AUTH_PARAM_LENGTH + 1];
+static char sessionPassword[AUTH_PARAM_LENGTH + 1];
+static int sessionAuthenticated = 0;
+
+// 1 se le autenticazioni chiedono la rubrica personale (setPersonalBook)
+static int personalBook = 0;
+
+/**
+ * Richiesta inviata con pipelineRequest
+ *
+ * Campi:
+ *  request - Pacchetto inviato
+ *  response - Risposta del server, valida se answered vale 1
+ *  answered - 1 se la risposta e' gia' stata letta dalla socket
+ *  discarded - 1 se la risposta, quando arriva, va scartata (pipelineDiscard)
+ */
+typedef struct {
+    serverPacket request;
+    serverPacket response;
+    int answered;
+    int discarded;
+} pipelinedRequest;
+
+// Richieste inviate in anticipo, in ordine di invio: il server risponde nello stesso ordine
+static pipelinedRequest pipeline[MAX_PIPELINED];
+static int pipelineLength = 0;
+
+void setReconnectHandler(int (*handler)(int clientFD)) {
+    reconnectHandler = handler;
+}
+
+void setPersonalBook(int personal) {
+    personalBook = personal;
+}
+
+int usesPersonalBook(void) {
+    return personalBook;
+}
+
+/**
+ * Comunica all'utente l'errore di comunicazione e termina il client
+ */
+static void connectionFailed(void) {
+    printf(CLEAR);
+    perror(RESET_COLOR "Impossibile comunicare con il server, terminata la connessione");
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Scrive il pacchetto toSend sulla socket clientFD
+ *
+ * Restituisce 1 in caso di successo, 0 in caso di errore di comunicazione
+ */
+static int writePacket(int clientFD, serverPacket toSend) {
+    char message[PACKET_LENGTH];
+    buildMessage(message, toSend);
+    return write(clientFD, message, PACKET_LENGTH) == PACKET_LENGTH;
+}
+
+/**
+ * Legge un pacchetto dalla socket clientFD salvandolo in received
+ * Il pacchetto puo' arrivare in piu' parti: si continua a leggere finche' non e' completo
+ *
+ * Restituisce 1 in caso di successo, 0 in caso di errore di comunicazione o di connessione chiusa
+ */
+static int readPacket(int clientFD, serverPacket *received) {
+    char response[PACKET_LENGTH];
+    size_t done = 0;
+    while(done < PACKET_LENGTH) {
+        ssize_t length = read(clientFD, response + done, PACKET_LENGTH - done);
+        if(length < 0 && errno == EINTR)
+            continue;
+        if(length <= 0) {
+            if(length == 0)
+                errno = ECONNRESET; // Per il messaggio d'errore, se la riconnessione non riesce
+            return 0;
+        }
+        done += length;
+    }
+    buildEmptyPacket(received);
+    parseMessage(response, received);
+    checkServerBusy(*received);
+    return 1;
+}
+
+/**
+ * Controlla, senza attendere, se il server ha gia' chiuso la connessione clientFD
+ * (ad esempio perche' e' stato riavviato mentre l'utente era nei menu)
+ */
+static int connectionClosed(int clientFD) {
+    char byte;
+    ssize_t length = recv(clientFD, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    if(length == 0)
+        errno = ECONNRESET; // Per il messaggio d'errore, se la riconnessione non riesce
+    return length == 0 || (length < 0 && errno != EAGAIN && errno != EWOULDBLOCK);
+}
+
+/**
+ * Legge dalla socket clientFD tutte le risposte alle richieste inviate in anticipo, in modo
+ * che la prossima risposta sulla socket sia quella della richiesta che si sta per inviare
+ * Se la connessione si interrompe le risposte mancanti vengono dimenticate: sara' la richiesta
+ * successiva ad accorgersi dell'interruzione e a ripristinare la connessione
+ */
+static void drainPipeline(int clientFD) {
+    for(int i = 0; i < pipelineLength; i++) {
+        if(pipeline[i].answered)
+            continue;
+        if(!readPacket(clientFD, &pipeline[i].response)) {
+            pipelineLength = 0;
+            return;
+        }
+        pipeline[i].answered = 1;
+    }
+
+    // Le risposte scartate non servono piu' a nessuno
+    int kept = 0;
+    for(int i = 0; i < pipelineLength; i++) {
+        if(!pipeline[i].discarded)
+            pipeline[kept++] = pipeline[i];
+    }
+    pipelineLength = kept;
+}
+
+/**
+ * Ripristina la connessione clientFD con la funzione impostata con setReconnectHandler
+ * e ripete l'autenticazione della sessione, in modo che le richieste successive usino la stessa rubrica
+ * Senza funzione di riconnessione, o se la connessione non si riesce a ripristinare, termina il client
+ */
+static void restoreConnection(int clientFD) {
+    int error = errno;
+    pipelineLength = 0; // Le risposte attese sulla vecchia connessione non arriveranno piu'
+    for(int attempt = 0; attempt < MAX_RESTORE_ATTEMPTS; attempt++) {
+        if(reconnectHandler == NULL || !reconnectHandler(clientFD))
+            break;
+        if(!sessionAuthenticated)
+            return;
+
+        serverPacket toSend, received;
+        buildEmptyPacket(&toSend);
+        toSend.operation = AUTH;
+        strcpy(toSend.username, sessionUsername);
+        strcpy(toSend.password, sessionPassword);
+        if(personalBook)
+            toSend.newName[0] = PERSONAL_BOOK;
+        if(!writePacket(clientFD, toSend) || !readPacket(clientFD, &received)) {
+            error = errno;
+            continue;
+        }
+        if(received.outcome != OPERATION_SUCCESS) {
+            sessionAuthenticated = 0;
+            printf(YELLOW "Le credenziali della sessione non sono piu' valide, rubrica condivisa in uso\n" RESET_COLOR);
+        }
+        return;
+    }
+    errno = error;
+    connectionFailed();
+}
+
+/**
+ * Invia il pacchetto toSend alla socket clientFD, in caso di errore di comunicazione termina il client
+ * Usata per le iscrizioni alle modifiche, che non vengono riprese dopo una riconnessione
+ */
+static void sendPacket(int clientFD, serverPacket toSend) {
+    drainPipeline(clientFD);
+    if (!writePacket(clientFD, toSend))
+        connectionFailed();
+}
+
+/**
+ * Attende un pacchetto dal server sulla socket clientFD salvandolo in received,
+ * in caso di errore di comunicazione termina il client
+ */
+static void receivePacket(int clientFD, serverPacket *received) {
+    if (!readPacket(clientFD, received))
+        connectionFailed();
+}
+
+/**
+ * Invia il pacchetto toSend alla socket clientFD e attende la risposta del server salvandola in received
+ *
+ * Se la connessione si interrompe viene ripristinata (vedi setReconnectHandler) e la richiesta
+ * viene ripetuta se non e' arrivata al server oppure se replay vale 1: le letture possono
+ * essere ripetute senza effetti, le modifiche invece potrebbero essere gia' state eseguite
+ *
+ * Restituisce 1 se e' arrivata la risposta, 0 se una richiesta da non ripetere ha perso la risposta
+ */
+static int exchangePacket(int clientFD, serverPacket toSend, serverPacket *received, int replay) {
+    drainPipeline(clientFD);
+    if(connectionClosed(clientFD))
+        restoreConnection(clientFD);
+    for(int attempt = 0; attempt < MAX_RESTORE_ATTEMPTS; attempt++) {
+        if(!writePacket(clientFD, toSend)) {
+            restoreConnection(clientFD);
+            continue;
+        }
+        if(readPacket(clientFD, received))
+            return 1;
+        restoreConnection(clientFD);
+        if(!replay) {
+            buildEmptyPacket(received);
+            return 0;
+        }
+    }
+    connectionFailed();
+    return 0;
+}
+
+/**
+ * Controlla se first e second sono la stessa richiesta
+ */
+static int sameRequest(const serverPacket *first, const serverPacket *second) {
+    return first->operation == second->operation && first->matchIndex == second->matchIndex &&
+        strcmp(first->username, second->username) == 0 && strcmp(first->name, second->name) == 0 &&
+        strcmp(first->surname, second->surname) == 0 && strcmp(first->phoneNumber, second->phoneNumber) == 0 &&
+        strcmp(first->newName, second->newName) == 0 && strcmp(first->newSurname, second->newSurname) == 0 &&
+        strcmp(first->newPhoneNumber, second->newPhoneNumber) == 0;
+}
+
+/**
+ * Restituisce la posizione di request tra le richieste inviate in anticipo, -1 se non c'e'
+ */
+static int findPipelined(const serverPacket *request) {
+    for(int i = 0; i < pipelineLength; i++) {
+        if(!pipeline[i].discarded && sameRequest(&pipeline[i].request, request))
+            return i;
+    }
+    return -1;
+}
+
+int pipelineRequest(int clientFD, serverPacket toSend) {
+    if(pipelineLength == MAX_PIPELINED || findPipelined(&toSend) >= 0)
+        return 0;
+    if(!writePacket(clientFD, toSend))
+        return 0;
+    pipeline[pipelineLength].request = toSend;
+    pipeline[pipelineLength].answered = 0;
+    pipeline[pipelineLength].discarded = 0;
+    pipelineLength++;
+    return 1;
+}
+
+int pipelineContains(serverPacket request) {
+    return findPipelined(&request) >= 0;
+}
+
+int pipelineResponse(int clientFD, serverPacket request, serverPacket *received) {
+    int position = findPipelined(&request);
+    if(position < 0)
+        return 0;
+
+    // Leggiamo le risposte solo fino a quella cercata, le successive restano in arrivo
+    for(int i = 0; i <= position; i++) {
+        if(pipeline[i].answered)
+            continue;
+        if(!readPacket(clientFD, &pipeline[i].response)) {
+            pipelineLength = 0;
+            return 0;
+        }
+        pipeline[i].answered = 1;
+    }
+    *received = pipeline[position].response;
+
+    // La risposta viene consumata, insieme alle scartate gia' arrivate che la precedono
+    int kept = 0;
+    for(int i = 0; i < pipelineLength; i++) {
+        if(i != position && !(pipeline[i].discarded && pipeline[i].answered))
+            pipeline[kept++] = pipeline[i];
+    }
+    pipelineLength = kept;
+    return 1;
+}
+
+void pipelineDiscard(void) {
+    for(int i = 0; i < pipelineLength; i++)
+        pipeline[i].discarded = 1;
+
+    // Le risposte gia' arrivate si possono togliere subito, quelle in arrivo verranno lette e scartate
+    int kept = 0;
+    for(int i = 0; i < pipelineLength; i++) {
+        if(!pipeline[i].answered)
+            pipeline[kept++] = pipeline[i];
+    }
+    pipelineLength = kept;
+}
+
 int readContact(int clientFD, Contact *toRead,int matchIndex, Contact *serverRead){
     int outcome = 0;
-    // Creazione del messaggio da inviare al server con i parametri per la ricerca
-    char message[PACKET_LENGTH];
-    serverPacket toSend;
+    // Creazione del pacchetto da inviare al server con i parametri per la ricerca
+    serverPacket toSend, received;
     buildEmptyPacket(&toSend);
     toSend.operation = READ;
     toSend.matchIndex = matchIndex;
     strcpy(toSend.name, toRead->name);
     strcpy(toSend.surname, toRead->surname);
     strcpy(toSend.phoneNumber, toRead->phoneNumber);
-    
-    buildMessage(message,toSend);
-    // Invio del messaggio al server e controllo esito della scrittura
-    ssize_t bytesWritten = write(clientFD,message,PACKET_LENGTH);
-    if (bytesWritten != PACKET_LENGTH) {
-        printf(CLEAR);
-        perror(RESET_COLOR "Impossibile comunicare con il server, terminata la connessione");    
-        exit(EXIT_FAILURE);
-    }
-    // Lettura della risposta del server e controllo esito della lettura
-    char response[PACKET_LENGTH];
-    ssize_t bytesRead = read(clientFD,response,PACKET_LENGTH);
-    if (bytesRead != PACKET_LENGTH) {
-        printf(CLEAR);
-        perror(RESET_COLOR "Impossibile comunicare con il server, terminata la connessione");    
-        exit(EXIT_FAILURE);
-    }
+    exchangePacket(clientFD, toSend, &received, 1);
+
     // Inizializzo il contatto serverRead con le informazioni del pacchetto letto
-    serverPacket received;
-    buildEmptyPacket(&received);
-    parseMessage(response,&received);
     strcpy(serverRead->name,received.name);
     strcpy(serverRead->surname,received.surname);
     strcpy(serverRead->phoneNumber,received.phoneNumber);
@@ -56,48 +342,272 @@ int readContact(int clientFD, Contact *toRead,int matchIndex, Contact *serverRea
     return outcome;
 }
 
-int authenticate(int clientFD, char *username, char *password){
+int fuzzyReadContact(int clientFD, Contact *toRead, int maxDistance, int matchIndex, Contact *serverRead){
     int outcome = 0;
-    // Creazione del messaggio da inviare al server con i parametri per la ricerca
-    char message[PACKET_LENGTH];
+
+    // Creazione del pacchetto con i parametri per la ricerca, la distanza viaggia nel campo newName
+    serverPacket toSend, received;
+    buildEmptyPacket(&toSend);
+    toSend.operation = FUZZY_READ;
+    toSend.matchIndex = matchIndex;
+    strcpy(toSend.name, toRead->name);
+    strcpy(toSend.surname, toRead->surname);
+    strcpy(toSend.phoneNumber, toRead->phoneNumber);
+    sprintf(toSend.newName, "%d", maxDistance);
+    exchangePacket(clientFD, toSend, &received, 1);
+
+    // Inizializzo il contatto serverRead con le informazioni del pacchetto letto
+    strcpy(serverRead->name,received.name);
+    strcpy(serverRead->surname,received.surname);
+    strcpy(serverRead->phoneNumber,received.phoneNumber);
+
+    // Controllo l'esito dell'operazione
+    if(received.outcome == OPERATION_SUCCESS)
+        outcome = 1;
+    else if(received.outcome == READ_CONTACT_MISSING)
+        outcome = 2;
+    return outcome;
+}
+
+int insensitiveReadContact(int clientFD, Contact *toRead, int matchIndex, Contact *serverRead){
+    int outcome = 0;
+
+    // Creazione del pacchetto con i parametri per la ricerca
+    serverPacket toSend, received;
+    buildEmptyPacket(&toSend);
+    toSend.operation = INSENSITIVE_READ;
+    toSend.matchIndex = matchIndex;
+    strcpy(toSend.name, toRead->name);
+    strcpy(toSend.surname, toRead->surname);
+    strcpy(toSend.phoneNumber, toRead->phoneNumber);
+    exchangePacket(clientFD, toSend, &received, 1);
+
+    // Inizializzo il contatto serverRead con le informazioni del pacchetto letto
+    strcpy(serverRead->name,received.name);
+    strcpy(serverRead->surname,received.surname);
+    strcpy(serverRead->phoneNumber,received.phoneNumber);
+
+    // Controllo l'esito dell'operazione
+    if(received.outcome == OPERATION_SUCCESS)
+        outcome = 1;
+    else if(received.outcome == READ_CONTACT_MISSING)
+        outcome = 2;
+    return outcome;
+}
+
+int suffixReadContact(int clientFD, Contact *toRead, int matchIndex, Contact *serverRead){
+    int outcome = 0;
+
+    // Creazione del pacchetto con i parametri per la ricerca, phoneNumber contiene le ultime cifre
+    serverPacket toSend, received;
+    buildEmptyPacket(&toSend);
+    toSend.operation = SUFFIX_READ;
+    toSend.matchIndex = matchIndex;
+    strcpy(toSend.name, toRead->name);
+    strcpy(toSend.surname, toRead->surname);
+    strcpy(toSend.phoneNumber, toRead->phoneNumber);
+    exchangePacket(clientFD, toSend, &received, 1);
+
+    // Inizializzo il contatto serverRead con le informazioni del pacchetto letto
+    strcpy(serverRead->name,received.name);
+    strcpy(serverRead->surname,received.surname);
+    strcpy(serverRead->phoneNumber,received.phoneNumber);
+
+    // Controllo l'esito dell'operazione
+    if(received.outcome == OPERATION_SUCCESS)
+        outcome = 1;
+    else if(received.outcome == READ_CONTACT_MISSING)
+        outcome = 2;
+    return outcome;
+}
+
+int orderedReadContact(int clientFD, Contact *from, Contact *to, int matchIndex, Contact *serverRead){
+    int outcome = 0;
+
+    // Creazione del pacchetto, l'ultimo contatto dell'intervallo viaggia nei campi new*
+    serverPacket toSend, received;
+    buildEmptyPacket(&toSend);
+    toSend.operation = ORDERED_READ;
+    toSend.matchIndex = matchIndex;
+    strcpy(toSend.name, from->name);
+    strcpy(toSend.surname, from->surname);
+    strcpy(toSend.phoneNumber, from->phoneNumber);
+    strcpy(toSend.newName, to->name);
+    strcpy(toSend.newSurname, to->surname);
+    strcpy(toSend.newPhoneNumber, to->phoneNumber);
+    exchangePacket(clientFD, toSend, &received, 1);
+
+    // Inizializzo il contatto serverRead con le informazioni del pacchetto letto
+    strcpy(serverRead->name,received.name);
+    strcpy(serverRead->surname,received.surname);
+    strcpy(serverRead->phoneNumber,received.phoneNumber);
+
+    // Controllo l'esito dell'operazione
+    if(received.outcome == OPERATION_SUCCESS)
+        outcome = 1;
+    else if(received.outcome == READ_CONTACT_MISSING)
+        outcome = 2;
+    return outcome;
+}
+
+int countContacts(int clientFD, char readOperation, Contact *toRead, int *count){
+    int outcome = 0;
+
+    // Creazione del pacchetto, l'operazione di cui usare i criteri viaggia nel campo newName
+    serverPacket toSend, received;
+    buildEmptyPacket(&toSend);
+    toSend.operation = COUNT;
+    strcpy(toSend.name, toRead->name);
+    strcpy(toSend.surname, toRead->surname);
+    strcpy(toSend.phoneNumber, toRead->phoneNumber);
+    toSend.newName[0] = readOperation;
+    exchangePacket(clientFD, toSend, &received, 1);
+
+    // Il conteggio viaggia in matchIndex
+    if(received.outcome == OPERATION_SUCCESS) {
+        *count = received.matchIndex;
+        outcome = 1;
+    }
+    return outcome;
+}
+
+int conditionalReadContact(int clientFD, char readOperation, Contact *toRead, int matchIndex, unsigned int *version, Contact *serverRead){
+    int outcome = 0;
+
+    // Creazione del pacchetto, la versione del risultato gia' in possesso viaggia nel campo newPhoneNumber
+    serverPacket toSend, received;
+    buildEmptyPacket(&toSend);
+    toSend.operation = readOperation;
+    toSend.matchIndex = matchIndex;
+    strcpy(toSend.name, toRead->name);
+    strcpy(toSend.surname, toRead->surname);
+    strcpy(toSend.phoneNumber, toRead->phoneNumber);
+    if(*version)
+        sprintf(toSend.newPhoneNumber, "%u", *version);
+    exchangePacket(clientFD, toSend, &received, 1);
+
+    // Versione a cui si riferisce la risposta (0 se il server non la indica)
+    *version = (unsigned int)strtoul(received.newPhoneNumber, NULL, 10);
+
+    // Controllo l'esito dell'operazione, il contatto e' presente solo se trovato
+    if(received.outcome == OPERATION_SUCCESS) {
+        strcpy(serverRead->name,received.name);
+        strcpy(serverRead->surname,received.surname);
+        strcpy(serverRead->phoneNumber,received.phoneNumber);
+        outcome = 1;
+    } else if(received.outcome == READ_CONTACT_MISSING) {
+        outcome = 2;
+    } else if(received.outcome == NOT_MODIFIED) {
+        outcome = 3;
+    }
+    return outcome;
+}
+
+int subscribeChanges(int clientFD, unsigned int *version){
+    serverPacket toSend, received;
+    buildEmptyPacket(&toSend);
+    toSend.operation = SUBSCRIBE;
+    exchangePacket(clientFD, toSend, &received, 1);
+
+    // La conferma contiene il numero dell'ultima modifica gia' avvenuta
+    if(received.operation == SUBSCRIBE && received.outcome == OPERATION_SUCCESS) {
+        *version = received.matchIndex;
+        return 1;
+    }
+    return 0;
+}
+
+void unsubscribeChanges(int clientFD){
     serverPacket toSend;
     buildEmptyPacket(&toSend);
+    toSend.operation = SUBSCRIBE;
+    sendPacket(clientFD, toSend);
+}
+
+void requestChangesSince(int clientFD, unsigned int version){
+    serverPacket toSend;
+    buildEmptyPacket(&toSend);
+    toSend.operation = SYNC_SINCE;
+    toSend.matchIndex = version;
+    sendPacket(clientFD, toSend);
+}
+
+int readChange(int clientFD, char *operation, Contact *old, Contact *new, unsigned int *version){
+    serverPacket received;
+    receivePacket(clientFD, &received);
+    *operation = received.operation;
+    *version = received.matchIndex;
+
+    // Pacchetti di servizio: modifiche perse o fine dell'iscrizione (o della sincronizzazione)
+    if(received.operation == SUBSCRIBE || received.operation == SYNC_SINCE) {
+        if(received.outcome == CHANGES_LOST)
+            return 2;
+        if(received.outcome == SERVER_BUSY)
+            return 4;
+        return received.outcome == OPERATION_SUCCESS ? 3 : 0;
+    }
+
+    // Contatto coinvolto e, per le modifiche, il nuovo contatto
+    strcpy(old->name, received.name);
+    strcpy(old->surname, received.surname);
+    strcpy(old->phoneNumber, received.phoneNumber);
+    strcpy(new->name, received.newName);
+    strcpy(new->surname, received.newSurname);
+    strcpy(new->phoneNumber, received.newPhoneNumber);
+    return received.operation == ADD || received.operation == DEL || received.operation == MODIFY;
+}
+
+// Indirizzo del primario indicato dall'ultima risposta REDIRECT
+static char primaryHost[AUTH_PARAM_LENGTH + 1];
+static int primaryPort;
+
+/**
+ * Salva l'indirizzo del primario contenuto nella risposta REDIRECT received
+ *
+ * Restituisce l'esito corrispondente (8)
+ */
+static int redirected(serverPacket received) {
+    strcpy(primaryHost, received.username);
+    primaryPort = received.matchIndex;
+    return 8;
+}
+
+void getPrimaryAddress(char *host, int *port){
+    strcpy(host, primaryHost);
+    *port = primaryPort;
+}
+
+int authenticate(int clientFD, char *username, char *password){
+    int outcome = 0;
+    // Creazione del pacchetto da inviare al server con le credenziali
+    serverPacket toSend, received;
+    buildEmptyPacket(&toSend);
     toSend.operation = AUTH;
     strcpy(toSend.username, username);
     strcpy(toSend.password, password);
-    buildMessage(message,toSend);
-    // Invio del messaggio al server e controllo esito della scrittura
-    ssize_t bytesWritten = write(clientFD,message,PACKET_LENGTH);
-    if (bytesWritten != PACKET_LENGTH) {
-        printf(CLEAR);
-        perror(RESET_COLOR "Impossibile comunicare con il server, terminata la connessione");    
-        exit(EXIT_FAILURE);
-    }
-    // Lettura della risposta del server e controllo esito della lettura
-    char response[PACKET_LENGTH];
-    ssize_t bytesRead = read(clientFD,response,PACKET_LENGTH);
-    if (bytesRead != PACKET_LENGTH) {
-        printf(CLEAR);
-        perror(RESET_COLOR "Impossibile comunicare con il server, terminata la connessione");    
-        exit(EXIT_FAILURE);
-    }
+    if(personalBook)
+        toSend.newName[0] = PERSONAL_BOOK;
 
-    // Inizializzo il pacchetto received con il messaggio letto
-    serverPacket received;
-    buildEmptyPacket(&received);
-    parseMessage(response,&received);
+    // Dopo l'autenticazione la sessione potrebbe usare un'altra rubrica: le letture anticipate non valgono piu'
+    pipelineDiscard();
+    exchangePacket(clientFD, toSend, &received, 1);
     
-    // Controllo se il server ha accettato le credenziali
-    if(received.outcome == OPERATION_SUCCESS)
+    // Controllo se il server ha accettato le credenziali, che vengono ripetute dopo una riconnessione
+    if(received.outcome == OPERATION_SUCCESS) {
+        strcpy(sessionUsername, username);
+        strcpy(sessionPassword, password);
+        sessionAuthenticated = 1;
         outcome = 1;
+    }
+    else if(received.outcome == REDIRECT)
+        outcome = redirected(received);
     return outcome;
 }
 
 int addContact(int clientFD, char *username, char *password, Contact *toAdd){
     int outcome = 0;
-    // Creazione del messaggio da inviare al server con i parametri per la ricerca
-    char message[PACKET_LENGTH];
-    serverPacket toSend;
+    // Creazione del pacchetto da inviare al server
+    serverPacket toSend, received;
     buildEmptyPacket(&toSend);
     toSend.operation = ADD;
     strcpy(toSend.username, username);
@@ -105,29 +615,13 @@ int addContact(int clientFD, char *username, char *password, Contact *toAdd){
     strcpy(toSend.name, toAdd->name);
     strcpy(toSend.surname, toAdd->surname);
     strcpy(toSend.phoneNumber, toAdd->phoneNumber);
-    buildMessage(message,toSend);
 
-    // Invio del messaggio al server e controllo esito della scrittura
-    ssize_t bytesWritten = write(clientFD,message,PACKET_LENGTH);
-    if (bytesWritten != PACKET_LENGTH) {
-        printf(CLEAR);
-        perror(RESET_COLOR "Impossibile comunicare con il server, terminata la connessione");    
-        exit(EXIT_FAILURE);
-    }
+    // Le letture anticipate potrebbero non essere piu' valide dopo la modifica
+    pipelineDiscard();
 
-    // Lettura della risposta del server e controllo esito della lettura
-    char response[PACKET_LENGTH];
-    ssize_t bytesRead = read(clientFD,response,PACKET_LENGTH);
-    if (bytesRead != PACKET_LENGTH) {
-        printf(CLEAR);
-        perror(RESET_COLOR "Impossibile comunicare con il server, terminata la connessione");    
-        exit(EXIT_FAILURE);
-    }
-
-    // Inizializzo il pacchetto received con il messaggio letto
-    serverPacket received;
-    buildEmptyPacket(&received);
-    parseMessage(response,&received);
+    // Se la connessione si interrompe dopo l'invio non sappiamo se la modifica e' stata eseguita
+    if(!exchangePacket(clientFD, toSend, &received, 0))
+        return CONNECTION_LOST;
 
     // Controllo l'esito dell'operazione
      if(received.outcome == OPERATION_SUCCESS)
@@ -136,14 +630,15 @@ int addContact(int clientFD, char *username, char *password, Contact *toAdd){
         outcome = 3;
     else if(received.outcome == CONTACT_ALREADY_EXISTS)
         outcome = 5;
+    else if(received.outcome == REDIRECT)
+        outcome = redirected(received);
     return outcome;
 }
 
 int deleteContact(int clientFD, char *username, char *password, Contact *toDelete){
     int outcome = 0;
-    // Creazione del messaggio da inviare al server con i parametri per la ricerca
-    char message[PACKET_LENGTH];
-    serverPacket toSend;
+    // Creazione del pacchetto da inviare al server
+    serverPacket toSend, received;
     buildEmptyPacket(&toSend);
     toSend.operation = DEL;
     strcpy(toSend.username, username);
@@ -151,29 +646,13 @@ int deleteContact(int clientFD, char *username, char *password, Contact *toDelet
     strcpy(toSend.name, toDelete->name);
     strcpy(toSend.surname, toDelete->surname);
     strcpy(toSend.phoneNumber, toDelete->phoneNumber);
-    buildMessage(message,toSend);
 
-    // Invio del messaggio al server e controllo esito della scrittura
-    ssize_t bytesWritten = write(clientFD,message,PACKET_LENGTH);
-    if (bytesWritten != PACKET_LENGTH) {
-        printf(CLEAR);
-        perror(RESET_COLOR "Impossibile comunicare con il server, terminata la connessione");    
-        exit(EXIT_FAILURE);
-    }
+    // Le letture anticipate potrebbero non essere piu' valide dopo la modifica
+    pipelineDiscard();
 
-    // Lettura della risposta del server e controllo esito della lettura
-    char response[PACKET_LENGTH];
-    ssize_t bytesRead = read(clientFD,response,PACKET_LENGTH);
-    if (bytesRead != PACKET_LENGTH) {
-        printf(CLEAR);
-        perror(RESET_COLOR "Impossibile comunicare con il server, terminata la connessione");    
-        exit(EXIT_FAILURE);
-    }
-    
-    // Inizializzo il pacchetto received con il messaggio letto
-    serverPacket received;
-    buildEmptyPacket(&received);
-    parseMessage(response,&received);
+    // Se la connessione si interrompe dopo l'invio non sappiamo se la modifica e' stata eseguita
+    if(!exchangePacket(clientFD, toSend, &received, 0))
+        return CONNECTION_LOST;
 
     // Controllo l'esito dell'operazione
     if(received.outcome == OPERATION_SUCCESS)
@@ -182,14 +661,15 @@ int deleteContact(int clientFD, char *username, char *password, Contact *toDelet
         outcome = 3;
     else if(received.outcome == CONTACT_ALREADY_MODIFIED)
         outcome = 4;
+    else if(received.outcome == REDIRECT)
+        outcome = redirected(received);
     return outcome;
 }
 
 int modifyContact(int clientFD, char *username, char *password, Contact *toModify, Contact *modifiedContact){
     int outcome = 0;
-    // Creazione del messaggio da inviare al server con i parametri per la ricerca
-    char message[PACKET_LENGTH];
-    serverPacket toSend;
+    // Creazione del pacchetto da inviare al server
+    serverPacket toSend, received;
     buildEmptyPacket(&toSend);
     toSend.operation = MODIFY;
     strcpy(toSend.username, username);
@@ -200,29 +680,13 @@ int modifyContact(int clientFD, char *username, char *password, Contact *toModif
     strcpy(toSend.newName, modifiedContact->name);
     strcpy(toSend.newSurname, modifiedContact->surname);
     strcpy(toSend.newPhoneNumber, modifiedContact->phoneNumber);
-    buildMessage(message,toSend);
 
-    // Invio del messaggio al server e controllo esito della scrittura
-    ssize_t bytesWritten = write(clientFD,message,PACKET_LENGTH);
-    if (bytesWritten != PACKET_LENGTH) {
-        printf(CLEAR);
-        perror(RESET_COLOR "Impossibile comunicare con il server, terminata la connessione");    
-        exit(EXIT_FAILURE);
-    }
+    // Le letture anticipate potrebbero non essere piu' valide dopo la modifica
+    pipelineDiscard();
 
-    // Lettura della risposta del server e controllo esito della lettura
-    char response[PACKET_LENGTH];
-    ssize_t bytesRead = read(clientFD,response,PACKET_LENGTH);
-    if (bytesRead != PACKET_LENGTH) {
-        printf(CLEAR);
-        perror(RESET_COLOR "Impossibile comunicare con il server, terminata la connessione");    
-        exit(EXIT_FAILURE);
-    }
-    
-    // Inizializzo il pacchetto received con il messaggio letto
-    serverPacket received;
-    buildEmptyPacket(&received);
-    parseMessage(response,&received);
+    // Se la connessione si interrompe dopo l'invio non sappiamo se la modifica e' stata eseguita
+    if(!exchangePacket(clientFD, toSend, &received, 0))
+        return CONNECTION_LOST;
 
     // Controllo l'esito dell'operazione
      if(received.outcome == OPERATION_SUCCESS)
@@ -231,6 +695,10 @@ int modifyContact(int clientFD, char *username, char *password, Contact *toModif
         outcome = 3;
     else if(received.outcome == CONTACT_ALREADY_MODIFIED)
         outcome = 4;
+    else if(received.outcome == CONTACT_ALREADY_EXISTS)
+        outcome = 5;
+    else if(received.outcome == REDIRECT)
+        outcome = redirected(received);
     return outcome;
 }
 
@@ -241,12 +709,12 @@ void buildMessage(char *message, serverPacket packet){
 
     // Impostiamo un'operazione solo se corretta
     char c = packet.operation;
-    if(c == READ || c == AUTH || c == ADD || c == DEL|| c == MODIFY)
+    if(c == READ || c == AUTH || c == ADD || c == DEL|| c == MODIFY || c == FUZZY_READ || c == INSENSITIVE_READ || c == SUFFIX_READ || c == ORDERED_READ || c == COUNT || c == SUBSCRIBE || c == SYNC_SINCE)
         message[OPERATION_INDEX]= c;
 
     // Impostiamo l'esito solo se valido
     c = packet.outcome;
-    if(c == SERVER_ERROR || c == OPERATION_SUCCESS || c == READ_CONTACT_MISSING || c == CREDENTIALS_EXPIRED || c == CONTACT_ALREADY_MODIFIED || c == CONTACT_ALREADY_EXISTS)
+    if(c == SERVER_ERROR || c == OPERATION_SUCCESS || c == READ_CONTACT_MISSING || c == CREDENTIALS_EXPIRED || c == CONTACT_ALREADY_MODIFIED || c == CONTACT_ALREADY_EXISTS || c == CHANGES_LOST || c == NOT_MODIFIED || c == REDIRECT)
         message[OUTCOME_INDEX]= c;
 
     // Impostiamo username
@@ -266,7 +734,9 @@ void buildMessage(char *message, serverPacket packet){
     // Impostiamo match index
     if(packet.matchIndex > 0){
         // Trasformiamo match index in stringa
+        // Il campo viene copiato per intero: dopo il numero non devono restare impurita' (una virgola renderebbe il pacchetto non valido)
         char mIndex[CONTACT_PARAM_LENGTH + 1];
+        memset(mIndex, '\0', CONTACT_PARAM_LENGTH + 1);
         sprintf(mIndex, "%d", packet.matchIndex);
         for(int i = 0; i <  CONTACT_PARAM_LENGTH; i++) {
             message[i + MATCHINDEX_INDEX] = mIndex[i];
@@ -418,6 +888,7 @@ void printMessage(char *message){
 }
 
 int closeConnection(int socketFd) {
+    drainPipeline(socketFd);
     char buf[PACKET_LENGTH];
     memset(buf, '\0', PACKET_LENGTH);
     buf[0] = 'x';
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2024 Giannuzzi Riccardo, Biribo' Francesco, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <string.h>
+#include "./../include/connection.h"
+#include "./../include/contactCache.h"
+
+/**
+ * Risposta del server conservata nella cache
+ * 
+ * Campi:
+ *  used - Indica se la posizione contiene una risposta
+ *  operation, criteria, matchIndex - Lettura richiesta
+ *  outcome - Esito della lettura (1 trovato, 2 nessuna corrispondenza)
+ *  found - Contatto trovato
+ *  version - Versione della rubrica a cui si riferisce la risposta
+ *  lastUse - Istante (logico) dell'ultimo utilizzo, per scegliere quale risposta sostituire
+ */
+typedef struct {
+    int used;
+    char operation;
+    Contact criteria;
+    int matchIndex;
+    int outcome;
+    Contact found;
+    unsigned int version;
+    unsigned long lastUse;
+} cachedRead;
+
+static cachedRead cache[CONTACT_CACHE_SIZE];
+static unsigned long cacheClock = 0;
+
+/**
+ * Controlla se entry contiene la risposta alla lettura richiesta
+ */
+static int sameRead(const cachedRead *entry, char operation, const Contact *criteria, int matchIndex) {
+    return entry->used && entry->operation == operation && entry->matchIndex == matchIndex
+        && !strcmp(entry->criteria.name, criteria->name)
+        && !strcmp(entry->criteria.surname, criteria->surname)
+        && !strcmp(entry->criteria.phoneNumber, criteria->phoneNumber);
+}
+
+int cachedReadContact(int clientFD, char readOperation, Contact *toRead, int matchIndex, Contact *serverRead) {
+
+    // Cerchiamo la lettura in cache, ricordando la posizione usata meno di recente per sostituirla
+    cachedRead *entry = NULL, *victim = &cache[0];
+    for(int i = 0; i < CONTACT_CACHE_SIZE && entry == NULL; i++) {
+        if(sameRead(&cache[i], readOperation, toRead, matchIndex))
+            entry = &cache[i];
+        else if(!cache[i].used || (victim->used && cache[i].lastUse < victim->lastUse))
+            victim = &cache[i];
+    }
+
+    unsigned int version = entry != NULL ? entry->version : 0;
+    Contact found;
+    int outcome = conditionalReadContact(clientFD, readOperation, toRead, matchIndex, &version, &found);
+
+    if(outcome == 3 && entry != NULL) { // La risposta in cache e' ancora valida
+        entry->version = version;
+        entry->lastUse = ++cacheClock;
+        if(entry->outcome == 1)
+            *serverRead = entry->found;
+        return entry->outcome;
+    }
+
+    // Nuova risposta: la conserviamo solo se il server ne ha indicato la versione
+    if((outcome == 1 || outcome == 2) && version) {
+        if(entry == NULL)
+            entry = victim;
+        entry->used = 1;
+        entry->operation = readOperation;
+        entry->criteria = *toRead;
+        entry->matchIndex = matchIndex;
+        entry->outcome = outcome;
+        entry->found = found;
+        entry->version = version;
+        entry->lastUse = ++cacheClock;
+    } else if(entry != NULL) {
+        entry->used = 0;
+    }
+
+    if(outcome == 1)
+        *serverRead = found;
+    return outcome == 3 ? 0 : outcome;
+}
@@ -0,0 +1,696 @@
+/*
+ * Copyright (c) 2024 Giannuzzi Riccardo, Biribo' Francesco, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "./../include/contactClient.h"
+
+// Stati di una connessione
+#define CC_STATE_DISCONNECTED 0
+#define CC_STATE_CONNECTING 1 // connect non bloccante in corso
+#define CC_STATE_CONNECTED 2
+
+/**
+ * Richiesta accodata o inviata
+ *
+ * Campi:
+ *  packet - Pacchetto da inviare
+ *  callback, context - Funzione di risposta e relativo parametro
+ *  internal - 1 per l'AUTH di apertura della connessione, che non ha funzione di risposta
+ *  next - Richiesta successiva nella coda
+ */
+typedef struct ccRequest {
+    serverPacket packet;
+    contactCallback callback;
+    void *context;
+    int internal;
+    struct ccRequest *next;
+} ccRequest;
+
+/**
+ * Coda di richieste, in ordine di invio
+ */
+typedef struct {
+    ccRequest *head;
+    ccRequest *tail;
+    int count;
+} ccQueue;
+
+/**
+ * Indirizzo di un server
+ *
+ * Campi:
+ *  address, length - Indirizzo
+ *  readOnly - 1 se all'ultimo AUTH il server ha risposto REDIRECT (e' una replica)
+ */
+typedef struct {
+    struct sockaddr_storage address;
+    socklen_t length;
+    int readOnly;
+} ccServer;
+
+/**
+ * Connessione verso un server
+ *
+ * Campi:
+ *  fd - Socket della connessione, -1 se chiusa
+ *  server - Indice del server in contactClient.servers
+ *  state - Uno degli stati CC_STATE_*
+ *  inFlight - Richieste assegnate alla connessione e non ancora concluse, nell'ordine di invio
+ *  writing - Prima richiesta di inFlight non ancora scritta del tutto, NULL se sono state scritte tutte
+ *  writeOffset - Byte di writing gia' scritti
+ *  received, receivedLength - Risposta ricevuta solo in parte
+ *  failures - Tentativi di connessione falliti di seguito, azzerati dalla prima risposta diversa da SERVER_BUSY
+ *  retryAt - Istante (in millisecondi, CLOCK_MONOTONIC) da cui si puo' riaprire la connessione
+ *  writable - 1 se l'AUTH della connessione e' riuscito: con credenziali solo queste ricevono ADD, DEL e MODIFY
+ */
+typedef struct {
+    int fd;
+    int server;
+    int state;
+    ccQueue inFlight;
+    ccRequest *writing;
+    size_t writeOffset;
+    char received[PACKET_LENGTH];
+    size_t receivedLength;
+    int failures;
+    long long retryAt;
+    int writable;
+} ccConnection;
+
+struct contactClient {
+    ccServer *servers;
+    int serverCount;
+    ccConnection *connections;
+    int connectionCount;
+    ccQueue queue; // Richieste non ancora assegnate a una connessione
+    char username[AUTH_PARAM_LENGTH + 1];
+    char password[AUTH_PARAM_LENGTH + 1];
+    int authenticate;
+    int authFailed;
+    unsigned int seed; // Per rand_r, senza toccare il generatore del programma
+};
+
+/**
+ * Restituisce l'istante attuale in millisecondi
+ */
+static long long nowMs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void pushBack(ccQueue *queue, ccRequest *request) {
+    request->next = NULL;
+    if(queue->tail != NULL)
+        queue->tail->next = request;
+    else
+        queue->head = request;
+    queue->tail = request;
+    queue->count++;
+}
+
+static ccRequest *popFront(ccQueue *queue) {
+    ccRequest *request = queue->head;
+    if(request != NULL) {
+        queue->head = request->next;
+        if(queue->head == NULL)
+            queue->tail = NULL;
+        queue->count--;
+    }
+    return request;
+}
+
+/**
+ * Sposta tutte le richieste di from in testa a to, mantenendone l'ordine
+ */
+static void prependQueue(ccQueue *to, ccQueue *from) {
+    if(from->head == NULL)
+        return;
+    from->tail->next = to->head;
+    if(to->tail == NULL)
+        to->tail = from->tail;
+    to->head = from->head;
+    to->count += from->count;
+    from->head = from->tail = NULL;
+    from->count = 0;
+}
+
+/**
+ * Conclude request chiamandone la funzione di risposta e la libera
+ */
+static void complete(ccRequest *request, int status, const serverPacket *response) {
+    if(!request->internal && request->callback != NULL)
+        request->callback(request->context, status, response);
+    free(request);
+}
+
+/**
+ * Toglie da queue la richiesta successiva a previous (la prima se previous e' NULL) e la restituisce
+ */
+static ccRequest *removeAfter(ccQueue *queue, ccRequest *previous) {
+    if(previous == NULL)
+        return popFront(queue);
+    ccRequest *request = previous->next;
+    previous->next = request->next;
+    if(queue->tail == request)
+        queue->tail = previous;
+    queue->count--;
+    return request;
+}
+
+/**
+ * Conclude con status tutte le richieste di queue
+ */
+static void failQueue(ccQueue *queue, int status) {
+    ccRequest *request;
+    while((request = popFront(queue)) != NULL)
+        complete(request, status, NULL);
+}
+
+/**
+ * Le letture possono essere ripetute senza effetti se la risposta e' andata persa
+ */
+static int isIdempotent(char operation) {
+    return operation == READ || operation == INSENSITIVE_READ || operation == SUFFIX_READ || operation == FUZZY_READ || operation == ORDERED_READ || operation == COUNT;
+}
+
+/**
+ * Salva in server l'indirizzo text, nella forma indirizzo:porta o percorso di una socket locale
+ *
+ * Restituisce 1 in caso di successo, 0 se l'indirizzo non e' valido
+ */
+static int parseServer(const char *text, ccServer *server) {
+    memset(server, 0, sizeof(ccServer));
+    if(strchr(text, '/') != NULL) {
+        struct sockaddr_un *local = (struct sockaddr_un*) &server->address;
+        if(strlen(text) >= sizeof(local->sun_path))
+            return 0;
+        local->sun_family = AF_UNIX;
+        strcpy(local->sun_path, text);
+        server->length = sizeof(struct sockaddr_un);
+        return 1;
+    }
+
+    const char *colon = strrchr(text, ':');
+    char host[AUTH_PARAM_LENGTH + 1];
+    if(colon == NULL || colon == text || colon - text > AUTH_PARAM_LENGTH || atoi(colon + 1) <= 0 || atoi(colon + 1) > 65535)
+        return 0;
+    memset(host, '\0', sizeof(host));
+    strncpy(host, text, colon - text);
+
+    // Come nel client, inet_pton non accetta localhost
+    struct sockaddr_in *remote = (struct sockaddr_in*) &server->address;
+    remote->sin_family = AF_INET;
+    remote->sin_port = htons(atoi(colon + 1));
+    if(strcmp(host, "localhost") == 0)
+        remote->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    else if(inet_pton(AF_INET, host, &remote->sin_addr) <= 0)
+        return 0;
+    server->length = sizeof(struct sockaddr_in);
+    return 1;
+}
+
+/**
+ * Restituisce 1 se la connessione puo' ricevere request: le letture vanno a qualsiasi connessione aperta,
+ * con credenziali le modifiche solo a quelle autenticate (una replica risponde REDIRECT all'AUTH)
+ */
+static int canCarry(contactClient *client, ccConnection *connection, ccRequest *request) {
+    return connection->state == CC_STATE_CONNECTED && connection->inFlight.count < CC_MAX_IN_FLIGHT &&
+        (!client->authenticate || connection->writable || isIdempotent(request->packet.operation));
+}
+
+/**
+ * Connessione appena stabilita: se il client ha credenziali la prima richiesta e' l'autenticazione
+ * I tentativi falliti non vengono azzerati qui: un server occupato accetta la connessione e poi la rifiuta
+ */
+static void connected(contactClient *client, ccConnection *connection) {
+    connection->state = CC_STATE_CONNECTED;
+    connection->writable = 0;
+    if(!client->authenticate)
+        return;
+    ccRequest *auth = calloc(1, sizeof(ccRequest));
+    if(auth == NULL)
+        return;
+    auth->packet.operation = AUTH;
+    strcpy(auth->packet.username, client->username);
+    strcpy(auth->packet.password, client->password);
+    auth->internal = 1;
+    pushBack(&connection->inFlight, auth);
+    connection->writing = auth;
+}
+
+/**
+ * Chiude la connessione e ne ridistribuisce le richieste: quelle non ancora inviate e le letture
+ * tornano in testa alla coda del client, le modifiche gia' inviate terminano con CC_DISCONNECTED
+ * Con requeueAll (il server ha rifiutato la connessione senza eseguire nulla) tornano in coda tutte
+ *
+ * Il prossimo tentativo di connessione e' immediato se la connessione funzionava, altrimenti
+ * attende un tempo che raddoppia a ogni fallimento fino a CC_MAX_DELAY_MS, ridotto a caso
+ * fino a meta' perche' molti client non ritentino tutti insieme dopo il riavvio di un server
+ */
+static void dropConnection(contactClient *client, ccConnection *connection, int requeueAll) {
+    close(connection->fd);
+    connection->fd = -1;
+
+    long long delay = 0;
+    if(connection->state != CC_STATE_CONNECTED || requeueAll) {
+        delay = CC_INITIAL_DELAY_MS;
+        for(int i = 0; i < connection->failures && delay < CC_MAX_DELAY_MS; i++)
+            delay *= 2;
+        if(delay > CC_MAX_DELAY_MS)
+            delay = CC_MAX_DELAY_MS;
+        delay -= rand_r(&client->seed) % (delay / 2 + 1);
+        connection->failures++;
+    }
+    connection->retryAt = nowMs() + delay;
+    connection->state = CC_STATE_DISCONNECTED;
+
+    ccQueue retry = {NULL, NULL, 0}, lost = {NULL, NULL, 0};
+    int sent = 1;
+    ccRequest *request;
+    while((request = popFront(&connection->inFlight)) != NULL) {
+        if(request == connection->writing && connection->writeOffset == 0)
+            sent = 0;
+        if(request->internal)
+            free(request);
+        else if(requeueAll || !sent || isIdempotent(request->packet.operation))
+            pushBack(&retry, request);
+        else
+            pushBack(&lost, request);
+        if(request == connection->writing)
+            sent = 0;
+    }
+    connection->writing = NULL;
+    connection->writeOffset = 0;
+    connection->receivedLength = 0;
+    prependQueue(&client->queue, &retry);
+    failQueue(&lost, CC_DISCONNECTED);
+}
+
+/**
+ * Se nessuna connessione e' aperta e tutte hanno fallito CC_MAX_FAILURES tentativi di seguito
+ * le richieste in coda terminano con CC_UNAVAILABLE, invece di attendere senza limite
+ */
+static void checkAvailability(contactClient *client) {
+    for(int i = 0; i < client->connectionCount; i++) {
+        if(client->connections[i].state != CC_STATE_DISCONNECTED || client->connections[i].failures < CC_MAX_FAILURES)
+            return;
+    }
+    failQueue(&client->queue, CC_UNAVAILABLE);
+}
+
+/**
+ * Avvia l'apertura non bloccante della connessione
+ */
+static void openConnection(contactClient *client, ccConnection *connection) {
+    ccServer *server = &client->servers[connection->server];
+    connection->fd = socket(server->address.ss_family, SOCK_STREAM, 0);
+    if(connection->fd < 0) {
+        connection->failures++;
+        connection->retryAt = nowMs() + CC_MAX_DELAY_MS;
+        return;
+    }
+    fcntl(connection->fd, F_SETFL, fcntl(connection->fd, F_GETFL) | O_NONBLOCK);
+    fcntl(connection->fd, F_SETFD, FD_CLOEXEC);
+
+    if(connect(connection->fd, (struct sockaddr*) &server->address, server->length) == 0)
+        connected(client, connection);
+    else if(errno == EINPROGRESS)
+        connection->state = CC_STATE_CONNECTING;
+    else
+        dropConnection(client, connection, 1);
+}
+
+/**
+ * Se il client ha credenziali e tutti i server sono repliche le modifiche in coda terminano con CC_UNAVAILABLE:
+ * nessuna connessione potra' riceverle
+ */
+static void checkWritable(contactClient *client) {
+    if(!client->authenticate)
+        return;
+    for(int i = 0; i < client->serverCount; i++) {
+        if(!client->servers[i].readOnly)
+            return;
+    }
+    ccRequest *previous = NULL, *request = client->queue.head;
+    while(request != NULL) {
+        ccRequest *next = request->next;
+        if(isIdempotent(request->packet.operation))
+            previous = request;
+        else
+            complete(removeAfter(&client->queue, previous), CC_UNAVAILABLE, NULL);
+        request = next;
+    }
+}
+
+/**
+ * Assegna le richieste in coda alle connessioni che possono riceverle, ogni volta a quella con meno richieste in attesa
+ * Le modifiche che non hanno ancora una connessione autenticata restano in coda, senza fermare le letture successive
+ */
+static void dispatch(contactClient *client) {
+    ccRequest *previous = NULL, *request = client->queue.head;
+    while(request != NULL) {
+        ccRequest *next = request->next;
+        ccConnection *best = NULL;
+        for(int i = 0; i < client->connectionCount; i++) {
+            ccConnection *connection = &client->connections[i];
+            if(canCarry(client, connection, request) && (best == NULL || connection->inFlight.count < best->inFlight.count))
+                best = connection;
+        }
+        if(best == NULL) {
+            previous = request;
+        } else {
+            removeAfter(&client->queue, previous);
+            pushBack(&best->inFlight, request);
+            if(best->writing == NULL)
+                best->writing = request;
+        }
+        request = next;
+    }
+}
+
+/**
+ * Scrive con una sola send le richieste non ancora inviate della connessione, finche' la socket le accetta
+ *
+ * Restituisce 1 in caso di successo, 0 se la connessione si e' interrotta
+ */
+static int flushConnection(ccConnection *connection) {
+    char buffer[(CC_MAX_IN_FLIGHT + 1) * PACKET_LENGTH];
+    size_t length = 0;
+    for(ccRequest *request = connection->writing; request != NULL; request = request->next) {
+        buildMessage(buffer + length, request->packet);
+        length += PACKET_LENGTH;
+    }
+    if(length == 0)
+        return 1;
+
+    ssize_t written = send(connection->fd, buffer + connection->writeOffset, length - connection->writeOffset, MSG_NOSIGNAL);
+    if(written < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    size_t done = connection->writeOffset + written;
+    while(done >= PACKET_LENGTH) {
+        connection->writing = connection->writing->next;
+        done -= PACKET_LENGTH;
+    }
+    connection->writeOffset = done;
+    return 1;
+}
+
+/**
+ * Gestisce la risposta response alla prima richiesta in attesa della connessione
+ *
+ * Restituisce 1 se la connessione puo' continuare, 0 se e' stata chiusa
+ */
+static int handleResponse(contactClient *client, ccConnection *connection, const serverPacket *response) {
+
+    // Il server ha rifiutato la sessione (SERVER_BUSY) prima di leggere le richieste: si ritenta piu' tardi
+    if(response->outcome == SERVER_BUSY) {
+        dropConnection(client, connection, 1);
+        return 0;
+    }
+    connection->failures = 0;
+
+    ccRequest *request = connection->inFlight.head;
+    if(request == NULL || request == connection->writing) { // Risposta a una richiesta mai inviata
+        dropConnection(client, connection, 0);
+        return 0;
+    }
+    popFront(&connection->inFlight);
+
+    /*
+     * AUTH di apertura: con successo la connessione riceve anche le modifiche, una replica (REDIRECT)
+     * resta aperta per le sole letture, ogni altro esito rifiuta le credenziali per tutto il client
+     */
+    if(request->internal && response->outcome == OPERATION_SUCCESS) {
+        connection->writable = 1;
+        client->servers[connection->server].readOnly = 0;
+    } else if(request->internal && response->outcome == REDIRECT) {
+        client->servers[connection->server].readOnly = 1;
+    } else if(request->internal) {
+        free(request);
+        client->authFailed = 1;
+        for(int i = 0; i < client->connectionCount; i++) {
+            if(client->connections[i].fd >= 0)
+                close(client->connections[i].fd);
+            client->connections[i].fd = -1;
+            client->connections[i].state = CC_STATE_DISCONNECTED;
+            client->connections[i].writing = NULL;
+            failQueue(&client->connections[i].inFlight, CC_AUTH_FAILED);
+        }
+        failQueue(&client->queue, CC_AUTH_FAILED);
+        return 0;
+    }
+    complete(request, CC_RESPONSE, response);
+    return 1;
+}
+
+/**
+ * Legge le risposte disponibili sulla connessione
+ *
+ * Restituisce 1 se la connessione e' ancora aperta, 0 altrimenti
+ */
+static int readConnection(contactClient *client, ccConnection *connection) {
+    char buffer[CC_MAX_IN_FLIGHT * PACKET_LENGTH];
+    ssize_t length = recv(connection->fd, buffer, sizeof(buffer), 0);
+    if(length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return 1;
+    if(length <= 0) {
+        dropConnection(client, connection, 0);
+        return 0;
+    }
+
+    ssize_t offset = 0;
+    while(offset < length) {
+        size_t missing = PACKET_LENGTH - connection->receivedLength;
+        size_t available = (size_t)(length - offset) < missing ? (size_t)(length - offset) : missing;
+        memcpy(connection->received + connection->receivedLength, buffer + offset, available);
+        connection->receivedLength += available;
+        offset += available;
+        if(connection->receivedLength < PACKET_LENGTH)
+            break;
+
+        connection->receivedLength = 0;
+        serverPacket response;
+        buildEmptyPacket(&response);
+        parseMessage(connection->received, &response);
+        if(!handleResponse(client, connection, &response))
+            return 0;
+    }
+    return 1;
+}
+
+contactClient *ccCreate(const char **servers, int serverCount, int connectionsPerServer, const char *username, const char *password) {
+    if(serverCount <= 0 || connectionsPerServer <= 0)
+        return NULL;
+    if(username != NULL && (strlen(username) > AUTH_PARAM_LENGTH || password == NULL || strlen(password) > AUTH_PARAM_LENGTH))
+        return NULL;
+
+    contactClient *client = calloc(1, sizeof(contactClient));
+    if(client == NULL)
+        return NULL;
+    client->servers = calloc(serverCount, sizeof(ccServer));
+    client->connections = calloc(serverCount * connectionsPerServer, sizeof(ccConnection));
+    if(client->servers == NULL || client->connections == NULL) {
+        free(client->servers);
+        free(client->connections);
+        free(client);
+        return NULL;
+    }
+    for(int i = 0; i < serverCount; i++) {
+        if(!parseServer(servers[i], &client->servers[i])) {
+            free(client->servers);
+            free(client->connections);
+            free(client);
+            return NULL;
+        }
+    }
+    client->serverCount = serverCount;
+    if(username != NULL) {
+        strcpy(client->username, username);
+        strcpy(client->password, password);
+        client->authenticate = 1;
+    }
+    client->seed = (unsigned int)(nowMs() ^ getpid());
+
+    // Le connessioni verso server diversi si alternano, per distribuire le richieste anche con poco carico
+    client->connectionCount = serverCount * connectionsPerServer;
+    for(int i = 0; i < client->connectionCount; i++) {
+        client->connections[i].fd = -1;
+        client->connections[i].server = i % serverCount;
+        openConnection(client, &client->connections[i]);
+    }
+    return client;
+}
+
+int ccSubmit(contactClient *client, const serverPacket *request, contactCallback callback, void *context) {
+    char operation = request->operation;
+    if(client->authFailed || !(isIdempotent(operation) || operation == ADD || operation == DEL || operation == MODIFY))
+        return 0;
+    ccRequest *queued = calloc(1, sizeof(ccRequest));
+    if(queued == NULL)
+        return 0;
+    queued->packet = *request;
+    queued->packet.outcome = '\0';
+    if(client->authenticate && !isIdempotent(operation) && queued->packet.username[0] == '\0') {
+        strcpy(queued->packet.username, client->username);
+        strcpy(queued->packet.password, client->password);
+    }
+    queued->callback = callback;
+    queued->context = context;
+    pushBack(&client->queue, queued);
+    return 1;
+}
+
+int ccPollFds(contactClient *client, struct pollfd *fds, int size) {
+    int count = 0;
+    for(int i = 0; i < client->connectionCount && count < size; i++) {
+        ccConnection *connection = &client->connections[i];
+        if(connection->state == CC_STATE_DISCONNECTED)
+            continue;
+        fds[count].fd = connection->fd;
+        fds[count].revents = 0;
+        if(connection->state == CC_STATE_CONNECTING)
+            fds[count].events = POLLOUT;
+        else
+            fds[count].events = POLLIN | (connection->writing != NULL ? POLLOUT : 0);
+        count++;
+    }
+    return count;
+}
+
+int ccPollTimeout(contactClient *client) {
+    if(client->queue.head == NULL)
+        return -1;
+
+    // Tipi di richieste in coda: le modifiche possono attendere una connessione autenticata
+    int reads = 0, writes = 0;
+    for(ccRequest *request = client->queue.head; request != NULL && !(reads && writes); request = request->next) {
+        if(isIdempotent(request->packet.operation))
+            reads = 1;
+        else
+            writes = 1;
+    }
+
+    // Richieste in coda: subito se una connessione puo' riceverle, altrimenti al prossimo tentativo di connessione
+    long long now = nowMs(), wait = -1;
+    for(int i = 0; i < client->connectionCount; i++) {
+        ccConnection *connection = &client->connections[i];
+        if(connection->state == CC_STATE_CONNECTED && connection->inFlight.count < CC_MAX_IN_FLIGHT &&
+           (reads || !client->authenticate || connection->writable))
+            return 0;
+        if(connection->state == CC_STATE_DISCONNECTED) {
+            long long remaining = connection->retryAt > now ? connection->retryAt - now : 0;
+            if(wait < 0 || remaining < wait)
+                wait = remaining;
+        }
+    }
+    return (int)wait;
+}
+
+void ccProcess(contactClient *client, const struct pollfd *fds, int count) {
+
+    // Gli eventi vanno abbinati prima di chiudere o riaprire connessioni, che potrebbero riusare lo stesso fd
+    short events[client->connectionCount];
+    for(int i = 0; i < client->connectionCount; i++) {
+        events[i] = 0;
+        for(int j = 0; j < count; j++) {
+            if(client->connections[i].state != CC_STATE_DISCONNECTED && fds[j].fd == client->connections[i].fd)
+                events[i] |= fds[j].revents;
+        }
+    }
+
+    for(int i = 0; i < client->connectionCount && !client->authFailed; i++) {
+        ccConnection *connection = &client->connections[i];
+        if(events[i] == 0 || connection->state == CC_STATE_DISCONNECTED)
+            continue;
+        if(connection->state == CC_STATE_CONNECTING) {
+            int error = 0;
+            socklen_t length = sizeof(error);
+            if(getsockopt(connection->fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0)
+                dropConnection(client, connection, 1);
+            else
+                connected(client, connection);
+            continue;
+        }
+        if((events[i] & (POLLIN | POLLHUP | POLLERR)) && !readConnection(client, connection))
+            continue;
+        if((events[i] & POLLOUT) && !flushConnection(connection))
+            dropConnection(client, connection, 0);
+    }
+    if(client->authFailed)
+        return;
+
+    // Le connessioni chiuse vengono riaperte solo se c'e' qualcosa da inviare
+    long long now = nowMs();
+    for(int i = 0; i < client->connectionCount; i++) {
+        ccConnection *connection = &client->connections[i];
+        if(connection->state == CC_STATE_DISCONNECTED && client->queue.head != NULL && connection->retryAt <= now)
+            openConnection(client, connection);
+    }
+    checkAvailability(client);
+    checkWritable(client);
+
+    // Le nuove richieste partono subito, senza attendere il prossimo POLLOUT
+    dispatch(client);
+    for(int i = 0; i < client->connectionCount; i++) {
+        ccConnection *connection = &client->connections[i];
+        if(connection->state == CC_STATE_CONNECTED && connection->writing != NULL && !flushConnection(connection))
+            dropConnection(client, connection, 0);
+    }
+}
+
+int ccRun(contactClient *client, int timeout) {
+    struct pollfd fds[client->connectionCount + 1];
+    int count = ccPollFds(client, fds, client->connectionCount);
+    int wait = ccPollTimeout(client);
+    if(wait < 0 || (timeout >= 0 && timeout < wait))
+        wait = timeout;
+    if(poll(fds, count, wait) < 0 && errno != EINTR)
+        return -1;
+    ccProcess(client, fds, count);
+    return ccPending(client);
+}
+
+int ccPending(contactClient *client) {
+    int pending = client->queue.count;
+    for(int i = 0; i < client->connectionCount; i++) {
+        for(ccRequest *request = client->connections[i].inFlight.head; request != NULL; request = request->next)
+            pending += !request->internal;
+    }
+    return pending;
+}
+
+void ccDestroy(contactClient *client) {
+    char closing[PACKET_LENGTH];
+    memset(closing, '\0', PACKET_LENGTH);
+    closing[OPERATION_INDEX] = INT;
+
+    for(int i = 0; i < client->connectionCount; i++) {
+        ccConnection *connection = &client->connections[i];
+
+        // Come closeConnection, senza attendere la conferma: il server chiude comunque la sessione
+        if(connection->state == CC_STATE_CONNECTED && connection->writing == NULL && connection->inFlight.head == NULL)
+            send(connection->fd, closing, PACKET_LENGTH, MSG_NOSIGNAL);
+        if(connection->fd >= 0)
+            close(connection->fd);
+        failQueue(&connection->inFlight, CC_CLOSED);
+    }
+    failQueue(&client->queue, CC_CLOSED);
+    free(client->servers);
+    free(client->connections);
+    free(client);
+}
@@ -0,0 +1,662 @@
+/*
+ * Copyright (c) 2024 Giannuzzi Riccardo, Biribo' Francesco, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Generatore di carico senza interfaccia: apre piu' connessioni al server e su ognuna invia richieste
+ * con gli stessi pacchetti del client, secondo un mix di operazioni e una frequenza obiettivo
+ *
+ * La frequenza e' a ciclo aperto: le richieste hanno un istante di invio previsto che non dipende
+ * da quanto il server ci mette a rispondere, e la latenza e' misurata da quell'istante e non dall'invio effettivo
+ * Cosi' un rallentamento del server pesa su tutte le richieste che avrebbero dovuto partire nel frattempo
+ * (correzione della coordinated omission), invece che su una sola
+ *
+ * Esempi di avvio, supponendo che il file eseguibile si chiami "loadgen":
+ *   ./loadgen - 4 connessioni a un server locale sulla porta 50000, sole letture alla massima velocita' per 10 secondi
+ *   ./loadgen -c 16 -r 5000 -d 30 localhost 50000 - 16 connessioni, 5000 richieste al secondo in totale per 30 secondi
+ *   ./loadgen -m r=70,c=10,+=10,m=5,-=5 -U admin -P admin /tmp/rubrica.sock - Mix con modifiche, sulla socket locale
+ *
+ * Come la modalita' batch il generatore legge e scrive i pacchetti da se', senza le funzioni di connection.c
+ * che terminano il processo: un errore di comunicazione o un rifiuto per server occupato viene contato
+ * come errore della connessione, che viene riaperta alla richiesta successiva, e la misura prosegue
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "./../include/connection.h"
+
+#define DEFAULT_PORT 50000 // Porta default
+#define DEFAULT_CONNECTIONS 4 // Connessioni aperte se non specificato
+#define DEFAULT_DURATION 10 // Secondi di misura se non specificato
+#define DEFAULT_MIX "r=100" // Mix di operazioni se non specificato
+#define READ_SPREAD 16 // Le letture chiedono a turno i primi READ_SPREAD contatti della rubrica
+#define OWNED_CONTACTS 64 // Contatti aggiunti da ogni connessione e non ancora cancellati, da modificare o cancellare
+#define RECONNECT_DELAY_MS 100 // Attesa dopo una riapertura fallita nel ciclo chiuso, per non ritentare a vuoto
+
+/*
+ * Istogramma delle latenze (in microsecondi) con lo stesso schema delle metriche del server:
+ * ogni potenza di due e' divisa in SUB_BUCKETS intervalli uguali, errore relativo massimo circa 6%
+ */
+#define SUB_BITS 4
+#define SUB_BUCKETS (1 << SUB_BITS)
+#define MAX_SHIFT 32
+#define BUCKETS (SUB_BUCKETS * (MAX_SHIFT + 2))
+
+// Operazioni generate, nell'ordine delle posizioni dei contatori
+#define LOAD_OPERATIONS "rca+-m"
+#define LOAD_SLOTS 6
+
+/**
+ * Latenze misurate
+ *
+ * Campi:
+ *  count - Richieste misurate
+ *  totalUs - Somma delle latenze, per la media
+ *  maxUs - Latenza massima
+ *  buckets - Numero di richieste per intervallo di latenza (vedi bucketOf)
+ */
+typedef struct {
+    unsigned long count;
+    unsigned long totalUs;
+    unsigned long maxUs;
+    unsigned long buckets[BUCKETS];
+} latencyHistogram;
+
+/**
+ * Stato e risultati di una connessione, ognuna servita dal proprio thread
+ *
+ * Campi:
+ *  id - Numero della connessione, usato per i contatti generati
+ *  connected - 1 se la connessione e' stata aperta
+ *  clientFD - Socket della connessione, -1 se va riaperta dopo un errore
+ *  requests - Richieste completate per operazione, nelle posizioni di LOAD_OPERATIONS
+ *  successes - Richieste completate con successo per operazione
+ *  errors - Richieste fallite per errore di comunicazione o perche' il server era occupato
+ *  skipped - Richieste previste ma non inviate perche' oltre il tempo massimo
+ *  response - Latenze dall'istante previsto per l'invio (corrette per la coordinated omission),
+ *             comprese le richieste non inviate, registrate con l'attesa accumulata fino alla rinuncia
+ *  service - Latenze dall'invio effettivo, cioe' il solo tempo di servizio del server
+ *  owned - Contatti aggiunti da questa connessione e non ancora cancellati
+ *  ownedCount - Numero di contatti in owned
+ *  sequence - Progressivo dei contatti generati
+ *  seed - Stato del generatore casuale del thread
+ */
+typedef struct {
+    int id;
+    int connected;
+    int clientFD;
+    unsigned long requests[LOAD_SLOTS];
+    unsigned long successes[LOAD_SLOTS];
+    unsigned long errors;
+    unsigned long skipped;
+    latencyHistogram response;
+    latencyHistogram service;
+    Contact owned[OWNED_CONTACTS];
+    int ownedCount;
+    unsigned long sequence;
+    unsigned int seed;
+} loadWorker;
+
+// Parametri della misura, condivisi in sola lettura dai thread
+static struct sockaddr_storage serverAddress;
+static socklen_t addressLength;
+static int connectionCount;
+static int weights[LOAD_SLOTS];
+static int totalWeight;
+static long long intervalNs; // Intervallo tra due richieste della stessa connessione, 0 per il ciclo chiuso
+static long long startNs, endNs, deadlineNs;
+static char username[AUTH_STRING_LENGTH] = "";
+static char password[AUTH_STRING_LENGTH] = "";
+
+/**
+ * Restituisce l'istante attuale del clock monotono in nanosecondi
+ */
+static long long nowNs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/**
+ * Attende fino all'istante instantNs del clock monotono
+ */
+static void sleepUntil(long long instantNs) {
+    struct timespec until = {instantNs / 1000000000LL, instantNs % 1000000000LL};
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) == EINTR);
+}
+
+/**
+ * Restituisce l'intervallo dell'istogramma in cui cade la latenza latencyUs
+ */
+static int bucketOf(unsigned long latencyUs) {
+    if(latencyUs < SUB_BUCKETS)
+        return (int)latencyUs;
+    int highest = 63 - __builtin_clzl(latencyUs);
+    int shift = highest - SUB_BITS;
+    int bucket = SUB_BUCKETS * (shift + 1) + (int)((latencyUs >> shift) - SUB_BUCKETS);
+    return bucket < BUCKETS ? bucket : BUCKETS - 1;
+}
+
+/**
+ * Restituisce il valore piu' alto che cade nell'intervallo bucket
+ */
+static unsigned long bucketUpperBound(int bucket) {
+    if(bucket < SUB_BUCKETS)
+        return bucket;
+    int shift = bucket / SUB_BUCKETS - 1;
+    unsigned long lower = (unsigned long)(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    return lower + (1UL << shift) - 1;
+}
+
+/**
+ * Registra in histogram una richiesta durata latencyUs microsecondi
+ */
+static void recordLatency(latencyHistogram *histogram, unsigned long latencyUs) {
+    histogram->count++;
+    histogram->totalUs += latencyUs;
+    histogram->buckets[bucketOf(latencyUs)]++;
+    if(latencyUs > histogram->maxUs)
+        histogram->maxUs = latencyUs;
+}
+
+/**
+ * Somma a total le latenze di partial
+ */
+static void mergeHistogram(latencyHistogram *total, const latencyHistogram *partial) {
+    total->count += partial->count;
+    total->totalUs += partial->totalUs;
+    if(partial->maxUs > total->maxUs)
+        total->maxUs = partial->maxUs;
+    for(int i = 0; i < BUCKETS; i++)
+        total->buckets[i] += partial->buckets[i];
+}
+
+/**
+ * Restituisce la latenza sotto cui cade la frazione percentile (tra 0 e 1) delle richieste in histogram
+ */
+static unsigned long percentileOf(const latencyHistogram *histogram, double percentile) {
+    if(histogram->count == 0)
+        return 0;
+    unsigned long wanted = (unsigned long)(percentile * histogram->count + 0.5), seen = 0;
+    if(wanted < 1)
+        wanted = 1;
+    int i;
+    for(i = 0; i < BUCKETS - 1; i++) {
+        seen += histogram->buckets[i];
+        if(seen >= wanted)
+            break;
+    }
+    unsigned long bound = bucketUpperBound(i);
+    return bound > histogram->maxUs ? histogram->maxUs : bound;
+}
+
+/**
+ * Legge il mix di operazioni mix, nella forma "op=peso,op=peso" con op tra quelle di LOAD_OPERATIONS
+ * (r lettura, c conteggio, a autenticazione, + aggiunta, - cancellazione, m modifica)
+ *
+ * Restituisce 1 se il mix e' valido, 0 altrimenti
+ */
+static int parseMix(const char *mix) {
+    memset(weights, 0, sizeof(weights));
+    totalWeight = 0;
+    const char *cursor = mix;
+    while(*cursor != '\0') {
+        const char *slot = strchr(LOAD_OPERATIONS, *cursor);
+        if(slot == NULL || cursor[1] != '=')
+            return 0;
+        char *end;
+        long weight = strtol(cursor + 2, &end, 10);
+        if(end == cursor + 2 || weight < 0 || weight > 1000000 || (*end != ',' && *end != '\0'))
+            return 0;
+        weights[slot - LOAD_OPERATIONS] += (int)weight;
+        totalWeight += (int)weight;
+        cursor = *end == ',' ? end + 1 : end;
+    }
+    return totalWeight > 0;
+}
+
+/**
+ * Sceglie a caso, secondo i pesi del mix, l'operazione della prossima richiesta
+ *
+ * Restituisce la posizione dell'operazione in LOAD_OPERATIONS
+ */
+static int pickOperation(loadWorker *worker) {
+    int draw = rand_r(&worker->seed) % totalWeight;
+    int slot = 0;
+    while(draw >= weights[slot]) {
+        draw -= weights[slot];
+        slot++;
+    }
+    return slot;
+}
+
+/**
+ * Genera in contact un nuovo contatto della connessione di worker, diverso da tutti quelli
+ * generati dalle altre connessioni (il nome dipende dalla connessione, il cognome dal progressivo)
+ */
+static void generateContact(loadWorker *worker, Contact *contact) {
+    worker->sequence++;
+    snprintf(contact->name, sizeof(contact->name), "Load%d", worker->id);
+    snprintf(contact->surname, sizeof(contact->surname), "S%lu", worker->sequence % 1000000000UL);
+    snprintf(contact->phoneNumber, sizeof(contact->phoneNumber), "%010lu",
+             ((unsigned long)worker->id * 100000000UL + worker->sequence) % 10000000000UL);
+}
+
+/**
+ * Apre una connessione al server della misura
+ *
+ * Restituisce il descrittore della socket, -1 in caso di errore
+ */
+static int openConnection(void) {
+    int clientFD = socket(serverAddress.ss_family, SOCK_STREAM, 0);
+    if(clientFD < 0)
+        return -1;
+    if(connect(clientFD, (struct sockaddr*) &serverAddress, addressLength) < 0) {
+        close(clientFD);
+        return -1;
+    }
+    return clientFD;
+}
+
+/**
+ * Invia request sulla connessione di worker e ne attende la risposta in response
+ * I pacchetti possono arrivare in piu' parti, come in batch.c si legge e scrive finche' non sono completi
+ *
+ * Restituisce 1 se e' arrivata la risposta, 0 in caso di errore di comunicazione o se il server ha rifiutato
+ * la connessione perche' occupato: la connessione viene chiusa, e riaperta alla richiesta successiva
+ */
+static int exchangeRequest(loadWorker *worker, serverPacket request, serverPacket *response) {
+    char message[PACKET_LENGTH];
+    buildMessage(message, request);
+    size_t done = 0;
+    while(done < PACKET_LENGTH) {
+        ssize_t length = write(worker->clientFD, message + done, PACKET_LENGTH - done);
+        if(length < 0 && errno == EINTR)
+            continue;
+        if(length <= 0)
+            break;
+        done += length;
+    }
+    if(done == PACKET_LENGTH) {
+        done = 0;
+        while(done < PACKET_LENGTH) {
+            ssize_t length = read(worker->clientFD, message + done, PACKET_LENGTH - done);
+            if(length < 0 && errno == EINTR)
+                continue;
+            if(length <= 0)
+                break;
+            done += length;
+        }
+    }
+    if(done == PACKET_LENGTH) {
+        buildEmptyPacket(response);
+        parseMessage(message, response);
+        if(response->outcome != SERVER_BUSY)
+            return 1;
+    }
+    close(worker->clientFD);
+    worker->clientFD = -1;
+    return 0;
+}
+
+/**
+ * Esegue sulla connessione di worker una richiesta dell'operazione in posizione *slot
+ * Cancellazioni e modifiche lavorano sui contatti aggiunti in precedenza dalla stessa connessione:
+ * se non ce ne sono la richiesta diventa un'aggiunta e *slot viene aggiornato
+ * Una connessione chiusa dopo un errore viene prima riaperta
+ *
+ * Restituisce 1 in caso di successo, 0 se il server ha risposto con un altro esito,
+ * -1 in caso di errore di comunicazione o di server occupato
+ */
+static int runOperation(loadWorker *worker, int *slot) {
+    char operation = LOAD_OPERATIONS[*slot];
+    if((operation == DEL || operation == MODIFY) && worker->ownedCount == 0)
+        operation = ADD;
+    if(operation == ADD && worker->ownedCount == OWNED_CONTACTS)
+        operation = DEL; // Manteniamo limitato il numero di contatti lasciati nella rubrica
+    *slot = (int)(strchr(LOAD_OPERATIONS, operation) - LOAD_OPERATIONS);
+
+    if(worker->clientFD < 0 && (worker->clientFD = openConnection()) < 0)
+        return -1;
+
+    // Stessi pacchetti delle funzioni di connection.c, le modifiche portano le credenziali
+    serverPacket request, response;
+    buildEmptyPacket(&request);
+    request.operation = operation;
+    Contact *target = NULL, modified;
+    switch(operation) {
+        case READ:
+            request.matchIndex = 1 + (int)(worker->sequence++ % READ_SPREAD);
+            break;
+        case COUNT:
+            request.newName[0] = READ; // Conteggio con i criteri della lettura esatta
+            break;
+        case AUTH:
+            strcpy(request.username, username);
+            strcpy(request.password, password);
+            break;
+        case ADD:
+            target = &modified;
+            generateContact(worker, target);
+            break;
+        case DEL:
+            target = &worker->owned[worker->ownedCount - 1];
+            break;
+        default: // MODIFY, cambia il numero di telefono di uno dei contatti aggiunti
+            target = &worker->owned[rand_r(&worker->seed) % worker->ownedCount];
+            generateContact(worker, &modified);
+            strcpy(modified.name, target->name);
+            strcpy(modified.surname, target->surname);
+            strcpy(request.newName, modified.name);
+            strcpy(request.newSurname, modified.surname);
+            strcpy(request.newPhoneNumber, modified.phoneNumber);
+            break;
+    }
+    if(target != NULL) {
+        strcpy(request.username, username);
+        strcpy(request.password, password);
+        strcpy(request.name, target->name);
+        strcpy(request.surname, target->surname);
+        strcpy(request.phoneNumber, target->phoneNumber);
+    }
+
+    int exchanged = exchangeRequest(worker, request, &response);
+
+    // Un contatto cancellato viene dimenticato anche se la risposta e' andata persa: potrebbe non esserci piu'
+    if(operation == DEL)
+        worker->ownedCount--;
+    if(!exchanged)
+        return -1;
+    if(response.outcome != OPERATION_SUCCESS)
+        return 0;
+    if(operation == ADD)
+        worker->owned[worker->ownedCount++] = modified;
+    else if(operation == MODIFY)
+        *target = modified;
+    return 1;
+}
+
+/**
+ * Corpo del thread di una connessione: invia le richieste secondo il calendario
+ * fino alla fine della misura e ne registra le latenze
+ */
+static void *runWorker(void *argument) {
+    loadWorker *worker = argument;
+    worker->clientFD = openConnection();
+    if(worker->clientFD < 0) {
+        fprintf(stderr, "Connessione %d non riuscita\n", worker->id);
+        return NULL;
+    }
+    worker->connected = 1;
+
+    /*
+     * Le connessioni partono sfasate di una frazione dell'intervallo, in modo che le richieste
+     * arrivino al server distribuite uniformemente e non a raffiche di una per connessione
+     */
+    long long scheduled = startNs + (intervalNs > 0 ? intervalNs * worker->id / connectionCount : 0);
+    while(scheduled < endNs) {
+        long long now = nowNs();
+        if(intervalNs > 0) {
+            if(now >= deadlineNs) {
+
+                /*
+                 * Se il server e' rimasto troppo indietro le richieste mancanti vengono contate come non inviate,
+                 * e registrate con l'attesa che avevano gia' accumulato: toglierle dall'istogramma
+                 * nasconderebbe proprio il ritardo che le ha fatte saltare
+                 */
+                for(; scheduled < endNs; scheduled += intervalNs) {
+                    worker->skipped++;
+                    recordLatency(&worker->response, (unsigned long)((now - scheduled) / 1000));
+                }
+                break;
+            }
+            if(scheduled > now) {
+                sleepUntil(scheduled);
+                now = scheduled;
+            }
+        } else {
+            scheduled = now; // Ciclo chiuso: ogni richiesta parte appena arriva la risposta precedente
+        }
+
+        int slot = pickOperation(worker);
+        long long sent = nowNs();
+        int outcome = runOperation(worker, &slot);
+        long long done = nowNs();
+
+        // Le richieste fallite non hanno una latenza da misurare, vengono solo contate
+        if(outcome < 0) {
+            worker->errors++;
+            if(worker->clientFD < 0 && intervalNs == 0)
+                sleepUntil(done + RECONNECT_DELAY_MS * 1000000LL);
+        } else {
+            worker->requests[slot]++;
+            if(outcome == 1)
+                worker->successes[slot]++;
+            recordLatency(&worker->response, (unsigned long)((done - scheduled) / 1000));
+            recordLatency(&worker->service, (unsigned long)((done - sent) / 1000));
+        }
+
+        if(intervalNs > 0)
+            scheduled += intervalNs;
+        else
+            scheduled = done;
+    }
+
+    // Il server chiude la sessione quando legge la fine della connessione, senza bisogno di closeConnection (che stampa a video)
+    if(worker->clientFD > -1)
+        close(worker->clientFD);
+    return NULL;
+}
+
+/**
+ * Imposta l'indirizzo del server dagli argomenti posizionali, come fa il client:
+ * nessuno per il server locale sulla porta di default, un percorso per la socket locale, indirizzo e porta altrimenti
+ *
+ * Restituisce 1 se l'indirizzo e' valido, 0 altrimenti
+ */
+static int parseAddress(int count, char **arguments) {
+    memset(&serverAddress, 0, sizeof(serverAddress));
+    if(count == 1) {
+        struct sockaddr_un *localAddress = (struct sockaddr_un*) &serverAddress;
+        if(strlen(arguments[0]) >= sizeof(localAddress->sun_path))
+            return 0;
+        localAddress->sun_family = AF_UNIX;
+        strcpy(localAddress->sun_path, arguments[0]);
+        addressLength = sizeof(struct sockaddr_un);
+        return 1;
+    }
+
+    struct sockaddr_in *networkAddress = (struct sockaddr_in*) &serverAddress;
+    networkAddress->sin_family = AF_INET;
+    addressLength = sizeof(struct sockaddr_in);
+    int port = DEFAULT_PORT;
+    if(count == 2) {
+        if(strcmp(arguments[0], "localhost") == 0)
+            networkAddress->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        else if(inet_pton(AF_INET, arguments[0], &networkAddress->sin_addr) <= 0)
+            return 0;
+        port = atoi(arguments[1]);
+        if(port <= 0 || port > 65535)
+            return 0;
+    } else if(count == 0) {
+        networkAddress->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    } else {
+        return 0;
+    }
+    networkAddress->sin_port = htons(port);
+    return 1;
+}
+
+/**
+ * Stampa media, percentili e massimo delle latenze di histogram, in millisecondi
+ */
+static void printLatencies(const char *title, const latencyHistogram *histogram) {
+    printf("%s\n", title);
+    printf("  media %.3f  p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f  max %.3f ms\n",
+           histogram->count > 0 ? histogram->totalUs / 1000.0 / histogram->count : 0.0,
+           percentileOf(histogram, 0.50) / 1000.0, percentileOf(histogram, 0.90) / 1000.0,
+           percentileOf(histogram, 0.99) / 1000.0, percentileOf(histogram, 0.999) / 1000.0,
+           histogram->maxUs / 1000.0);
+}
+
+/**
+ * Stampa la distribuzione delle latenze di histogram, raggruppando gli intervalli per potenza di due
+ */
+static void printHistogram(const latencyHistogram *histogram) {
+    printf("Distribuzione delle latenze (dall'istante previsto):\n");
+    unsigned long seen = 0;
+    for(int group = 0; group <= MAX_SHIFT + 1 && seen < histogram->count; group++) {
+        unsigned long inGroup = 0;
+        for(int i = group * SUB_BUCKETS; i < (group + 1) * SUB_BUCKETS; i++)
+            inGroup += histogram->buckets[i];
+        if(inGroup == 0)
+            continue;
+        seen += inGroup;
+
+        // Una barra di al massimo 40 caratteri, proporzionale alla frazione di richieste nel gruppo
+        char bar[41];
+        int length = (int)(40 * inGroup / histogram->count);
+        memset(bar, '#', length);
+        bar[length] = '\0';
+        printf("  <= %10.3f ms %10lu %6.2f%% %s\n", bucketUpperBound((group + 1) * SUB_BUCKETS - 1) / 1000.0,
+               inGroup, 100.0 * inGroup / histogram->count, bar);
+    }
+}
+
+int main(int argc, char **argv) {
+    int connections = DEFAULT_CONNECTIONS, duration = DEFAULT_DURATION;
+    double rate = 0;
+    const char *mix = DEFAULT_MIX;
+
+    int option;
+    while((option = getopt(argc, argv, "c:r:d:m:U:P:")) != -1) {
+        switch(option) {
+            case 'c': connections = atoi(optarg); break;
+            case 'r': rate = atof(optarg); break;
+            case 'd': duration = atoi(optarg); break;
+            case 'm': mix = optarg; break;
+            case 'U': strncpy(username, optarg, AUTH_STRING_LENGTH - 1); break;
+            case 'P': strncpy(password, optarg, AUTH_STRING_LENGTH - 1); break;
+            default:
+                fprintf(stderr, "Uso: %s [-c connessioni] [-r richieste/s] [-d secondi] [-m op=peso,...] [-U utente -P password] [indirizzo porta | socket]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if(connections <= 0 || duration <= 0 || rate < 0) {
+        fprintf(stderr, "Connessioni, durata e frequenza devono essere positive\n");
+        exit(EXIT_FAILURE);
+    }
+    if(!parseMix(mix)) {
+        fprintf(stderr, "Mix di operazioni non valido: %s (esempio: r=80,c=10,+=5,m=3,-=2)\n", mix);
+        exit(EXIT_FAILURE);
+    }
+    // Autenticazioni e modifiche richiedono le credenziali
+    if((weights[2] || weights[3] || weights[4] || weights[5]) && (username[0] == '\0' || password[0] == '\0')) {
+        fprintf(stderr, "Il mix contiene operazioni che richiedono le credenziali (-U e -P)\n");
+        exit(EXIT_FAILURE);
+    }
+    if(!parseAddress(argc - optind, argv + optind)) {
+        fprintf(stderr, "Indirizzo del server non valido\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Le scritture su una connessione chiusa dal server devono fallire, non terminare il processo
+    signal(SIGPIPE, SIG_IGN);
+
+    loadWorker *workers = calloc(connections, sizeof(loadWorker));
+    pthread_t *threads = calloc(connections, sizeof(pthread_t));
+    if(workers == NULL || threads == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    /*
+     * Ogni connessione invia rate/connections richieste al secondo
+     * Se il server non riesce a starci dietro la misura prosegue oltre la durata prevista per smaltire le richieste
+     * in ritardo, al massimo per un'altra durata: quelle rimaste vengono riportate come non inviate
+     */
+    connectionCount = connections;
+    intervalNs = rate > 0 ? (long long)(1e9 * connections / rate) : 0;
+    if(rate > 0 && intervalNs == 0)
+        intervalNs = 1;
+    startNs = nowNs() + 100000000LL; // Lasciamo ai thread il tempo di connettersi prima della prima richiesta
+    endNs = startNs + duration * 1000000000LL;
+    deadlineNs = endNs + duration * 1000000000LL;
+
+    for(int i = 0; i < connections; i++) {
+        workers[i].id = i;
+        workers[i].seed = (unsigned int)(time(NULL) ^ (i * 2654435761U));
+        if(pthread_create(&threads[i], NULL, runWorker, &workers[i]) != 0) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Raccolta dei risultati di tutte le connessioni
+    static latencyHistogram response, service;
+    unsigned long requests[LOAD_SLOTS] = {0}, successes[LOAD_SLOTS] = {0}, errors = 0, skipped = 0, total = 0;
+    int opened = 0;
+    for(int i = 0; i < connections; i++) {
+        pthread_join(threads[i], NULL);
+        mergeHistogram(&response, &workers[i].response);
+        mergeHistogram(&service, &workers[i].service);
+        for(int slot = 0; slot < LOAD_SLOTS; slot++) {
+            requests[slot] += workers[i].requests[slot];
+            successes[slot] += workers[i].successes[slot];
+        }
+        errors += workers[i].errors;
+        skipped += workers[i].skipped;
+        opened += workers[i].connected;
+    }
+    if(opened == 0) {
+        fprintf(stderr, "Nessuna connessione al server riuscita\n");
+        exit(EXIT_FAILURE);
+    }
+    double elapsed = (nowNs() - startNs) / 1e9;
+    for(int slot = 0; slot < LOAD_SLOTS; slot++)
+        total += requests[slot];
+
+    static const char *names[LOAD_SLOTS] = {"READ", "COUNT", "AUTH", "ADD", "DEL", "MODIFY"};
+    printf("Connessioni: %d su %d, durata prevista: %d s, frequenza obiettivo: ", opened, connections, duration);
+    if(rate > 0)
+        printf("%.0f richieste/s\n", rate);
+    else
+        printf("massima (ciclo chiuso)\n");
+    printf("Richieste completate: %lu in %.2f s (%.1f richieste/s)", total, elapsed, total / elapsed);
+    if(skipped > 0)
+        printf(", non inviate per ritardo del server: %lu", skipped);
+    printf("\n");
+    if(errors > 0) {
+        printf("Richieste fallite (errore di comunicazione o server occupato): %lu\n", errors);
+        for(int i = 0; i < connections; i++) {
+            if(workers[i].errors > 0)
+                printf("  connessione %d: %lu\n", i, workers[i].errors);
+        }
+    }
+    printf("  %-8s %12s %12s\n", "Op", "Richieste", "Successi");
+    for(int slot = 0; slot < LOAD_SLOTS; slot++) {
+        if(requests[slot] > 0)
+            printf("  %-8s %12lu %12lu\n", names[slot], requests[slot], successes[slot]);
+    }
+    printLatencies("Latenza dall'istante previsto per l'invio (corretta per la coordinated omission):", &response);
+    printLatencies("Tempo di servizio (dall'invio effettivo):", &service);
+    printHistogram(&response);
+
+    free(workers);
+    free(threads);
+    return 0;
+}
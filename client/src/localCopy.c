@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2024 Giannuzzi Riccardo, Biribo' Francesco, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "./../include/connection.h"
+#include "./../include/localCopy.h"
+
+/**
+ * Copia locale caricata in memoria
+ * 
+ * Campi:
+ *  contacts - Contatti, nell'ordine della rubrica
+ *  count - Numero di contatti
+ *  capacity - Numero di contatti allocati
+ */
+typedef struct {
+    Contact *contacts;
+    int count;
+    int capacity;
+} localBook;
+
+/**
+ * Aggiunge contact in fondo alla copia
+ * 
+ * Restituisce 1 in caso di successo, 0 in caso di errore di memoria
+ */
+static int appendLocal(localBook *book, const Contact *contact) {
+    if(book->count == book->capacity) {
+        int capacity = book->capacity ? book->capacity * 2 : 64;
+        Contact *contacts = realloc(book->contacts, capacity * sizeof(Contact));
+        if(contacts == NULL)
+            return 0;
+        book->contacts = contacts;
+        book->capacity = capacity;
+    }
+    book->contacts[book->count++] = *contact;
+    return 1;
+}
+
+/**
+ * Controlla se contact e' coinvolto dalla rimozione o modifica di old
+ * (stesso nome e cognome, numero che inizia con quello di old, come sul server)
+ */
+static int matchesLocal(const Contact *contact, const Contact *old) {
+    return !strcmp(contact->name, old->name) && !strcmp(contact->surname, old->surname)
+        && !strncmp(contact->phoneNumber, old->phoneNumber, strlen(old->phoneNumber));
+}
+
+/**
+ * Applica alla copia una modifica ricevuta dal server
+ */
+static int applyLocal(localBook *book, char operation, const Contact *old, const Contact *new) {
+    if(operation == ADD)
+        return appendLocal(book, old);
+
+    int kept = 0;
+    for(int i = 0; i < book->count; i++) {
+        if(!matchesLocal(&book->contacts[i], old))
+            book->contacts[kept++] = book->contacts[i];
+        else if(operation == MODIFY)
+            book->contacts[kept++] = *new;
+    }
+    book->count = kept;
+    return 1;
+}
+
+/**
+ * Carica la copia salvata in path, salvandone la versione in version
+ * Se il file non esiste la copia e' vuota e la versione 0
+ */
+static int loadLocal(const char *path, localBook *book, unsigned int *version) {
+    *version = 0;
+    FILE *file = fopen(path, "r");
+    if(file == NULL)
+        return 1;
+
+    char line[3 * CONTACT_STRINGS_LENGTH + 4];
+    int loaded = fscanf(file, "%u\n", version) == 1;
+    while(loaded && fgets(line, sizeof(line), file) != NULL) {
+        Contact contact;
+        memset(&contact, '\0', sizeof(Contact));
+        line[strcspn(line, "\n")] = '\0';
+        char *name = strtok(line, ","), *surname = strtok(NULL, ","), *phoneNumber = strtok(NULL, ",");
+        if(name == NULL || surname == NULL || phoneNumber == NULL)
+            continue;
+        strncpy(contact.name, name, CONTACT_STRINGS_LENGTH - 1);
+        strncpy(contact.surname, surname, CONTACT_STRINGS_LENGTH - 1);
+        strncpy(contact.phoneNumber, phoneNumber, CONTACT_STRINGS_LENGTH - 1);
+        loaded = appendLocal(book, &contact);
+    }
+    fclose(file);
+
+    // Una copia illeggibile viene sostituita da quella completa
+    if(!loaded) {
+        book->count = 0;
+        *version = 0;
+    }
+    return 1;
+}
+
+/**
+ * Salva la copia in path, passando da un file temporaneo per non lasciare mai una copia a meta'
+ */
+static int saveLocal(const char *path, const localBook *book, unsigned int version) {
+    char tmpPath[256];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    FILE *file = fopen(tmpPath, "w");
+    if(file == NULL)
+        return 0;
+    int saved = fprintf(file, "%u\n", version) > 0;
+    for(int i = 0; i < book->count && saved; i++)
+        saved = fprintf(file, "%s,%s,%s\n", book->contacts[i].name, book->contacts[i].surname, book->contacts[i].phoneNumber) > 0;
+    if(fclose(file) != 0 || !saved) {
+        remove(tmpPath);
+        return 0;
+    }
+    return rename(tmpPath, path) == 0;
+}
+
+int syncLocalCopy(int clientFD, const char *path, int *changes, int *total) {
+    localBook book = {NULL, 0, 0};
+    unsigned int version;
+    loadLocal(path, &book, &version);
+
+    // Chiediamo le modifiche e le leggiamo tutte, fino alla fine della sincronizzazione
+    requestChangesSince(clientFD, version);
+    int outcome, applied = 1;
+    *changes = 0;
+    do {
+        char operation;
+        Contact old, new;
+        outcome = readChange(clientFD, &operation, &old, &new, &version);
+        if(outcome == 1) {
+            applied = applied && applyLocal(&book, operation, &old, &new);
+            (*changes)++;
+        } else if(outcome == 2) { // Segue la rubrica completa
+            book.count = 0;
+        }
+    } while(outcome == 1 || outcome == 2);
+
+    int synced = outcome == 3 && applied && saveLocal(path, &book, version);
+    *total = book.count;
+    free(book.contacts);
+    return synced;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2024 Giannuzzi Riccardo, Biribo' Francesco, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "./../include/connection.h"
+#include "./../include/contactCache.h"
+#include "./../include/prefetch.h"
+
+static int prefetchWindow = DEFAULT_PREFETCH_WINDOW;
+
+// Ricerca delle ultime letture anticipate
+static char prefetchedOperation = '\0';
+static Contact prefetchedCriteria;
+static int prefetchedDistance = 0;
+
+void setPrefetchWindow(int window) {
+    if(window < 0)
+        window = 0;
+    if(window > MAX_PIPELINED)
+        window = MAX_PIPELINED;
+    prefetchWindow = window;
+}
+
+/**
+ * Prepara in packet la lettura della corrispondenza matchIndex, identica a quella
+ * delle funzioni di lettura in modo che la risposta anticipata si possa ritrovare
+ */
+static void buildMatchRequest(serverPacket *packet, char readOperation, Contact *toRead, int maxDistance, int matchIndex) {
+    buildEmptyPacket(packet);
+    packet->operation = readOperation;
+    packet->matchIndex = matchIndex;
+    strcpy(packet->name, toRead->name);
+    strcpy(packet->surname, toRead->surname);
+    strcpy(packet->phoneNumber, toRead->phoneNumber);
+    if(readOperation == FUZZY_READ)
+        sprintf(packet->newName, "%d", maxDistance);
+}
+
+void prefetchMatches(int clientFD, char readOperation, Contact *toRead, int maxDistance, int matchIndex) {
+
+    // Le letture anticipate di un'altra ricerca non verranno piu' consumate
+    if(readOperation != prefetchedOperation || maxDistance != prefetchedDistance || strcmp(toRead->name, prefetchedCriteria.name) != 0 ||
+       strcmp(toRead->surname, prefetchedCriteria.surname) != 0 || strcmp(toRead->phoneNumber, prefetchedCriteria.phoneNumber) != 0) {
+        pipelineDiscard();
+        prefetchedOperation = readOperation;
+        prefetchedCriteria = *toRead;
+        prefetchedDistance = maxDistance;
+    }
+
+    for(int next = matchIndex + 1; next <= matchIndex + prefetchWindow; next++) {
+        serverPacket request;
+        buildMatchRequest(&request, readOperation, toRead, maxDistance, next);
+        if(!pipelineContains(request) && !pipelineRequest(clientFD, request))
+            return;
+    }
+}
+
+void resetPrefetch(void) {
+    pipelineDiscard();
+    prefetchedOperation = '\0';
+}
+
+int pagedReadContact(int clientFD, char readOperation, Contact *toRead, int maxDistance, int matchIndex, Contact *serverRead) {
+    serverPacket request, received;
+    buildMatchRequest(&request, readOperation, toRead, maxDistance, matchIndex);
+    if(pipelineResponse(clientFD, request, &received)) {
+        strcpy(serverRead->name, received.name);
+        strcpy(serverRead->surname, received.surname);
+        strcpy(serverRead->phoneNumber, received.phoneNumber);
+        if(received.outcome == OPERATION_SUCCESS)
+            return 1;
+        return received.outcome == READ_CONTACT_MISSING ? 2 : 0;
+    }
+
+    // Corrispondenza non anticipata (finestra a 0, pipeline piena o connessione interrotta)
+    if(readOperation == FUZZY_READ)
+        return fuzzyReadContact(clientFD, toRead, maxDistance, matchIndex, serverRead);
+    if(readOperation == SUFFIX_READ)
+        return suffixReadContact(clientFD, toRead, matchIndex, serverRead);
+    return cachedReadContact(clientFD, readOperation, toRead, matchIndex, serverRead);
+}
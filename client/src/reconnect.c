@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2024 Giannuzzi Riccardo, Biribo' Francesco, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "./../include/utility.h"
+#include "./../include/reconnect.h"
+
+// Indirizzo del server, salvato da setServerAddress
+static struct sockaddr_storage serverAddress;
+static socklen_t serverAddressLength = 0;
+
+int backoffDelay(int attempt) {
+    int delay = INITIAL_DELAY;
+    for(int i = 1; i < attempt && delay < MAX_DELAY; i++)
+        delay *= 2;
+    if(delay > MAX_DELAY)
+        delay = MAX_DELAY;
+    return delay - rand() % (delay / 2 + 1);
+}
+
+void setServerAddress(const struct sockaddr *address, socklen_t length) {
+    memcpy(&serverAddress, address, length);
+    serverAddressLength = length;
+    srand(time(NULL) ^ getpid());
+}
+
+int reconnectToServer(int clientFD) {
+    if(serverAddressLength == 0)
+        return 0;
+
+    // Il primo tentativo e' immediato: dopo un riavvio il server potrebbe essere gia' disponibile
+    printf(RESET_COLOR "\n");
+    for(int attempt = 1; attempt <= MAX_CONNECTION_ATTEMPTS; attempt++) {
+        int newFD = socket(serverAddress.ss_family, SOCK_STREAM, 0);
+        if(newFD >= 0 && connect(newFD, (struct sockaddr*) &serverAddress, serverAddressLength) == 0) {
+
+            // Il nuovo collegamento prende il posto del vecchio, cosi' clientFD resta valido per il resto del client
+            int restored = dup2(newFD, clientFD) == clientFD;
+            close(newFD);
+            if(restored) {
+                printf("\r" GREEN "Connessione con il server ristabilita" RESET_COLOR "                              \n");
+                return 1;
+            }
+        } else if(newFD >= 0) {
+            close(newFD);
+        }
+        if(attempt == MAX_CONNECTION_ATTEMPTS)
+            break;
+
+        // Decrementiamo un secondo alla volta per comunicare in modo più preciso i secondi mancanti all'utente
+        for(int delay = backoffDelay(attempt); delay > 0; delay--) {
+            printf("\r" YELLOW "Connessione con il server persa" RESET_COLOR ", nuovo tentativo tra " BMAGENTA "%d" RESET_COLOR " secondi, tentativi: [" BCYAN "%d" RESET_COLOR "]   ", delay, attempt);
+            fflush(stdout);
+            sleep(1);
+        }
+    }
+    printf("\n");
+    return 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2024 Biribo' Francesco, Giannuzzi Riccardo, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+// Sessioni contemporanee e connessioni in coda ammesse, se non indicate all'avvio
+#define DEFAULT_MAX_SESSIONS 64
+#define DEFAULT_MAX_WAITING 32
+
+// Attesa massima (in millisecondi) di una connessione in coda, dopo viene rifiutata
+#define ADMISSION_MAX_WAIT_MS 10000
+
+/*
+ * Codici di uscita dei processi delle sessioni chiuse dal server per liberare risorse:
+ * client inattivo oltre il timeout di sessione, o non piu' raggiungibile (rilevato dal keepalive TCP)
+ */
+#define SESSION_IDLE_EXIT 3
+#define SESSION_UNREACHABLE_EXIT 4
+
+/**
+ * Contatori del controllo di ammissione, scritti solo dal processo principale del server
+ *
+ * Campi:
+ *  maxSessions, maxWaiting - Limiti impostati all'avvio
+ *  active - Sessioni in corso
+ *  waiting - Connessioni in coda
+ *  admitted - Sessioni avviate
+ *  queued - Sessioni avviate dopo un'attesa in coda
+ *  rejected - Connessioni rifiutate con SERVER_BUSY (coda piena o attesa troppo lunga)
+ *  totalWaitMs - Somma delle attese in coda delle sessioni avviate
+ *  maxWaitMs - Attesa in coda piu' lunga
+ *  idleClosed - Sessioni chiuse per inattivita' del client
+ *  unreachableClosed - Sessioni chiuse perche' il client non era piu' raggiungibile
+ */
+typedef struct {
+    int maxSessions;
+    int maxWaiting;
+    int active;
+    int waiting;
+    unsigned long admitted;
+    unsigned long queued;
+    unsigned long rejected;
+    unsigned long totalWaitMs;
+    unsigned long maxWaitMs;
+    unsigned long idleClosed;
+    unsigned long unreachableClosed;
+} admissionStats;
+
+/**
+ * Prepara il controllo di ammissione: al massimo maxSessions sessioni contemporanee
+ * (DEFAULT_MAX_SESSIONS se non positivo) e maxWaiting connessioni in coda (DEFAULT_MAX_WAITING
+ * se negativo), da chiamare una sola volta all'avvio del server
+ * I contatori vengono salvati nel file files/admission.dat mappato in memoria
+ *
+ * Restituisce 1 in caso di successo, 0 altrimenti
+ */
+int initAdmission(int maxSessions, int maxWaiting);
+
+/**
+ * Restituisce 1 se c'e' posto per una nuova sessione, 0 altrimenti
+ */
+int canStartSession(void);
+
+/**
+ * Registra l'avvio della sessione del processo pid, dopo waitedMs millisecondi in coda
+ */
+void sessionStarted(pid_t pid, long waitedMs);
+
+/**
+ * Registra la fine del processo pid, terminato con lo stato status (come restituito da waitpid)
+ * Le sessioni uscite con SESSION_IDLE_EXIT o SESSION_UNREACHABLE_EXIT vengono contate a parte
+ *
+ * Restituisce 1 se era una sessione (si e' liberato un posto), 0 altrimenti
+ */
+int sessionEnded(pid_t pid, int status);
+
+/**
+ * Mette in coda la connessione fd (local indica se arriva dalla socket locale)
+ *
+ * Restituisce 1 in caso di successo, 0 se la coda e' piena (la connessione va rifiutata)
+ */
+int queueConnection(int fd, int local);
+
+/**
+ * Toglie dalla coda la connessione che aspetta da piu' tempo, salvandone il descrittore in fd,
+ * la provenienza in local e l'attesa in waitedMs
+ *
+ * Restituisce 1 in caso di successo, 0 se la coda e' vuota
+ */
+int takeQueuedConnection(int *fd, int *local, long *waitedMs);
+
+/**
+ * Toglie dalla coda una connessione che aspetta da piu' di ADMISSION_MAX_WAIT_MS, salvandone il descrittore in fd
+ *
+ * Restituisce 1 se e' stata trovata, 0 altrimenti
+ */
+int takeExpiredConnection(int *fd);
+
+/**
+ * Restituisce quanti millisecondi mancano prima che scada la connessione in coda da piu' tempo,
+ * -1 se la coda e' vuota (da usare come timeout di poll)
+ */
+int getAdmissionTimeout(void);
+
+/**
+ * Chiude i descrittori delle connessioni in coda, senza toglierle dalla coda
+ * Da chiamare nei processi figli, che altrimenti le terrebbero aperte anche dopo un rifiuto
+ */
+void closeQueuedConnections(void);
+
+/**
+ * Restituisce il numero di sessioni in corso e di connessioni in coda
+ */
+int sessionsInProgress(void);
+
+/**
+ * Invia il segnale sig a tutti i processi delle sessioni in corso
+ */
+void signalSessions(int sig);
+
+/**
+ * Registra il rifiuto di una connessione
+ */
+void connectionRejected(void);
+
+/**
+ * Legge i contatori del controllo di ammissione, anche da un processo diverso dal server
+ *
+ * Restituisce 1 in caso di successo, 0 se il file dei contatori non esiste
+ */
+int getAdmissionStats(admissionStats *stats);
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2024 Biribo' Francesco, Giannuzzi Riccardo, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Numero di modifiche recenti conservate per gli iscritti
+#define FEED_SIZE 256
+
+// Numero di modifiche conservate nel registro files/changes.log, se non indicato all'avvio
+#define CHANGE_LOG_RETENTION 10000
+
+// Attesa massima (in millisecondi) di nuove modifiche prima di tornare al chiamante
+#define FEED_WAIT_MS 500
+
+/**
+ * Modifica della rubrica, come viene notificata agli iscritti
+ *
+ * Campi:
+ *  version - Numero progressivo della modifica, prosegue tra un avvio e l'altro del server
+ *  operation - ADD, DEL o MODIFY (0 per un riavvio: la rubrica e' stata cambiata senza passare dal server
+ *              e qualsiasi risultato puo' essere cambiato)
+ *  old - Contatto rimosso o modificato (vuoto per ADD), il numero puo' esserne solo l'inizio come in removeContact
+ *  new - Contatto aggiunto o nuovo contatto della modifica (vuoto per DEL)
+ */
+typedef struct {
+    unsigned int version;
+    char operation;
+    Contact old;
+    Contact new;
+} contactChange;
+
+/**
+ * Crea la coda condivisa delle modifiche recenti (file files/feed.dat
+ * mappato in memoria), da chiamare una sola volta all'avvio del server:
+ * i processi figli la ereditano con la fork
+ *
+ * Ogni modifica viene anche aggiunta al registro files/changes.log, che conserva
+ * almeno le ultime retention modifiche (CHANGE_LOG_RETENTION se retention non e' positivo)
+ * Il numero dell'ultima modifica viene salvato in files/version.txt e la numerazione
+ * prosegue dopo un riavvio
+ *
+ * Restituisce 1 in caso di successo, 0 altrimenti (iscrizioni e sincronizzazioni non saranno disponibili)
+ */
+int initChangeFeed(int retention);
+
+/**
+ * Come initChangeFeed, ma si collega alla coda gia' creata da un server precedente
+ * senza reinizializzarla: le iscrizioni delle sessioni del vecchio server continuano
+ * a ricevere le modifiche fatte dalle sessioni del nuovo
+ *
+ * Restituisce 1 in caso di successo, 0 se la coda non esiste
+ */
+int attachChangeFeed(int retention);
+
+/**
+ * Aggiunge una modifica alla coda e risveglia gli iscritti in attesa
+ *
+ * La coda ha dimensione fissa: chi pubblica non aspetta mai gli iscritti,
+ * le modifiche piu' vecchie vengono sovrascritte
+ *
+ * Restituisce il numero assegnato alla modifica, 0 se la coda non e' disponibile
+ */
+unsigned int publishContactChange(char operation, Contact old, Contact new);
+
+/**
+ * Se la rubrica e' stata cambiata senza passare dal server dopo l'ultima modifica
+ * pubblicata, pubblica un riavvio
+ *
+ * Restituisce il numero dell'ultima modifica (0 se la coda non e' disponibile)
+ */
+unsigned int checkFeedBook(void);
+
+/**
+ * Restituisce il numero dell'ultima modifica pubblicata (0 se la coda non e' disponibile)
+ */
+unsigned int getFeedVersion(void);
+
+/**
+ * Legge dal file della coda, anche da un processo diverso dal server, il numero dell'ultima
+ * modifica pubblicata (salvato in version) e quante modifiche conserva il registro (in retained)
+ *
+ * Restituisce 1 in caso di successo, 0 se la coda non esiste
+ */
+int getFeedStats(unsigned int *version, unsigned int *retained);
+
+/**
+ * Copia in changes (al massimo maxChanges) le modifiche successive alla numero after
+ *
+ * Restituisce il numero di modifiche copiate, -1 se alcune modifiche successive
+ * ad after sono gia' state sovrascritte o se la coda non e' disponibile
+ */
+int readContactChanges(unsigned int after, contactChange *changes, int maxChanges);
+
+/**
+ * Controlla che la rubrica sia ancora quella dell'ultima modifica pubblicata,
+ * cioe' che non sia stata modificata senza passare dal server
+ *
+ * Restituisce 1 se e' cosi', 0 altrimenti (o se la coda non e' disponibile)
+ */
+int isFeedInSync(void);
+
+/**
+ * Apre il registro per leggere con readChangeLog le modifiche successive alla numero since,
+ * fino all'ultima pubblicata (il cui numero viene salvato in until)
+ *
+ * Restituisce il descrittore del registro, -1 se le modifiche non sono piu' tutte nel
+ * registro, comprendono un riavvio o since non e' valido: in questi casi il client
+ * deve rileggere tutta la rubrica
+ */
+int openChangeLog(unsigned int since, unsigned int *until);
+
+/**
+ * Legge da log (aperto con openChangeLog) la prossima modifica salvandola in change
+ *
+ * Restituisce 1 in caso di successo, 0 se il registro e' finito
+ */
+int readChangeLog(int log, contactChange *change);
+
+/**
+ * Come readContactChanges, ma aspetta fino a FEED_WAIT_MS millisecondi se non ce ne sono ancora
+ *
+ * Restituisce il numero di modifiche copiate (0 se non ce ne sono),
+ * -1 se alcune modifiche successive ad after sono gia' state sovrascritte
+ * (l'iscritto e' rimasto troppo indietro) o se la coda non e' disponibile
+ */
+int waitContactChanges(unsigned int after, contactChange *changes, int maxChanges);
@@ -35,6 +35,17 @@
 #define DEL '-'
 #define MODIFY 'm'
 #define INT 'x'
+#define FUZZY_READ 'f'
+#define INSENSITIVE_READ 'i'
+#define SUFFIX_READ 'p'
+#define ORDERED_READ 'o'
+#define COUNT 'c'
+#define SUBSCRIBE 's'
+#define SYNC_SINCE 'y'
+#define REPLICATE 'l'
+
+// Valore di newName in AUTH per passare alla rubrica personale dell'utente (vedi serverPacket)
+#define PERSONAL_BOOK 'u'
 
 // Outcome delle operazioni
 #define SERVER_ERROR '0'
@@ -43,6 +54,10 @@
 #define CREDENTIALS_EXPIRED '3'
 #define CONTACT_ALREADY_MODIFIED '4'
 #define CONTACT_ALREADY_EXISTS '5'
+#define CHANGES_LOST '6'
+#define NOT_MODIFIED '7'
+#define REDIRECT '8'
+#define SERVER_BUSY '9'
 #define INVALID_PACKET 'e'
 
 
@@ -61,6 +76,52 @@
  *  newName - Nuono nome del contatto (da usare per la modifica)
  *  newSurname - Nuono cognome del contatto (da usare per la modifica)
  *  newPhoneNumber - Nuono numero di telefono del contatto (da usare per la modifica)
+ *
+ * Le operazioni di lettura non usano i campi new*, che vengono quindi
+ * riutilizzati per i parametri aggiuntivi della ricerca:
+ *  FUZZY_READ - newName contiene la distanza di modifica massima ammessa
+ *  ORDERED_READ - newName, newSurname e newPhoneNumber contengono l'ultimo contatto dell'intervallo richiesto
+ *  COUNT - newName contiene l'operazione di lettura di cui usare i criteri, la risposta contiene il conteggio in matchIndex
+ *  AUTH - newName contiene PERSONAL_BOOK per usare la rubrica personale dell'utente
+ *
+ * In SUFFIX_READ il campo phoneNumber contiene solo le ultime cifre del numero cercato
+ *
+ * Nelle risposte a READ e INSENSITIVE_READ newPhoneNumber contiene la versione della rubrica
+ * a cui si riferisce il risultato: il client puo' rimandarla nella stessa richiesta e, se nessuna
+ * modifica successiva coinvolge i criteri di ricerca, il server risponde NOT_MODIFIED senza contatto
+ *
+ * Dopo una richiesta SUBSCRIBE il server invia un pacchetto per ogni modifica della rubrica:
+ * operation e' ADD, DEL o MODIFY, matchIndex il numero progressivo della modifica,
+ * name, surname e phoneNumber il contatto aggiunto, rimosso o modificato e new* il nuovo contatto
+ * Se il client non legge abbastanza in fretta e alcune modifiche vengono perse riceve invece
+ * un pacchetto SUBSCRIBE con esito CHANGES_LOST, e riprende dalla modifica indicata in matchIndex
+ * L'iscrizione termina quando il client invia un altro pacchetto SUBSCRIBE: il server risponde
+ * con un pacchetto SUBSCRIBE con esito OPERATION_SUCCESS (matchIndex e' il numero dell'ultima modifica inviata)
+ * Se il server viene riavviato (SIGHUP) chiude invece l'iscrizione con un pacchetto SUBSCRIBE con esito
+ * SERVER_BUSY e chiude la connessione: il client si ricollega e si iscrive di nuovo
+ *
+ * In SYNC_SINCE il client indica in matchIndex la versione della rubrica che possiede (0 se nessuna):
+ * il server invia le modifiche successive con gli stessi pacchetti di SUBSCRIBE oppure, se non le ha
+ * piu' tutte, un pacchetto SYNC_SINCE con esito CHANGES_LOST seguito da un ADD per ogni contatto
+ * La risposta finale e' un pacchetto SYNC_SINCE con la versione raggiunta in matchIndex
+ *
+ * Le sessioni usano la rubrica condivisa, anche dopo un AUTH: solo un AUTH con PERSONAL_BOOK
+ * in newName porta la sessione sulla rubrica personale dell'utente (da quel momento ADD, DEL e MODIFY
+ * usano quella delle credenziali inviate), e un AUTH successivo senza PERSONAL_BOOK la riporta su quella condivisa
+ * SUBSCRIBE, SYNC_SINCE e le letture condizionate sono disponibili solo per la rubrica condivisa:
+ * con una rubrica personale SUBSCRIBE e SYNC_SINCE rispondono SERVER_ERROR
+ *
+ * REPLICATE e' usato dalle repliche: come SYNC_SINCE invia le modifiche successive a matchIndex
+ * (o tutta la rubrica), chiuse da un pacchetto REPLICATE con esito OPERATION_SUCCESS, poi prosegue
+ * con ogni nuova modifica come SUBSCRIBE; prima di ogni gruppo di modifiche, e comunque ogni
+ * FEED_WAIT_MS, invia un pacchetto REPLICATE con esito OPERATION_SUCCESS e in matchIndex
+ * l'ultima modifica del primario, da cui la replica calcola il suo ritardo
+ * Se il primario viene riavviato invia un pacchetto REPLICATE con esito SERVER_BUSY e chiude la connessione
+ * Una replica risponde REDIRECT ad AUTH, ADD, DEL e MODIFY: username contiene l'indirizzo del
+ * primario e matchIndex la sua porta
+ *
+ * Quando il server ha gia' il massimo di sessioni e la coda di attesa e' piena (o la connessione
+ * ha atteso troppo) invia, senza richiesta, un solo pacchetto con esito SERVER_BUSY e chiude la connessione
  */
 typedef struct {
     char operation;
@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2024 Biribo' Francesco, Giannuzzi Riccardo, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Distanza di modifica usata quando il client non ne specifica una, e massima consentita
+#define FUZZY_DEFAULT_DISTANCE 2
+#define FUZZY_MAX_DISTANCE 4
+
+// Numero massimo di livelli della skip list dell'ordinamento alfabetico
+#define SKIP_MAX_LEVEL 24
+
+// Modalita' di confronto dei criteri di ricerca
+#define SEARCH_EXACT 0
+#define SEARCH_INSENSITIVE 1
+
+/**
+ * Istantanea in memoria della rubrica, organizzata per colonne
+ *
+ * Ogni campo dei contatti e' salvato in un array contiguo (colonna)
+ * a dimensione fissa, cosi' la scansione di un solo campo (es. tutti
+ * i nomi) legge memoria sequenziale senza toccare gli altri campi
+ *
+ * Accanto ai campi originali vengono salvate le chiavi normalizzate
+ * (minuscole e senza accenti) di nome e cognome, indicizzate tramite
+ * due tabelle hash: ogni bucket e' una catena di posizioni nell'ordine
+ * della rubrica, cosi' la n-esima corrispondenza si trova senza scansione
+ *
+ * Per la ricerca sulle ultime cifre del numero di telefono le cifre di ogni
+ * numero vengono salvate al contrario: un suffisso del numero diventa un
+ * prefisso della chiave, e le posizioni ordinate per chiave permettono di
+ * trovare tutti i numeri con quel suffisso con una ricerca binaria
+ * L'ordinamento viene costruito alla prima ricerca per suffisso
+ *
+ * L'ordinamento alfabetico per (cognome, nome, numero) e' mantenuto da una
+ * skip list costruita alla prima richiesta: ogni contatto e' un nodo con un
+ * numero casuale di livelli, i puntatori di ogni nodo sono consecutivi in
+ * skipPool a partire da skipOffsets[posizione]
+ *
+ * I contatti rimossi dal processo stesso restano nelle colonne (alive = 0)
+ * per non spostare le posizioni degli altri, ma escono da tutti gli indici
+ *
+ * Campi:
+ *  count - Numero di posizioni occupate nelle colonne (compresi i contatti rimossi)
+ *  liveCount - Numero di contatti presenti
+ *  capacity - Numero di contatti allocati nelle colonne
+ *  names - Colonna dei nomi, nell'ordine in cui compaiono nella rubrica
+ *  surnames - Colonna dei cognomi
+ *  phoneNumbers - Colonna dei numeri di telefono
+ *  alive - 1 se il contatto e' presente, 0 se e' stato rimosso
+ *  nameKeys - Colonna dei nomi normalizzati
+ *  surnameKeys - Colonna dei cognomi normalizzati
+ *  nameLengths - Lunghezza di ogni nome normalizzato (evita strlen durante la scansione)
+ *  surnameLengths - Lunghezza di ogni cognome normalizzato
+ *  nameMasks - Insieme (approssimato) dei caratteri presenti in ogni nome normalizzato, un bit per carattere
+ *  surnameMasks - Insieme (approssimato) dei caratteri presenti in ogni cognome normalizzato
+ *  bucketCount - Numero di bucket delle tabelle hash (potenza di 2)
+ *  nameBuckets - Prima posizione della catena di ogni bucket dei nomi, -1 se vuota
+ *  surnameBuckets - Prima posizione della catena di ogni bucket dei cognomi, -1 se vuota
+ *  nameNext - Posizione successiva nella stessa catena dei nomi, -1 a fine catena
+ *  surnameNext - Posizione successiva nella stessa catena dei cognomi, -1 a fine catena
+ *  phoneSuffixKeys - Colonna delle cifre dei numeri di telefono, dall'ultima alla prima
+ *  phoneSuffixOrder - Posizioni dei contatti ordinate per phoneSuffixKeys (a parita' di chiave nell'ordine della rubrica)
+ *  suffixReady - Indica se phoneSuffixOrder e' stato costruito
+ *  orderedReady - Indica se la skip list e' stata costruita
+ *  skipLevel - Numero di livelli in uso nella skip list
+ *  skipHead - Primo nodo di ogni livello, -1 se il livello e' vuoto
+ *  skipHeights - Numero di livelli di ogni nodo
+ *  skipOffsets - Indice in skipPool del primo puntatore di ogni nodo
+ *  skipPool - Puntatori di tutti i nodi: il successivo di p al livello l e' skipPool[skipOffsets[p] + l]
+ *  skipPoolSize - Numero di puntatori usati in skipPool
+ *  skipPoolCapacity - Numero di puntatori allocati in skipPool
+ */
+typedef struct {
+    int count;
+    int liveCount;
+    int capacity;
+    char (*names)[CONTACT_STRINGS_LENGTH + 1];
+    char (*surnames)[CONTACT_STRINGS_LENGTH + 1];
+    char (*phoneNumbers)[CONTACT_STRINGS_LENGTH + 1];
+    unsigned char *alive;
+    char (*nameKeys)[CONTACT_STRINGS_LENGTH + 1];
+    char (*surnameKeys)[CONTACT_STRINGS_LENGTH + 1];
+    unsigned char *nameLengths;
+    unsigned char *surnameLengths;
+    unsigned int *nameMasks;
+    unsigned int *surnameMasks;
+    int bucketCount;
+    int *nameBuckets;
+    int *surnameBuckets;
+    int *nameNext;
+    int *surnameNext;
+    char (*phoneSuffixKeys)[CONTACT_STRINGS_LENGTH + 1];
+    int *phoneSuffixOrder;
+    int suffixReady;
+    int orderedReady;
+    int skipLevel;
+    int skipHead[SKIP_MAX_LEVEL];
+    unsigned char *skipHeights;
+    int *skipOffsets;
+    int *skipPool;
+    int skipPoolSize;
+    int skipPoolCapacity;
+} contactTable;
+
+/**
+ * Calcola la chiave normalizzata del campo field e la salva in key
+ *
+ * Le lettere vengono portate in minuscolo e le lettere accentate
+ * (codificate in UTF-8, es. "è", "Ò") vengono sostituite dalla lettera
+ * senza accento, cosi' "Nicolò", "NICOLO" e "nicolo" hanno la stessa chiave
+ *
+ * key deve poter contenere almeno strlen(field) + 1 caratteri
+ *
+ * Restituisce la lunghezza della chiave
+ */
+int normalizeKey(const char *field, char *key);
+
+/**
+ * Aggiorna l'istantanea in memoria della rubrica
+ *
+ * La rubrica viene riletta solo se il file e' cambiato dall'ultimo
+ * caricamento (controllando inode, dimensione e data di modifica),
+ * quindi chiamarla prima di ogni ricerca costa una sola stat()
+ * (una per segmento, se la rubrica e' divisa in segmenti: vedi statContactBook)
+ *
+ * L'ordine della rubrica divisa in segmenti e' quello dei segmenti, uno dopo l'altro
+ *
+ * Restituisce il numero di contatti presenti, -1 in caso di errore di memoria
+ */
+int refreshContactIndex(void);
+
+/**
+ * Aggiornano l'istantanea dopo una modifica della rubrica fatta da questo processo
+ * (con addContact, removeContact e modifyContact andati a buon fine), senza rileggerla
+ *
+ * Prima della modifica va chiamata refreshContactIndex, cosi' l'istantanea
+ * corrisponde al file. Dopo la modifica controlliamo che la dimensione della
+ * rubrica sia cambiata esattamente come previsto: se non e' cosi' (un altro
+ * processo l'ha modificata nel frattempo) l'istantanea viene scartata e
+ * sara' riletta alla prossima refreshContactIndex
+ *
+ * Come removeContact e modifyContact, le ultime due agiscono su tutti i contatti
+ * con lo stesso nome e cognome il cui numero inizia con quello indicato
+ *
+ * In una rubrica divisa in segmenti un contatto aggiunto (o spostato in un altro segmento)
+ * non finisce in fondo alla rubrica: in quel caso l'istantanea viene riletta
+ */
+void applyContactAdded(Contact added);
+void applyContactRemoved(Contact removed);
+void applyContactModified(Contact old, Contact new);
+
+/**
+ * Restituisce un puntatore all'istantanea corrente della rubrica
+ *
+ * N.B. Il contenuto e' valido fino alla successiva refreshContactIndex
+ */
+const contactTable *getContactTable(void);
+
+/**
+ * Restituisce le informazioni (stat) del file rubrica da cui e' stata
+ * costruita l'istantanea corrente, NULL se non e' stata caricata
+ */
+const struct stat *getContactIndexStat(void);
+
+/**
+ * Calcola la distanza di Levenshtein tra pattern e text, fermandosi
+ * appena e' certo che sia maggiore di maxDistance
+ *
+ * Utilizza l'algoritmo bit-parallelo di Myers (variante di Hyyro'),
+ * che elabora un carattere del testo alla volta aggiornando l'intera
+ * colonna della matrice delle distanze con poche operazioni su una
+ * parola a 64 bit (pattern al massimo di 64 caratteri)
+ *
+ * Restituisce la distanza se e' minore o uguale a maxDistance, maxDistance + 1 altrimenti
+ */
+int boundedEditDistance(const char *pattern, const char *text, int maxDistance);
+
+/**
+ * Cerca nella rubrica il contatto che corrisponde in maniera approssimata
+ * ai criteri di asked, e restituisce la matchIndex-esima corrispondenza
+ *
+ * Nome e cognome (se specificati) corrispondono se le loro chiavi normalizzate
+ * distano al massimo maxDistance modifiche da quelle cercate, il numero di
+ * telefono (se specificato) deve invece coincidere esattamente
+ *
+ * asked - Criteri di ricerca
+ * maxDistance - Distanza massima ammessa (limitata a FUZZY_MAX_DISTANCE)
+ * matchIndex - Quale corrispondenza restituire (a partire da 1)
+ * found - Contatto trovato
+ *
+ * Restituisce 1 se la corrispondenza e' stata trovata, 0 altrimenti
+ */
+int findFuzzyContact(Contact asked, int maxDistance, int matchIndex, Contact *found);
+
+/**
+ * Cerca nella rubrica il contatto che corrisponde ai criteri di asked
+ * e restituisce la matchIndex-esima corrispondenza, nell'ordine della rubrica
+ *
+ * Come per matchesParameters i campi vuoti di asked non vengono confrontati
+ * Senza nome ne' cognome viene scorsa tutta la rubrica: oltre PARALLEL_SCAN_MIN_CONTACTS
+ * contatti la scansione viene divisa tra piu' thread
+ *
+ * asked - Criteri di ricerca
+ * mode - SEARCH_EXACT confronta i campi byte per byte, SEARCH_INSENSITIVE confronta
+ *        nome e cognome ignorando maiuscole e accenti
+ * matchIndex - Quale corrispondenza restituire (a partire da 1)
+ * found - Contatto trovato
+ *
+ * Restituisce 1 se la corrispondenza e' stata trovata, 0 altrimenti
+ */
+int findContact(Contact asked, int mode, int matchIndex, Contact *found);
+
+/**
+ * Conta i contatti che findContact troverebbe con gli stessi criteri,
+ * senza copiarne nessuno
+ *
+ * Senza criteri la risposta e' il numero di contatti presenti, con il nome
+ * (o il cognome) vengono controllati solo i contatti della sua catena e con il
+ * solo numero solo quelli con le stesse cifre nell'indice dei suffissi
+ *
+ * Restituisce il numero di corrispondenze, -1 in caso di errore di memoria
+ */
+int countContacts(Contact asked, int mode);
+
+/**
+ * Come countContacts, ma copia anche le prime maxCollected corrispondenze
+ * (nell'ordine della rubrica) in collected
+ *
+ * Restituisce il numero totale di corrispondenze, -1 in caso di errore di memoria
+ */
+int collectContacts(Contact asked, int mode, Contact *collected, int maxCollected);
+
+/**
+ * Cerca nella rubrica il contatto il cui numero di telefono termina con
+ * le cifre di asked.phoneNumber e restituisce la matchIndex-esima corrispondenza
+ *
+ * Eventuali caratteri non numerici del suffisso vengono ignorati, nome e
+ * cognome (se specificati) vengono confrontati secondo mode come in findContact
+ *
+ * Le corrispondenze sono ordinate per numero di telefono letto al contrario
+ * (a parita' di numero nell'ordine della rubrica): l'ordine e' stabile finche'
+ * la rubrica non cambia, e senza altri criteri la matchIndex-esima si trova
+ * in tempo logaritmico
+ *
+ * asked - Criteri di ricerca, phoneNumber contiene il suffisso cercato
+ * mode - SEARCH_EXACT o SEARCH_INSENSITIVE, per nome e cognome
+ * matchIndex - Quale corrispondenza restituire (a partire da 1)
+ * found - Contatto trovato
+ *
+ * Restituisce 1 se la corrispondenza e' stata trovata, 0 altrimenti
+ */
+int findContactByPhoneSuffix(Contact asked, int mode, int matchIndex, Contact *found);
+
+/**
+ * Conta i contatti che findContactByPhoneSuffix troverebbe con gli stessi criteri
+ *
+ * Senza nome e cognome la risposta e' l'ampiezza dell'intervallo trovato
+ * con la ricerca binaria, senza visitare i contatti
+ *
+ * Restituisce il numero di corrispondenze, -1 in caso di errore di memoria
+ */
+int countContactsByPhoneSuffix(Contact asked, int mode);
+
+/**
+ * Scorre la rubrica in ordine alfabetico per cognome, nome e numero di
+ * telefono (ignorando maiuscole e accenti) e restituisce il matchIndex-esimo
+ * contatto compreso tra from e to
+ *
+ * Gli estremi sono inclusi e confrontati campo per campo fermandosi al primo
+ * campo vuoto: from con il solo cognome "Rossi" parte dal primo Rossi, to con
+ * il solo cognome "Rossi" si ferma dopo l'ultimo. Estremi vuoti non limitano
+ *
+ * Per sfogliare la rubrica a pagine basta usare come from l'ultimo contatto
+ * ricevuto e matchIndex 2: il costo della ricerca e' logaritmico e non dipende
+ * da quante pagine sono state lette
+ *
+ * from - Primo contatto dell'intervallo
+ * to - Ultimo contatto dell'intervallo
+ * matchIndex - Quale contatto dell'intervallo restituire (a partire da 1)
+ * found - Contatto trovato
+ *
+ * Restituisce 1 se il contatto e' stato trovato, 0 altrimenti
+ */
+int findOrderedContact(Contact from, Contact to, int matchIndex, Contact *found);
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2024 Biribo' Francesco, Giannuzzi Riccardo, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <time.h>
+
+// File condiviso delle metriche e versione del suo formato, per chi lo legge da fuori
+#define METRICS_PATH "files/metrics.dat"
+#define METRICS_FORMAT 1
+
+/*
+ * Istogramma delle latenze (in microsecondi) a precisione relativa costante, come gli istogrammi HDR:
+ * ogni potenza di due e' divisa in METRICS_SUB_BUCKETS intervalli uguali (errore massimo 1/16, circa 6%)
+ * Le latenze oltre 2^(METRICS_MAX_SHIFT + METRICS_SUB_BITS + 1) microsecondi (circa 38 ore) finiscono nell'ultimo intervallo
+ */
+#define METRICS_SUB_BITS 4
+#define METRICS_SUB_BUCKETS (1 << METRICS_SUB_BITS)
+#define METRICS_MAX_SHIFT 32
+#define METRICS_BUCKETS (METRICS_SUB_BUCKETS * (METRICS_MAX_SHIFT + 2))
+
+/*
+ * Operazioni misurate, nell'ordine delle posizioni dei contatori
+ * Le operazioni non valide sono contate nell'ultima posizione (METRICS_INVALID)
+ */
+#define METRICS_OPERATIONS "raf+-mxipocsyl"
+#define METRICS_INVALID 14
+#define METRICS_SLOTS 15
+
+/*
+ * Esiti contati: quelli di connection.h ('0'..'9' ed 'e'), gli altri nell'ultima posizione
+ */
+#define METRICS_OUTCOMES "0123456789e"
+#define METRICS_OUTCOME_SLOTS 12
+
+/**
+ * Latenze di un'operazione
+ *
+ * Campi:
+ *  count - Richieste misurate
+ *  totalUs - Somma delle latenze, per la media
+ *  maxUs - Latenza massima
+ *  buckets - Numero di richieste per intervallo di latenza (vedi metricsBucket)
+ */
+typedef struct {
+    unsigned long count;
+    unsigned long totalUs;
+    unsigned long maxUs;
+    unsigned long buckets[METRICS_BUCKETS];
+} latencyHistogram;
+
+/**
+ * Contenuto del file condiviso delle metriche, aggiornato da tutte le sessioni con operazioni atomiche
+ * (senza lock) e leggibile da qualsiasi processo mappando METRICS_PATH
+ *
+ * Campi:
+ *  format - METRICS_FORMAT
+ *  started - Avvio del server che ha creato il file
+ *  operations - Latenze e conteggi per operazione, nelle posizioni di METRICS_OPERATIONS
+ *  outcomes - Risposte per esito, nelle posizioni di METRICS_OUTCOMES
+ */
+typedef struct {
+    int format;
+    time_t started;
+    latencyHistogram operations[METRICS_SLOTS];
+    unsigned long outcomes[METRICS_OUTCOME_SLOTS];
+} serverMetrics;
+
+/**
+ * Crea il file delle metriche (vuoto) e lo mappa in memoria, da chiamare
+ * una sola volta all'avvio del server: i processi figli lo ereditano con la fork
+ *
+ * Restituisce 1 in caso di successo, 0 altrimenti (il server funziona anche senza metriche)
+ */
+int initMetrics(void);
+
+/**
+ * Come initMetrics, ma si collega alle metriche gia' create da un server precedente senza azzerarle
+ * (dopo un passaggio delle socket)
+ *
+ * Restituisce 1 in caso di successo, 0 se il file non esiste
+ */
+int attachMetrics(void);
+
+/**
+ * Registra una richiesta dell'operazione operation, a cui e' stato risposto
+ * con l'esito outcome dopo latencyUs microsecondi
+ */
+void recordRequest(char operation, char outcome, unsigned long latencyUs);
+
+/**
+ * Copia in metrics le metriche del server, anche da un processo diverso dal server
+ * I contatori vengono letti mentre il server li aggiorna, possono essere leggermente disallineati tra loro
+ *
+ * Restituisce 1 in caso di successo, 0 se il file delle metriche non esiste
+ */
+int readMetrics(serverMetrics *metrics);
+
+/**
+ * Restituisce la posizione dell'operazione operation nei contatori (METRICS_INVALID se non valida)
+ */
+int metricsSlot(char operation);
+
+/**
+ * Restituisce il nome dell'operazione in posizione slot dei contatori
+ */
+const char *metricsOperationName(int slot);
+
+/**
+ * Restituisce l'intervallo dell'istogramma in cui cade la latenza latencyUs
+ */
+int metricsBucket(unsigned long latencyUs);
+
+/**
+ * Restituisce la latenza (in microsecondi, estremo superiore dell'intervallo) sotto cui cade
+ * la frazione percentile (tra 0 e 1) delle richieste misurate in histogram, 0 se non ce ne sono
+ */
+unsigned long metricsPercentile(const latencyHistogram *histogram, double percentile);
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2024 Biribo' Francesco, Giannuzzi Riccardo, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Dimensioni della cache: CACHE_SETS insiemi da CACHE_WAYS risultati ciascuno
+#define CACHE_SETS 64
+#define CACHE_WAYS 4
+
+// Numero massimo di corrispondenze salvate per ogni risultato
+#define CACHE_MAX_MATCHES 16
+
+/**
+ * Contatori della cache, condivisi da tutti i processi del server
+ *
+ * Campi:
+ *  hits - Letture a cui e' stato risposto dalla cache
+ *  misses - Letture per cui e' stato necessario cercare nella rubrica
+ *  invalidations - Risultati scartati perche' la rubrica e' cambiata
+ */
+typedef struct {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long invalidations;
+} queryCacheStats;
+
+/**
+ * Crea la cache condivisa dei risultati delle letture (file files/cache.dat
+ * mappato in memoria), da chiamare una sola volta all'avvio del server:
+ * i processi figli la ereditano con la fork
+ *
+ * Restituisce 1 in caso di successo, 0 altrimenti (il server funziona anche senza cache)
+ */
+int initQueryCache(void);
+
+/**
+ * Collega il server alla cache gia' creata da un server precedente, senza svuotarla,
+ * cosi' le sessioni del vecchio e del nuovo server continuano a condividerla
+ * Da usare al posto di initQueryCache quando il server riceve la socket da uno in esecuzione
+ *
+ * Restituisce 1 in caso di successo, 0 se la cache non esiste
+ */
+int attachQueryCache(void);
+
+/**
+ * Variante di findContact che passa prima dalla cache condivisa
+ *
+ * La cache e' indicizzata dai criteri di ricerca (e dalla modalita') e contiene,
+ * nell'ordine della rubrica, le prime CACHE_MAX_MATCHES corrispondenze e il loro
+ * numero totale: se la corrispondenza richiesta e' tra quelle salvate (o oltre
+ * l'ultima) la risposta non richiede di consultare la rubrica
+ *
+ * La cache contiene solo risultati della rubrica condivisa: con una rubrica
+ * personale (vedi selectContactBook) equivale a findContact
+ *
+ * Restituisce 1 se la corrispondenza e' stata trovata, 0 altrimenti
+ */
+int findContactCached(Contact asked, int mode, int matchIndex, Contact *found);
+
+/**
+ * Delimitano una modifica della rubrica (aggiunta, rimozione o modifica di un contatto)
+ *
+ * beginContactChange acquisisce il lock della cache, cosi' nessun processo
+ * puo' leggere o salvare risultati mentre la rubrica cambia (e le modifiche
+ * dei diversi processi non si sovrappongono)
+ *
+ * endContactChange scarta solo i risultati i cui criteri corrispondono al
+ * contatto coinvolto (removed e added, se non vuoti) e rilascia il lock
+ * Come removeContact e modifyContact, il numero di removed indica l'inizio del numero
+ *
+ * Viene bloccato anche il file della rubrica con lockContactBook (cosi' la rubrica non viene
+ * ripartita durante la modifica), ed e' l'unico lock per una rubrica personale o senza cache:
+ * le modifiche a rubriche diverse procedono in parallelo
+ */
+void beginContactChange(void);
+void endContactChange(Contact removed, Contact added);
+
+/**
+ * Controlla se l'aggiunta (o la rimozione) del contatto changed puo' cambiare
+ * le corrispondenze della ricerca asked con modalita' mode
+ * Con phonePrefix il numero di changed e' solo l'inizio del numero coinvolto
+ *
+ * Restituisce 1 se la ricerca e' coinvolta, 0 altrimenti
+ */
+int searchAffected(Contact asked, int mode, Contact changed, int phonePrefix);
+
+/**
+ * Controlla, senza consultare la rubrica, se le corrispondenze della ricerca asked
+ * sono rimaste le stesse dopo la modifica numero since: nessuna delle modifiche
+ * successive (ancora nella coda delle modifiche) le coinvolge e la rubrica
+ * non e' stata cambiata dall'esterno
+ *
+ * La coda descrive solo la rubrica condivisa, per una rubrica personale restituisce sempre 0
+ *
+ * Restituisce 1 se le corrispondenze non sono cambiate, 0 se potrebbero esserlo
+ */
+int isReadUnchanged(Contact asked, int mode, unsigned int since);
+
+/**
+ * Legge i contatori della cache, anche da un processo diverso dal server
+ *
+ * Restituisce 1 in caso di successo, 0 se la cache non esiste
+ */
+int getQueryCacheStats(queryCacheStats *stats);
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2024 Biribo' Francesco, Giannuzzi Riccardo, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+// Stato della replica, aggiornato mentre segue il primario
+#define REPLICA_STATUS_PATH "files/replica.txt"
+
+// File in cui viene ricevuta una copia completa della rubrica del primario
+#define REPLICA_SNAPSHOT_PATH "files/replica.tmp"
+
+// Attesa (in secondi) prima di ricollegarsi al primario
+#define REPLICA_RETRY_SECONDS 1
+
+/**
+ * Stato di una replica
+ *
+ * Campi:
+ *  primaryHost, primaryPort - Indirizzo del primario
+ *  applied - Numero dell'ultima modifica del primario applicata alla rubrica della replica
+ *  primaryVersion - Numero dell'ultima modifica del primario, secondo il suo ultimo pacchetto di stato
+ *  connected - 1 se la replica e' collegata al primario, 0 altrimenti
+ *  updated - Istante dell'ultimo pacchetto di stato ricevuto
+ */
+typedef struct {
+    char primaryHost[AUTH_PARAM_LENGTH + 1];
+    int primaryPort;
+    unsigned int applied;
+    unsigned int primaryVersion;
+    int connected;
+    time_t updated;
+} replicaStatus;
+
+/**
+ * Rende il server una replica in sola lettura del primario primary ("indirizzo:porta",
+ * l'indirizzo e' un IPv4 o localhost), da chiamare all'avvio dopo initQueryCache e initChangeFeed
+ *
+ * Avvia un processo che riceve dal primario le modifiche della rubrica condivisa (REPLICATE), quella
+ * su cui scrivono i client salvo richiesta esplicita della rubrica personale, che resta solo sul primario,
+ * e le applica alla rubrica locale, pubblicandole nella coda delle modifiche della replica;
+ * se il collegamento si interrompe riprende dall'ultima modifica applicata
+ * author identifica la replica nel file di log
+ *
+ * Restituisce 1 in caso di successo, 0 se primary non e' valido o il processo non puo' essere avviato
+ */
+int startReplica(const char *primary, const char *author);
+
+/**
+ * Ferma il processo avviato da startReplica, attendendo che finisca di applicare la modifica in corso
+ * Da chiamare prima di passare la socket a un nuovo server, che seguira' il primario al suo posto
+ */
+void stopReplica(void);
+
+/**
+ * Restituisce 1 se il server e' una replica, 0 se e' un primario
+ */
+int isReplica(void);
+
+/**
+ * Prepara in packet la risposta di una replica a un'operazione che solo il primario puo' eseguire:
+ * esito REDIRECT, indirizzo del primario in username e porta in matchIndex
+ */
+void redirectToPrimary(serverPacket *packet);
+
+/**
+ * Rimuove lo stato salvato da un precedente avvio come replica,
+ * da chiamare all'avvio di un primario
+ */
+void clearReplicaStatus(void);
+
+/**
+ * Legge in status lo stato della replica (anche da un altro processo, come il manager)
+ *
+ * Restituisce 1 in caso di successo, 0 se il server non e' una replica
+ */
+int readReplicaStatus(replicaStatus *status);
+
+/**
+ * Calcola il ritardo della replica descritta da status: in ops il numero di modifiche del primario
+ * non ancora applicate, in bytes la loro dimensione nel registro del primario
+ */
+void getReplicaLag(const replicaStatus *status, unsigned int *ops, unsigned long *bytes);
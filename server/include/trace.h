@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2024 Biribo' Francesco, Giannuzzi Riccardo, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stddef.h>
+
+// Da includere dopo connection.h (PACKET_LENGTH)
+
+/*
+ * Tracciato delle richieste: un'intestazione (TRACE_MAGIC seguito dalla versione TRACE_FORMAT su 4 byte)
+ * e un record di lunghezza fissa per richiesta, con i numeri in little endian:
+ *  8 byte - Arrivo della richiesta, in microsecondi dal 1970
+ *  4 byte - Connessione (pid del processo della sessione)
+ *  4 byte - Latenza della risposta in microsecondi
+ *  1 byte - Esito della risposta
+ *  PACKET_LENGTH byte - Pacchetto ricevuto, cosi' come e' arrivato
+ *
+ * I pacchetti contengono le credenziali in chiaro: il file viene creato leggibile solo dal proprietario
+ */
+#define TRACE_MAGIC "RTRC"
+#define TRACE_FORMAT 1
+#define TRACE_HEADER_LENGTH 8
+#define TRACE_RECORD_LENGTH (8 + 4 + 4 + 1 + PACKET_LENGTH)
+
+/**
+ * Richiesta registrata nel tracciato
+ *
+ * Campi:
+ *  arrivalUs - Arrivo della richiesta, in microsecondi dal 1970
+ *  connection - Connessione su cui e' arrivata, uguale per tutte le richieste di una sessione
+ *  latencyUs - Tempo impiegato dal server per rispondere
+ *  outcome - Esito della risposta
+ *  packet - Pacchetto della richiesta
+ */
+typedef struct {
+    unsigned long long arrivalUs;
+    unsigned int connection;
+    unsigned int latencyUs;
+    char outcome;
+    char packet[PACKET_LENGTH];
+} traceRecord;
+
+/**
+ * Apre (o crea) il tracciato path e registra da ora in poi le richieste, da chiamare
+ * una sola volta all'avvio del server: i processi delle sessioni ereditano il file con la fork
+ * Le richieste vengono aggiunte in fondo, quindi un tracciato esistente viene allungato
+ *
+ * Restituisce 1 in caso di successo, 0 altrimenti (anche se path non e' un tracciato)
+ */
+int openTrace(const char *path);
+
+/**
+ * Aggiunge record al tracciato aperto con openTrace, se ce n'e' uno
+ * Ogni record viene scritto con una sola write in append: le sessioni non si mescolano
+ */
+void traceRequest(const traceRecord *record);
+
+/**
+ * Legge tutto il tracciato path in un vettore allocato con malloc, da liberare con free,
+ * salvato in records insieme al numero di richieste (count)
+ * Un record finale incompleto (server interrotto durante la scrittura) viene ignorato
+ *
+ * Restituisce 1 in caso di successo, 0 se il file non esiste o non e' un tracciato
+ */
+int readTrace(const char *path, traceRecord **records, size_t *count);
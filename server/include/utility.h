@@ -7,6 +7,7 @@
  */
 
 #include <stdlib.h>
+#include <sys/stat.h>
 #define CONTACT_STRINGS_LENGTH 10
 #define AUTH_STRINGS_LENGTH 20
 
@@ -35,6 +36,18 @@
 
 #define HASH_LENGTH 20
 
+// Rubrica condivisa, usata dalle sessioni non autenticate
+#define SHARED_BOOK_PATH "files/rubrica.txt"
+
+// Cartella delle rubriche personali, una per utente: files/rubriche/<username>.txt
+#define USER_BOOKS_DIR "files/rubriche"
+
+// Lunghezza massima del percorso di una rubrica
+#define BOOK_PATH_LENGTH 64
+
+// Numero massimo di segmenti in cui puo' essere divisa una rubrica
+#define MAX_BOOK_SEGMENTS 64
+
 /**
  * Rappresenta un contatto della rubrica
  * Campi:
@@ -52,6 +65,95 @@ typedef struct {
     char phoneNumber[CONTACT_STRINGS_LENGTH + 1];
 } Contact;
 
+/**
+ * Sceglie la rubrica su cui agiscono le operazioni successive di questo processo
+ * (getContact, addContact, removeContact, modifyContact e l'istantanea in memoria)
+ * 
+ * username - Utente autenticato, la sua rubrica e' USER_BOOKS_DIR/<username>.txt
+ *            NULL o stringa vuota per la rubrica condivisa SHARED_BOOK_PATH
+ * 
+ * Ogni rubrica e' un file separato: le modifiche a rubriche diverse non si
+ * bloccano a vicenda e le ricerche scorrono solo i contatti dell'utente
+ * 
+ * Restituisce 1 in caso di successo, 0 se username non e' valido (resta la rubrica precedente)
+ */
+int selectContactBook(const char *username);
+
+/**
+ * Restituisce il percorso della rubrica scelta con selectContactBook
+ */
+const char *getContactBookPath(void);
+
+/**
+ * Restituisce 1 se la rubrica scelta e' quella condivisa, 0 se e' una rubrica personale
+ */
+int isSharedContactBook(void);
+
+/**
+ * Blocca le modifiche alla rubrica scelta da parte degli altri processi
+ * (lock esclusivo sul file <rubrica>.lock), fino a unlockContactBook
+ * 
+ * Restituisce il descrittore da passare a unlockContactBook, -1 in caso di errore
+ */
+int lockContactBook(void);
+
+/**
+ * Sblocca la rubrica bloccata con lockContactBook
+ */
+void unlockContactBook(int lock);
+
+/**
+ * Una rubrica puo' essere un unico file oppure essere divisa in segmenti:
+ * il file <rubrica>.seg indica il numero di segmenti e la loro generazione, e il
+ * contatto si trova nel file <rubrica>.<generazione>.<segmento>, scelto dall'hash
+ * di nome e cognome
+ *
+ * Tutti i contatti su cui agiscono removeContact e modifyContact hanno lo stesso
+ * nome e cognome, quindi ogni modifica riscrive un solo segmento
+ */
+
+/**
+ * Sceglie in quanti segmenti dividere le rubriche create da ora in poi da questo processo
+ * (1, il valore iniziale, per un unico file); le rubriche esistenti non cambiano
+ */
+void setNewBookSegments(int segments);
+
+/**
+ * Restituisce il numero di segmenti della rubrica path (1 se e' un unico file)
+ * e salva in generation (se non e' NULL) la generazione dei loro file
+ */
+int getContactBookSegments(const char *path, unsigned int *generation);
+
+/**
+ * Salva in file (lungo almeno BOOK_PATH_LENGTH + 16) il percorso del segmento numero
+ * segment della rubrica path, ottenuti generation e segments con getContactBookSegments
+ * Per una rubrica in un unico file e' il percorso della rubrica stessa
+ */
+void getContactBookFile(const char *path, unsigned int generation, int segments, int segment, char *file);
+
+/**
+ * Restituisce il segmento (tra segments) in cui si trovano i contatti con nome e cognome di cntc
+ */
+int contactSegment(Contact cntc, int segments);
+
+/**
+ * Come stat, per una rubrica che puo' essere divisa in segmenti: st_size e' la dimensione
+ * complessiva, st_mtim la modifica piu' recente e st_ino cambia ogni volta che uno dei file
+ * viene sostituito; gli altri campi non sono significativi
+ *
+ * Restituisce 1 in caso di successo, 0 altrimenti (info viene azzerato)
+ */
+int statContactBook(const char *path, struct stat *info);
+
+/**
+ * Ridistribuisce i contatti della rubrica scelta in segments segmenti (1 per un unico file),
+ * anche mentre il server e' in esecuzione: le modifiche aspettano la fine (lockContactBook),
+ * le letture vedono la rubrica prima o dopo la ripartizione, mai a meta'
+ *
+ * Restituisce il numero di contatti ridistribuiti, -1 in caso di errore (la rubrica non cambia)
+ */
+int reshardContactBook(int segments);
+
 /**
  * Restituisce l'n-esimo contatto salvato nella rubrica
  * 
@@ -98,6 +200,7 @@ int removeContact(Contact cntc);
  *  0 - Contatto non modificato per errore su file
  *  1 - Contatto modificato correttamente
  *  2 - Contatto non modificato perchè non presente
+ *  3 - Contatto non modificato perchè new era gia' presente in un altro segmento
  */
 int modifyContact(Contact old, Contact new);
 
@@ -243,4 +346,13 @@ int isDigit(char c);
 /**
  * Controlla se il carattere (c) è una lettera (da 'a/A' a 'z/Z')
  */
-int isLetter(char c);
\ No newline at end of file
+int isLetter(char c);
+
+/**
+ * Sostituisce il contenuto della rubrica scelta con il file file (un contatto per riga),
+ * che viene spostato al suo posto: se la rubrica era divisa in segmenti viene poi
+ * ripartita nello stesso numero di segmenti
+ *
+ * Restituisce 1 in caso di successo, 0 altrimenti (la rubrica non cambia)
+ */
+int replaceContactBook(const char *file);
@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2024 Biribo' Francesco, Giannuzzi Riccardo, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/types.h>
+#include "./../include/admission.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <signal.h>
+
+/**
+ * Connessione in attesa di una sessione
+ *
+ * Campi:
+ *  fd - Descrittore della connessione accettata
+ *  local - 1 se arriva dalla socket locale
+ *  accepted - Istante (monotono, in millisecondi) in cui e' stata accettata
+ */
+typedef struct {
+    int fd;
+    int local;
+    long accepted;
+} waitingConnection;
+
+/**
+ * stats - Contatori condivisi (file files/admission.dat)
+ * sessions - Processi delle sessioni in corso, al massimo stats->maxSessions
+ * waiting - Coda circolare delle connessioni in attesa, la prima in posizione first
+ *
+ * La coda e le sessioni sono gestite solo dal processo principale del server
+ */
+static admissionStats *stats = NULL;
+static pid_t *sessions = NULL;
+static waitingConnection *waiting = NULL;
+static int first = 0;
+
+/**
+ * Restituisce l'istante attuale in millisecondi, dall'orologio monotono
+ */
+static long nowMs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000L + now.tv_nsec / 1000000L;
+}
+
+int initAdmission(int maxSessions, int maxWaiting) {
+    if(maxSessions <= 0)
+        maxSessions = DEFAULT_MAX_SESSIONS;
+    if(maxWaiting < 0)
+        maxWaiting = DEFAULT_MAX_WAITING;
+
+    /*
+     * Il file viene ricreato invece che svuotato: dopo un passaggio della socket il vecchio server
+     * continua ad aggiornare i contatori delle sue sessioni, che non devono sovrapporsi a quelli nuovi
+     */
+    umask(0);
+    unlink("files/admission.dat");
+    int fd = open("files/admission.dat", O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if(fd < 0)
+        return 0;
+    if(ftruncate(fd, sizeof(admissionStats)) < 0) {
+        close(fd);
+        return 0;
+    }
+    void *mapped = mmap(NULL, sizeof(admissionStats), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED)
+        return 0;
+
+    sessions = calloc(maxSessions, sizeof(pid_t));
+    waiting = calloc(maxWaiting > 0 ? maxWaiting : 1, sizeof(waitingConnection));
+    if(sessions == NULL || waiting == NULL) {
+        munmap(mapped, sizeof(admissionStats));
+        free(sessions);
+        free(waiting);
+        return 0;
+    }
+    stats = mapped;
+    stats->maxSessions = maxSessions;
+    stats->maxWaiting = maxWaiting;
+    return 1;
+}
+
+int canStartSession(void) {
+    return stats == NULL || stats->active < stats->maxSessions;
+}
+
+void sessionStarted(pid_t pid, long waitedMs) {
+    if(stats == NULL)
+        return;
+    for(int i = 0; i < stats->maxSessions; i++) {
+        if(sessions[i] == 0) {
+            sessions[i] = pid;
+            break;
+        }
+    }
+    stats->active++;
+    stats->admitted++;
+    if(waitedMs > 0) {
+        stats->queued++;
+        stats->totalWaitMs += waitedMs;
+        if((unsigned long)waitedMs > stats->maxWaitMs)
+            stats->maxWaitMs = waitedMs;
+    }
+}
+
+int sessionEnded(pid_t pid, int status) {
+    if(stats == NULL)
+        return 0;
+    for(int i = 0; i < stats->maxSessions; i++) {
+        if(sessions[i] == pid) {
+            sessions[i] = 0;
+            stats->active--;
+            if(WIFEXITED(status) && WEXITSTATUS(status) == SESSION_IDLE_EXIT)
+                stats->idleClosed++;
+            else if(WIFEXITED(status) && WEXITSTATUS(status) == SESSION_UNREACHABLE_EXIT)
+                stats->unreachableClosed++;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int queueConnection(int fd, int local) {
+    if(stats == NULL || stats->waiting >= stats->maxWaiting)
+        return 0;
+    waitingConnection *last = &waiting[(first + stats->waiting) % stats->maxWaiting];
+    last->fd = fd;
+    last->local = local;
+    last->accepted = nowMs();
+    stats->waiting++;
+    return 1;
+}
+
+int takeQueuedConnection(int *fd, int *local, long *waitedMs) {
+    if(stats == NULL || stats->waiting == 0)
+        return 0;
+    *fd = waiting[first].fd;
+    *local = waiting[first].local;
+    *waitedMs = nowMs() - waiting[first].accepted;
+    first = (first + 1) % stats->maxWaiting;
+    stats->waiting--;
+    return 1;
+}
+
+int takeExpiredConnection(int *fd) {
+    if(stats == NULL || stats->waiting == 0 || nowMs() - waiting[first].accepted < ADMISSION_MAX_WAIT_MS)
+        return 0;
+    int local;
+    long waitedMs;
+    return takeQueuedConnection(fd, &local, &waitedMs);
+}
+
+int getAdmissionTimeout(void) {
+    if(stats == NULL || stats->waiting == 0)
+        return -1;
+    long left = waiting[first].accepted + ADMISSION_MAX_WAIT_MS - nowMs();
+    return left > 0 ? (int)left : 0;
+}
+
+void closeQueuedConnections(void) {
+    if(stats == NULL)
+        return;
+    for(int i = 0; i < stats->waiting; i++)
+        close(waiting[(first + i) % stats->maxWaiting].fd);
+}
+
+int sessionsInProgress(void) {
+    return stats == NULL ? 0 : stats->active + stats->waiting;
+}
+
+void signalSessions(int sig) {
+    if(stats == NULL)
+        return;
+    for(int i = 0; i < stats->maxSessions; i++) {
+        if(sessions[i] > 0)
+            kill(sessions[i], sig);
+    }
+}
+
+void connectionRejected(void) {
+    if(stats != NULL)
+        stats->rejected++;
+}
+
+int getAdmissionStats(admissionStats *copy) {
+    int fd = open("files/admission.dat", O_RDONLY);
+    if(fd < 0)
+        return 0;
+
+    struct stat info;
+    if(fstat(fd, &info) < 0 || info.st_size < (off_t)sizeof(admissionStats)) {
+        close(fd);
+        return 0;
+    }
+    admissionStats *mapped = mmap(NULL, sizeof(admissionStats), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED)
+        return 0;
+
+    // Lettura senza lock: i contatori possono essere leggermente disallineati tra loro
+    *copy = *mapped;
+    munmap(mapped, sizeof(admissionStats));
+    return 1;
+}
@@ -0,0 +1,420 @@
+/*
+ * Copyright (c) 2024 Biribo' Francesco, Giannuzzi Riccardo, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "./../include/utility.h"
+#include "./../include/changeFeed.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * Contenuto del file condiviso
+ *
+ * Campi:
+ *  lock - Mutex condiviso tra i processi
+ *  changed - Condizione segnalata a ogni nuova modifica
+ *  version - Numero dell'ultima modifica pubblicata
+ *  lastReset - Numero dell'ultimo riavvio (o modifica esterna) della rubrica
+ *  logFirst - Numero della prima modifica conservata nel registro
+ *  inode, size, mtime - Rubrica dopo l'ultima modifica pubblicata
+ *  changes - Ultime FEED_SIZE modifiche, la numero v si trova in posizione v % FEED_SIZE
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    unsigned int version;
+    unsigned int lastReset;
+    unsigned int logFirst;
+    ino_t inode;
+    off_t size;
+    struct timespec mtime;
+    contactChange changes[FEED_SIZE];
+} sharedFeed;
+
+// Coda mappata in memoria, NULL se non disponibile
+static sharedFeed *feed = NULL;
+
+// Numero di modifiche conservate nel registro
+static int retention = CHANGE_LOG_RETENTION;
+
+// Lunghezza della riga di files/version.txt: numero dell'ultima modifica e rubrica dopo di essa
+#define STATE_LENGTH 86
+
+/**
+ * Salva in files/version.txt il numero dell'ultima modifica e lo stato della rubrica,
+ * sempre con la stessa lunghezza cosi' da sovrascrivere la riga per intero
+ */
+static void saveState(void) {
+    char line[STATE_LENGTH + 1];
+    sprintf(line, "%010u %020llu %020lld %020lld %09ld\n", feed->version, (unsigned long long)feed->inode,
+        (long long)feed->size, (long long)feed->mtime.tv_sec, feed->mtime.tv_nsec);
+    int fd = open("files/version.txt", O_WRONLY | O_CREAT, 0666);
+    if(fd > -1) {
+        pwrite(fd, line, STATE_LENGTH, 0);
+        close(fd);
+    }
+}
+
+/**
+ * Controlla se la rubrica e' ancora quella dell'ultima modifica pubblicata
+ */
+static int sameFeedBook(void) {
+    struct stat current;
+    memset(&current, 0, sizeof(current));
+    statContactBook(SHARED_BOOK_PATH, &current);
+    return current.st_ino == feed->inode && current.st_size == feed->size
+        && current.st_mtim.tv_sec == feed->mtime.tv_sec && current.st_mtim.tv_nsec == feed->mtime.tv_nsec;
+}
+
+/**
+ * Associa la coda allo stato attuale della rubrica
+ */
+static void setFeedBook(void) {
+    struct stat current;
+    memset(&current, 0, sizeof(current));
+    statContactBook(SHARED_BOOK_PATH, &current);
+    feed->inode = current.st_ino;
+    feed->size = current.st_size;
+    feed->mtime = current.st_mtim;
+}
+
+/**
+ * Riscrive il registro conservando solo le ultime retention modifiche
+ * Chi sta leggendo il registro continua a leggere il vecchio file, che resta integro
+ */
+static void compactLog(void) {
+    unsigned int keepFrom = feed->version - retention + 1;
+    int oldLog = open("files/changes.log", O_RDONLY);
+    int newLog = open("files/changes.tmp", O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    int copied = oldLog > -1 && newLog > -1;
+
+    contactChange change;
+    off_t offset = (off_t)(keepFrom - feed->logFirst) * sizeof(contactChange);
+    while(copied && pread(oldLog, &change, sizeof(change), offset) == sizeof(change)) {
+        if(write(newLog, &change, sizeof(change)) != sizeof(change))
+            copied = 0;
+        offset += sizeof(change);
+    }
+
+    if(oldLog > -1)
+        close(oldLog);
+    if(newLog > -1)
+        close(newLog);
+    if(copied && rename("files/changes.tmp", "files/changes.log") == 0)
+        feed->logFirst = keepFrom;
+    else
+        unlink("files/changes.tmp");
+}
+
+/**
+ * Pubblica una modifica: la aggiunge alla coda e al registro e risveglia gli iscritti,
+ * da chiamare con il lock acquisito
+ *
+ * Il registro viene aperto a ogni modifica perche' la compattazione lo sostituisce,
+ * e ogni processo deve scrivere nel file attuale
+ */
+static unsigned int storeChange(char operation, Contact old, Contact new) {
+    unsigned int version = feed->version + 1;
+    contactChange *change = &feed->changes[version % FEED_SIZE];
+    change->version = version;
+    change->operation = operation;
+    change->old = old;
+    change->new = new;
+
+    int log = open("files/changes.log", O_WRONLY | O_CREAT | O_APPEND, 0666);
+    if(log > -1) {
+        write(log, change, sizeof(contactChange));
+        close(log);
+    }
+
+    feed->version = version;
+    if(operation == 0)
+        feed->lastReset = version;
+    if(version - feed->logFirst + 1 > 2 * (unsigned int)retention)
+        compactLog();
+    setFeedBook();
+    saveState();
+    pthread_cond_broadcast(&feed->changed);
+    return version;
+}
+
+/**
+ * Acquisisce il lock della coda
+ *
+ * Le modifiche vengono scritte per intero prima di aggiornare version,
+ * quindi anche se il processo che possedeva il lock e' terminato la coda e' coerente
+ */
+static void lockFeed(void) {
+    if(pthread_mutex_lock(&feed->lock) == EOWNERDEAD)
+        pthread_mutex_consistent(&feed->lock);
+}
+
+static void unlockFeed(void) {
+    pthread_mutex_unlock(&feed->lock);
+}
+
+/**
+ * Riprende la numerazione dal registro e da files/version.txt, da chiamare durante initChangeFeed
+ */
+static void loadState(void) {
+    Contact none;
+    createEmptyContact(&none);
+
+    // Ultima modifica e stato della rubrica salvati, se presenti
+    char line[STATE_LENGTH + 1];
+    memset(line, '\0', STATE_LENGTH + 1);
+    unsigned long long inode = 0;
+    long long size = -1, seconds = 0;
+    long nanoseconds = 0;
+    int fd = open("files/version.txt", O_RDONLY);
+    if(fd > -1) {
+        if(pread(fd, line, STATE_LENGTH, 0) > 0)
+            sscanf(line, "%u %llu %lld %lld %ld", &feed->version, &inode, &size, &seconds, &nanoseconds);
+        close(fd);
+    }
+
+    /*
+     * Il registro deve contenere modifiche consecutive fino all'ultima salvata:
+     * un'eventuale modifica scritta a meta' (terminazione improvvisa) viene scartata,
+     * e se il registro non arriva fino all'ultima modifica viene svuotato
+     */
+    contactChange first, last;
+    int log = open("files/changes.log", O_RDWR | O_CREAT, 0666);
+    off_t records = log > -1 ? lseek(log, 0, SEEK_END) / sizeof(contactChange) : 0;
+    if(records > 0 && pread(log, &first, sizeof(first), 0) == sizeof(first)
+        && pread(log, &last, sizeof(last), (records - 1) * sizeof(contactChange)) == sizeof(last)
+        && last.version - first.version + 1 == records && last.version >= feed->version) {
+        ftruncate(log, records * sizeof(contactChange));
+        feed->version = last.version;
+        feed->logFirst = first.version;
+    } else {
+        if(log > -1)
+            ftruncate(log, 0);
+        feed->logFirst = feed->version + 1;
+    }
+    if(log > -1)
+        close(log);
+
+    /*
+     * Se la rubrica non e' quella dell'ultima modifica (e' stata cambiata mentre il server
+     * era spento) pubblichiamo un riavvio: qualsiasi risultato puo' essere cambiato
+     */
+    feed->inode = (ino_t)inode;
+    feed->size = (off_t)size;
+    feed->mtime.tv_sec = (time_t)seconds;
+    feed->mtime.tv_nsec = nanoseconds;
+    if(!sameFeedBook() || feed->version == 0)
+        storeChange(0, none, none);
+}
+
+int initChangeFeed(int changeRetention) {
+    umask(0);
+    if(changeRetention > 0)
+        retention = changeRetention;
+
+    // Nuovo file anche se esiste gia': gli iscritti di un altro server nella stessa cartella attendono sul vecchio
+    unlink("files/feed.dat");
+    int fd = open("files/feed.dat", O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if(fd < 0)
+        return 0;
+    if(ftruncate(fd, sizeof(sharedFeed)) < 0) {
+        close(fd);
+        return 0;
+    }
+    void *mapped = mmap(NULL, sizeof(sharedFeed), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED)
+        return 0;
+
+    // Come per la cache il mutex e' condiviso tra processi e robusto
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&((sharedFeed *)mapped)->lock, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+
+    // L'attesa degli iscritti usa l'orologio monotono, non influenzato dai cambi di ora
+    pthread_condattr_t conditionAttributes;
+    pthread_condattr_init(&conditionAttributes);
+    pthread_condattr_setpshared(&conditionAttributes, PTHREAD_PROCESS_SHARED);
+    pthread_condattr_setclock(&conditionAttributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&((sharedFeed *)mapped)->changed, &conditionAttributes);
+    pthread_condattr_destroy(&conditionAttributes);
+    feed = mapped;
+
+    loadState();
+    return 1;
+}
+
+int attachChangeFeed(int changeRetention) {
+    if(changeRetention > 0)
+        retention = changeRetention;
+    int fd = open("files/feed.dat", O_RDWR);
+    if(fd < 0)
+        return 0;
+
+    struct stat info;
+    if(fstat(fd, &info) < 0 || info.st_size < (off_t)sizeof(sharedFeed)) {
+        close(fd);
+        return 0;
+    }
+    void *mapped = mmap(NULL, sizeof(sharedFeed), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED)
+        return 0;
+    feed = mapped;
+    return 1;
+}
+
+unsigned int publishContactChange(char operation, Contact old, Contact new) {
+    if(feed == NULL)
+        return 0;
+    lockFeed();
+    unsigned int version = storeChange(operation, old, new);
+    unlockFeed();
+    return version;
+}
+
+unsigned int checkFeedBook(void) {
+    if(feed == NULL)
+        return 0;
+    Contact none;
+    createEmptyContact(&none);
+    lockFeed();
+    if(!sameFeedBook())
+        storeChange(0, none, none);
+    unsigned int version = feed->version;
+    unlockFeed();
+    return version;
+}
+
+unsigned int getFeedVersion(void) {
+    if(feed == NULL)
+        return 0;
+    lockFeed();
+    unsigned int version = feed->version;
+    unlockFeed();
+    return version;
+}
+
+/**
+ * Copia le modifiche successive ad after, da chiamare con il lock acquisito
+ */
+static int copyChanges(unsigned int after, contactChange *changes, int maxChanges) {
+
+    // Le modifiche successive ad after devono essere ancora tutte nella coda
+    if(feed->version - after > FEED_SIZE)
+        return -1;
+    int copied = 0;
+    while(after + copied < feed->version && copied < maxChanges) {
+        changes[copied] = feed->changes[(after + copied + 1) % FEED_SIZE];
+        copied++;
+    }
+    return copied;
+}
+
+int getFeedStats(unsigned int *version, unsigned int *retained) {
+    int fd = open("files/feed.dat", O_RDONLY);
+    if(fd < 0)
+        return 0;
+
+    struct stat info;
+    if(fstat(fd, &info) < 0 || info.st_size < (off_t)sizeof(sharedFeed)) {
+        close(fd);
+        return 0;
+    }
+    sharedFeed *mapped = mmap(NULL, sizeof(sharedFeed), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED)
+        return 0;
+
+    // Lettura senza lock, come per i contatori della cache
+    *version = mapped->version;
+    *retained = mapped->version >= mapped->logFirst ? mapped->version - mapped->logFirst + 1 : 0;
+    munmap(mapped, sizeof(sharedFeed));
+    return 1;
+}
+
+int readContactChanges(unsigned int after, contactChange *changes, int maxChanges) {
+    if(feed == NULL)
+        return -1;
+    lockFeed();
+    int copied = copyChanges(after, changes, maxChanges);
+    unlockFeed();
+    return copied;
+}
+
+int isFeedInSync(void) {
+    if(feed == NULL)
+        return 0;
+    lockFeed();
+    int inSync = sameFeedBook();
+    unlockFeed();
+    return inSync;
+}
+
+int openChangeLog(unsigned int since, unsigned int *until) {
+    if(feed == NULL)
+        return -1;
+    checkFeedBook();
+
+    /*
+     * Le modifiche successive a since devono essere tutte nel registro e non devono
+     * comprendere riavvii, dopo i quali il client deve rileggere tutta la rubrica
+     */
+    int log = -1;
+    lockFeed();
+    if(since > 0 && since >= feed->lastReset && since + 1 >= feed->logFirst && since <= feed->version) {
+        log = open("files/changes.log", O_RDONLY);
+        if(log > -1 && lseek(log, (off_t)(since + 1 - feed->logFirst) * sizeof(contactChange), SEEK_SET) < 0) {
+            close(log);
+            log = -1;
+        }
+        *until = feed->version;
+    }
+    unlockFeed();
+    return log;
+}
+
+int readChangeLog(int log, contactChange *change) {
+    return read(log, change, sizeof(contactChange)) == sizeof(contactChange);
+}
+
+int waitContactChanges(unsigned int after, contactChange *changes, int maxChanges) {
+    if(feed == NULL)
+        return -1;
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += FEED_WAIT_MS / 1000;
+    deadline.tv_nsec += (FEED_WAIT_MS % 1000) * 1000000L;
+    if(deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    lockFeed();
+    while(feed->version == after) {
+        int res = pthread_cond_timedwait(&feed->changed, &feed->lock, &deadline);
+        if(res == EOWNERDEAD)
+            pthread_mutex_consistent(&feed->lock);
+        else if(res == ETIMEDOUT)
+            break;
+    }
+    int copied = copyChanges(after, changes, maxChanges);
+    unlockFeed();
+    return copied;
+}
@@ -34,12 +34,12 @@ void buildMessage(char *message, serverPacket packet){
 
     // Impostiamo un'operazione solo se corretta
     char c = packet.operation;
-    if(c == READ || c == AUTH || c == ADD || c == DEL|| c == MODIFY)
+    if(c == READ || c == AUTH || c == ADD || c == DEL|| c == MODIFY || c == FUZZY_READ || c == INSENSITIVE_READ || c == SUFFIX_READ || c == ORDERED_READ || c == COUNT || c == SUBSCRIBE || c == SYNC_SINCE || c == REPLICATE)
         message[OPERATION_INDEX]= c;
 
     // Impostiamo l'esito solo se valido
     c = packet.outcome;
-    if(c == SERVER_ERROR || c == OPERATION_SUCCESS || c == READ_CONTACT_MISSING || c == CREDENTIALS_EXPIRED || c == CONTACT_ALREADY_MODIFIED || c == CONTACT_ALREADY_EXISTS || c == INVALID_PACKET)
+    if(c == SERVER_ERROR || c == OPERATION_SUCCESS || c == READ_CONTACT_MISSING || c == CREDENTIALS_EXPIRED || c == CONTACT_ALREADY_MODIFIED || c == CONTACT_ALREADY_EXISTS || c == INVALID_PACKET || c == CHANGES_LOST || c == NOT_MODIFIED || c == REDIRECT || c == SERVER_BUSY)
         message[OUTCOME_INDEX]= c;
 
     // Impostiamo username
@@ -59,7 +59,9 @@ void buildMessage(char *message, serverPacket packet){
     // Impostiamo match index
     if(packet.matchIndex > 0){
         // Trasformiamo match index in stringa
+        // Il campo viene copiato per intero: dopo il numero non devono restare impurita' (una virgola renderebbe il pacchetto non valido)
         char mIndex[CONTACT_PARAM_LENGTH + 1];
+        memset(mIndex, '\0', CONTACT_PARAM_LENGTH + 1);
         sprintf(mIndex, "%d", packet.matchIndex);
         for(int i = 0; i <  CONTACT_PARAM_LENGTH; i++) {
             message[i + MATCHINDEX_INDEX] = mIndex[i];
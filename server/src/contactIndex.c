@@ -0,0 +1,1277 @@
+/*
+ * Copyright (c) 2024 Biribo' Francesco, Giannuzzi Riccardo, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "./../include/utility.h"
+#include "./../include/contactIndex.h"
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+// Dimensione del buffer usato per leggere la rubrica a blocchi
+#define LOAD_BUFFER_SIZE 65536
+
+// Tentativi di caricamento, se la rubrica viene ripartita mentre la leggiamo
+#define LOAD_ATTEMPTS 3
+
+// Le ricerche che scorrono tutta la rubrica vengono divise tra SCAN_THREADS thread oltre questo numero di contatti
+#define PARALLEL_SCAN_MIN_CONTACTS 65536
+#define SCAN_THREADS 4
+#define INITIAL_CAPACITY 1024
+#define MIN_BUCKETS 16
+#define INITIAL_POOL_CAPACITY 4096
+
+/**
+ * table - Istantanea della rubrica posseduta da questo processo
+ * loadedStat - Informazioni sul file rubrica al momento dell'ultimo caricamento
+ * loadedPath - Rubrica (condivisa o personale) da cui e' stata caricata la tabella
+ * loaded - Indica se e' gia' stato fatto almeno un caricamento
+ *
+ * Ogni processo che gestisce una sessione ha la propria copia, che viene
+ * ricaricata quando un altro processo modifica la rubrica o quando la sessione
+ * passa a un'altra rubrica (selectContactBook)
+ */
+static contactTable table;
+static struct stat loadedStat;
+static char loadedPath[BOOK_PATH_LENGTH];
+static int loaded = 0;
+
+/**
+ * Lettera senza accento corrispondente ai caratteri UTF-8 che iniziano con 0xC3
+ * (da U+00C0 a U+00FF), indicizzata dal secondo byte meno 0x80
+ * '*' indica un carattere che non e' una lettera accentata e resta invariato
+ */
+static const char accentFolding[] = "aaaaaaaceeeeiiiidnooooo*ouuuuy*saaaaaaaceeeeiiiidnooooo*ouuuuy*y";
+
+/**
+ * Ridimensiona la colonna puntata da column per contenere capacity elementi
+ *
+ * Restituisce 1 in caso di successo, 0 se la memoria non e' sufficiente
+ */
+static int resizeColumn(void *column, size_t elementSize, int capacity) {
+    void **columnPtr = (void **)column;
+    void *resized = realloc(*columnPtr, elementSize * capacity);
+    if(resized == NULL)
+        return 0;
+    *columnPtr = resized;
+    return 1;
+}
+
+/**
+ * Si assicura che le colonne abbiano spazio per almeno needed contatti
+ *
+ * Restituisce 1 in caso di successo, 0 se la memoria non e' sufficiente
+ */
+static int ensureCapacity(int needed) {
+    if(needed <= table.capacity)
+        return 1;
+
+    int newCapacity = table.capacity ? table.capacity : INITIAL_CAPACITY;
+    while(newCapacity < needed)
+        newCapacity *= 2;
+
+    if(!resizeColumn(&table.names, sizeof(*table.names), newCapacity)
+        || !resizeColumn(&table.surnames, sizeof(*table.surnames), newCapacity)
+        || !resizeColumn(&table.phoneNumbers, sizeof(*table.phoneNumbers), newCapacity)
+        || !resizeColumn(&table.alive, sizeof(*table.alive), newCapacity)
+        || !resizeColumn(&table.nameKeys, sizeof(*table.nameKeys), newCapacity)
+        || !resizeColumn(&table.surnameKeys, sizeof(*table.surnameKeys), newCapacity)
+        || !resizeColumn(&table.nameLengths, sizeof(*table.nameLengths), newCapacity)
+        || !resizeColumn(&table.surnameLengths, sizeof(*table.surnameLengths), newCapacity)
+        || !resizeColumn(&table.nameMasks, sizeof(*table.nameMasks), newCapacity)
+        || !resizeColumn(&table.surnameMasks, sizeof(*table.surnameMasks), newCapacity)
+        || !resizeColumn(&table.nameNext, sizeof(*table.nameNext), newCapacity)
+        || !resizeColumn(&table.surnameNext, sizeof(*table.surnameNext), newCapacity)
+        || !resizeColumn(&table.phoneSuffixKeys, sizeof(*table.phoneSuffixKeys), newCapacity)
+        || !resizeColumn(&table.phoneSuffixOrder, sizeof(*table.phoneSuffixOrder), newCapacity)
+        || !resizeColumn(&table.skipHeights, sizeof(*table.skipHeights), newCapacity)
+        || !resizeColumn(&table.skipOffsets, sizeof(*table.skipOffsets), newCapacity))
+        return 0;
+
+    table.capacity = newCapacity;
+    return 1;
+}
+
+int normalizeKey(const char *field, char *key) {
+    int length = 0;
+
+    for(int i = 0; field[i] != '\0'; i++) {
+        unsigned char c = field[i];
+
+        if(c >= 'A' && c <= 'Z') {
+            key[length++] = c - 'A' + 'a';
+        } else if(c == 0xC3 && (unsigned char)field[i + 1] >= 0x80 && (unsigned char)field[i + 1] <= 0xBF) {
+
+            // Lettera accentata codificata su due byte, la sostituiamo con la lettera base
+            char folded = accentFolding[(unsigned char)field[i + 1] - 0x80];
+            if(folded != '*') {
+                key[length++] = folded;
+            } else {
+                key[length++] = field[i];
+                key[length++] = field[i + 1];
+            }
+            i++;
+        } else {
+            key[length++] = c;
+        }
+    }
+    key[length] = '\0';
+    return length;
+}
+
+/**
+ * Salva in key le cifre di phoneNumber dall'ultima alla prima, ignorando
+ * gli altri caratteri (es. "+39 333-1234" diventa "43213339")
+ *
+ * Restituisce la lunghezza della chiave
+ */
+static int reverseDigits(const char *phoneNumber, char *key) {
+    int length = 0;
+    for(int i = strlen(phoneNumber) - 1; i >= 0; i--)
+        if(phoneNumber[i] >= '0' && phoneNumber[i] <= '9')
+            key[length++] = phoneNumber[i];
+    key[length] = '\0';
+    return length;
+}
+
+/**
+ * Funzione hash FNV-1a sulle chiavi normalizzate
+ */
+static unsigned int hashKey(const char *key) {
+    unsigned int hash = 2166136261U;
+    for(int i = 0; key[i] != '\0'; i++) {
+        hash ^= (unsigned char)key[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+/**
+ * Copia il campo che inizia in start (lungo length) nella colonna column
+ * troncandolo alla lunghezza massima di un campo del contatto
+ */
+static void copyField(char *column, const char *start, int length) {
+    if(length > CONTACT_STRINGS_LENGTH)
+        length = CONTACT_STRINGS_LENGTH;
+    memcpy(column, start, length);
+    memset(column + length, '\0', CONTACT_STRINGS_LENGTH + 1 - length);
+}
+
+/**
+ * Calcola l'insieme dei caratteri presenti in field, raggruppandoli in 32 classi
+ * (le maiuscole e le minuscole della stessa lettera cadono nella stessa classe)
+ */
+static unsigned int characterMask(const char *field, int length) {
+    unsigned int mask = 0;
+    for(int i = 0; i < length; i++)
+        mask |= 1U << ((unsigned char)field[i] & 31);
+    return mask;
+}
+
+/**
+ * Calcola le chiavi del contatto in posizione i a partire dai suoi campi
+ */
+static void computeKeys(int i) {
+    table.nameLengths[i] = normalizeKey(table.names[i], table.nameKeys[i]);
+    table.surnameLengths[i] = normalizeKey(table.surnames[i], table.surnameKeys[i]);
+    table.nameMasks[i] = characterMask(table.nameKeys[i], table.nameLengths[i]);
+    table.surnameMasks[i] = characterMask(table.surnameKeys[i], table.surnameLengths[i]);
+    reverseDigits(table.phoneNumbers[i], table.phoneSuffixKeys[i]);
+}
+
+/**
+ * Aggiunge alla tabella il contatto contenuto nella linea [nome,cognome,numeroTelefono]
+ *
+ * Restituisce 1 in caso di successo, 0 se la memoria non e' sufficiente
+ */
+static int appendLine(const char *line, int length) {
+    if(length == 0)
+        return 1;
+    if(!ensureCapacity(table.count + 1))
+        return 0;
+
+    // Cerchiamo le due virgole che separano i tre campi
+    const char *firstComma = memchr(line, ',', length);
+    const char *secondComma = firstComma ? memchr(firstComma + 1, ',', length - (firstComma + 1 - line)) : NULL;
+    if(secondComma == NULL) // Linea non valida, la ignoriamo come farebbe getContact
+        return 1;
+
+    int i = table.count;
+    copyField(table.names[i], line, firstComma - line);
+    copyField(table.surnames[i], firstComma + 1, secondComma - firstComma - 1);
+    copyField(table.phoneNumbers[i], secondComma + 1, length - (secondComma + 1 - line));
+
+    // Le chiavi normalizzate vengono calcolate una volta sola, al caricamento
+    computeKeys(i);
+    table.alive[i] = 1;
+    table.count++;
+    table.liveCount++;
+    return 1;
+}
+
+/**
+ * Ordina due posizioni per numero di telefono al contrario e poi per posizione
+ */
+static int comparePhoneSuffix(const void *first, const void *second) {
+    int a = *(const int *)first, b = *(const int *)second;
+    int result = strcmp(table.phoneSuffixKeys[a], table.phoneSuffixKeys[b]);
+    if(result == 0)
+        result = (a > b) - (a < b);
+    return result;
+}
+
+/**
+ * Costruisce le tabelle hash sulle chiavi normalizzate di nome e cognome
+ *
+ * Inseriamo le posizioni in testa alle catene partendo dall'ultimo contatto,
+ * cosi' ogni catena risulta ordinata come la rubrica
+ *
+ * Restituisce 1 in caso di successo, 0 se la memoria non e' sufficiente
+ */
+static int buildKeyIndex(void) {
+    int bucketCount = MIN_BUCKETS;
+    while(bucketCount < 2 * table.count)
+        bucketCount *= 2;
+
+    if(bucketCount != table.bucketCount) {
+        if(!resizeColumn(&table.nameBuckets, sizeof(*table.nameBuckets), bucketCount)
+            || !resizeColumn(&table.surnameBuckets, sizeof(*table.surnameBuckets), bucketCount))
+            return 0;
+        table.bucketCount = bucketCount;
+    }
+    memset(table.nameBuckets, -1, bucketCount * sizeof(*table.nameBuckets));
+    memset(table.surnameBuckets, -1, bucketCount * sizeof(*table.surnameBuckets));
+
+    for(int i = table.count - 1; i >= 0; i--) {
+        unsigned int nameBucket = hashKey(table.nameKeys[i]) & (bucketCount - 1);
+        unsigned int surnameBucket = hashKey(table.surnameKeys[i]) & (bucketCount - 1);
+        table.nameNext[i] = table.nameBuckets[nameBucket];
+        table.nameBuckets[nameBucket] = i;
+        table.surnameNext[i] = table.surnameBuckets[surnameBucket];
+        table.surnameBuckets[surnameBucket] = i;
+    }
+
+    // L'ordinamento per suffisso e la skip list vengono ricostruiti solo quando servono
+    table.suffixReady = 0;
+    table.orderedReady = 0;
+    return 1;
+}
+
+/**
+ * Inserisce position nella catena del bucket di key, mantenendo la catena
+ * nell'ordine della rubrica
+ */
+static void linkChain(int *buckets, int *next, const char *key, int position) {
+    int *link = &buckets[hashKey(key) & (table.bucketCount - 1)];
+    while(*link != -1 && *link < position)
+        link = &next[*link];
+    next[position] = *link;
+    *link = position;
+}
+
+/**
+ * Toglie position dalla catena del bucket di key
+ */
+static void unlinkChain(int *buckets, int *next, const char *key, int position) {
+    int *link = &buckets[hashKey(key) & (table.bucketCount - 1)];
+    while(*link != -1 && *link != position)
+        link = &next[*link];
+    if(*link == position)
+        *link = next[position];
+}
+
+/**
+ * Ordina le posizioni dei contatti per numero di telefono al contrario
+ */
+static void buildSuffixIndex(void) {
+    int sortedCount = 0;
+    for(int i = 0; i < table.count; i++)
+        if(table.alive[i])
+            table.phoneSuffixOrder[sortedCount++] = i;
+    qsort(table.phoneSuffixOrder, sortedCount, sizeof(*table.phoneSuffixOrder), comparePhoneSuffix);
+    table.suffixReady = 1;
+}
+
+/**
+ * Cerca in phoneSuffixOrder il punto in cui si trova (o andrebbe inserita) position
+ */
+static int suffixSlot(int position) {
+    int low = 0, high = table.liveCount;
+    while(low < high) {
+        int middle = low + (high - low) / 2;
+        if(comparePhoneSuffix(&table.phoneSuffixOrder[middle], &position) < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+/**
+ * Confronta due contatti secondo l'ordine alfabetico: cognome, nome e numero
+ * di telefono ignorando maiuscole e accenti, poi cognome e nome originali,
+ * infine la posizione nella rubrica
+ */
+static int compareOrdered(int a, int b) {
+    int result = strcmp(table.surnameKeys[a], table.surnameKeys[b]);
+    if(result == 0) result = strcmp(table.nameKeys[a], table.nameKeys[b]);
+    if(result == 0) result = strcmp(table.phoneNumbers[a], table.phoneNumbers[b]);
+    if(result == 0) result = strcmp(table.surnames[a], table.surnames[b]);
+    if(result == 0) result = strcmp(table.names[a], table.names[b]);
+    if(result == 0) result = (a > b) - (a < b);
+    return result;
+}
+
+/**
+ * Adattatore di compareOrdered per qsort
+ */
+static int compareOrderedPositions(const void *first, const void *second) {
+    return compareOrdered(*(const int *)first, *(const int *)second);
+}
+
+/**
+ * Restituisce il puntatore al successivo di node al livello level,
+ * node == -1 indica la testa della skip list
+ */
+static int *skipLink(int node, int level) {
+    return node == -1 ? &table.skipHead[level] : &table.skipPool[table.skipOffsets[node] + level];
+}
+
+/**
+ * Estrae il numero di livelli di un nuovo nodo: ogni livello in piu' ha probabilita' 1/4
+ * Usiamo un generatore xorshift interno per non alterare la sequenza di rand()
+ */
+static int randomHeight(void) {
+    static unsigned int state = 2463534242U;
+    int height = 1;
+    while(height < SKIP_MAX_LEVEL) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        if(state & 3)
+            break;
+        height++;
+    }
+    return height;
+}
+
+/**
+ * Riserva in skipPool i puntatori del nodo position
+ *
+ * Restituisce il numero di livelli del nodo, 0 se la memoria non e' sufficiente
+ */
+static int allocateNode(int position) {
+    int height = randomHeight();
+    if(table.skipPoolSize + height > table.skipPoolCapacity) {
+        int newCapacity = table.skipPoolCapacity ? table.skipPoolCapacity : INITIAL_POOL_CAPACITY;
+        while(newCapacity < table.skipPoolSize + height)
+            newCapacity *= 2;
+        if(!resizeColumn(&table.skipPool, sizeof(*table.skipPool), newCapacity))
+            return 0;
+        table.skipPoolCapacity = newCapacity;
+    }
+
+    table.skipHeights[position] = height;
+    table.skipOffsets[position] = table.skipPoolSize;
+    table.skipPoolSize += height;
+    if(height > table.skipLevel)
+        table.skipLevel = height;
+    return height;
+}
+
+/**
+ * Costruisce la skip list ordinando tutti i contatti e collegandoli in un solo passaggio
+ *
+ * Restituisce 1 in caso di successo, 0 se la memoria non e' sufficiente
+ */
+static int buildOrderedIndex(void) {
+    int *sorted = malloc((table.liveCount + 1) * sizeof(int));
+    if(sorted == NULL)
+        return 0;
+
+    int sortedCount = 0;
+    for(int i = 0; i < table.count; i++)
+        if(table.alive[i])
+            sorted[sortedCount++] = i;
+    qsort(sorted, sortedCount, sizeof(int), compareOrderedPositions);
+
+    // last[l] e' l'ultimo nodo collegato al livello l, -1 finche' il livello e' vuoto
+    int last[SKIP_MAX_LEVEL];
+    table.skipPoolSize = 0;
+    table.skipLevel = 0;
+    for(int level = 0; level < SKIP_MAX_LEVEL; level++) {
+        table.skipHead[level] = -1;
+        last[level] = -1;
+    }
+
+    for(int i = 0; i < sortedCount; i++) {
+        int position = sorted[i];
+        int height = allocateNode(position);
+        if(height == 0) {
+            free(sorted);
+            return 0;
+        }
+        for(int level = 0; level < height; level++) {
+            *skipLink(position, level) = -1;
+            *skipLink(last[level], level) = position;
+            last[level] = position;
+        }
+    }
+
+    free(sorted);
+    table.orderedReady = 1;
+    return 1;
+}
+
+/**
+ * Scende la skip list salvando in update, per ogni livello, l'ultimo nodo
+ * che precede position (-1 se e' la testa)
+ */
+static void findPredecessors(int position, int update[SKIP_MAX_LEVEL]) {
+    int current = -1;
+    for(int level = table.skipLevel - 1; level >= 0; level--) {
+        while(*skipLink(current, level) != -1 && compareOrdered(*skipLink(current, level), position) < 0)
+            current = *skipLink(current, level);
+        update[level] = current;
+    }
+}
+
+/**
+ * Inserisce position nella skip list
+ *
+ * Restituisce 1 in caso di successo, 0 se la memoria non e' sufficiente
+ */
+static int insertOrdered(int position) {
+    int update[SKIP_MAX_LEVEL];
+    int previousLevel = table.skipLevel;
+    findPredecessors(position, update);
+
+    int height = allocateNode(position);
+    if(height == 0)
+        return 0;
+
+    // I livelli appena aperti partono dalla testa
+    for(int level = previousLevel; level < height; level++)
+        update[level] = -1;
+
+    for(int level = 0; level < height; level++) {
+        *skipLink(position, level) = *skipLink(update[level], level);
+        *skipLink(update[level], level) = position;
+    }
+    return 1;
+}
+
+/**
+ * Toglie position dalla skip list, i suoi puntatori in skipPool restano
+ * inutilizzati fino alla prossima ricostruzione
+ */
+static void removeOrdered(int position) {
+    int update[SKIP_MAX_LEVEL];
+    findPredecessors(position, update);
+    for(int level = 0; level < table.skipHeights[position]; level++)
+        if(*skipLink(update[level], level) == position)
+            *skipLink(update[level], level) = *skipLink(position, level);
+}
+
+/**
+ * Inserisce il contatto in posizione position in tutti gli indici
+ *
+ * Restituisce 1 in caso di successo, 0 se la memoria non e' sufficiente
+ */
+static int linkPosition(int position) {
+    linkChain(table.nameBuckets, table.nameNext, table.nameKeys[position], position);
+    linkChain(table.surnameBuckets, table.surnameNext, table.surnameKeys[position], position);
+
+    if(table.suffixReady) {
+        int slot = suffixSlot(position);
+        memmove(&table.phoneSuffixOrder[slot + 1], &table.phoneSuffixOrder[slot], (table.liveCount - slot) * sizeof(int));
+        table.phoneSuffixOrder[slot] = position;
+    }
+
+    table.alive[position] = 1;
+    table.liveCount++;
+    return !table.orderedReady || insertOrdered(position);
+}
+
+/**
+ * Toglie il contatto in posizione position da tutti gli indici
+ */
+static void unlinkPosition(int position) {
+    unlinkChain(table.nameBuckets, table.nameNext, table.nameKeys[position], position);
+    unlinkChain(table.surnameBuckets, table.surnameNext, table.surnameKeys[position], position);
+
+    if(table.suffixReady) {
+        int slot = suffixSlot(position);
+        if(slot < table.liveCount && table.phoneSuffixOrder[slot] == position)
+            memmove(&table.phoneSuffixOrder[slot], &table.phoneSuffixOrder[slot + 1], (table.liveCount - slot - 1) * sizeof(int));
+    }
+
+    if(table.orderedReady)
+        removeOrdered(position);
+    table.alive[position] = 0;
+    table.liveCount--;
+}
+
+/**
+ * File della rubrica (o segmento) letto da un thread durante loadTable
+ *
+ * Campi:
+ *  file - Percorso del file
+ *  data, length - Contenuto letto
+ *  missing - Il file non esiste
+ *  ok - La lettura e' terminata senza errori
+ */
+typedef struct {
+    char file[BOOK_PATH_LENGTH + 16];
+    char *data;
+    ssize_t length;
+    int missing;
+    int ok;
+} segmentLoad;
+
+/**
+ * Legge in memoria tutto il file di segment, eseguita da un thread per ogni segmento
+ *
+ * A differenza di readLine, che esegue una read() per ogni carattere,
+ * leggiamo il file a blocchi; le linee vengono separate dopo, in ordine
+ */
+static void *readSegment(void *argument) {
+    segmentLoad *segment = argument;
+    segment->data = NULL;
+    segment->length = 0;
+    segment->ok = 0;
+
+    int fd = open(segment->file, O_RDONLY);
+    segment->missing = fd < 0 && errno == ENOENT;
+    if(fd < 0)
+        return NULL;
+
+    ssize_t capacity = 0, bytesRead = 1;
+    while(bytesRead > 0) {
+        if(segment->length + LOAD_BUFFER_SIZE > capacity) {
+            char *grown = realloc(segment->data, capacity + 2 * LOAD_BUFFER_SIZE + capacity / 2);
+            if(grown == NULL)
+                break;
+            segment->data = grown;
+            capacity += 2 * LOAD_BUFFER_SIZE + capacity / 2;
+        }
+        bytesRead = read(fd, segment->data + segment->length, LOAD_BUFFER_SIZE);
+        if(bytesRead > 0)
+            segment->length += bytesRead;
+    }
+    segment->ok = bytesRead == 0;
+    close(fd);
+    return NULL;
+}
+
+/**
+ * Aggiunge alla tabella le linee contenute in data
+ *
+ * Restituisce 1 in caso di successo, 0 altrimenti
+ */
+static int appendLines(const char *data, ssize_t length) {
+    char line[3 * CONTACT_STRINGS_LENGTH + 2 + 1];
+    int lineLength = 0, ok = 1;
+
+    for(ssize_t i = 0; ok && i < length; i++) {
+        if(data[i] == '\n') {
+            ok = appendLine(line, lineLength);
+            lineLength = 0;
+        } else if(lineLength < (int)sizeof(line)) {
+            line[lineLength++] = data[i];
+        }
+    }
+
+    // L'ultima linea potrebbe non terminare con \n
+    if(ok && lineLength > 0)
+        ok = appendLine(line, lineLength);
+    return ok;
+}
+
+/**
+ * Rilegge tutta la rubrica nella tabella
+ *
+ * Se la rubrica e' divisa in segmenti ogni segmento viene letto da un thread,
+ * poi le linee vengono aggiunte alla tabella un segmento dopo l'altro
+ * Se nel frattempo la rubrica viene ripartita (un segmento non esiste piu')
+ * la lettura ricomincia dai nuovi segmenti
+ *
+ * Restituisce 1 in caso di successo, 0 altrimenti
+ */
+static int loadTable(void) {
+    segmentLoad segments[MAX_BOOK_SEGMENTS];
+    pthread_t threads[MAX_BOOK_SEGMENTS];
+    int started[MAX_BOOK_SEGMENTS], ok = 0, retry = 1;
+
+    for(int attempt = 0; attempt < LOAD_ATTEMPTS && retry; attempt++) {
+        table.count = 0;
+        table.liveCount = 0;
+        retry = 0;
+        ok = 1;
+
+        unsigned int generation;
+        int segmentCount = getContactBookSegments(getContactBookPath(), &generation);
+        for(int i = 0; i < segmentCount; i++) {
+            getContactBookFile(getContactBookPath(), generation, segmentCount, i, segments[i].file);
+            started[i] = segmentCount > 1 && pthread_create(&threads[i], NULL, readSegment, &segments[i]) == 0;
+            if(!started[i])
+                readSegment(&segments[i]);
+        }
+
+        for(int i = 0; i < segmentCount; i++) {
+            if(started[i])
+                pthread_join(threads[i], NULL);
+
+            // Una rubrica in un unico file inesistente equivale a una rubrica vuota, un segmento mancante no
+            if(segments[i].missing && segmentCount > 1)
+                retry = 1;
+            else if(!segments[i].missing && !segments[i].ok)
+                ok = 0;
+            else if(ok && !retry)
+                ok = appendLines(segments[i].data, segments[i].length);
+            free(segments[i].data);
+        }
+    }
+    return ok && !retry && buildKeyIndex();
+}
+
+int refreshContactIndex(void) {
+    struct stat current;
+    statContactBook(getContactBookPath(), &current);
+
+    /*
+     * Le modifiche alla rubrica avvengono o in append (cambiano dimensione e data)
+     * o riscrivendo un file temporaneo rinominato al posto dell'originale (cambia l'inode)
+     * se nessuna di queste informazioni e' cambiata la tabella e' ancora valida
+     */
+    if(loaded && !strcmp(loadedPath, getContactBookPath()) && current.st_ino == loadedStat.st_ino && current.st_size == loadedStat.st_size
+        && current.st_mtim.tv_sec == loadedStat.st_mtim.tv_sec && current.st_mtim.tv_nsec == loadedStat.st_mtim.tv_nsec)
+        return table.liveCount;
+
+    if(!loadTable()) {
+        loaded = 0;
+        return -1;
+    }
+    loadedStat = current;
+    strcpy(loadedPath, getContactBookPath());
+    loaded = 1;
+    return table.liveCount;
+}
+
+const contactTable *getContactTable(void) {
+    return &table;
+}
+
+const struct stat *getContactIndexStat(void) {
+    return loaded ? &loadedStat : NULL;
+}
+
+/**
+ * Lunghezza della linea della rubrica che contiene il contatto in posizione position
+ */
+static off_t lineLength(int position) {
+    return strlen(table.names[position]) + strlen(table.surnames[position]) + strlen(table.phoneNumbers[position]) + 3;
+}
+
+/**
+ * Controlla che la rubrica sia cambiata come previsto rispetto all'istantanea:
+ * dimensione aumentata di sizeDelta e, se sameFile, stesso inode (scrittura in append)
+ * Se non e' cosi' scarta l'istantanea, che verra' riletta
+ *
+ * Restituisce 1 se l'istantanea puo' essere aggiornata, 0 altrimenti
+ */
+static int expectChange(off_t sizeDelta, int sameFile, struct stat *current) {
+    if(!statContactBook(getContactBookPath(), current) || !loaded
+        || current->st_size != loadedStat.st_size + sizeDelta
+        || (sameFile && current->st_ino != loadedStat.st_ino)) {
+        loaded = 0;
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Raccoglie in matches le posizioni su cui agiscono removeContact e modifyContact:
+ * stesso nome e cognome, numero che inizia con quello di target
+ *
+ * Restituisce il numero di posizioni trovate, -1 se la memoria non e' sufficiente
+ */
+static int collectAffected(Contact target, int **matches) {
+    char nameKey[CONTACT_STRINGS_LENGTH + 1];
+    normalizeKey(target.name, nameKey);
+    int found = 0, capacity = 0, phoneLength = strlen(target.phoneNumber);
+    *matches = NULL;
+
+    // Nome uguale implica chiave uguale, basta percorrere una catena
+    int position = table.bucketCount ? table.nameBuckets[hashKey(nameKey) & (table.bucketCount - 1)] : -1;
+    for(; position != -1; position = table.nameNext[position]) {
+        if(strcmp(table.names[position], target.name) || strcmp(table.surnames[position], target.surname)
+            || strncmp(table.phoneNumbers[position], target.phoneNumber, phoneLength))
+            continue;
+
+        if(found == capacity) {
+            capacity = capacity ? 2 * capacity : 4;
+            if(!resizeColumn(matches, sizeof(int), capacity)) {
+                free(*matches);
+                return -1;
+            }
+        }
+        (*matches)[found++] = position;
+    }
+    return found;
+}
+
+void applyContactAdded(Contact added) {
+    struct stat current;
+    off_t length = strlen(added.name) + strlen(added.surname) + strlen(added.phoneNumber) + 3;
+    if(!expectChange(length, 1, &current))
+        return;
+
+    /*
+     * In una rubrica divisa in segmenti il contatto e' in fondo al suo segmento e non all'ultima
+     * posizione: la tabella va riletta, cosi' l'ordine resta quello degli altri processi
+     */
+    if(getContactBookSegments(getContactBookPath(), NULL) > 1) {
+        loaded = 0;
+        return;
+    }
+    if(!ensureCapacity(table.count + 1)) {
+        loaded = 0;
+        return;
+    }
+
+    // Il contatto e' stato scritto in fondo alla rubrica, occupa quindi l'ultima posizione
+    int position = table.count++;
+    copyField(table.names[position], added.name, strlen(added.name));
+    copyField(table.surnames[position], added.surname, strlen(added.surname));
+    copyField(table.phoneNumbers[position], added.phoneNumber, strlen(added.phoneNumber));
+    computeKeys(position);
+    if(!linkPosition(position)) {
+        loaded = 0;
+        return;
+    }
+    loadedStat = current;
+}
+
+void applyContactRemoved(Contact removed) {
+    int *matches;
+    int found = loaded ? collectAffected(removed, &matches) : -1;
+    if(found < 0) {
+        loaded = 0;
+        return;
+    }
+
+    off_t delta = 0;
+    for(int i = 0; i < found; i++)
+        delta -= lineLength(matches[i]);
+
+    struct stat current;
+    if(expectChange(delta, 0, &current)) {
+
+        // Le posizioni restano occupate, cosi' quelle degli altri contatti non cambiano
+        for(int i = 0; i < found; i++)
+            unlinkPosition(matches[i]);
+        loadedStat = current;
+    }
+    free(matches);
+}
+
+void applyContactModified(Contact old, Contact new) {
+
+    // Se il contatto cambia segmento viene spostato in fondo a quello nuovo, come per applyContactAdded
+    int segments = getContactBookSegments(getContactBookPath(), NULL);
+    if(segments > 1 && contactSegment(old, segments) != contactSegment(new, segments)) {
+        loaded = 0;
+        return;
+    }
+
+    int *matches;
+    int found = loaded ? collectAffected(old, &matches) : -1;
+    if(found < 0) {
+        loaded = 0;
+        return;
+    }
+
+    off_t delta = 0, newLength = strlen(new.name) + strlen(new.surname) + strlen(new.phoneNumber) + 3;
+    for(int i = 0; i < found; i++)
+        delta += newLength - lineLength(matches[i]);
+
+    struct stat current;
+    if(expectChange(delta, 0, &current)) {
+
+        // modifyContact riscrive il contatto al suo posto, la posizione non cambia
+        for(int i = 0; i < found && loaded; i++) {
+            int position = matches[i];
+            unlinkPosition(position);
+            copyField(table.names[position], new.name, strlen(new.name));
+            copyField(table.surnames[position], new.surname, strlen(new.surname));
+            copyField(table.phoneNumbers[position], new.phoneNumber, strlen(new.phoneNumber));
+            computeKeys(position);
+            if(!linkPosition(position))
+                loaded = 0;
+        }
+        if(loaded)
+            loadedStat = current;
+    }
+    free(matches);
+}
+
+/**
+ * Copia il contatto in posizione position della tabella in found
+ */
+static void copyContact(int position, Contact *found) {
+    createEmptyContact(found);
+    strcpy(found->name, table.names[position]);
+    strcpy(found->surname, table.surnames[position]);
+    strcpy(found->phoneNumber, table.phoneNumbers[position]);
+}
+
+/**
+ * Prepara le maschere di bit del pattern per l'algoritmo di Myers
+ * peq[c] ha il bit i acceso se pattern[i] == c
+ */
+static void buildPatternMasks(const char *pattern, int length, unsigned long long peq[256]) {
+    memset(peq, 0, 256 * sizeof(unsigned long long));
+    for(int i = 0; i < length; i++)
+        peq[(unsigned char)pattern[i]] |= 1ULL << i;
+}
+
+/**
+ * Nucleo dell'algoritmo di Myers/Hyyro' per la distanza di Levenshtein
+ *
+ * VP e VN rappresentano le differenze verticali (+1 e -1) della colonna corrente
+ * della matrice delle distanze, ogni carattere del testo aggiorna tutta la
+ * colonna con operazioni bit a bit. score tiene la distanza dell'ultima riga
+ */
+static int myersDistance(const unsigned long long peq[256], int patternLength, const char *text, int textLength, int maxDistance) {
+    unsigned long long mask = patternLength == 64 ? ~0ULL : (1ULL << patternLength) - 1;
+    unsigned long long last = 1ULL << (patternLength - 1);
+    unsigned long long VP = mask, VN = 0;
+    int score = patternLength;
+
+    for(int j = 0; j < textLength; j++) {
+        unsigned long long eq = peq[(unsigned char)text[j]];
+        unsigned long long X = eq | VN;
+        unsigned long long D0 = (((X & VP) + VP) ^ VP) | X;
+        unsigned long long HP = VN | ~(D0 | VP);
+        unsigned long long HN = D0 & VP;
+
+        if(HP & last) score++;
+        if(HN & last) score--;
+
+        // La prima riga della matrice vale j, quindi la differenza orizzontale in cima e' sempre +1
+        HP = (HP << 1) | 1;
+        HN = HN << 1;
+        VP = (HN | ~(D0 | HP)) & mask;
+        VN = HP & D0;
+
+        // Anche nel caso migliore ogni carattere rimasto puo' togliere al massimo 1 alla distanza
+        if(score - (textLength - j - 1) > maxDistance)
+            return maxDistance + 1;
+    }
+    return score <= maxDistance ? score : maxDistance + 1;
+}
+
+int boundedEditDistance(const char *pattern, const char *text, int maxDistance) {
+    int patternLength = strlen(pattern), textLength = strlen(text);
+
+    // La distanza e' almeno pari alla differenza di lunghezza
+    int lengthDifference = patternLength > textLength ? patternLength - textLength : textLength - patternLength;
+    if(lengthDifference > maxDistance)
+        return maxDistance + 1;
+    if(patternLength == 0)
+        return textLength;
+    if(patternLength > 64)
+        return maxDistance + 1;
+
+    unsigned long long peq[256];
+    buildPatternMasks(pattern, patternLength, peq);
+    return myersDistance(peq, patternLength, text, textLength, maxDistance);
+}
+
+/**
+ * Controlla se il campo field dista al massimo maxDistance dal pattern
+ *
+ * Prima di eseguire Myers applichiamo due filtri economici che scartano
+ * la maggior parte dei candidati:
+ *  - La distanza e' almeno la differenza di lunghezza
+ *  - Ogni classe di caratteri presente in una sola delle due stringhe richiede almeno una modifica
+ */
+static int fieldWithin(const unsigned long long peq[256], int patternLength, unsigned int patternMask, const char *field, int fieldLength, unsigned int fieldMask, int maxDistance) {
+    int lengthDifference = patternLength > fieldLength ? patternLength - fieldLength : fieldLength - patternLength;
+    if(lengthDifference > maxDistance)
+        return 0;
+    if(__builtin_popcount(patternMask & ~fieldMask) > maxDistance || __builtin_popcount(fieldMask & ~patternMask) > maxDistance)
+        return 0;
+    return myersDistance(peq, patternLength, field, fieldLength, maxDistance) <= maxDistance;
+}
+
+int findFuzzyContact(Contact asked, int maxDistance, int matchIndex, Contact *found) {
+    if(maxDistance < 0) maxDistance = 0;
+    if(maxDistance > FUZZY_MAX_DISTANCE) maxDistance = FUZZY_MAX_DISTANCE;
+
+    if(refreshContactIndex() < 0)
+        return 0;
+
+    // Confrontiamo le chiavi normalizzate, una maiuscola o un accento sbagliato non contano come errori
+    char nameKey[CONTACT_STRINGS_LENGTH + 1], surnameKey[CONTACT_STRINGS_LENGTH + 1];
+    int nameLength = normalizeKey(asked.name, nameKey), surnameLength = normalizeKey(asked.surname, surnameKey);
+
+    // Le maschere del pattern vengono calcolate una volta sola per tutta la scansione
+    unsigned long long namePeq[256], surnamePeq[256];
+    if(nameLength) buildPatternMasks(nameKey, nameLength, namePeq);
+    if(surnameLength) buildPatternMasks(surnameKey, surnameLength, surnamePeq);
+    unsigned int nameMask = characterMask(nameKey, nameLength), surnameMask = characterMask(surnameKey, surnameLength);
+
+    int foundIndex = 0;
+    for(int i = 0; i < table.count; i++) {
+
+        // Controlliamo prima il numero di telefono, confronto esatto ed economico
+        if(!table.alive[i])
+            continue;
+        if(asked.phoneNumber[0] != '\0' && strcmp(asked.phoneNumber, table.phoneNumbers[i]))
+            continue;
+        if(nameLength && !fieldWithin(namePeq, nameLength, nameMask, table.nameKeys[i], table.nameLengths[i], table.nameMasks[i], maxDistance))
+            continue;
+        if(surnameLength && !fieldWithin(surnamePeq, surnameLength, surnameMask, table.surnameKeys[i], table.surnameLengths[i], table.surnameMasks[i], maxDistance))
+            continue;
+
+        // Abbiamo trovato l'i-esimo contatto che corrisponde ai criteri
+        foundIndex++;
+        if(foundIndex == matchIndex) {
+            copyContact(i, found);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Controlla se il contatto in posizione position corrisponde ai criteri
+ * nameKey e surnameKey sono le chiavi normalizzate di nome e cognome di asked
+ */
+static int positionMatches(int position, const Contact *asked, const char *nameKey, const char *surnameKey, int mode) {
+    if(!table.alive[position])
+        return 0;
+    if(asked->phoneNumber[0] != '\0' && strcmp(asked->phoneNumber, table.phoneNumbers[position]))
+        return 0;
+
+    if(mode == SEARCH_INSENSITIVE) {
+        if(nameKey[0] != '\0' && strcmp(nameKey, table.nameKeys[position]))
+            return 0;
+        if(surnameKey[0] != '\0' && strcmp(surnameKey, table.surnameKeys[position]))
+            return 0;
+    } else {
+        if(asked->name[0] != '\0' && strcmp(asked->name, table.names[position]))
+            return 0;
+        if(asked->surname[0] != '\0' && strcmp(asked->surname, table.surnames[position]))
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * Intervallo di posizioni della tabella controllato da un thread in parallelScan
+ *
+ * Campi:
+ *  asked, nameKey, surnameKey, mode - Criteri di ricerca, come in positionMatches
+ *  from, to - Posizioni da controllare (to esclusa)
+ *  count - Numero di corrispondenze trovate nell'intervallo
+ */
+typedef struct {
+    const Contact *asked;
+    const char *nameKey;
+    const char *surnameKey;
+    int mode;
+    int from;
+    int to;
+    int count;
+} scanRange;
+
+/**
+ * Conta le corrispondenze di un intervallo, eseguita da un thread per ogni intervallo
+ */
+static void *countRange(void *argument) {
+    scanRange *range = argument;
+    range->count = 0;
+    for(int position = range->from; position < range->to; position++) {
+        if(positionMatches(position, range->asked, range->nameKey, range->surnameKey, range->mode))
+            range->count++;
+    }
+    return NULL;
+}
+
+/**
+ * Come scanContacts quando bisogna scorrere tutta la rubrica, ma dividendola in SCAN_THREADS
+ * intervalli contati in parallelo: poi si cercano in ordine la matchIndex-esima corrispondenza
+ * (o le prime maxCollected) solo negli intervalli che le contengono
+ */
+static int parallelScan(const Contact *asked, const char *nameKey, const char *surnameKey, int mode, int matchIndex, Contact *found, Contact *collected, int maxCollected) {
+    scanRange ranges[SCAN_THREADS];
+    pthread_t threads[SCAN_THREADS];
+    int started[SCAN_THREADS], step = (table.count + SCAN_THREADS - 1) / SCAN_THREADS;
+
+    for(int t = 0; t < SCAN_THREADS; t++) {
+        ranges[t].asked = asked;
+        ranges[t].nameKey = nameKey;
+        ranges[t].surnameKey = surnameKey;
+        ranges[t].mode = mode;
+        ranges[t].from = t * step < table.count ? t * step : table.count;
+        ranges[t].to = (t + 1) * step < table.count ? (t + 1) * step : table.count;
+        started[t] = pthread_create(&threads[t], NULL, countRange, &ranges[t]) == 0;
+        if(!started[t])
+            countRange(&ranges[t]);
+    }
+    for(int t = 0; t < SCAN_THREADS; t++) {
+        if(started[t])
+            pthread_join(threads[t], NULL);
+    }
+
+    int foundIndex = 0;
+    for(int t = 0; t < SCAN_THREADS; t++) {
+        int needed = ranges[t].count > 0 && (matchIndex > 0 ? foundIndex + ranges[t].count >= matchIndex : foundIndex < maxCollected);
+        for(int position = ranges[t].from, seen = foundIndex; needed && position < ranges[t].to; position++) {
+            if(!positionMatches(position, asked, nameKey, surnameKey, mode))
+                continue;
+            if(seen < maxCollected)
+                copyContact(position, &collected[seen]);
+            seen++;
+            if(seen == matchIndex) {
+                copyContact(position, found);
+                return seen;
+            }
+            if(matchIndex <= 0 && seen >= maxCollected)
+                break;
+        }
+        foundIndex += ranges[t].count;
+    }
+    return foundIndex;
+}
+
+/**
+ * Percorre i contatti che corrispondono ai criteri di asked, nell'ordine della rubrica
+ *
+ * Se matchIndex e' maggiore di 0 si ferma alla matchIndex-esima corrispondenza
+ * e la copia in found, altrimenti le conta tutte copiando le prime maxCollected in collected
+ *
+ * Restituisce il numero di corrispondenze incontrate
+ */
+static int scanContacts(Contact asked, int mode, int matchIndex, Contact *found, Contact *collected, int maxCollected) {
+
+    // La query viene normalizzata una volta sola
+    char nameKey[CONTACT_STRINGS_LENGTH + 1], surnameKey[CONTACT_STRINGS_LENGTH + 1];
+    normalizeKey(asked.name, nameKey);
+    normalizeKey(asked.surname, surnameKey);
+
+    /*
+     * Scegliamo da dove prendere i candidati:
+     *  - Se e' specificato il nome (o il cognome) percorriamo la catena del suo bucket,
+     *    che contiene tutti i contatti con la stessa chiave normalizzata (piu' eventuali collisioni)
+     *  - Altrimenti percorriamo tutta la rubrica
+     * Anche la ricerca esatta usa la catena: due campi uguali hanno sempre la stessa chiave
+     */
+    int position = table.count > 0 ? 0 : -1;
+    const int *next = NULL;
+    if(nameKey[0] != '\0') {
+        position = table.nameBuckets[hashKey(nameKey) & (table.bucketCount - 1)];
+        next = table.nameNext;
+    } else if(surnameKey[0] != '\0') {
+        position = table.surnameBuckets[hashKey(surnameKey) & (table.bucketCount - 1)];
+        next = table.surnameNext;
+    } else if(table.count >= PARALLEL_SCAN_MIN_CONTACTS) {
+        return parallelScan(&asked, nameKey, surnameKey, mode, matchIndex, found, collected, maxCollected);
+    }
+
+    int foundIndex = 0;
+    while(position != -1) {
+        if(positionMatches(position, &asked, nameKey, surnameKey, mode)) {
+            if(foundIndex < maxCollected)
+                copyContact(position, &collected[foundIndex]);
+            foundIndex++;
+            if(foundIndex == matchIndex) {
+                copyContact(position, found);
+                return foundIndex;
+            }
+        }
+
+        if(next != NULL)
+            position = next[position];
+        else
+            position = position + 1 < table.count ? position + 1 : -1;
+    }
+    return foundIndex;
+}
+
+int findContact(Contact asked, int mode, int matchIndex, Contact *found) {
+    if(matchIndex <= 0 || refreshContactIndex() < 0)
+        return 0;
+    return scanContacts(asked, mode, matchIndex, found, NULL, 0) == matchIndex;
+}
+
+/**
+ * Cerca in phoneSuffixOrder la prima posizione la cui chiave, limitata
+ * ai primi length caratteri, e' maggiore (strict = 1) o maggiore o uguale
+ * (strict = 0) di reversed
+ */
+static int suffixBound(const char *reversed, int length, int strict) {
+    int low = 0, high = table.liveCount;
+    while(low < high) {
+        int middle = low + (high - low) / 2;
+        int result = strncmp(table.phoneSuffixKeys[table.phoneSuffixOrder[middle]], reversed, length);
+        if(result < 0 || (strict && result == 0))
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+/**
+ * Conta i contatti con numero phoneNumber sull'indice dei suffissi: la chiave intera
+ * (terminatore compreso) delimita i numeri con le stesse cifre, che confrontiamo per esteso
+ */
+static int countPhoneNumber(const char *phoneNumber) {
+    if(!table.suffixReady)
+        buildSuffixIndex();
+
+    char reversed[CONTACT_STRINGS_LENGTH + 1];
+    int length = reverseDigits(phoneNumber, reversed);
+    int last = suffixBound(reversed, length + 1, 1), counted = 0;
+    for(int i = suffixBound(reversed, length + 1, 0); i < last; i++)
+        if(!strcmp(table.phoneNumbers[table.phoneSuffixOrder[i]], phoneNumber))
+            counted++;
+    return counted;
+}
+
+int countContacts(Contact asked, int mode) {
+    if(refreshContactIndex() < 0)
+        return -1;
+
+    // Senza criteri la risposta e' gia' nota, con il solo numero basta l'indice dei suffissi
+    if(isContactEmpty(asked))
+        return table.liveCount;
+    if(asked.name[0] == '\0' && asked.surname[0] == '\0')
+        return countPhoneNumber(asked.phoneNumber);
+    return scanContacts(asked, mode, 0, NULL, NULL, 0);
+}
+
+int collectContacts(Contact asked, int mode, Contact *collected, int maxCollected) {
+    if(refreshContactIndex() < 0)
+        return -1;
+    return scanContacts(asked, mode, 0, NULL, collected, maxCollected);
+}
+
+/**
+ * Come scanContacts, ma percorre solo i contatti il cui numero termina con le cifre di asked.phoneNumber
+ * (nell'ordine di phoneSuffixOrder)
+ */
+static int scanPhoneSuffix(Contact asked, int mode, int matchIndex, Contact *found) {
+    if(!table.suffixReady)
+        buildSuffixIndex();
+
+    // Il suffisso letto al contrario e' un prefisso delle chiavi
+    char reversed[CONTACT_STRINGS_LENGTH + 1];
+    int length = reverseDigits(asked.phoneNumber, reversed);
+
+    // I numeri con quel suffisso occupano un intervallo contiguo dell'ordinamento
+    int first = suffixBound(reversed, length, 0);
+    int last = suffixBound(reversed, length, 1);
+
+    // Senza altri criteri la corrispondenza (o il loro numero) si trova direttamente
+    if(asked.name[0] == '\0' && asked.surname[0] == '\0') {
+        if(matchIndex <= 0 || matchIndex > last - first)
+            return last - first;
+        copyContact(table.phoneSuffixOrder[first + matchIndex - 1], found);
+        return matchIndex;
+    }
+
+    // Altrimenti filtriamo l'intervallo su nome e cognome, il numero e' gia' stato controllato
+    char nameKey[CONTACT_STRINGS_LENGTH + 1], surnameKey[CONTACT_STRINGS_LENGTH + 1];
+    normalizeKey(asked.name, nameKey);
+    normalizeKey(asked.surname, surnameKey);
+    asked.phoneNumber[0] = '\0';
+
+    int foundIndex = 0;
+    for(int i = first; i < last; i++) {
+        if(positionMatches(table.phoneSuffixOrder[i], &asked, nameKey, surnameKey, mode)) {
+            foundIndex++;
+            if(foundIndex == matchIndex) {
+                copyContact(table.phoneSuffixOrder[i], found);
+                return foundIndex;
+            }
+        }
+    }
+    return foundIndex;
+}
+
+int findContactByPhoneSuffix(Contact asked, int mode, int matchIndex, Contact *found) {
+    if(matchIndex <= 0 || refreshContactIndex() < 0)
+        return 0;
+    return scanPhoneSuffix(asked, mode, matchIndex, found) == matchIndex;
+}
+
+int countContactsByPhoneSuffix(Contact asked, int mode) {
+    if(refreshContactIndex() < 0)
+        return -1;
+    return scanPhoneSuffix(asked, mode, 0, NULL);
+}
+
+/**
+ * Confronta il contatto in posizione position con un estremo dell'intervallo,
+ * nello stesso ordine di compareOrdered, fermandosi al primo campo vuoto dell'estremo
+ */
+static int compareBound(int position, const Contact *bound, const char *nameKey, const char *surnameKey) {
+    if(surnameKey[0] == '\0')
+        return 0;
+    int result = strcmp(table.surnameKeys[position], surnameKey);
+    if(result != 0 || nameKey[0] == '\0')
+        return result;
+    result = strcmp(table.nameKeys[position], nameKey);
+    if(result != 0 || bound->phoneNumber[0] == '\0')
+        return result;
+    result = strcmp(table.phoneNumbers[position], bound->phoneNumber);
+    if(result == 0) result = strcmp(table.surnames[position], bound->surname);
+    if(result == 0) result = strcmp(table.names[position], bound->name);
+    return result;
+}
+
+int findOrderedContact(Contact from, Contact to, int matchIndex, Contact *found) {
+    if(matchIndex <= 0 || refreshContactIndex() < 0)
+        return 0;
+    if(!table.orderedReady && !buildOrderedIndex())
+        return 0;
+
+    char fromName[CONTACT_STRINGS_LENGTH + 1], fromSurname[CONTACT_STRINGS_LENGTH + 1];
+    char toName[CONTACT_STRINGS_LENGTH + 1], toSurname[CONTACT_STRINGS_LENGTH + 1];
+    normalizeKey(from.name, fromName);
+    normalizeKey(from.surname, fromSurname);
+    normalizeKey(to.name, toName);
+    normalizeKey(to.surname, toSurname);
+
+    // Scendiamo la skip list fino all'ultimo contatto che precede from
+    int current = -1;
+    for(int level = table.skipLevel - 1; level >= 0; level--)
+        while(*skipLink(current, level) != -1 && compareBound(*skipLink(current, level), &from, fromName, fromSurname) < 0)
+            current = *skipLink(current, level);
+
+    // Dal primo contatto dell'intervallo avanziamo fino al matchIndex-esimo
+    int position = *skipLink(current, 0);
+    for(int i = 1; i < matchIndex && position != -1; i++)
+        position = *skipLink(position, 0);
+
+    // I contatti sono ordinati, se il matchIndex-esimo non supera to nemmeno i precedenti lo fanno
+    if(position == -1 || compareBound(position, &to, toName, toSurname) > 0)
+        return 0;
+
+    copyContact(position, found);
+    return 1;
+}
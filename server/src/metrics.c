@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2024 Biribo' Francesco, Giannuzzi Riccardo, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "./../include/metrics.h"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Metriche mappate in memoria, NULL se non disponibili
+static serverMetrics *metrics = NULL;
+
+/**
+ * Mappa in lettura e scrittura il file delle metriche aperto in fd, che viene chiuso
+ *
+ * Restituisce la mappatura, NULL in caso di errore
+ */
+static serverMetrics *mapMetrics(int fd) {
+    void *mapped = mmap(NULL, sizeof(serverMetrics), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return mapped == MAP_FAILED ? NULL : mapped;
+}
+
+int initMetrics(void) {
+
+    // Le metriche di un altro server avviato nella stessa cartella restano nel suo file, che viene solo scollegato
+    umask(0);
+    unlink(METRICS_PATH);
+    int fd = open(METRICS_PATH, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if(fd < 0)
+        return 0;
+
+    // Il file parte azzerato, della dimensione della struttura
+    if(ftruncate(fd, sizeof(serverMetrics)) < 0) {
+        close(fd);
+        return 0;
+    }
+    metrics = mapMetrics(fd);
+    if(metrics == NULL)
+        return 0;
+    metrics->format = METRICS_FORMAT;
+    metrics->started = time(NULL);
+    return 1;
+}
+
+int attachMetrics(void) {
+    int fd = open(METRICS_PATH, O_RDWR);
+    if(fd < 0)
+        return 0;
+
+    struct stat info;
+    if(fstat(fd, &info) < 0 || info.st_size < (off_t)sizeof(serverMetrics)) {
+        close(fd);
+        return 0;
+    }
+    metrics = mapMetrics(fd);
+    return metrics != NULL && metrics->format == METRICS_FORMAT;
+}
+
+int metricsSlot(char operation) {
+    const char *found = operation != '\0' ? strchr(METRICS_OPERATIONS, operation) : NULL;
+    return found != NULL ? (int)(found - METRICS_OPERATIONS) : METRICS_INVALID;
+}
+
+const char *metricsOperationName(int slot) {
+    static const char *names[METRICS_SLOTS] = {"READ", "AUTH", "FUZZY_READ", "ADD", "DEL", "MODIFY", "INT",
+        "INSENSITIVE_READ", "SUFFIX_READ", "ORDERED_READ", "COUNT", "SUBSCRIBE", "SYNC_SINCE", "REPLICATE", "invalid"};
+    return slot >= 0 && slot < METRICS_SLOTS ? names[slot] : names[METRICS_INVALID];
+}
+
+int metricsBucket(unsigned long latencyUs) {
+
+    // Sotto METRICS_SUB_BUCKETS un intervallo per ogni valore
+    if(latencyUs < METRICS_SUB_BUCKETS)
+        return (int)latencyUs;
+
+    // Altrimenti la potenza di due sceglie il gruppo e i bit successivi al piu' alto l'intervallo nel gruppo
+    int highest = 63 - __builtin_clzl(latencyUs);
+    int shift = highest - METRICS_SUB_BITS;
+    int bucket = METRICS_SUB_BUCKETS * (shift + 1) + (int)((latencyUs >> shift) - METRICS_SUB_BUCKETS);
+    return bucket < METRICS_BUCKETS ? bucket : METRICS_BUCKETS - 1;
+}
+
+/**
+ * Restituisce il valore piu' alto che cade nell'intervallo bucket
+ */
+static unsigned long bucketUpperBound(int bucket) {
+    if(bucket < METRICS_SUB_BUCKETS)
+        return bucket;
+    int shift = bucket / METRICS_SUB_BUCKETS - 1;
+    unsigned long lower = (unsigned long)(METRICS_SUB_BUCKETS + bucket % METRICS_SUB_BUCKETS) << shift;
+    return lower + (1UL << shift) - 1;
+}
+
+void recordRequest(char operation, char outcome, unsigned long latencyUs) {
+    if(metrics == NULL)
+        return;
+
+    // Ogni contatore e' incrementato atomicamente: le sessioni non si aspettano a vicenda
+    latencyHistogram *histogram = &metrics->operations[metricsSlot(operation)];
+    __atomic_fetch_add(&histogram->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram->totalUs, latencyUs, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram->buckets[metricsBucket(latencyUs)], 1, __ATOMIC_RELAXED);
+
+    // Il massimo si aggiorna solo se nel frattempo nessuno ne ha scritto uno piu' alto
+    unsigned long max = __atomic_load_n(&histogram->maxUs, __ATOMIC_RELAXED);
+    while(latencyUs > max && !__atomic_compare_exchange_n(&histogram->maxUs, &max, latencyUs, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    const char *found = outcome != '\0' ? strchr(METRICS_OUTCOMES, outcome) : NULL;
+    int outcomeSlot = found != NULL ? (int)(found - METRICS_OUTCOMES) : METRICS_OUTCOME_SLOTS - 1;
+    __atomic_fetch_add(&metrics->outcomes[outcomeSlot], 1, __ATOMIC_RELAXED);
+}
+
+int readMetrics(serverMetrics *copy) {
+    int fd = open(METRICS_PATH, O_RDONLY);
+    if(fd < 0)
+        return 0;
+
+    struct stat info;
+    if(fstat(fd, &info) < 0 || info.st_size < (off_t)sizeof(serverMetrics)) {
+        close(fd);
+        return 0;
+    }
+    serverMetrics *mapped = mmap(NULL, sizeof(serverMetrics), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED)
+        return 0;
+
+    *copy = *mapped;
+    munmap(mapped, sizeof(serverMetrics));
+    return copy->format == METRICS_FORMAT;
+}
+
+unsigned long metricsPercentile(const latencyHistogram *histogram, double percentile) {
+
+    // Il conteggio viene ricalcolato dagli intervalli, che possono essere piu' avanti di count durante la lettura
+    unsigned long total = 0;
+    for(int i = 0; i < METRICS_BUCKETS; i++)
+        total += histogram->buckets[i];
+    if(total == 0)
+        return 0;
+
+    unsigned long wanted = (unsigned long)(percentile * total + 0.5), seen = 0;
+    if(wanted < 1)
+        wanted = 1;
+    int i;
+    for(i = 0; i < METRICS_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if(seen >= wanted)
+            break;
+    }
+
+    // L'estremo dell'intervallo puo' superare la latenza piu' alta davvero misurata
+    unsigned long bound = bucketUpperBound(i < METRICS_BUCKETS ? i : METRICS_BUCKETS - 1);
+    return histogram->maxUs > 0 && bound > histogram->maxUs ? histogram->maxUs : bound;
+}
@@ -0,0 +1,400 @@
+/*
+ * Copyright (c) 2024 Biribo' Francesco, Giannuzzi Riccardo, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "./../include/utility.h"
+#include "./../include/contactIndex.h"
+#include "./../include/queryCache.h"
+#include "./../include/changeFeed.h"
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * Risultato di una lettura salvato in cache
+ *
+ * Campi:
+ *  used - Indica se la posizione contiene un risultato
+ *  mode - Modalita' di confronto della lettura (SEARCH_EXACT o SEARCH_INSENSITIVE)
+ *  criteria - Criteri di ricerca
+ *  matchCount - Numero totale di corrispondenze
+ *  matches - Prime corrispondenze, nell'ordine della rubrica
+ *  lastUse - Istante (logico) dell'ultimo utilizzo, per scegliere quale risultato sostituire
+ */
+typedef struct {
+    int used;
+    int mode;
+    Contact criteria;
+    int matchCount;
+    Contact matches[CACHE_MAX_MATCHES];
+    unsigned long lastUse;
+} cacheEntry;
+
+/**
+ * Contenuto del file condiviso
+ *
+ * Campi:
+ *  lock - Mutex condiviso tra i processi
+ *  inode, size, mtime - Rubrica a cui si riferiscono i risultati salvati
+ *  stats - Contatori
+ *  clock - Istante logico, incrementato a ogni utilizzo
+ *  entries - Risultati, CACHE_WAYS consecutivi per ogni insieme
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    ino_t inode;
+    off_t size;
+    struct timespec mtime;
+    queryCacheStats stats;
+    unsigned long clock;
+    cacheEntry entries[CACHE_SETS * CACHE_WAYS];
+} sharedCache;
+
+// Cache mappata in memoria, NULL se non disponibile
+static sharedCache *cache = NULL;
+
+// Lock del file della rubrica preso da beginContactChange (esclude anche reshardContactBook)
+static int bookLock = -1;
+
+int initQueryCache(void) {
+
+    /*
+     * Un altro server avviato nella stessa cartella potrebbe usare ancora il file: svuotandolo
+     * gli azzereremmo il mutex mentre lo possiede, creandone uno nuovo conserva la sua cache
+     */
+    umask(0);
+    unlink("files/cache.dat");
+    int fd = open("files/cache.dat", O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if(fd < 0)
+        return 0;
+
+    // Il file parte vuoto (tutti i risultati non usati) della dimensione della struttura
+    if(ftruncate(fd, sizeof(sharedCache)) < 0) {
+        close(fd);
+        return 0;
+    }
+    void *mapped = mmap(NULL, sizeof(sharedCache), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED)
+        return 0;
+
+    /*
+     * Il mutex e' condiviso tra processi e robusto: se un processo termina
+     * mentre lo possiede, il successivo che lo acquisisce ne viene informato
+     */
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&((sharedCache *)mapped)->lock, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+
+    cache = mapped;
+    return 1;
+}
+
+int attachQueryCache(void) {
+    int fd = open("files/cache.dat", O_RDWR);
+    if(fd < 0)
+        return 0;
+
+    struct stat info;
+    if(fstat(fd, &info) < 0 || info.st_size < (off_t)sizeof(sharedCache)) {
+        close(fd);
+        return 0;
+    }
+    void *mapped = mmap(NULL, sizeof(sharedCache), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED)
+        return 0;
+    cache = mapped;
+    return 1;
+}
+
+/**
+ * Acquisisce il lock della cache
+ *
+ * Se il processo che lo possedeva e' terminato durante un'operazione la cache
+ * potrebbe essere incoerente, quindi scartiamo tutti i risultati
+ */
+static void lockCache(void) {
+    if(pthread_mutex_lock(&cache->lock) == EOWNERDEAD) {
+        for(int i = 0; i < CACHE_SETS * CACHE_WAYS; i++)
+            cache->entries[i].used = 0;
+        cache->inode = 0;
+        pthread_mutex_consistent(&cache->lock);
+    }
+}
+
+static void unlockCache(void) {
+    pthread_mutex_unlock(&cache->lock);
+}
+
+/**
+ * Controlla se info descrive la stessa rubrica a cui si riferiscono i risultati
+ */
+static int sameBook(const struct stat *info) {
+    return info->st_ino == cache->inode && info->st_size == cache->size
+        && info->st_mtim.tv_sec == cache->mtime.tv_sec && info->st_mtim.tv_nsec == cache->mtime.tv_nsec;
+}
+
+/**
+ * Associa la cache alla rubrica descritta da info
+ */
+static void setBook(const struct stat *info) {
+    cache->inode = info->st_ino;
+    cache->size = info->st_size;
+    cache->mtime = info->st_mtim;
+}
+
+/**
+ * Scarta tutti i risultati, usato quando la rubrica e' cambiata
+ * senza passare da beginContactChange/endContactChange
+ */
+static void flushCache(void) {
+    for(int i = 0; i < CACHE_SETS * CACHE_WAYS; i++) {
+        if(cache->entries[i].used) {
+            cache->entries[i].used = 0;
+            cache->stats.invalidations++;
+        }
+    }
+}
+
+/**
+ * Calcola l'insieme della cache in cui si trova il risultato dei criteri asked (FNV-1a)
+ */
+static int cacheSet(const Contact *asked, int mode) {
+    unsigned int hash = 2166136261U ^ (unsigned int)mode;
+    const char *fields[3] = {asked->name, asked->surname, asked->phoneNumber};
+    for(int f = 0; f < 3; f++) {
+        for(int i = 0; fields[f][i] != '\0'; i++) {
+            hash ^= (unsigned char)fields[f][i];
+            hash *= 16777619U;
+        }
+        hash ^= ',';
+        hash *= 16777619U;
+    }
+    return hash % CACHE_SETS;
+}
+
+/**
+ * Cerca nell'insieme set il risultato dei criteri asked
+ *
+ * Restituisce il risultato, NULL se non presente
+ */
+static cacheEntry *findEntry(int set, const Contact *asked, int mode) {
+    for(int way = 0; way < CACHE_WAYS; way++) {
+        cacheEntry *entry = &cache->entries[set * CACHE_WAYS + way];
+        if(entry->used && entry->mode == mode && !strcmp(entry->criteria.name, asked->name)
+            && !strcmp(entry->criteria.surname, asked->surname) && !strcmp(entry->criteria.phoneNumber, asked->phoneNumber))
+            return entry;
+    }
+    return NULL;
+}
+
+int findContactCached(Contact asked, int mode, int matchIndex, Contact *found) {
+    if(cache == NULL || !isSharedContactBook())
+        return findContact(asked, mode, matchIndex, found);
+    if(matchIndex <= 0)
+        return 0;
+
+    int set = cacheSet(&asked, mode), result = -1;
+    struct stat current;
+    memset(&current, 0, sizeof(current));
+
+    // Lo stato della rubrica va letto con il lock, una modifica in corso lo possiede fino alla fine
+    lockCache();
+    statContactBook(SHARED_BOOK_PATH, &current);
+
+    // La rubrica e' stata cambiata dall'esterno, nessun risultato e' piu' affidabile
+    if(!sameBook(&current)) {
+        flushCache();
+        setBook(&current);
+    }
+
+    // Rispondiamo se la corrispondenza e' tra quelle salvate o se sappiamo che non esiste
+    cacheEntry *entry = findEntry(set, &asked, mode);
+    if(entry != NULL && (matchIndex <= CACHE_MAX_MATCHES || entry->matchCount < matchIndex)) {
+        result = matchIndex <= entry->matchCount;
+        if(result)
+            *found = entry->matches[matchIndex - 1];
+        entry->lastUse = ++cache->clock;
+        cache->stats.hits++;
+    } else {
+        cache->stats.misses++;
+    }
+    unlockCache();
+
+    if(result >= 0)
+        return result;
+
+    // Le corrispondenze oltre quelle che possiamo salvare vengono cercate direttamente
+    if(matchIndex > CACHE_MAX_MATCHES)
+        return findContact(asked, mode, matchIndex, found);
+
+    // Cerchiamo nella rubrica raccogliendo le prime corrispondenze e il loro numero
+    Contact matches[CACHE_MAX_MATCHES];
+    int matchCount = collectContacts(asked, mode, matches, CACHE_MAX_MATCHES);
+    if(matchCount < 0)
+        return 0;
+
+    lockCache();
+
+    /*
+     * Salviamo il risultato solo se e' stato calcolato sulla rubrica a cui si
+     * riferisce la cache: se nel frattempo e' cambiata il risultato potrebbe
+     * essere gia' vecchio
+     */
+    const struct stat *snapshot = getContactIndexStat();
+    if(snapshot != NULL && sameBook(snapshot) && findEntry(set, &asked, mode) == NULL) {
+
+        // Sostituiamo il risultato usato meno di recente dell'insieme
+        cacheEntry *victim = &cache->entries[set * CACHE_WAYS];
+        for(int way = 1; way < CACHE_WAYS && victim->used; way++) {
+            cacheEntry *candidate = &cache->entries[set * CACHE_WAYS + way];
+            if(!candidate->used || candidate->lastUse < victim->lastUse)
+                victim = candidate;
+        }
+
+        victim->used = 1;
+        victim->mode = mode;
+        victim->criteria = asked;
+        victim->matchCount = matchCount;
+        memcpy(victim->matches, matches, (matchCount < CACHE_MAX_MATCHES ? matchCount : CACHE_MAX_MATCHES) * sizeof(Contact));
+        victim->lastUse = ++cache->clock;
+    }
+    unlockCache();
+
+    if(matchIndex > matchCount)
+        return 0;
+    *found = matches[matchIndex - 1];
+    return 1;
+}
+
+void beginContactChange(void) {
+
+    // Le rubriche personali non passano dalla cache, basta non sovrapporsi alle altre modifiche della stessa rubrica
+    if(cache == NULL || !isSharedContactBook()) {
+        bookLock = lockContactBook();
+        return;
+    }
+
+    // Il lock del file segue sempre quello della cache, chi ripartisce la rubrica prende solo il primo
+    lockCache();
+    bookLock = lockContactBook();
+
+    // Se la rubrica e' gia' cambiata dall'esterno i risultati salvati non sono piu' affidabili
+    struct stat current;
+    memset(&current, 0, sizeof(current));
+    statContactBook(SHARED_BOOK_PATH, &current);
+    if(!sameBook(&current)) {
+        flushCache();
+        setBook(&current);
+    }
+}
+
+/**
+ * Confronta un campo dei criteri con quello di un contatto secondo mode
+ */
+static int fieldMatches(const char *criteria, const char *field, int mode) {
+    if(criteria[0] == '\0')
+        return 1;
+    if(mode == SEARCH_EXACT)
+        return !strcmp(criteria, field);
+
+    char criteriaKey[CONTACT_STRINGS_LENGTH + 1], fieldKey[CONTACT_STRINGS_LENGTH + 1];
+    normalizeKey(criteria, criteriaKey);
+    normalizeKey(field, fieldKey);
+    return !strcmp(criteriaKey, fieldKey);
+}
+
+int searchAffected(Contact asked, int mode, Contact changed, int phonePrefix) {
+    if(!fieldMatches(asked.name, changed.name, mode) || !fieldMatches(asked.surname, changed.surname, mode))
+        return 0;
+
+    const char *phone = asked.phoneNumber;
+    if(phone[0] == '\0')
+        return 1;
+    if(phonePrefix)
+        return !strncmp(phone, changed.phoneNumber, strlen(changed.phoneNumber));
+    return !strcmp(phone, changed.phoneNumber);
+}
+
+int isReadUnchanged(Contact asked, int mode, unsigned int since) {
+    if(!isSharedContactBook())
+        return 0;
+
+    // Modifiche avvenute dopo la risposta in possesso del client (tutte, se alcune non sono piu' nella coda)
+    contactChange changes[FEED_SIZE];
+    int count = readContactChanges(since, changes, FEED_SIZE);
+    if(count < 0 || !isFeedInSync())
+        return 0;
+
+    for(int i = 0; i < count; i++) {
+        if(changes[i].operation == 0) // Riavvio del server
+            return 0;
+        if((!isContactEmpty(changes[i].old) && searchAffected(asked, mode, changes[i].old, 1))
+            || (!isContactEmpty(changes[i].new) && searchAffected(asked, mode, changes[i].new, 0)))
+            return 0;
+    }
+    return 1;
+}
+
+void endContactChange(Contact removed, Contact added) {
+    if(cache == NULL || !isSharedContactBook()) {
+        unlockContactBook(bookLock);
+        bookLock = -1;
+        return;
+    }
+
+    /*
+     * I risultati si riferiscono alla rubrica prima della modifica (controllato da
+     * beginContactChange), basta scartare quelli che possono contenere il contatto coinvolto
+     */
+    for(int i = 0; i < CACHE_SETS * CACHE_WAYS; i++) {
+        cacheEntry *entry = &cache->entries[i];
+        if(entry->used && ((!isContactEmpty(removed) && searchAffected(entry->criteria, entry->mode, removed, 1))
+            || (!isContactEmpty(added) && searchAffected(entry->criteria, entry->mode, added, 0)))) {
+            entry->used = 0;
+            cache->stats.invalidations++;
+        }
+    }
+
+    // I risultati rimasti sono validi anche per la rubrica modificata
+    struct stat current;
+    memset(&current, 0, sizeof(current));
+    statContactBook(SHARED_BOOK_PATH, &current);
+    setBook(&current);
+    unlockContactBook(bookLock);
+    bookLock = -1;
+    unlockCache();
+}
+
+int getQueryCacheStats(queryCacheStats *stats) {
+    int fd = open("files/cache.dat", O_RDONLY);
+    if(fd < 0)
+        return 0;
+
+    struct stat info;
+    if(fstat(fd, &info) < 0 || info.st_size < (off_t)sizeof(sharedCache)) {
+        close(fd);
+        return 0;
+    }
+    sharedCache *mapped = mmap(NULL, sizeof(sharedCache), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED)
+        return 0;
+
+    // Lettura senza lock: i contatori possono essere leggermente disallineati tra loro
+    *stats = mapped->stats;
+    munmap(mapped, sizeof(sharedCache));
+    return 1;
+}
@@ -0,0 +1,363 @@
+/*
+ * Copyright (c) 2024 Biribo' Francesco, Giannuzzi Riccardo, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "./../include/utility.h"
+#include "./../include/log.h"
+#include "./../include/connection.h"
+#include "./../include/contactIndex.h"
+#include "./../include/queryCache.h"
+#include "./../include/changeFeed.h"
+#include "./../include/replica.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+/**
+ * replica - 1 se il server e' una replica
+ * primaryHost, primaryPort, primaryAddress - Indirizzo del primario
+ *
+ * Vengono impostate prima delle fork, i processi delle sessioni le ereditano
+ */
+static int replica = 0;
+static char primaryHost[AUTH_PARAM_LENGTH + 1];
+static int primaryPort;
+static struct sockaddr_in primaryAddress;
+
+/**
+ * follower - Processo che segue il primario, 0 se non avviato (solo nel server)
+ * stopFollowing - Impostata da SIGTERM nel processo che segue il primario, che termina
+ *                 dopo aver finito di applicare la modifica in corso
+ */
+static pid_t follower = 0;
+static volatile sig_atomic_t stopFollowing = 0;
+
+/**
+ * Handler di SIGTERM del processo che segue il primario
+ */
+static void stopFollowingHandler(int sig) {
+    (void)sig;
+    stopFollowing = 1;
+}
+
+int isReplica(void) {
+    return replica;
+}
+
+void redirectToPrimary(serverPacket *packet) {
+    packet->outcome = REDIRECT;
+    memset(packet->username, '\0', AUTH_PARAM_LENGTH + 1);
+    strcpy(packet->username, primaryHost);
+    packet->matchIndex = primaryPort;
+}
+
+void clearReplicaStatus(void) {
+    unlink(REPLICA_STATUS_PATH);
+}
+
+/**
+ * Salva status nel file di stato, sostituendolo con una rename
+ * (chi lo legge trova sempre uno stato completo)
+ */
+static void saveReplicaStatus(const replicaStatus *status) {
+    char line[128], tmpPath[] = REPLICA_STATUS_PATH ".tmp";
+    sprintf(line, "%s %d %u %u %d %ld\n", status->primaryHost, status->primaryPort, status->applied,
+        status->primaryVersion, status->connected, (long)status->updated);
+    umask(0);
+    int fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if(fd < 0)
+        return;
+    int ok = write(fd, line, strlen(line)) == (ssize_t)strlen(line);
+    close(fd);
+    if(ok)
+        rename(tmpPath, REPLICA_STATUS_PATH);
+}
+
+int readReplicaStatus(replicaStatus *status) {
+    char line[128];
+    memset(line, '\0', sizeof(line));
+    memset(status, 0, sizeof(replicaStatus));
+    int fd = open(REPLICA_STATUS_PATH, O_RDONLY);
+    if(fd < 0)
+        return 0;
+    int ok = read(fd, line, sizeof(line) - 1) > 0;
+    close(fd);
+
+    long updated;
+    ok = ok && sscanf(line, "%20s %d %u %u %d %ld", status->primaryHost, &status->primaryPort, &status->applied,
+        &status->primaryVersion, &status->connected, &updated) == 6;
+    status->updated = ok ? (time_t)updated : 0;
+    return ok;
+}
+
+void getReplicaLag(const replicaStatus *status, unsigned int *ops, unsigned long *bytes) {
+    *ops = status->primaryVersion > status->applied ? status->primaryVersion - status->applied : 0;
+    *bytes = (unsigned long)*ops * sizeof(contactChange);
+}
+
+/**
+ * Legge dal primario un pacchetto intero, anche se arriva in piu' parti
+ *
+ * Restituisce 1 in caso di successo, 0 se il collegamento si e' interrotto
+ */
+static int readPrimaryPacket(int primary, char *buffer) {
+    int received = 0;
+    while(received < PACKET_LENGTH) {
+        ssize_t n = read(primary, buffer + received, PACKET_LENGTH - received);
+        if(n <= 0)
+            return 0;
+        received += n;
+    }
+    return 1;
+}
+
+/**
+ * Applica alla rubrica della replica la modifica del primario descritta da packet,
+ * come farebbe una sessione del server, pubblicandola nella coda delle modifiche
+ *
+ * Restituisce l'esito di addContact, removeContact o modifyContact
+ */
+static int applyPrimaryChange(const serverPacket *packet) {
+    Contact old, new, none;
+    createEmptyContact(&old);
+    createEmptyContact(&new);
+    createEmptyContact(&none);
+    Contact *shown = packet->operation == ADD ? &new : &old;
+    strcpy(shown->name, packet->name);
+    strcpy(shown->surname, packet->surname);
+    strcpy(shown->phoneNumber, packet->phoneNumber);
+    if(packet->operation == MODIFY) {
+        strcpy(new.name, packet->newName);
+        strcpy(new.surname, packet->newSurname);
+        strcpy(new.phoneNumber, packet->newPhoneNumber);
+    }
+
+    beginContactChange();
+    refreshContactIndex();
+    checkFeedBook();
+    int res;
+    if(packet->operation == ADD)
+        res = addContact(new);
+    else if(packet->operation == DEL)
+        res = removeContact(old);
+    else
+        res = modifyContact(old, new);
+    if(res == 1) {
+        if(packet->operation == ADD)
+            applyContactAdded(new);
+        else if(packet->operation == DEL)
+            applyContactRemoved(old);
+        else
+            applyContactModified(old, new);
+        publishContactChange(packet->operation, old, new);
+    }
+    endContactChange(res == 1 ? old : none, res == 1 ? new : none);
+    return res;
+}
+
+/**
+ * Sostituisce la rubrica della replica con la copia completa ricevuta dal primario
+ * La coda delle modifiche della replica pubblica un riavvio, i suoi iscritti rileggono la rubrica
+ *
+ * Restituisce 1 in caso di successo, 0 altrimenti
+ */
+static int installPrimarySnapshot(void) {
+    Contact none;
+    createEmptyContact(&none);
+    if(!replaceContactBook(REPLICA_SNAPSHOT_PATH))
+        return 0;
+    beginContactChange();
+    refreshContactIndex();
+    checkFeedBook();
+    endContactChange(none, none);
+    return 1;
+}
+
+/**
+ * Ciclo del processo della replica: si collega al primario, chiede le modifiche successive
+ * all'ultima applicata e le applica man mano che arrivano, finche' il server e' attivo
+ */
+static void followPrimary(pid_t server, const char *author) {
+    replicaStatus status;
+    logMessage toBeLogged;
+    char logAuthor[CLIENT_MAX_LENGTH], additionalMsg[ADDITIONAL_MESSAGE_MAX_LENGTH], buffer[PACKET_LENGTH];
+    memset(logAuthor, '\0', CLIENT_MAX_LENGTH);
+    strncpy(logAuthor, author, CLIENT_MAX_LENGTH - 1);
+
+    // Come le sessioni, il processo non risponde a CTRL-C e gestisce da se' la chiusura del collegamento
+    signal(SIGINT, SIG_IGN);
+    signal(SIGUSR1, SIG_IGN);
+    signal(SIGUSR2, SIG_IGN);
+    signal(SIGPIPE, SIG_IGN);
+
+    // Senza SA_RESTART, cosi' SIGTERM interrompe anche le attese sulla socket del primario
+    struct sigaction stopAction;
+    memset(&stopAction, 0, sizeof(stopAction));
+    stopAction.sa_handler = stopFollowingHandler;
+    sigaction(SIGTERM, &stopAction, NULL);
+
+    // Riprendiamo dall'ultima modifica applicata, se la rubrica proviene dallo stesso primario
+    if(!readReplicaStatus(&status) || strcmp(status.primaryHost, primaryHost) != 0 || status.primaryPort != primaryPort) {
+        memset(&status, 0, sizeof(replicaStatus));
+        strcpy(status.primaryHost, primaryHost);
+        status.primaryPort = primaryPort;
+    }
+    status.connected = 0;
+    saveReplicaStatus(&status);
+
+    // Il processo termina insieme al server che l'ha avviato
+    while(getppid() == server && !stopFollowing) {
+        int primary = socket(AF_INET, SOCK_STREAM, 0);
+        if(primary < 0 || connect(primary, (struct sockaddr*) &primaryAddress, sizeof(primaryAddress)) < 0) {
+            if(primary > -1)
+                close(primary);
+            sleep(REPLICA_RETRY_SECONDS);
+            continue;
+        }
+
+        // Chiediamo le modifiche successive all'ultima applicata
+        serverPacket packet;
+        buildEmptyPacket(&packet);
+        packet.operation = REPLICATE;
+        packet.matchIndex = status.applied;
+        memset(buffer, '\0', PACKET_LENGTH);
+        buildMessage(buffer, packet);
+        int following = write(primary, buffer, PACKET_LENGTH) == PACKET_LENGTH;
+
+        status.connected = following;
+        saveReplicaStatus(&status);
+        sprintf(additionalMsg, "Following %s:%d from version %u", primaryHost, primaryPort, status.applied);
+        formatMessage(&toBeLogged, logAuthor, "Replication started", following ? SUCCESS : FAILURE, additionalMsg);
+        logF(toBeLogged);
+
+        /*
+         * snapshot - File in cui riceviamo la copia completa della rubrica (-1 se non e' in corso)
+         * snapshotVersion - Modifica del primario a cui corrisponde la copia
+         */
+        int snapshot = -1, applied = 0, restarting = 0;
+        unsigned int snapshotVersion = 0;
+        while(following && getppid() == server && !stopFollowing && readPrimaryPacket(primary, buffer)) {
+            buildEmptyPacket(&packet);
+            parseMessage(buffer, &packet);
+
+            if(packet.operation == REPLICATE && packet.outcome == CHANGES_LOST) {
+
+                // Il primario non ha piu' tutte le modifiche: segue una copia completa, un ADD per contatto
+                if(snapshot > -1)
+                    close(snapshot);
+                umask(0);
+                snapshot = open(REPLICA_SNAPSHOT_PATH, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+                snapshotVersion = packet.matchIndex;
+                following = snapshot > -1;
+
+            } else if(packet.operation == REPLICATE && packet.outcome == OPERATION_SUCCESS) {
+
+                // Pacchetto di stato: chiude l'eventuale copia completa e indica l'ultima modifica del primario
+                if(snapshot > -1) {
+                    close(snapshot);
+                    snapshot = -1;
+                    following = installPrimarySnapshot();
+                    if(following)
+                        status.applied = snapshotVersion;
+                    sprintf(additionalMsg, "Address book replaced with primary copy at version %u", snapshotVersion);
+                    formatMessage(&toBeLogged, logAuthor, "Replica snapshot", following ? SUCCESS : FAILURE, additionalMsg);
+                    logF(toBeLogged);
+                }
+                status.primaryVersion = packet.matchIndex;
+                status.updated = time(NULL);
+                saveReplicaStatus(&status);
+
+            } else if(packet.outcome == OPERATION_SUCCESS && (packet.operation == ADD || packet.operation == DEL || packet.operation == MODIFY)) {
+
+                if(snapshot > -1) { // Contatto della copia completa
+                    char line[3 * CONTACT_STRINGS_LENGTH + 4];
+                    sprintf(line, "%s,%s,%s\n", packet.name, packet.surname, packet.phoneNumber);
+                    following = write(snapshot, line, strlen(line)) == (ssize_t)strlen(line);
+                } else { // Modifica da applicare, se non e' piu' applicabile la rubrica e' gia' aggiornata
+                    following = applyPrimaryChange(&packet) > 0;
+                    status.applied = packet.matchIndex;
+                    applied++;
+
+                    // Aggiorniamo lo stato quando abbiamo applicato tutto quello che e' arrivato
+                    struct pollfd primaryPoll = {primary, POLLIN, 0};
+                    if(poll(&primaryPoll, 1, 0) == 0)
+                        saveReplicaStatus(&status);
+                }
+
+            } else if(packet.operation == REPLICATE && packet.outcome == SERVER_BUSY) {
+
+                // Il primario ha passato le socket a un nuovo server: ci ricolleghiamo subito a quello
+                following = 0;
+                restarting = 1;
+
+            } else { // Il primario non puo' inviare le modifiche
+                following = 0;
+            }
+        }
+
+        // Collegamento interrotto: riproviamo dall'ultima modifica applicata
+        close(primary);
+        if(snapshot > -1) {
+            close(snapshot);
+            unlink(REPLICA_SNAPSHOT_PATH);
+        }
+        status.connected = 0;
+        saveReplicaStatus(&status);
+        sprintf(additionalMsg, "Applied %d changes, stopped at version %u", applied, status.applied);
+        formatMessage(&toBeLogged, logAuthor, "Replication interrupted", IGNORED, additionalMsg);
+        logF(toBeLogged);
+        if(!stopFollowing && !restarting)
+            sleep(REPLICA_RETRY_SECONDS);
+    }
+    exit(EXIT_SUCCESS);
+}
+
+int startReplica(const char *primary, const char *author) {
+
+    // L'indirizzo del primario ha la forma indirizzo:porta
+    const char *colon = strrchr(primary, ':');
+    if(colon == NULL || colon == primary || colon - primary > AUTH_PARAM_LENGTH || atoi(colon + 1) <= 0)
+        return 0;
+    memset(primaryHost, '\0', AUTH_PARAM_LENGTH + 1);
+    strncpy(primaryHost, primary, colon - primary);
+    primaryPort = atoi(colon + 1);
+
+    // Come nel client, inet_pton non accetta localhost
+    memset(&primaryAddress, 0, sizeof(primaryAddress));
+    primaryAddress.sin_family = AF_INET;
+    primaryAddress.sin_port = htons(primaryPort);
+    if(strcmp(primaryHost, "localhost") == 0)
+        primaryAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    else if(inet_pton(AF_INET, primaryHost, &primaryAddress.sin_addr) <= 0)
+        return 0;
+
+    pid_t server = getpid(), pid = fork();
+    if(pid < 0)
+        return 0;
+    if(pid == 0)
+        followPrimary(server, author);
+    follower = pid;
+    replica = 1;
+    return 1;
+}
+
+void stopReplica(void) {
+    if(follower <= 0)
+        return;
+    kill(follower, SIGTERM);
+    waitpid(follower, NULL, 0);
+    follower = 0;
+}
@@ -8,6 +8,8 @@
 
 #include <stdlib.h>
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
 #include <signal.h>
 #include <fcntl.h>
 #include <sys/types.h>
@@ -16,26 +18,92 @@
 #include "./../include/log.h"
 #include "./../include/utility.h"
 #include "./../include/connection.h"
+#include "./../include/contactIndex.h"
+#include "./../include/queryCache.h"
+#include "./../include/changeFeed.h"
+#include "./../include/replica.h"
+#include "./../include/admission.h"
+#include "./../include/metrics.h"
+#include "./../include/trace.h"
+#include <sys/wait.h>
+#include <poll.h>
 #include <string.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <errno.h>
+#include <time.h>
 #include <stdio.h>
 
 #define DEFAULT_PORT 50000
-#define MAX_REQUESTS 10
+
+// Lunghezza della coda di connessioni del kernel: quelle accettate vengono poi limitate dal controllo di ammissione
+#define LISTEN_BACKLOG SOMAXCONN
+
+/*
+ * Secondi di inattivita' dopo cui una sessione viene chiusa, se non indicati all'avvio
+ * e secondi di silenzio della connessione TCP prima delle sonde di keepalive, che vengono
+ * ripetute KEEPALIVE_PROBES volte ogni KEEPALIVE_INTERVAL secondi prima di dichiarare il client irraggiungibile
+ */
+#define DEFAULT_IDLE_TIMEOUT 600
+#define DEFAULT_KEEPALIVE_IDLE 60
+#define KEEPALIVE_INTERVAL 10
+#define KEEPALIVE_PROBES 3
+
+/*
+ * Variabile d'ambiente con cui il server passa al suo successore le socket in ascolto
+ * e la pipe su cui attende che sia pronto (al massimo HANDOVER_TIMEOUT_MS millisecondi)
+ * Durante lo svuotamento il vecchio server controlla le sue sessioni almeno ogni DRAIN_CHECK_MS
+ */
+#define HANDOVER_ENV "CONTACT_SERVER_HANDOVER"
+#define HANDOVER_TIMEOUT_MS 30000
+#define DRAIN_CHECK_MS 1000
 
 /**
  * serverFd - FD della 'server socket', ovvero quella che si occupa di accettare connessioni
+ * unixFd - FD della socket locale (AF_UNIX) che accetta connessioni dalla stessa macchina, -1 se non aperta
  * clientFd - FD della socket usata per comunicare con il client, ottenuta tramite accept
  * portNumber - Numero di porta su cui è aperto il server
+ * idleTimeout - Secondi di inattivita' del client dopo cui la sessione viene chiusa (0 per non chiuderla mai)
+ * keepaliveIdle - Secondi di silenzio prima delle sonde di keepalive TCP (0 per disattivarle)
+ * unixPath - Percorso della socket locale
  * operationAuthor - Stringa che identifica chi esegue un operazione 
  * 
  * Sono variabili globali in quanto la gestione delle socket e il logging avviene anche
  * a livello di gestione dei segnali (ctrl-c), è quindi necessario oltre che utile
  * poter accedere ai file descriptor fuori dal main
  */
-int serverFd, clientFd, portNumber;
+int serverFd, unixFd = -1, clientFd, portNumber, idleTimeout = DEFAULT_IDLE_TIMEOUT, keepaliveIdle = DEFAULT_KEEPALIVE_IDLE;
+char unixPath[sizeof(((struct sockaddr_un *)0)->sun_path)];
 char operationAuthor[CLIENT_MAX_LENGTH];
 
+/**
+ * serverArgv - Argomenti di avvio, riusati per avviare il nuovo server dopo un SIGHUP
+ * primaryAddress - Primario indicato con -p, NULL se il server non e' una replica
+ * restartRequested - Impostata dall'handler di SIGHUP, il passaggio avviene nel ciclo di accettazione
+ * draining - 1 dopo aver passato le socket: il server non accetta piu' connessioni e termina con l'ultima sessione
+ * wakePipe - Pipe su cui gli handler di SIGCHLD e SIGHUP scrivono un byte per svegliare la poll del ciclo di accettazione
+ * stopStreaming - Impostata nelle sessioni da SIGTERM, inviato dal server quando passa le socket: SUBSCRIBE e REPLICATE,
+ *                 che altrimenti non terminano finche' il client resta collegato, chiudono l'invio delle modifiche
+ */
+char **serverArgv;
+char *primaryAddress = NULL;
+volatile sig_atomic_t restartRequested = 0;
+int draining = 0;
+int wakePipe[2] = {-1, -1};
+volatile sig_atomic_t stopStreaming = 0;
+
+/**
+ * Sveglia il ciclo di accettazione scrivendo un byte su wakePipe
+ * Un segnale arrivato tra i controlli del ciclo e la poll non va perso: il byte resta nella pipe
+ * e la poll ritorna subito (se la pipe e' piena c'e' gia' un risveglio in attesa)
+ */
+void wakeAcceptLoop(void) {
+    int savedErrno = errno;
+    if(wakePipe[1] > -1)
+        write(wakePipe[1], "", 1);
+    errno = savedErrno;
+}
+
 /**
  * Gestiamo il segnale SIGPIPE
  * Vogliamo gestire la chiusura improvvisa della socket del client
@@ -126,6 +194,12 @@ void sigusr2Handler(int sig) {
     close(serverFd);
     logMessage toBeLogged;
 
+    // La socket locale va anche rimossa dal file system
+    if(unixFd > -1) {
+        close(unixFd);
+        unlink(unixPath);
+    }
+
     // Facciamo log dell'operazione
     sprintf(operationAuthor, "Server:%d", portNumber);
     formatMessage(&toBeLogged, operationAuthor, "Server socket closing", IGNORED, "Socket successfully closed");
@@ -136,6 +210,301 @@ void sigusr2Handler(int sig) {
     exit(EXIT_SUCCESS);
 }
 
+/**
+ * Il processo principale non ignora piu' SIGCHLD, deve sapere quando una sessione termina per
+ * liberarne il posto: l'handler sveglia soltanto il ciclo di accettazione, i figli terminati
+ * vengono raccolti con waitpid subito dopo
+ */
+void sigchldHandler(int sig) {
+    wakeAcceptLoop();
+}
+
+/**
+ * SIGTERM arriva alle sessioni quando il server ha passato le socket al successore: le altre richieste
+ * vengono completate normalmente, solo SUBSCRIBE e REPLICATE controllano stopStreaming e terminano
+ */
+void stopStreamingHandler(int sig) {
+    stopStreaming = 1;
+}
+
+/**
+ * SIGHUP chiede un riavvio senza interruzioni: l'handler si limita a segnalarlo,
+ * il ciclo di accettazione (che viene svegliato) esegue handOverSockets
+ */
+void sighupHandler(int sig) {
+    restartRequested = 1;
+    wakeAcceptLoop();
+}
+
+/**
+ * Avvia una nuova istanza del server (lo stesso eseguibile con gli stessi argomenti, tipicamente appena
+ * ricompilato) passandole le socket in ascolto, che restano aperte con la exec
+ *
+ * Il vecchio server attende che il nuovo abbia caricato la rubrica e sia pronto ad accettare, poi chiude
+ * le sue copie delle socket e serve fino alla fine le sessioni in corso e quelle in coda (draining)
+ * Le iscrizioni (SUBSCRIBE) e le repliche collegate (REPLICATE) non terminano da sole: con SIGTERM le loro
+ * sessioni chiudono l'invio con un ultimo pacchetto SERVER_BUSY, e il client si ricollega al nuovo server
+ * Se il nuovo server non si avvia entro HANDOVER_TIMEOUT_MS il vecchio continua come prima
+ */
+void handOverSockets(void) {
+    logMessage toBeLogged;
+    char handover[40], additionalMsg[ADDITIONAL_MESSAGE_MAX_LENGTH];
+    int ready[2];
+
+    sprintf(operationAuthor, "Server:%d", portNumber);
+    if(pipe(ready) < 0) {
+        formatMessage(&toBeLogged, operationAuthor, "Socket handover", FAILURE, "Couldn't create handover pipe");
+        logF(toBeLogged);
+        return;
+    }
+    fcntl(ready[0], F_SETFD, FD_CLOEXEC);
+
+    // Il nuovo server seguira' il primario al posto nostro, dall'ultima modifica applicata
+    if(primaryAddress != NULL)
+        stopReplica();
+
+    pid_t pid = fork();
+    if(pid == 0) {
+        closeQueuedConnections();
+        sprintf(handover, "%d %d %d", serverFd, unixFd, ready[1]);
+        setenv(HANDOVER_ENV, handover, 1);
+        execvp(serverArgv[0], serverArgv);
+        exit(EXIT_FAILURE);
+    }
+    close(ready[1]);
+
+    // Il nuovo server scrive un byte quando e' pronto, la pipe si chiude senza dati se termina prima
+    char byte;
+    int result = -1;
+    struct pollfd readyPoll = {ready[0], POLLIN, 0};
+    if(pid > 0) {
+        do {
+            result = poll(&readyPoll, 1, HANDOVER_TIMEOUT_MS);
+        } while(result < 0 && errno == EINTR);
+    }
+    int handedOver = result > 0 && read(ready[0], &byte, 1) == 1;
+    close(ready[0]);
+
+    if(!handedOver) {
+        if(pid > 0)
+            kill(pid, SIGKILL);
+        if(primaryAddress != NULL)
+            startReplica(primaryAddress, operationAuthor);
+        formatMessage(&toBeLogged, operationAuthor, "Socket handover", FAILURE, "New server didn't start, keeping the current one");
+        logF(toBeLogged);
+        printf(RED "Riavvio non riuscito, il server resta attivo\n" RESET_COLOR);
+        return;
+    }
+
+    /*
+     * Da qui le connessioni vengono accettate solo dal nuovo server: il file della socket locale
+     * ora e' suo e non va rimosso, e il CTRL-C (che arriva a entrambi) viene gestito solo da lui
+     */
+    close(serverFd);
+    serverFd = -1;
+    if(unixFd > -1) {
+        close(unixFd);
+        unixFd = -1;
+    }
+    draining = 1;
+    signal(SIGINT, SIG_IGN);
+    signalSessions(SIGTERM);
+    sprintf(additionalMsg, "Listening sockets passed to new server (pid %d), draining %d sessions", pid, sessionsInProgress());
+    formatMessage(&toBeLogged, operationAuthor, "Socket handover", SUCCESS, additionalMsg);
+    logF(toBeLogged);
+    printf(GREEN "Socket passate al nuovo server, in attesa della fine di %d sessioni\n" RESET_COLOR, sessionsInProgress());
+}
+
+/**
+ * Rifiuta la connessione fd perche' il server e' occupato: invia un pacchetto con esito SERVER_BUSY
+ * (senza attendere richieste e senza generare SIGPIPE nel processo principale) e la chiude
+ * reason viene riportato nel log
+ */
+void rejectConnection(int fd, char *reason) {
+    logMessage toBeLogged;
+    serverPacket busy;
+    char busyBuffer[PACKET_LENGTH];
+
+    buildEmptyPacket(&busy);
+    busy.outcome = SERVER_BUSY;
+    buildMessage(busyBuffer, busy);
+    send(fd, busyBuffer, PACKET_LENGTH, MSG_NOSIGNAL | MSG_DONTWAIT);
+    shutdown(fd, SHUT_WR);
+    close(fd);
+
+    connectionRejected();
+    formatMessage(&toBeLogged, operationAuthor, "Connection rejected", FAILURE, reason);
+    logF(toBeLogged);
+}
+
+/**
+ * Attiva il keepalive TCP sulla connessione fd, cosi' un client sparito senza chiudere
+ * (macchina spenta, rete interrotta) fa fallire la read della sessione invece di bloccarla per sempre
+ */
+void enableKeepalive(int fd) {
+    int on = 1, idle = keepaliveIdle, interval = KEEPALIVE_INTERVAL, probes = KEEPALIVE_PROBES;
+    setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &probes, sizeof(probes));
+}
+
+/**
+ * Legge dal client della sessione un pacchetto intero in buffer
+ * Un client che invia piu' richieste di seguito (batch) puo' far arrivare un pacchetto in piu' pezzi
+ * Con idleTimeout ogni pezzo va atteso al massimo idleTimeout secondi, anche a pacchetto iniziato:
+ * un client che si ferma a meta' non deve occupare la sessione per sempre
+ *
+ * Restituisce PACKET_LENGTH in caso di successo, altrimenti i byte letti prima della chiusura
+ * della connessione o -1 in caso di errore (errno indica quale, EAGAIN se il client non ha inviato
+ * nulla per idleTimeout secondi)
+ */
+ssize_t readPacket(char *buffer) {
+    ssize_t done = 0;
+    while(done < PACKET_LENGTH) {
+        if(idleTimeout > 0) {
+            struct pollfd requestPoll = {clientFd, POLLIN, 0};
+            int ready = poll(&requestPoll, 1, idleTimeout * 1000);
+            if(ready < 0 && errno == EINTR)
+                continue;
+            if(ready == 0)
+                errno = EAGAIN;
+            if(ready <= 0)
+                return -1;
+        }
+        ssize_t length = read(clientFd, buffer + done, PACKET_LENGTH - done);
+        if(length < 0 && errno == EINTR)
+            continue;
+        if(length <= 0)
+            return length < 0 ? -1 : done;
+        done += length;
+    }
+    return done;
+}
+
+/**
+ * Invia il pacchetto packet al client della sessione
+ *
+ * Restituisce 1 in caso di successo, 0 altrimenti
+ */
+int sendPacket(serverPacket packet) {
+    char buffer[PACKET_LENGTH];
+    memset(buffer, '\0', PACKET_LENGTH);
+    buildMessage(buffer, packet);
+    return write(clientFd, buffer, PACKET_LENGTH) == PACKET_LENGTH;
+}
+
+/**
+ * Invia al client il pacchetto che descrive la modifica change (per SUBSCRIBE e SYNC_SINCE):
+ * il contatto aggiunto, rimosso o modificato e, per MODIFY, il nuovo contatto nei campi new*
+ *
+ * Restituisce 1 in caso di successo, 0 altrimenti
+ */
+int sendChange(const contactChange *change) {
+    serverPacket event;
+    buildEmptyPacket(&event);
+    event.operation = change->operation;
+    event.outcome = OPERATION_SUCCESS;
+    event.matchIndex = change->version;
+    const Contact *shown = change->operation == ADD ? &change->new : &change->old;
+    strncpy(event.name, shown->name, strlen(shown->name));
+    strncpy(event.surname, shown->surname, strlen(shown->surname));
+    strncpy(event.phoneNumber, shown->phoneNumber, strlen(shown->phoneNumber));
+    if(change->operation == MODIFY) {
+        strncpy(event.newName, change->new.name, strlen(change->new.name));
+        strncpy(event.newSurname, change->new.surname, strlen(change->new.surname));
+        strncpy(event.newPhoneNumber, change->new.phoneNumber, strlen(change->new.phoneNumber));
+    }
+    return sendPacket(event);
+}
+
+/**
+ * Indica al client che alcune modifiche non possono essere inviate
+ * e che le successive partono dalla numero version
+ *
+ * Restituisce 1 in caso di successo, 0 altrimenti
+ */
+int sendChangesLost(char operation, unsigned int version) {
+    serverPacket event;
+    buildEmptyPacket(&event);
+    event.operation = operation;
+    event.outcome = CHANGES_LOST;
+    event.matchIndex = version;
+    return sendPacket(event);
+}
+
+/**
+ * Invia al client le modifiche successive alla numero since (per SYNC_SINCE e REPLICATE):
+ * se sono ancora tutte nel registro solo quelle, altrimenti un pacchetto operation con esito
+ * CHANGES_LOST seguito da un ADD per ogni contatto della rubrica
+ * In until viene salvato il numero della modifica raggiunta, in snapshot 1 se e' stata
+ * inviata tutta la rubrica, 0 altrimenti
+ *
+ * Restituisce il numero di modifiche o contatti inviati, -1 in caso di errore
+ */
+int sendChangesSince(char operation, unsigned int since, unsigned int *until, int *snapshot) {
+    int log = openChangeLog(since, until), sent = 0, ok = 1;
+    contactChange change;
+    *snapshot = log < 0;
+
+    if(log > -1) { // Sincronizzazione incrementale, proporzionale alle modifiche
+
+        for(unsigned int v = since; v < *until && ok && readChangeLog(log, &change); v++) {
+            ok = sendChange(&change);
+            sent++;
+        }
+        close(log);
+
+    } else { // Rubrica completa
+
+        /*
+         * Aggiorniamo l'istantanea bloccando le modifiche (come una modifica vuota),
+         * cosi' corrisponde esattamente alla versione until; l'invio avviene dopo
+         * dall'istantanea, che resta quella finche' non la aggiorniamo
+         */
+        Contact none;
+        createEmptyContact(&none);
+        beginContactChange();
+        int loaded = refreshContactIndex();
+        *until = checkFeedBook();
+        endContactChange(none, none);
+
+        if(loaded < 0) {
+            ok = 0;
+        } else {
+            const contactTable *table = getContactTable();
+            ok = sendChangesLost(operation, *until);
+            change.version = *until;
+            change.operation = ADD;
+            for(int i = 0; i < table->count && ok; i++) {
+                if(!table->alive[i])
+                    continue;
+                createEmptyContact(&change.new);
+                strcpy(change.new.name, table->names[i]);
+                strcpy(change.new.surname, table->surnames[i]);
+                strcpy(change.new.phoneNumber, table->phoneNumbers[i]);
+                ok = sendChange(&change);
+                sent++;
+            }
+        }
+    }
+    return ok ? sent : -1;
+}
+
+/**
+ * Invia alla replica un pacchetto di stato REPLICATE con il numero dell'ultima modifica del primario
+ *
+ * Restituisce 1 in caso di successo, 0 altrimenti
+ */
+int sendReplicaStatus(void) {
+    serverPacket event;
+    buildEmptyPacket(&event);
+    event.operation = REPLICATE;
+    event.outcome = OPERATION_SUCCESS;
+    event.matchIndex = getFeedVersion();
+    return sendPacket(event);
+}
+
 int main(int argc, char **argv) {
 
     // Dichiarazione strutture dati necessarie
@@ -144,69 +513,357 @@ int main(int argc, char **argv) {
     struct sockaddr *serverFdAddressPtr, *clientFdAddressPtr;
     logMessage toBeLogged;
 
-    // Il server puo' essere avviato specificando una porta specifica sulla quale accettare connessioni
-    portNumber = (argc > 1) ? (atoi(argv[1]) ? atoi(argv[1]) : DEFAULT_PORT) : DEFAULT_PORT;
+    /*
+     * Opzioni di avvio, seguite eventualmente dalla porta sulla quale accettare connessioni
+     *  -r modifiche - Numero di modifiche conservate nel registro per le sincronizzazioni (SYNC_SINCE)
+     *  -s segmenti - Numero di segmenti in cui dividere le rubriche create da ora in poi
+     *                (quelle esistenti si ripartiscono dal manager)
+     *  -p indirizzo:porta - Avvia il server come replica in sola lettura del primario indicato,
+     *                       da una cartella diversa da quella del primario (ha una propria rubrica)
+     *  -u percorso - Accetta connessioni anche dalla socket locale (AF_UNIX) percorso, per i client
+     *                sulla stessa macchina, oltre che dalla porta TCP
+     *  -c sessioni - Numero massimo di sessioni contemporanee (DEFAULT_MAX_SESSIONS se non indicato)
+     *  -q attesa - Numero massimo di connessioni in coda in attesa di una sessione libera (DEFAULT_MAX_WAITING
+     *              se non indicato, 0 per rifiutare subito): oltre, o dopo ADMISSION_MAX_WAIT_MS di attesa,
+     *              la connessione viene rifiutata con SERVER_BUSY
+     *  -t secondi - Chiude le sessioni il cui client non invia richieste per secondi (DEFAULT_IDLE_TIMEOUT
+     *               se non indicato, 0 per non chiuderle mai)
+     *  -k secondi - Silenzio dopo cui il keepalive TCP verifica che il client sia ancora raggiungibile
+     *               (DEFAULT_KEEPALIVE_IDLE se non indicato, 0 per disattivarlo)
+     *  -w tracciato - Registra le richieste ricevute nel file tracciato (vedi trace.h), da cui
+     *                 traceReplay puo' ripeterle verso un altro server
+     *
+     * Esempio: ./server -r 50000 -s 8 50001
+     *          ./server -p 127.0.0.1:50001 50002
+     *          ./server -u /tmp/rubrica.sock
+     *          ./server -c 200 -q 100 50001
+     *          ./server -t 120 -k 30 50001
+     *          ./server -w tracciato.dat 50001
+     *
+     * Inviando SIGHUP al server (kill -HUP pid) questo viene riavviato senza rifiutare connessioni:
+     * vedi handOverSockets
+     */
+    int retention = CHANGE_LOG_RETENTION, segments, option, maxSessions = DEFAULT_MAX_SESSIONS, maxWaiting = DEFAULT_MAX_WAITING;
+    char *primary = NULL, *tracePath = NULL;
+    serverArgv = argv;
+    memset(unixPath, '\0', sizeof(unixPath));
+    while((option = getopt(argc, argv, "r:s:p:u:c:q:t:k:w:")) != -1) {
+        switch(option) {
+            case 'p':
+                primary = optarg;
+                break;
+            case 'w':
+                tracePath = optarg;
+                break;
+            case 'u':
+                if(optarg[0] == '\0' || strlen(optarg) >= sizeof(unixPath)) {
+                    printf(RED "Percorso della socket locale non valido: %s\n" RESET_COLOR, optarg);
+                    exit(EXIT_FAILURE);
+                }
+                strcpy(unixPath, optarg);
+                break;
+            case 'c':
+                maxSessions = atoi(optarg);
+                if(maxSessions <= 0) {
+                    printf(RED "Numero di sessioni contemporanee non valido: %s\n" RESET_COLOR, optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'q':
+                maxWaiting = atoi(optarg);
+                if(maxWaiting < 0 || (maxWaiting == 0 && strcmp(optarg, "0") != 0)) {
+                    printf(RED "Numero di connessioni in coda non valido: %s\n" RESET_COLOR, optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 't':
+            case 'k':
+                if(atoi(optarg) < 0 || (atoi(optarg) == 0 && strcmp(optarg, "0") != 0)) {
+                    printf(RED "Numero di secondi non valido: %s\n" RESET_COLOR, optarg);
+                    exit(EXIT_FAILURE);
+                }
+                if(option == 't')
+                    idleTimeout = atoi(optarg);
+                else
+                    keepaliveIdle = atoi(optarg);
+                break;
+            case 'r':
+                retention = atoi(optarg);
+                if(retention <= 0) {
+                    printf(RED "Numero di modifiche da conservare non valido: %s\n" RESET_COLOR, optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 's':
+                segments = atoi(optarg);
+                if(segments < 1 || segments > MAX_BOOK_SEGMENTS) {
+                    printf(RED "Numero di segmenti non valido: %s (da 1 a %d)\n" RESET_COLOR, optarg, MAX_BOOK_SEGMENTS);
+                    exit(EXIT_FAILURE);
+                }
+                setNewBookSegments(segments);
+                break;
+            default:
+                printf("Utilizzo: %s [-r modifiche] [-s segmenti] [-p primario:porta] [-u socket] [-c sessioni] [-q attesa] [-t inattivita'] [-k keepalive] [-w tracciato] [porta]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    portNumber = (optind < argc) ? (atoi(argv[optind]) ? atoi(argv[optind]) : DEFAULT_PORT) : DEFAULT_PORT;
 
     /*
      * Gestione dei segnali
      *  Vogliamo gestire SIGPIPE chiudendo correttamente la socket di comunicazione con il client
-     *  Vogliamo ignorare i segnali SIGCHLD (death-of-child), cosi' i figli possono interrompersi e non aspetteranno la wait del padre (evitiamo i processi zombie)
+     *  Vogliamo sapere quando termina un figlio (SIGCHLD), per liberare il posto della sua sessione: il padre lo raccoglie con waitpid (evitiamo i processi zombie)
      *  Vogliamo gestire il CTRL-C (solo del processo padre) per gestire, oltre a una corretta terminazione, alcune operazioni del server
+     * La pipe di risveglio non deve mai bloccare l'handler, e non passa al nuovo server dopo un SIGHUP
      */
+    if(pipe(wakePipe) < 0) {
+        perror("Impossibile creare la pipe di risveglio");
+        exit(EXIT_FAILURE);
+    }
+    for(int i = 0; i < 2; i++) {
+        fcntl(wakePipe[i], F_SETFL, O_NONBLOCK);
+        fcntl(wakePipe[i], F_SETFD, FD_CLOEXEC);
+    }
     signal(SIGPIPE, sigpipe_handler);
-    signal(SIGCHLD, SIG_IGN);
+    signal(SIGCHLD, sigchldHandler);
     signal(SIGINT, ctrlcHandler);
     signal(SIGUSR1, sigusr1Handler);
     signal(SIGUSR2, sigusr2Handler);
+    signal(SIGHUP, sighupHandler);
 
     // Inizializzazione della socket, dominio AF_INET, bidirezionale e protocollo scelto automaticamente
     serverFdAddressPtr = (struct sockaddr*) &serverAddress;
     serverLength = sizeof(serverAddress);
     clientFdAddressPtr = (struct sockaddr*) &clientAddress;
     clientLength = sizeof(clientAddress);
-    serverFd = socket(AF_INET, SOCK_STREAM, 0);
 
     /*
-     * Quando una socket viene chiusa, la porta che utilizzava viene liberata dal sistema operativo
-     * Ma non è detto che quella porta possa essere riassegnata subito. Chiudere un server (con socket compresa)
-     * e riaprirlo puo' quindi portare ad avere la porta non subito riassegnata
+     * Dopo un SIGHUP il server precedente ci passa le sue socket gia' in ascolto (descrittori ereditati
+     * con la exec, indicati in HANDOVER_ENV insieme alla pipe con cui avvisarlo quando siamo pronti):
+     * non vengono ricreate, cosi' nessuna connessione viene rifiutata durante il riavvio
      */
-    int opt = 1;
-    if(setsockopt(serverFd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt))) {
-        close(serverFd);
-        exit(EXIT_FAILURE);
+    int readyFd = -1;
+    char *handover = getenv(HANDOVER_ENV);
+    if(handover != NULL && sscanf(handover, "%d %d %d", &serverFd, &unixFd, &readyFd) == 3) {
+        unsetenv(HANDOVER_ENV);
+        sprintf(operationAuthor, "Server:%d", portNumber);
+        formatMessage(&toBeLogged, operationAuthor, "Socket handover", SUCCESS, "Listening sockets received from previous server");
+        logF(toBeLogged);
+        printf(GREEN "Server riavviato con successo\nIn attesa di richieste...\n" RESET_COLOR);
+    } else {
+        readyFd = -1;
+        unixFd = -1;
+        serverFd = socket(AF_INET, SOCK_STREAM, 0);
+
+        /*
+         * Quando una socket viene chiusa, la porta che utilizzava viene liberata dal sistema operativo
+         * Ma non è detto che quella porta possa essere riassegnata subito. Chiudere un server (con socket compresa)
+         * e riaprirlo puo' quindi portare ad avere la porta non subito riassegnata
+         */
+        int opt = 1;
+        if(setsockopt(serverFd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt))) {
+            close(serverFd);
+            exit(EXIT_FAILURE);
+        }
+
+        // Inizializziamo la porta
+        serverAddress.sin_family = AF_INET;
+        serverAddress.sin_port = htons(portNumber);
+        serverAddress.sin_addr.s_addr = htonl(INADDR_ANY); // Ascoltiamo richieste provenienti da qualsiasi rete
+
+        bind(serverFd, serverFdAddressPtr, serverLength);
+
+        // Controlliamo se il bind ha successo o meno
+        if(serverFd < 0) {
+            formatMessage(&toBeLogged, "Server", "Socket creation", FAILURE, "Couldn't create socket");
+            printf(RED "Server non avviato, errore creazione socket\n" RESET_COLOR);
+            exit(EXIT_FAILURE);
+        } else {
+            sprintf(operationAuthor, "Server:%d", portNumber);
+            formatMessage(&toBeLogged, operationAuthor, "Socket creation", SUCCESS, "Socket successfully created");
+            printf(GREEN "Server avviato con successo\nIn attesa di richieste...\n" RESET_COLOR);
+        }
+        logF(toBeLogged);
+
+        /*
+         * Socket locale: stessa sessione delle connessioni TCP, ma senza passare dallo stack di rete
+         * Un file rimasto da un avvio precedente viene rimosso, solo se e' una socket
+         */
+        if(unixPath[0] != '\0') {
+            struct sockaddr_un unixAddress;
+            struct stat unixInfo;
+            char listeningMsg[ADDITIONAL_MESSAGE_MAX_LENGTH];
+            memset(&unixAddress, 0, sizeof(unixAddress));
+            unixAddress.sun_family = AF_UNIX;
+            strcpy(unixAddress.sun_path, unixPath);
+            if(stat(unixPath, &unixInfo) == 0 && S_ISSOCK(unixInfo.st_mode))
+                unlink(unixPath);
+
+            unixFd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if(unixFd < 0 || bind(unixFd, (struct sockaddr*) &unixAddress, sizeof(unixAddress)) < 0 || listen(unixFd, LISTEN_BACKLOG) < 0) {
+                formatMessage(&toBeLogged, operationAuthor, "Local socket creation", FAILURE, "Couldn't create local socket");
+                logF(toBeLogged);
+                printf(RED "Server non avviato, errore creazione socket locale %s\n" RESET_COLOR, unixPath);
+                exit(EXIT_FAILURE);
+            }
+            sprintf(listeningMsg, "Listening on %s", unixPath);
+            formatMessage(&toBeLogged, operationAuthor, "Local socket creation", SUCCESS, listeningMsg);
+            logF(toBeLogged);
+        }
     }
 
-    // Inizializziamo la porta
-    serverAddress.sin_family = AF_INET;
-    serverAddress.sin_port = htons(portNumber);
-    serverAddress.sin_addr.s_addr = htonl(INADDR_ANY); // Ascoltiamo richieste provenienti da qualsiasi rete
+    // Limiti delle sessioni e coda di attesa, i contatori sono leggibili dal manager
+    if(!initAdmission(maxSessions, maxWaiting))
+        printf(YELLOW "Controllo di ammissione non disponibile, sessioni non limitate\n" RESET_COLOR);
+
+    /*
+     * La cache dei risultati delle letture viene creata qui, cosi' tutti i figli la condividono
+     * Dopo un passaggio delle socket usiamo quella del server precedente, ancora usata dalle sue sessioni
+     */
+    if(!(readyFd > -1 && attachQueryCache()) && !initQueryCache())
+        printf(YELLOW "Cache delle letture non disponibile\n" RESET_COLOR);
+
+    // Lo stesso vale per la coda delle modifiche inviate agli iscritti e alle sincronizzazioni
+    if(!(readyFd > -1 && attachChangeFeed(retention)) && !initChangeFeed(retention))
+        printf(YELLOW "Iscrizioni e sincronizzazioni non disponibili\n" RESET_COLOR);
 
-    bind(serverFd, serverFdAddressPtr, serverLength);
+    // E per le metriche delle operazioni, che proseguono dopo un passaggio delle socket
+    if(!(readyFd > -1 && attachMetrics()) && !initMetrics())
+        printf(YELLOW "Metriche delle operazioni non disponibili\n" RESET_COLOR);
 
-    // Controlliamo se il bind ha successo o meno
-    if(serverFd < 0) {
-        formatMessage(&toBeLogged, "Server", "Socket creation", FAILURE, "Couldn't create socket");
-        printf(RED "Server non avviato, errore creazione socket\n" RESET_COLOR);
+    // Le richieste vengono registrate nel tracciato solo se richiesto all'avvio (da riprodurre con traceReplay)
+    if(tracePath != NULL && !openTrace(tracePath)) {
+        printf(RED "Impossibile registrare le richieste in %s\n" RESET_COLOR, tracePath);
         exit(EXIT_FAILURE);
+    }
+
+    // Una replica segue il primario con un processo dedicato, che usa la cache e la coda appena create
+    if(primary != NULL) {
+        if(!startReplica(primary, operationAuthor)) {
+            printf(RED "Primario non valido: %s (indirizzo:porta)\n" RESET_COLOR, primary);
+            exit(EXIT_FAILURE);
+        }
+        printf(GREEN "Replica in sola lettura di %s\n" RESET_COLOR, primary);
+        primaryAddress = primary;
     } else {
-        sprintf(operationAuthor, "Server:%d", portNumber);
-        formatMessage(&toBeLogged, operationAuthor, "Socket creation", SUCCESS, "Socket successfully created");
-        printf(GREEN "Server avviato con successo\nIn attesa di richieste...\n" RESET_COLOR);
+        clearReplicaStatus();
+    }
+
+    /*
+     * Carichiamo l'istantanea della rubrica condivisa prima di accettare connessioni:
+     * i figli la ereditano con la fork e non devono rileggere la rubrica alla prima richiesta
+     */
+    int loaded = refreshContactIndex();
+    if(loaded >= 0) {
+        char loadedMsg[ADDITIONAL_MESSAGE_MAX_LENGTH];
+        sprintf(loadedMsg, "%d contacts loaded", loaded);
+        formatMessage(&toBeLogged, operationAuthor, "Address book warm-up", SUCCESS, loadedMsg);
+        logF(toBeLogged);
+    }
+
+    // Avvisiamo il server precedente che siamo pronti, da ora smette di accettare connessioni
+    if(readyFd > -1) {
+        write(readyFd, "1", 1);
+        close(readyFd);
     }
-    logF(toBeLogged);
 
     // Prepariamo la socket per accettare richieste
-    listen(serverFd, MAX_REQUESTS);
+    listen(serverFd, LISTEN_BACKLOG);
     while(1) {
 
-        // Accettiamo una richiesta di connessione e incarichiamo un processo figlio di gestirla, il padre tornera' ad accettare richieste
-        clientFd = accept(serverFd, clientFdAddressPtr, &clientLength);
+        // Riavvio richiesto con SIGHUP
+        if(restartRequested) {
+            restartRequested = 0;
+            if(!draining)
+                handOverSockets();
+        }
+
+        // Raccogliamo i figli terminati, liberando i posti delle sessioni
+        pid_t ended;
+        int endStatus;
+        while((ended = waitpid(-1, &endStatus, WNOHANG)) > 0)
+            sessionEnded(ended, endStatus);
+
+        // Dopo aver passato le socket terminiamo quando non restano sessioni da servire
+        if(draining && sessionsInProgress() == 0) {
+            formatMessage(&toBeLogged, operationAuthor, "Server socket closing", IGNORED, "All sessions drained after handover");
+            logF(toBeLogged);
+            exit(EXIT_SUCCESS);
+        }
+
+        /*
+         * Se c'e' un posto libero serviamo prima la connessione in coda da piu' tempo (anche se e' appena
+         * scaduta: un posto liberato non deve trasformarsi in un rifiuto), altrimenti rifiutiamo quelle
+         * in coda da troppo tempo e attendiamo una richiesta di connessione sulla porta TCP o sulla socket locale
+         * (al massimo fino alla scadenza della prima connessione in coda)
+         */
+        int local = 0;
+        long waitedMs = 0;
+        if(!canStartSession() || !takeQueuedConnection(&clientFd, &local, &waitedMs)) {
+            int expiredFd;
+            while(takeExpiredConnection(&expiredFd))
+                rejectConnection(expiredFd, "Server busy, waited too long in queue");
+
+            // Durante lo svuotamento le socket sono chiuse (-1, ignorate da poll): attendiamo solo la fine delle sessioni
+            int timeout = getAdmissionTimeout();
+            if(draining && (timeout < 0 || timeout > DRAIN_CHECK_MS))
+                timeout = DRAIN_CHECK_MS;
+
+            // La pipe di risveglio interrompe l'attesa quando termina una sessione o arriva un SIGHUP
+            struct pollfd listening[3] = {{serverFd, POLLIN, 0}, {unixFd, POLLIN, 0}, {wakePipe[0], POLLIN, 0}};
+            int ready = poll(listening, 3, timeout);
+            if(ready > 0 && (listening[2].revents & POLLIN)) {
+                char wakeBytes[64];
+                while(read(wakePipe[0], wakeBytes, sizeof(wakeBytes)) > 0);
+            }
+            if(ready <= 0 || !((listening[0].revents | listening[1].revents) & POLLIN))
+                continue;
+            local = unixFd > -1 && (listening[1].revents & POLLIN);
+
+            // Accettiamo la richiesta di connessione, se non c'e' posto la mettiamo in coda o la rifiutiamo
+            clientFd = local ? accept(unixFd, NULL, NULL) : accept(serverFd, clientFdAddressPtr, &clientLength);
+            if(clientFd < 0)
+                continue;
+            if(!canStartSession()) {
+                if(!queueConnection(clientFd, local))
+                    rejectConnection(clientFd, "Server busy, session limit reached and queue full");
+                continue;
+            }
+        }
+
+        /*
+         * Incarichiamo un processo figlio di gestire la sessione, il padre tornera' ad accettare richieste
+         * SIGTERM resta bloccato finche' il figlio non ha il suo handler, cosi' un passaggio delle socket
+         * che avviene proprio ora non termina la sessione
+         */
+        sigset_t termMask, previousMask;
+        sigemptyset(&termMask);
+        sigaddset(&termMask, SIGTERM);
+        sigprocmask(SIG_BLOCK, &termMask, &previousMask);
         pid_t pid = fork();
         if(pid == 0) {
 
-            // Processo figlio
+            /*
+             * Con SA_RESTART le letture e scritture delle richieste normali non vengono interrotte
+             * Una sessione avviata durante lo svuotamento (dalla coda) non riceve SIGTERM: parte gia' fermata
+             */
+            struct sigaction stopAction;
+            memset(&stopAction, 0, sizeof(stopAction));
+            stopAction.sa_handler = stopStreamingHandler;
+            stopAction.sa_flags = SA_RESTART;
+            sigaction(SIGTERM, &stopAction, NULL);
+            stopStreaming = draining;
+            sigprocmask(SIG_SETMASK, &previousMask, NULL);
+
+            // Processo figlio, le connessioni in coda e la pipe di risveglio appartengono al padre
             close(serverFd);
+            if(unixFd > -1)
+                close(unixFd);
+            closeQueuedConnections();
+            close(wakePipe[0]);
+            close(wakePipe[1]);
+            wakePipe[0] = wakePipe[1] = -1;
+            signal(SIGCHLD, SIG_IGN);
 
             // Detach-iamo il processo figlio dal terminale
             int nullFd = open("/dev/null", O_RDWR);
@@ -219,24 +876,40 @@ int main(int argc, char **argv) {
             // Processo figlio, ascolta le richieste della sessione con il client
             serverPacket packetReceived, packetToSend;
 
+            // La socket locale non passa dalla rete, il keepalive serve solo per le connessioni TCP
+            if(!local && keepaliveIdle > 0)
+                enableKeepalive(clientFd);
+
             // Nel client gestiamo le interruzioni di sospensione e interruzione disabilitandole
             signal(SIGINT, SIG_IGN);
             signal(SIGUSR1, SIG_IGN);
             signal(SIGUSR2, SIG_IGN);
 
             char clientInfo[INET_ADDRSTRLEN], requestMsg[OPERATION_MESSAGE_MAX_LENGTH], additionalMsg[ADDITIONAL_MESSAGE_MAX_LENGTH];
-            int status, a = getpeername(clientFd, clientFdAddressPtr, &clientLength);
-            inet_ntop(AF_INET, &(clientAddress.sin_addr), clientInfo, INET_ADDRSTRLEN);
+            int status;
             memset(operationAuthor, '\0', 40);
-            sprintf(operationAuthor, "%s:%d@Server:%d", clientInfo, clientAddress.sin_port, portNumber);
+            if(local) { // Il client e' sulla stessa macchina, non ha un indirizzo di rete
+                sprintf(operationAuthor, "local@Server:%d", portNumber);
+            } else {
+                getpeername(clientFd, clientFdAddressPtr, &clientLength);
+                inet_ntop(AF_INET, &(clientAddress.sin_addr), clientInfo, INET_ADDRSTRLEN);
+                sprintf(operationAuthor, "%s:%d@Server:%d", clientInfo, clientAddress.sin_port, portNumber);
+            }
 
             // Facciamo il log del collegamento del client
-            formatMessage(&toBeLogged, operationAuthor, "Connection established", IGNORED, "Session started");
+            if(waitedMs > 0)
+                sprintf(additionalMsg, "Session started after %ld ms in queue", waitedMs);
+            else
+                sprintf(additionalMsg, "Session started");
+            formatMessage(&toBeLogged, operationAuthor, "Connection established", IGNORED, additionalMsg);
             logF(toBeLogged);
 
             char socketBuffer[PACKET_LENGTH];
             int connected = 1;
 
+            // 1 se il client ha chiesto con AUTH la rubrica personale: altrimenti anche le modifiche autenticate vanno alla rubrica condivisa
+            int personalBook = 0;
+
             // Sessione di comunicazione con il client
             while(connected) {
 
@@ -244,13 +917,42 @@ int main(int argc, char **argv) {
                 memset(socketBuffer, '\0', PACKET_LENGTH);
                 memset(requestMsg, '\0', 350);
                 memset(additionalMsg, '\0', 200);
-                if(read(clientFd, socketBuffer, PACKET_LENGTH) != PACKET_LENGTH) { // Controlliamo che sia la lunghezza giusta (quella del pacchetto)
+
+                errno = 0;
+                if(readPacket(socketBuffer) != PACKET_LENGTH) { // Controlliamo che sia la lunghezza giusta (quella del pacchetto)
+                    int readError = errno;
                     close(clientFd);
+
+                    // EAGAIN: il client non ha inviato nulla per idleTimeout secondi, chiudiamo la sessione liberandone il processo
+                    if(readError == EAGAIN) {
+                        sprintf(additionalMsg, "No data for %d seconds, closing socket", idleTimeout);
+                        formatMessage(&toBeLogged, operationAuthor, "Connection terminated", FAILURE, additionalMsg);
+                        logF(toBeLogged);
+                        exit(SESSION_IDLE_EXIT);
+                    }
+
+                    // ETIMEDOUT: le sonde di keepalive non hanno avuto risposta
+                    if(readError == ETIMEDOUT) {
+                        formatMessage(&toBeLogged, operationAuthor, "Connection terminated", FAILURE, "Client unreachable (keepalive), closing socket");
+                        logF(toBeLogged);
+                        exit(SESSION_UNREACHABLE_EXIT);
+                    }
                     formatMessage(&toBeLogged, operationAuthor, "Connection terminated", FAILURE, "Error during client request, closing socket");
                     logF(toBeLogged);
                     exit(EXIT_FAILURE);
                 }      
 
+                // La latenza della richiesta si misura da qui (pacchetto ricevuto) all'invio della risposta
+                struct timespec requestStart, requestEnd;
+                clock_gettime(CLOCK_MONOTONIC, &requestStart);
+
+                // Il pacchetto viene sovrascritto dalla risposta, ne teniamo una copia per il tracciato
+                traceRecord traced;
+                struct timespec arrival;
+                clock_gettime(CLOCK_REALTIME, &arrival);
+                traced.arrivalUs = (unsigned long long)arrival.tv_sec * 1000000ULL + arrival.tv_nsec / 1000;
+                memcpy(traced.packet, socketBuffer, PACKET_LENGTH);
+
                 // Scomponiamo il messaggio formattando il pacchetto
                 buildEmptyPacket(&packetReceived);  
                 buildEmptyPacket(&packetToSend);       
@@ -264,8 +966,12 @@ int main(int argc, char **argv) {
                      * Specifica i parametri per la ricerca del contatto e quale istanza
                      * vuole.
                      * matchIndex di packet rappresenta appunto il numero di istanza
+                     *
+                     * Con INSENSITIVE_READ nome e cognome vengono confrontati ignorando
+                     * maiuscole e accenti ("rossi" trova "Rossi", "nicolo" trova "Nicolò")
                      */
                     case READ:
+                    case INSENSITIVE_READ:
 
                         /*
                          * Inizializziamo una struct contact con le informazioni per la ricerca
@@ -277,48 +983,40 @@ int main(int argc, char **argv) {
                         strncpy(toSearch.name, packetReceived.name, strlen(packetReceived.name));
                         strncpy(toSearch.surname, packetReceived.surname, strlen(packetReceived.surname));
                         strncpy(toSearch.phoneNumber, packetReceived.phoneNumber, strlen(packetReceived.phoneNumber));
-                        packetToSend.operation = READ;
-
-                        int searchIndex = 0, foundIndex = 0, contactRetrived = 1;
-                        
+                        packetToSend.operation = packetReceived.operation;
+                        int searchMode = packetReceived.operation == INSENSITIVE_READ ? SEARCH_INSENSITIVE : SEARCH_EXACT;
 
                         /*
-                         * Leggiamo la rubrica un contatto alla volta tramite getContact
-                         * Controlliamo se il parametro trovato combacia con i criteri stabiliti
-                         * dal client. In tal caso controlliamo se tale contatto è l'n-esima (matchIndex)
-                         * corrispondenza trovata, in tal caso lo invieremo al client, in  caso contrario 
-                         * cercheremo il successivo corrispondente
-                         * 
-                         * searchIndex - Indice di scorrimento della rubrica, rappresenta quale contatto prendere dalla rubrica
-                         * foundIndex - Rappresenta quanti contatti sono stati trovati che corrispondono ai criteri di ricerca
-                         * (se ci fosse un array solo di contatti che combaciano, sarebbe l'indice di tale array)
+                         * La ricerca avviene sull'istantanea in memoria della rubrica:
+                         * se e' indicato il nome (o il cognome) vengono controllati solo i contatti
+                         * con la stessa chiave normalizzata, altrimenti tutta la rubrica
+                         * findContact restituisce la matchIndex-esima corrispondenza, nell'ordine della rubrica
+                         *
+                         * La versione della rubrica viene letta prima della ricerca: se nel frattempo
+                         * avviene una modifica, la prossima lettura condizionata se ne accorgera'
+                         * Solo la rubrica condivisa ha una versione, le rubriche personali non sono nella coda delle modifiche
                          */
-                        while(foundIndex < packetReceived.matchIndex && contactRetrived) {
-
-                            // Leggo un contatto dalla rubrica
-                            createEmptyContact(&found);
-                            contactRetrived = getContact(&found, searchIndex);
-                            // Se get restituisce 0 la rubrica non aveva ulteriori contatti (è stata letta tutta)
-                            if(contactRetrived) { 
-
-                                // Controllo se il contatto trovato corrisponde a quello cercato in base ai criteri stabiliti
-                                if(matchesParameters(toSearch, found)) {
-                                    foundIndex ++; // Abbiamo trovato l'i-esimo (foundIndex) contatto che corrisponde ai criteri di ricerca
-                                }
-                            }
-                            searchIndex ++; // Mi preparo a leggere il successivo
-                        }
+                        unsigned int version = isSharedContactBook() ? getFeedVersion() : 0;
+                        if(version)
+                            sprintf(packetToSend.newPhoneNumber, "%u", version);
 
                         /*
-                         * Abbiamo due possibili cause per l'uscita dal ciclo
-                         *   è stato trovato il contatto che cercavamo
-                         *   Sono finiti i contatti
+                         * Lettura condizionata: il client indica la versione del risultato che possiede,
+                         * se nessuna modifica successiva lo coinvolge rispondiamo senza cercare nella rubrica
                          */
-                        if(foundIndex == packetReceived.matchIndex) { // Se il contatto è stato trovato
+                        if(packetReceived.newPhoneNumber[0] != '\0' && isReadUnchanged(toSearch, searchMode, (unsigned int)strtoul(packetReceived.newPhoneNumber, NULL, 10))) {
+                            packetToSend.outcome = NOT_MODIFIED;
+                            packetToSend.matchIndex = packetReceived.matchIndex;
+
+                            // Per il logging
+                            status = SUCCESS;
+                            sprintf(additionalMsg, "Result unchanged since version %s", packetReceived.newPhoneNumber);
+
+                        } else if(findContactCached(toSearch, searchMode, packetReceived.matchIndex, &found)) { // Se il contatto è stato trovato
 
                             // Inizializziamo il pacchetto di risposta da inviare al client, indicando il successo e il contatto trovato
                             packetToSend.outcome = OPERATION_SUCCESS;
-                            packetToSend.matchIndex = foundIndex;
+                            packetToSend.matchIndex = packetReceived.matchIndex;
                             strncpy(packetToSend.name, found.name, strlen(found.name));
                             strncpy(packetToSend.surname, found.surname, strlen(found.surname));
                             strncpy(packetToSend.phoneNumber, found.phoneNumber, strlen(found.phoneNumber));
@@ -327,7 +1025,7 @@ int main(int argc, char **argv) {
                             status = SUCCESS;
                             sprintf(additionalMsg, "Found matching contact: [%s, %s, %s]", found.name, found.surname, found.phoneNumber);
 
-                        } else { // Abbiamo letto tutta la rubrica senza trovare il contatto che cercavamo
+                        } else { // Non ci sono altri contatti che corrispondono ai criteri
 
                             // Inizializziamo il pacchetto di risposta da inviare al client, indicando il fallimento
                             packetToSend.outcome = READ_CONTACT_MISSING;
@@ -344,7 +1042,7 @@ int main(int argc, char **argv) {
                         if(isContactEmpty(toSearch)) {
                             sprintf(requestMsg, "Requested search for contact number %d", packetReceived.matchIndex);
                         } else {
-                            sprintf(requestMsg, "Requested search for contact number %d that matches [", packetReceived.matchIndex);
+                            sprintf(requestMsg, "Requested %ssearch for contact number %d that matches [", searchMode == SEARCH_INSENSITIVE ? "case-insensitive " : "", packetReceived.matchIndex);
                             if(toSearch.name[0] != '\0') sprintf(requestMsg + strlen(requestMsg), "-Name: %s ", toSearch.name);
                             if(toSearch.surname[0] != '\0') sprintf(requestMsg + strlen(requestMsg), "-Surname: %s ", toSearch.surname);
                             if(toSearch.phoneNumber[0] != '\0') sprintf(requestMsg + strlen(requestMsg), "-Phone number: %s", toSearch.phoneNumber);
@@ -352,6 +1050,199 @@ int main(int argc, char **argv) {
                         }
                         break;
 
+                    /*
+                     * Il client ha richiesto una lettura approssimata dalla rubrica
+                     * Come per READ specifica i parametri di ricerca e quale corrispondenza
+                     * vuole, ma nome e cognome possono differire da quelli salvati
+                     * di al massimo un certo numero di modifiche (errori di battitura)
+                     */
+                    case FUZZY_READ:
+
+                        // Inizializziamo i criteri di ricerca con le informazioni del pacchetto
+                        createEmptyContact(&toSearch);
+                        strncpy(toSearch.name, packetReceived.name, strlen(packetReceived.name));
+                        strncpy(toSearch.surname, packetReceived.surname, strlen(packetReceived.surname));
+                        strncpy(toSearch.phoneNumber, packetReceived.phoneNumber, strlen(packetReceived.phoneNumber));
+                        packetToSend.operation = FUZZY_READ;
+
+                        // La distanza massima viaggia nel campo newName, se assente usiamo quella predefinita
+                        int maxDistance = packetReceived.newName[0] != '\0' ? atoi(packetReceived.newName) : FUZZY_DEFAULT_DISTANCE;
+
+                        // La ricerca avviene sull'istantanea in memoria della rubrica
+                        if(findFuzzyContact(toSearch, maxDistance, packetReceived.matchIndex, &found)) {
+
+                            // Inizializziamo il pacchetto di risposta indicando il successo e il contatto trovato
+                            packetToSend.outcome = OPERATION_SUCCESS;
+                            packetToSend.matchIndex = packetReceived.matchIndex;
+                            strncpy(packetToSend.name, found.name, strlen(found.name));
+                            strncpy(packetToSend.surname, found.surname, strlen(found.surname));
+                            strncpy(packetToSend.phoneNumber, found.phoneNumber, strlen(found.phoneNumber));
+
+                            // Per il logging
+                            status = SUCCESS;
+                            sprintf(additionalMsg, "Found approximate match: [%s, %s, %s]", found.name, found.surname, found.phoneNumber);
+                        } else {
+
+                            // Nessun contatto abbastanza vicino ai criteri
+                            packetToSend.outcome = READ_CONTACT_MISSING;
+
+                            // Per il logging
+                            status = FAILURE;
+                            sprintf(additionalMsg, "Finished file without any contacts");
+                        }
+
+                        // Per il logging indichiamo solo i parametri richiesti
+                        sprintf(requestMsg, "Requested approximate search (distance %d) for contact number %d that matches [", maxDistance, packetReceived.matchIndex);
+                        if(toSearch.name[0] != '\0') sprintf(requestMsg + strlen(requestMsg), "-Name: %s ", toSearch.name);
+                        if(toSearch.surname[0] != '\0') sprintf(requestMsg + strlen(requestMsg), "-Surname: %s ", toSearch.surname);
+                        if(toSearch.phoneNumber[0] != '\0') sprintf(requestMsg + strlen(requestMsg), "-Phone number: %s", toSearch.phoneNumber);
+                        sprintf(requestMsg + strlen(requestMsg), "]");
+                        break;
+
+                    /*
+                     * Il client ha richiesto una lettura conoscendo solo le ultime cifre
+                     * del numero di telefono, contenute nel campo phoneNumber
+                     * nome e cognome (se presenti) vengono confrontati come in INSENSITIVE_READ
+                     */
+                    case SUFFIX_READ:
+
+                        // Inizializziamo i criteri di ricerca con le informazioni del pacchetto
+                        createEmptyContact(&toSearch);
+                        strncpy(toSearch.name, packetReceived.name, strlen(packetReceived.name));
+                        strncpy(toSearch.surname, packetReceived.surname, strlen(packetReceived.surname));
+                        strncpy(toSearch.phoneNumber, packetReceived.phoneNumber, strlen(packetReceived.phoneNumber));
+                        packetToSend.operation = SUFFIX_READ;
+
+                        // La ricerca avviene sull'ordinamento dei numeri letti al contrario
+                        if(findContactByPhoneSuffix(toSearch, SEARCH_INSENSITIVE, packetReceived.matchIndex, &found)) {
+
+                            // Inizializziamo il pacchetto di risposta indicando il successo e il contatto trovato
+                            packetToSend.outcome = OPERATION_SUCCESS;
+                            packetToSend.matchIndex = packetReceived.matchIndex;
+                            strncpy(packetToSend.name, found.name, strlen(found.name));
+                            strncpy(packetToSend.surname, found.surname, strlen(found.surname));
+                            strncpy(packetToSend.phoneNumber, found.phoneNumber, strlen(found.phoneNumber));
+
+                            // Per il logging
+                            status = SUCCESS;
+                            sprintf(additionalMsg, "Found matching contact: [%s, %s, %s]", found.name, found.surname, found.phoneNumber);
+                        } else {
+
+                            // Nessun numero termina con le cifre indicate
+                            packetToSend.outcome = READ_CONTACT_MISSING;
+
+                            // Per il logging
+                            status = FAILURE;
+                            sprintf(additionalMsg, "Finished file without any contacts");
+                        }
+
+                        // Per il logging indichiamo solo i parametri richiesti
+                        sprintf(requestMsg, "Requested phone suffix search for contact number %d that matches [", packetReceived.matchIndex);
+                        if(toSearch.name[0] != '\0') sprintf(requestMsg + strlen(requestMsg), "-Name: %s ", toSearch.name);
+                        if(toSearch.surname[0] != '\0') sprintf(requestMsg + strlen(requestMsg), "-Surname: %s ", toSearch.surname);
+                        sprintf(requestMsg + strlen(requestMsg), "-Phone number ending with: %s]", toSearch.phoneNumber);
+                        break;
+
+                    /*
+                     * Il client ha richiesto la rubrica in ordine alfabetico (cognome, nome, numero)
+                     * name, surname e phoneNumber contengono il primo contatto dell'intervallo,
+                     * newName, newSurname e newPhoneNumber l'ultimo (campi vuoti non limitano)
+                     * matchIndex indica quale contatto dell'intervallo restituire
+                     */
+                    case ORDERED_READ:
+
+                        // Estremi dell'intervallo
+                        Contact from, to;
+                        createEmptyContact(&from);
+                        createEmptyContact(&to);
+                        strncpy(from.name, packetReceived.name, strlen(packetReceived.name));
+                        strncpy(from.surname, packetReceived.surname, strlen(packetReceived.surname));
+                        strncpy(from.phoneNumber, packetReceived.phoneNumber, strlen(packetReceived.phoneNumber));
+                        strncpy(to.name, packetReceived.newName, strlen(packetReceived.newName));
+                        strncpy(to.surname, packetReceived.newSurname, strlen(packetReceived.newSurname));
+                        strncpy(to.phoneNumber, packetReceived.newPhoneNumber, strlen(packetReceived.newPhoneNumber));
+                        packetToSend.operation = ORDERED_READ;
+
+                        // La ricerca avviene sulla skip list dell'ordinamento alfabetico
+                        if(findOrderedContact(from, to, packetReceived.matchIndex, &found)) {
+
+                            // Inizializziamo il pacchetto di risposta indicando il successo e il contatto trovato
+                            packetToSend.outcome = OPERATION_SUCCESS;
+                            packetToSend.matchIndex = packetReceived.matchIndex;
+                            strncpy(packetToSend.name, found.name, strlen(found.name));
+                            strncpy(packetToSend.surname, found.surname, strlen(found.surname));
+                            strncpy(packetToSend.phoneNumber, found.phoneNumber, strlen(found.phoneNumber));
+
+                            // Per il logging
+                            status = SUCCESS;
+                            sprintf(additionalMsg, "Found contact: [%s, %s, %s]", found.name, found.surname, found.phoneNumber);
+                        } else {
+
+                            // L'intervallo non contiene altri contatti
+                            packetToSend.outcome = READ_CONTACT_MISSING;
+
+                            // Per il logging
+                            status = FAILURE;
+                            sprintf(additionalMsg, "No more contacts in range");
+                        }
+
+                        // Per il logging indichiamo gli estremi richiesti
+                        sprintf(requestMsg, "Requested ordered contact number %d from [%s, %s, %s] to [%s, %s, %s]", packetReceived.matchIndex,
+                            from.name, from.surname, from.phoneNumber, to.name, to.surname, to.phoneNumber);
+                        break;
+
+                    /*
+                     * Il client ha richiesto quanti contatti corrispondono ai criteri di ricerca,
+                     * senza riceverli. I criteri sono quelli di una lettura, newName indica quale:
+                     * READ (predefinita), INSENSITIVE_READ o SUFFIX_READ
+                     * Il numero di corrispondenze viene inviato in matchIndex
+                     */
+                    case COUNT:
+
+                        // Inizializziamo i criteri di ricerca con le informazioni del pacchetto
+                        createEmptyContact(&toSearch);
+                        strncpy(toSearch.name, packetReceived.name, strlen(packetReceived.name));
+                        strncpy(toSearch.surname, packetReceived.surname, strlen(packetReceived.surname));
+                        strncpy(toSearch.phoneNumber, packetReceived.phoneNumber, strlen(packetReceived.phoneNumber));
+                        packetToSend.operation = COUNT;
+
+                        // Contiamo sugli indici in memoria, senza leggere i contatti uno per uno
+                        char countedOperation = packetReceived.newName[0] != '\0' ? packetReceived.newName[0] : READ;
+                        int matches = -1;
+                        if(countedOperation == READ)
+                            matches = countContacts(toSearch, SEARCH_EXACT);
+                        else if(countedOperation == INSENSITIVE_READ)
+                            matches = countContacts(toSearch, SEARCH_INSENSITIVE);
+                        else if(countedOperation == SUFFIX_READ)
+                            matches = countContactsByPhoneSuffix(toSearch, SEARCH_INSENSITIVE);
+
+                        if(matches >= 0) {
+
+                            // Il conteggio viaggia in matchIndex
+                            packetToSend.outcome = OPERATION_SUCCESS;
+                            packetToSend.matchIndex = matches;
+
+                            // Per il logging
+                            status = SUCCESS;
+                            sprintf(additionalMsg, "Counted %d matching contacts", matches);
+                        } else {
+
+                            // Operazione da contare non valida o errore di memoria
+                            packetToSend.outcome = SERVER_ERROR;
+
+                            // Per il logging
+                            status = FAILURE;
+                            sprintf(additionalMsg, "Could not count contacts");
+                        }
+
+                        // Per il logging indichiamo solo i parametri richiesti
+                        sprintf(requestMsg, "Requested count of contacts (operation %c) that match [", countedOperation);
+                        if(toSearch.name[0] != '\0') sprintf(requestMsg + strlen(requestMsg), "-Name: %s ", toSearch.name);
+                        if(toSearch.surname[0] != '\0') sprintf(requestMsg + strlen(requestMsg), "-Surname: %s ", toSearch.surname);
+                        if(toSearch.phoneNumber[0] != '\0') sprintf(requestMsg + strlen(requestMsg), "-Phone number: %s", toSearch.phoneNumber);
+                        sprintf(requestMsg + strlen(requestMsg), "]");
+                        break;
+
                     /*
                      * Il client ha richiesto un'operazione di autenticazione
                      * Invia nome utente e password e controlla la sua validita'
@@ -362,21 +1253,39 @@ int main(int argc, char **argv) {
                         // Leggiamo username e password e li controlliamo
                         packetToSend.operation = AUTH;
 
+                        /*
+                         * Una sessione autenticata serve a modificare la rubrica, che la replica riceve solo dal primario,
+                         * e le rubriche personali (PERSONAL_BOOK) non vengono replicate: il client deve autenticarsi li'
+                         */
+                        if(isReplica()) {
+                            redirectToPrimary(&packetToSend);
+                            status = FAILURE;
+                            sprintf(requestMsg, "Requested operation %c on read-only replica", packetReceived.operation);
+                            sprintf(additionalMsg, "Redirected to primary %s:%u", packetToSend.username, packetToSend.matchIndex);
+                            break;
+                        }
+
                         /*
                          * Il nome utente non puo' essere vuoto
                          * Quindi procediamo solo in caso sia corretto
                          */
                         if(packetReceived.username[0] != '\0') {
 
-                            // Controlliamo la validita' delle credenziali
-                            if(checkCredentials(packetReceived.username, packetReceived.password)) { // Se sono corrette
+                            /*
+                             * Controlliamo la validita' delle credenziali
+                             * Solo se il client lo chiede (PERSONAL_BOOK) la sessione passa alla rubrica personale dell'utente,
+                             * altrimenti resta sulla rubrica condivisa (anche dopo una rubrica personale scelta in precedenza)
+                             */
+                            int personal = packetReceived.newName[0] == PERSONAL_BOOK;
+                            if(checkCredentials(packetReceived.username, packetReceived.password) && selectContactBook(personal ? packetReceived.username : NULL)) { // Se sono corrette
+                                personalBook = personal;
                             
                                 // Inizializziamo il pacchetto di risposta da inviare al client, indicando il successo
                                 packetToSend.outcome = OPERATION_SUCCESS;
 
                                 // Per logging
                                 status = SUCCESS;
-                                sprintf(additionalMsg, "User identified as [%s]", packetReceived.username);
+                                sprintf(additionalMsg, "User identified as [%s], using address book %s", packetReceived.username, getContactBookPath());
                             } else {
 
                                 // Inizializziamo il pacchetto di risposta da inviare al client, indicando il fallimento
@@ -400,7 +1309,7 @@ int main(int argc, char **argv) {
                     /*
                      * Il client ha richiesto un'operazione di aggiunta di un contatto
                      * Invia nome utente e password, per verificarne la validita' (l'utente potrebbe essere stato modificato o eliminato)
-                     * Invia inoltre un contatto da aggiungere alla rubrica, se non è gia' presente
+                     * Invia inoltre un contatto da aggiungere alla rubrica della sessione, se non è gia' presente
                      * Invia al client un pacchetto contenente l'esito
                      */
                     case ADD:
@@ -408,8 +1317,17 @@ int main(int argc, char **argv) {
                         // Inizializziamo il pacchetto da inviare
                         packetToSend.operation = ADD;
 
-                        // Controlliamo se l'utente è autorizzato
-                        if(checkCredentials(packetReceived.username, packetReceived.password)) {
+                        // Una replica non modifica la rubrica: il client deve rivolgersi al primario
+                        if(isReplica()) {
+                            redirectToPrimary(&packetToSend);
+                            status = FAILURE;
+                            sprintf(requestMsg, "Requested operation %c on read-only replica", packetReceived.operation);
+                            sprintf(additionalMsg, "Redirected to primary %s:%u", packetToSend.username, packetToSend.matchIndex);
+                            break;
+                        }
+
+                        // Controlliamo se l'utente è autorizzato (con la rubrica personale la modifica va a quella delle credenziali inviate)
+                        if(checkCredentials(packetReceived.username, packetReceived.password) && selectContactBook(personalBook ? packetReceived.username : NULL)) {
 
                             // Inizializziamo il contatto da aggiungere
                             Contact toAdd;
@@ -418,8 +1336,20 @@ int main(int argc, char **argv) {
                             strncpy(toAdd.surname, packetReceived.surname, strlen(packetReceived.surname));
                             strncpy(toAdd.phoneNumber, packetReceived.phoneNumber, strlen(packetReceived.phoneNumber));
 
-                            // Proviamo ad aggiungerlo
+                            // Proviamo ad aggiungerlo, partendo da un'istantanea aggiornata della rubrica
+                            Contact none;
+                            createEmptyContact(&none);
+                            beginContactChange();
+                            refreshContactIndex();
+                            if(isSharedContactBook())
+                                checkFeedBook();
                             int addRes = addContact(toAdd);
+                            if(addRes == 1) {
+                                applyContactAdded(toAdd);
+                                if(isSharedContactBook())
+                                    publishContactChange(ADD, none, toAdd);
+                            }
+                            endContactChange(none, addRes == 1 ? toAdd : none);
                             
                             if(addRes == 1) { 
 
@@ -473,8 +1403,17 @@ int main(int argc, char **argv) {
                         packetToSend.operation = DEL;
                         Contact toRemove;
 
+                        // Una replica non modifica la rubrica: il client deve rivolgersi al primario
+                        if(isReplica()) {
+                            redirectToPrimary(&packetToSend);
+                            status = FAILURE;
+                            sprintf(requestMsg, "Requested operation %c on read-only replica", packetReceived.operation);
+                            sprintf(additionalMsg, "Redirected to primary %s:%u", packetToSend.username, packetToSend.matchIndex);
+                            break;
+                        }
+
                         // Controlliamo se l'utente è autorizzato
-                        if(checkCredentials(packetReceived.username, packetReceived.password)) {
+                        if(checkCredentials(packetReceived.username, packetReceived.password) && selectContactBook(personalBook ? packetReceived.username : NULL)) {
 
                             // Inizializziamo una struct con le informazioni del contatto da rimuovere
                             createEmptyContact(&toRemove);
@@ -482,8 +1421,20 @@ int main(int argc, char **argv) {
                             strncpy(toRemove.surname, packetReceived.surname, strlen(packetReceived.surname));
                             strncpy(toRemove.phoneNumber, packetReceived.phoneNumber, strlen(packetReceived.phoneNumber));
 
-                            // Tentiamo la rimozione
+                            // Tentiamo la rimozione, partendo da un'istantanea aggiornata della rubrica
+                            Contact none;
+                            createEmptyContact(&none);
+                            beginContactChange();
+                            refreshContactIndex();
+                            if(isSharedContactBook())
+                                checkFeedBook();
                             int removed = removeContact(toRemove);
+                            if(removed == 1) {
+                                applyContactRemoved(toRemove);
+                                if(isSharedContactBook())
+                                    publishContactChange(DEL, toRemove, none);
+                            }
+                            endContactChange(removed == 1 ? toRemove : none, none);
                             if(removed == 1) {
 
                                 // Il contatto è stato rimosso con successo
@@ -535,8 +1486,17 @@ int main(int argc, char **argv) {
                         packetToSend.operation = MODIFY;
                         Contact toModify, modified;
 
+                        // Una replica non modifica la rubrica: il client deve rivolgersi al primario
+                        if(isReplica()) {
+                            redirectToPrimary(&packetToSend);
+                            status = FAILURE;
+                            sprintf(requestMsg, "Requested operation %c on read-only replica", packetReceived.operation);
+                            sprintf(additionalMsg, "Redirected to primary %s:%u", packetToSend.username, packetToSend.matchIndex);
+                            break;
+                        }
+
                         // Controlliamo se l'utente è autorizzato
-                        if(checkCredentials(packetReceived.username, packetReceived.password)) {
+                        if(checkCredentials(packetReceived.username, packetReceived.password) && selectContactBook(personalBook ? packetReceived.username : NULL)) {
 
                             // Inizializziamo due struct, una con il contatto vecchio, da modificare, e una con il contatto nuovo
                             createEmptyContact(&toModify);
@@ -549,8 +1509,20 @@ int main(int argc, char **argv) {
                             strncpy(modified.surname, packetReceived.newSurname, strlen(packetReceived.newSurname));
                             strncpy(modified.phoneNumber, packetReceived.newPhoneNumber, strlen(packetReceived.newPhoneNumber));
 
-                            // Tentiamo la modifica
+                            // Tentiamo la modifica, partendo da un'istantanea aggiornata della rubrica
+                            Contact none;
+                            createEmptyContact(&none);
+                            beginContactChange();
+                            refreshContactIndex();
+                            if(isSharedContactBook())
+                                checkFeedBook();
                             int modifiedRes = modifyContact(toModify, modified);
+                            if(modifiedRes == 1) {
+                                applyContactModified(toModify, modified);
+                                if(isSharedContactBook())
+                                    publishContactChange(MODIFY, toModify, modified);
+                            }
+                            endContactChange(modifiedRes == 1 ? toModify : none, modifiedRes == 1 ? modified : none);
                             if(modifiedRes == 1) {
 
                                 // Il contatto è stato modificato con successo
@@ -567,6 +1539,14 @@ int main(int argc, char **argv) {
                                 // Per logging
                                 status = FAILURE;
                                 sprintf(additionalMsg, "Could not modify contact, wasn't present");
+                            } else if(modifiedRes == 3) {
+
+                                // Il contatto non è stato modificato in quanto quello nuovo era gia' presente
+                                packetToSend.outcome = CONTACT_ALREADY_EXISTS;
+
+                                // Per logging
+                                status = FAILURE;
+                                sprintf(additionalMsg, "Could not modify contact, new contact already present");
                             } else {
 
                                 // Il contatto non è stato modificato per errore dovuto al file rubrica
@@ -591,6 +1571,223 @@ int main(int argc, char **argv) {
                         sprintf(requestMsg + strlen(requestMsg), " with new info [%s, %s, %s]", modified.name, modified.surname, modified.phoneNumber);
                         break;
 
+                    /*
+                     * Il client si e' iscritto alle modifiche della rubrica
+                     * Confermiamo l'iscrizione e da quel momento inviamo un pacchetto per ogni
+                     * aggiunta, rimozione o modifica fatta da qualsiasi sessione, finche' il
+                     * client non invia un altro pacchetto SUBSCRIBE
+                     *
+                     * Le modifiche arrivano dalla coda condivisa: se il client legge troppo
+                     * lentamente la coda lo supera (chi modifica la rubrica non lo aspetta mai)
+                     * e gli viene segnalato con CHANGES_LOST
+                     */
+                    case SUBSCRIBE:
+
+                        packetToSend.operation = SUBSCRIBE;
+                        sprintf(requestMsg, "Subscription to address book changes");
+
+                        // Solo le modifiche alla rubrica condivisa passano dalla coda
+                        if(!isSharedContactBook()) {
+                            packetToSend.outcome = SERVER_ERROR;
+                            status = FAILURE;
+                            sprintf(additionalMsg, "Not available for personal address books");
+                            break;
+                        }
+
+                        unsigned int lastSent = getFeedVersion();
+                        int sent = 0, lost = 0;
+
+                        // Confermiamo l'iscrizione indicando il numero dell'ultima modifica
+                        packetToSend.outcome = OPERATION_SUCCESS;
+                        packetToSend.matchIndex = lastSent;
+                        int subscribed = sendPacket(packetToSend);
+
+                        /*
+                         * Attendiamo le modifiche controllando ogni FEED_WAIT_MS se il client ha inviato qualcosa
+                         * o se il server ha passato le socket a un successore (stopStreaming)
+                         */
+                        struct pollfd clientPoll = {clientFd, POLLIN, 0};
+                        while(subscribed && !stopStreaming && poll(&clientPoll, 1, 0) == 0) {
+                            contactChange changes[FEED_SIZE];
+                            int count = waitContactChanges(lastSent, changes, FEED_SIZE);
+
+                            if(count < 0) { // Modifiche perse, il client riprende dall'ultima
+                                lastSent = getFeedVersion();
+                                subscribed = sendChangesLost(SUBSCRIBE, lastSent);
+                                lost++;
+                            }
+                            for(int i = 0; i < count && subscribed; i++) {
+
+                                // Dopo una modifica esterna della rubrica il client deve rileggerla
+                                if(changes[i].operation == 0) {
+                                    subscribed = sendChangesLost(SUBSCRIBE, changes[i].version);
+                                    lost++;
+                                } else {
+                                    subscribed = sendChange(&changes[i]);
+                                    sent++;
+                                }
+                                lastSent = changes[i].version;
+                            }
+                        }
+
+                        /*
+                         * Il server sta per terminare: chiudiamo l'iscrizione con un pacchetto SERVER_BUSY
+                         * (matchIndex e' l'ultima modifica inviata) e la sessione, il client si iscrive di nuovo
+                         * sul nuovo server
+                         */
+                        if(subscribed && stopStreaming) {
+                            packetToSend.outcome = SERVER_BUSY;
+                            packetToSend.matchIndex = lastSent;
+                            sendPacket(packetToSend);
+                            close(clientFd);
+                            sprintf(additionalMsg, "Subscription closed for server restart, %d changes sent, %d notifications of lost changes", sent, lost);
+                            formatMessage(&toBeLogged, operationAuthor, requestMsg, SUCCESS, additionalMsg);
+                            logF(toBeLogged);
+                            exit(EXIT_SUCCESS);
+                        }
+
+                        /*
+                         * Il client chiude l'iscrizione inviando un nuovo pacchetto SUBSCRIBE,
+                         * lo consumiamo qui e rispondiamo con il numero dell'ultima modifica inviata
+                         */
+                        if(subscribed && readPacket(socketBuffer) != PACKET_LENGTH) {
+                            close(clientFd);
+                            formatMessage(&toBeLogged, operationAuthor, "Connection terminated", FAILURE, "Error during client request, closing socket");
+                            logF(toBeLogged);
+                            exit(EXIT_FAILURE);
+                        }
+                        packetToSend.matchIndex = lastSent;
+                        status = subscribed ? SUCCESS : FAILURE;
+                        sprintf(additionalMsg, "Subscription ended, %d changes sent, %d notifications of lost changes", sent, lost);
+                        break;
+
+                    /*
+                     * Il client chiede le modifiche avvenute dopo la versione della rubrica che possiede
+                     * (in matchIndex, 0 se non ne possiede nessuna)
+                     *
+                     * Se sono ancora tutte nel registro inviamo solo quelle, un pacchetto per modifica
+                     * come per SUBSCRIBE, altrimenti inviamo un pacchetto con esito CHANGES_LOST
+                     * (il client scarta la sua copia) seguito da un ADD per ogni contatto della rubrica
+                     * Al termine rispondiamo con la versione raggiunta, in matchIndex
+                     */
+                    case SYNC_SINCE:
+
+                        packetToSend.operation = SYNC_SINCE;
+                        sprintf(requestMsg, "Requested changes since version %u", packetReceived.matchIndex);
+
+                        // Come per SUBSCRIBE, il registro contiene solo le modifiche alla rubrica condivisa
+                        if(!isSharedContactBook()) {
+                            packetToSend.outcome = SERVER_ERROR;
+                            status = FAILURE;
+                            sprintf(additionalMsg, "Not available for personal address books");
+                            break;
+                        }
+
+                        unsigned int until = 0;
+                        int snapshot, syncSent = sendChangesSince(SYNC_SINCE, packetReceived.matchIndex, &until, &snapshot), syncOk = syncSent >= 0;
+                        if(snapshot)
+                            sprintf(additionalMsg, "Sent full snapshot of %d contacts", syncSent);
+                        else
+                            sprintf(additionalMsg, "Sent %d changes", syncSent);
+
+                        packetToSend.outcome = syncOk ? OPERATION_SUCCESS : SERVER_ERROR;
+                        packetToSend.matchIndex = until;
+                        status = syncOk ? SUCCESS : FAILURE;
+                        break;
+
+                    /*
+                     * Una replica chiede le modifiche successive all'ultima che ha applicato (in matchIndex)
+                     * Inviamo quelle mancanti come in SYNC_SINCE, poi ogni nuova modifica come in SUBSCRIBE,
+                     * seguite da un pacchetto di stato con il numero dell'ultima modifica del primario
+                     * (inviato anche ogni FEED_WAIT_MS senza modifiche), da cui la replica calcola il ritardo
+                     *
+                     * Se la replica resta troppo indietro rispetto alla coda riprendiamo dal registro
+                     * e, dopo una modifica esterna della rubrica, inviamo di nuovo tutta la rubrica
+                     */
+                    case REPLICATE:
+
+                        packetToSend.operation = REPLICATE;
+                        sprintf(requestMsg, "Replication requested from version %u", packetReceived.matchIndex);
+
+                        // Si replica solo la rubrica condivisa
+                        if(!isSharedContactBook() || isReplica()) {
+                            packetToSend.outcome = SERVER_ERROR;
+                            status = FAILURE;
+                            sprintf(additionalMsg, isReplica() ? "Not available on a replica" : "Not available for personal address books");
+                            break;
+                        }
+
+                        unsigned int shipped = packetReceived.matchIndex;
+                        int shippedNow, shippedTotal = 0, snapshots = 0, snapshotSent;
+                        shippedNow = sendChangesSince(REPLICATE, shipped, &shipped, &snapshotSent);
+                        int shipping = shippedNow >= 0 && sendReplicaStatus();
+                        shippedTotal += shippedNow;
+                        snapshots += snapshotSent;
+
+                        /*
+                         * Attendiamo le modifiche finche' la replica non chiude il collegamento
+                         * o il server termina o passa le socket a un successore: la replica si ricollega al nuovo server
+                         */
+                        pid_t serverPid = getppid();
+                        struct pollfd replicaPoll = {clientFd, POLLIN, 0};
+                        while(shipping && !stopStreaming && getppid() == serverPid && poll(&replicaPoll, 1, 0) == 0) {
+                            contactChange changes[FEED_SIZE];
+                            int count = waitContactChanges(shipped, changes, FEED_SIZE);
+
+                            /*
+                             * Senza modifiche controlliamo anche che la rubrica non sia stata cambiata
+                             * senza passare dal server: in quel caso pubblichiamo il riavvio, che arrivera'
+                             * alla prossima attesa
+                             */
+                            if(count == 0 && !isFeedInSync()) {
+                                Contact none;
+                                createEmptyContact(&none);
+                                beginContactChange();
+                                checkFeedBook();
+                                endContactChange(none, none);
+                            }
+
+                            /*
+                             * Il pacchetto di stato precede le modifiche: la replica conosce subito
+                             * l'ultima modifica del primario e misura il ritardo mentre le applica
+                             */
+                            shipping = sendReplicaStatus();
+
+                            // Modifiche gia' uscite dalla coda o modifica esterna: ripartiamo dal registro
+                            int resync = count < 0;
+                            for(int i = 0; i < count && shipping && !resync; i++) {
+                                if(changes[i].operation == 0) {
+                                    resync = 1;
+                                } else {
+                                    shipping = sendChange(&changes[i]);
+                                    shipped = changes[i].version;
+                                    shippedTotal++;
+                                }
+                            }
+                            if(shipping && resync) {
+                                shippedNow = sendChangesSince(REPLICATE, shipped, &shipped, &snapshotSent);
+                                shipping = shippedNow >= 0;
+                                shippedTotal += shippedNow;
+                                snapshots += snapshotSent;
+                                if(shipping)
+                                    shipping = sendReplicaStatus();
+                            }
+                        }
+
+                        // Con il passaggio delle socket avvisiamo la replica, che si ricollega subito senza attendere
+                        if(shipping && stopStreaming) {
+                            packetToSend.outcome = SERVER_BUSY;
+                            packetToSend.matchIndex = shipped;
+                            sendPacket(packetToSend);
+                        }
+
+                        // La replica ha chiuso il collegamento (o non e' piu' raggiungibile) o il server termina: la sessione termina
+                        close(clientFd);
+                        sprintf(additionalMsg, "Replica disconnected at version %u, %d changes and %d full snapshots sent", shipped, shippedTotal, snapshots);
+                        formatMessage(&toBeLogged, operationAuthor, requestMsg, shipping ? SUCCESS : FAILURE, additionalMsg);
+                        logF(toBeLogged);
+                        exit(EXIT_SUCCESS);
+
                     /*
                      * Il client ha richiesto di interrompere la connessione
                      * con il server
@@ -642,15 +1839,29 @@ int main(int argc, char **argv) {
                     logF(toBeLogged);
                     exit(EXIT_FAILURE);
                 }
+                clock_gettime(CLOCK_MONOTONIC, &requestEnd);
+                unsigned long latencyUs = (unsigned long)((requestEnd.tv_sec - requestStart.tv_sec) * 1000000L + (requestEnd.tv_nsec - requestStart.tv_nsec) / 1000);
+                recordRequest(packetReceived.operation, packetToSend.outcome, latencyUs);
+
+                traced.connection = (unsigned int)getpid();
+                traced.latencyUs = (unsigned int)latencyUs;
+                traced.outcome = packetToSend.outcome;
+                traceRequest(&traced);
             }
             
             // Chiudiamo la socket e terminiamo l'esecuzione
             close(clientFd);
             exit(EXIT_SUCCESS);
 
-        } else { 
-            // Processo padre, continua a stare in ascolto di richieste
+        }
+
+        // Processo padre, continua a stare in ascolto di richieste
+        sigprocmask(SIG_SETMASK, &previousMask, NULL);
+        if(pid > 0) {
+            sessionStarted(pid, waitedMs);
             close(clientFd); // Chiude il descrittore di file
+        } else {
+            rejectConnection(clientFd, "Server busy, couldn't start session process");
         }
     }
     return 0;
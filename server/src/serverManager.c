@@ -9,11 +9,141 @@
 #include "../include/utility.h"
 #include "../include/log.h"
 #include "../include/connection.h"
+#include "../include/queryCache.h"
+#include "../include/replica.h"
+#include "../include/admission.h"
+#include "../include/metrics.h"
+#include "../include/changeFeed.h"
+#include "../include/contactIndex.h"
 #include <unistd.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/stat.h>
+
+// Intervallo di aggiornamento della schermata delle statistiche, in millisecondi
+#define STATS_REFRESH_MS 1000
+
+/**
+ * Scrive in text la latenza latencyUs in un formato leggibile (us, ms o s), "-" se non ci sono richieste
+ */
+static void formatLatency(char *text, unsigned long latencyUs, int requests) {
+    if(!requests)
+        sprintf(text, "-");
+    else if(latencyUs < 10000)
+        sprintf(text, "%lu us", latencyUs);
+    else if(latencyUs < 10000000)
+        sprintf(text, "%lu ms", latencyUs / 1000);
+    else
+        sprintf(text, "%lu s", latencyUs / 1000000);
+}
+
+/**
+ * Schermata delle statistiche del server, aggiornata ogni STATS_REFRESH_MS finche' l'utente non preme INVIO
+ *
+ * Tutto viene letto dai file condivisi (metriche, controllo di ammissione, coda delle modifiche)
+ * e dalla rubrica, senza comunicare con il server: osservarlo non gli costa nulla
+ * Richieste al secondo e percentili si riferiscono all'ultimo intervallo, calcolati dalla differenza
+ * tra due letture consecutive degli istogrammi
+ */
+static void showLiveStats(void) {
+    static serverMetrics previous, current;
+    static latencyHistogram interval;
+    struct timespec previousTime, currentTime;
+    int havePrevious = 0;
+
+    while(1) {
+        clock_gettime(CLOCK_MONOTONIC, &currentTime);
+        int haveMetrics = readMetrics(&current);
+        double elapsed = havePrevious ? (currentTime.tv_sec - previousTime.tv_sec) + (currentTime.tv_nsec - previousTime.tv_nsec) / 1e9 : 0;
+
+        printf(CLEAR);
+        printf(RESET_COLOR "Statistiche del server, aggiornate ogni secondo - premere " BCYAN "INVIO" RESET_COLOR " per tornare al menu\n\n");
+
+        if(!haveMetrics) {
+            printf(YELLOW "Metriche delle operazioni non disponibili\n" RESET_COLOR);
+        } else {
+            printf(UNDERLINE "%-17s %9s %11s %9s %9s %9s" RESET_COLOR "\n", "Operazione", "req/s", "totali", "p50", "p99", "p999");
+            latencyHistogram all;
+            memset(&all, 0, sizeof(all));
+            unsigned long allTotal = 0;
+            char p50[16], p99[16], p999[16];
+            for(int slot = 0; slot <= METRICS_SLOTS; slot++) {
+                latencyHistogram *shown = &interval;
+                unsigned long total;
+                if(slot < METRICS_SLOTS) {
+
+                    // Differenza con la lettura precedente: le richieste dell'ultimo intervallo
+                    const latencyHistogram *now = &current.operations[slot], *before = &previous.operations[slot];
+                    total = now->count;
+                    if(total == 0)
+                        continue;
+                    memset(&interval, 0, sizeof(interval));
+                    for(int b = 0; b < METRICS_BUCKETS; b++) {
+                        interval.buckets[b] = havePrevious ? now->buckets[b] - before->buckets[b] : 0;
+                        interval.count += interval.buckets[b];
+                        all.buckets[b] += interval.buckets[b];
+                    }
+                    all.count += interval.count;
+                    allTotal += total;
+                } else { // Riga finale con tutte le operazioni
+                    shown = &all;
+                    total = allTotal;
+                }
+                formatLatency(p50, metricsPercentile(shown, 0.5), shown->count > 0);
+                formatLatency(p99, metricsPercentile(shown, 0.99), shown->count > 0);
+                formatLatency(p999, metricsPercentile(shown, 0.999), shown->count > 0);
+                printf("%s%-17s %9.1f %11lu %9s %9s %9s" RESET_COLOR "\n", slot < METRICS_SLOTS ? "" : BCYAN,
+                    slot < METRICS_SLOTS ? metricsOperationName(slot) : "Totale",
+                    elapsed > 0 ? shown->count / elapsed : 0.0, total, p50, p99, p999);
+            }
+            printf("\nEsiti:");
+            for(int i = 0; i < METRICS_OUTCOME_SLOTS; i++)
+                if(current.outcomes[i])
+                    printf(" %c=%lu", i < METRICS_OUTCOME_SLOTS - 1 ? METRICS_OUTCOMES[i] : '?', current.outcomes[i]);
+            printf("\n");
+        }
+
+        // Sessioni attive e in coda
+        admissionStats admission;
+        if(getAdmissionStats(&admission))
+            printf("\nSessioni attive: " MAGENTA "%d" RESET_COLOR "/%d, in coda: " MAGENTA "%d" RESET_COLOR "/%d, rifiutate: %lu\n",
+                admission.active, admission.maxSessions, admission.waiting, admission.maxWaiting, admission.rejected);
+
+        // Rubrica condivisa: il manager la rilegge solo quando cambia
+        struct stat book;
+        selectContactBook(NULL);
+        int contacts = refreshContactIndex();
+        if(statContactBook(SHARED_BOOK_PATH, &book))
+            printf("Rubrica condivisa: " MAGENTA "%d" RESET_COLOR " contatti, %lld byte in %d segmenti\n",
+                contacts, (long long)book.st_size, getContactBookSegments(SHARED_BOOK_PATH, NULL));
+
+        // Il log viene scritto in modo sincrono: mostriamo le modifiche trattenute nel registro e la dimensione del log
+        unsigned int version, retained;
+        struct stat logInfo;
+        if(getFeedStats(&version, &retained))
+            printf("Registro delle modifiche: " MAGENTA "%u" RESET_COLOR " modifiche conservate, ultima %u\n", retained, version);
+        if(stat("files/log.txt", &logInfo) == 0)
+            printf("File di log: %lld KB\n", (long long)logInfo.st_size / 1024);
+
+        if(haveMetrics) {
+            previous = current;
+            previousTime = currentTime;
+            havePrevious = 1;
+        }
+
+        // Attendiamo l'intervallo o l'INVIO dell'utente
+        fflush(stdout);
+        struct pollfd input = {STDIN_FILENO, POLLIN, 0};
+        if(poll(&input, 1, STATS_REFRESH_MS) > 0) {
+            cleanInputBuffer();
+            return;
+        }
+    }
+}
 
 /*
  * Il processo figlio, che comunica con il client è immune a CTRL-C
@@ -56,6 +186,11 @@ int main(int argc, char **argv) {
         printf(RESET_COLOR "Server utilities - Scegli operazione da eseguire:\n\n");
         printf("[" BCYAN "+" RESET_COLOR "] Aggiungi utente\n");
         printf("[" BCYAN "-" RESET_COLOR "] Rimuovi utente\n");
+        printf("[" BCYAN "c" RESET_COLOR "] Statistiche cache delle letture\n");
+        printf("[" BCYAN "r" RESET_COLOR "] Ripartisci una rubrica in segmenti\n");
+        printf("[" BCYAN "l" RESET_COLOR "] Stato della replica\n");
+        printf("[" BCYAN "a" RESET_COLOR "] Sessioni e connessioni in coda\n");
+        printf("[" BCYAN "v" RESET_COLOR "] Statistiche in tempo reale\n");
         printf("[" BYELLOW "x" RESET_COLOR "] Esci dal menu\n");
         printf("[" BRED "S" RESET_COLOR "] Termina server\n\n");
 
@@ -136,7 +271,7 @@ int main(int argc, char **argv) {
                 printf("Aggiunta dell'utente:\n\n");
                 printf("  Username: " MAGENTA "%s\n" RESET_COLOR, username);
                 char hiddenPassword[AUTH_PARAM_LENGTH + 1];
-                int i;
+                size_t i;
                 for(i = 0; i < strlen(password); i++)
                     hiddenPassword[i] = '*';
                 hiddenPassword[i] = '\0';
@@ -243,6 +378,116 @@ int main(int argc, char **argv) {
                 }
                 break;
 
+            // Contatori della cache condivisa delle letture
+            case 'c':
+            case 'C':
+                {
+                    queryCacheStats stats;
+                    if(getQueryCacheStats(&stats)) {
+                        unsigned long total = stats.hits + stats.misses;
+                        sprintf(additional, "Cache: %lu hit, %lu miss (%lu%% hit), %lu risultati invalidati",
+                            stats.hits, stats.misses, total ? stats.hits * 100 / total : 0, stats.invalidations);
+                        sprintf(color, GREEN);
+                    } else {
+                        sprintf(additional, "Cache delle letture non disponibile");
+                        sprintf(color, YELLOW);
+                    }
+                }
+                break;
+
+            // Ridistribuzione dei contatti di una rubrica in un altro numero di segmenti
+            case 'r':
+            case 'R':
+                {
+                    // Rubrica da ripartire: quella condivisa o quella personale di un utente
+                    printf("Digitare l'utente di cui ripartire la rubrica (vuoto per la rubrica condivisa):\n\n");
+                    printf("  Username: " MAGENTA);
+                    getOptionalInput(username, AUTH_PARAM_LENGTH + 2);
+                    printf(RESET_COLOR);
+                    if(!selectContactBook(username)) {
+                        sprintf(additional, "Nome utente digitato non valido: utilizzare solo lettere e numeri");
+                        sprintf(color, RED);
+                        break;
+                    }
+
+                    // Numero di segmenti, mostrando quello attuale
+                    char segmentsInput[4];
+                    printf("\n  Segmenti attuali di %s: " MAGENTA "%d\n" RESET_COLOR, getContactBookPath(), getContactBookSegments(getContactBookPath(), NULL));
+                    printf("  Nuovo numero di segmenti (da 1 a %d): " MAGENTA, MAX_BOOK_SEGMENTS);
+                    getOptionalInput(segmentsInput, sizeof(segmentsInput));
+                    printf(RESET_COLOR);
+                    int segments = atoi(segmentsInput);
+                    if(segments < 1 || segments > MAX_BOOK_SEGMENTS) {
+                        sprintf(additional, "Numero di segmenti non valido");
+                        sprintf(color, RED);
+                        break;
+                    }
+
+                    // La ripartizione avviene con il server attivo: le modifiche alla rubrica aspettano che finisca
+                    int moved = reshardContactBook(segments);
+                    if(moved >= 0) {
+                        status = SUCCESS;
+                        sprintf(additional, "Rubrica %s ripartita in %d segmenti (%d contatti)", getContactBookPath(), segments, moved);
+                        sprintf(color, GREEN);
+                    } else {
+                        status = FAILURE;
+                        sprintf(additional, "Impossibile ripartire la rubrica %s", getContactBookPath());
+                        sprintf(color, RED);
+                    }
+
+                    // Facciamo log dell'operazione
+                    sprintf(opMsg, "Reshard address book [%s] into %d segments", getContactBookPath(), segments);
+                    formatMessage(&toBeLogged, operationAuthor, opMsg, status, additional);
+                    logF(toBeLogged);
+                }
+                break;
+
+            // Ritardo della replica rispetto al primario che segue
+            case 'l':
+            case 'L':
+                {
+                    replicaStatus replica;
+                    if(readReplicaStatus(&replica)) {
+                        unsigned int lagOps;
+                        unsigned long lagBytes;
+                        getReplicaLag(&replica, &lagOps, &lagBytes);
+                        snprintf(additional, ADDITIONAL_MESSAGE_MAX_LENGTH, "Replica di %s:%d (%s): modifica %u applicata, %u sul primario, ritardo %u modifiche (%lu byte)",
+                            replica.primaryHost, replica.primaryPort, replica.connected ? "collegata" : "non collegata",
+                            replica.applied, replica.primaryVersion, lagOps, lagBytes);
+                        if(replica.updated)
+                            snprintf(additional + strlen(additional), ADDITIONAL_MESSAGE_MAX_LENGTH - strlen(additional), ", stato di %lds fa", (long)(time(NULL) - replica.updated));
+                        sprintf(color, replica.connected ? GREEN : YELLOW);
+                    } else {
+                        sprintf(additional, "Il server non e' una replica");
+                        sprintf(color, YELLOW);
+                    }
+                }
+                break;
+
+            // Contatori del controllo di ammissione: sessioni attive, coda e attese
+            case 'a':
+            case 'A':
+                {
+                    admissionStats admission;
+                    if(getAdmissionStats(&admission)) {
+                        snprintf(additional, ADDITIONAL_MESSAGE_MAX_LENGTH, "Sessioni %d/%d, coda %d/%d, avviate %lu (%lu in coda, media %lu ms, max %lu ms), rifiutate %lu, chiuse per inattivita' %lu, irraggiungibili %lu",
+                            admission.active, admission.maxSessions, admission.waiting, admission.maxWaiting, admission.admitted,
+                            admission.queued, admission.queued ? admission.totalWaitMs / admission.queued : 0, admission.maxWaitMs, admission.rejected,
+                            admission.idleClosed, admission.unreachableClosed);
+                        sprintf(color, admission.waiting > 0 || admission.rejected > 0 ? YELLOW : GREEN);
+                    } else {
+                        sprintf(additional, "Controllo di ammissione non disponibile");
+                        sprintf(color, YELLOW);
+                    }
+                }
+                break;
+
+            // Statistiche aggiornate ogni secondo, fino all'INVIO
+            case 'v':
+            case 'V':
+                showLiveStats();
+                break;
+
             // Uscita dal menu
             case 'x':
             case 'X':
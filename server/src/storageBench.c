@@ -0,0 +1,474 @@
+/*
+ * Copyright (c) 2024 Biribo' Francesco, Giannuzzi Riccardo, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Micro-benchmark delle funzioni di utility.c che lavorano sui file (rubrica e credenziali)
+ *
+ * Per ogni dimensione richiesta genera una rubrica sintetica e un file credenziali con altrettanti
+ * utenti in una cartella temporanea, poi misura ogni funzione da sola: tempo per chiamata,
+ * syscall di lettura e scrittura per chiamata e byte letti e scritti per chiamata
+ * (dai contatori del kernel in /proc/self/io, quindi open, close e rename non sono comprese)
+ *
+ * I risultati vengono anche aggiunti in formato CSV a un file, una riga per funzione e dimensione,
+ * con un'etichetta a scelta (ad esempio il commit) per confrontare misure diverse nel tempo
+ *
+ * Esempi di avvio, supponendo che il file eseguibile si chiami "storageBench":
+ *   ./storageBench - Rubriche da 1000, 10000 e 100000 contatti, risultati in storageBench.csv
+ *   ./storageBench -s 1000,10000000 -l $(git rev-parse --short HEAD) - Rubriche da 1e3 e 1e7 contatti, con il commit come etichetta
+ *   ./storageBench -g 8 -t 1000 -o risultati.csv - Rubriche divise in 8 segmenti, almeno un secondo per funzione
+ */
+
+#include "./../include/utility.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+
+#define DEFAULT_SIZES "1000,10000,100000" // Dimensioni delle rubriche se non specificate
+#define MIN_CONTACTS 1000
+#define MAX_CONTACTS 10000000 // Con gli inserimenti gli indici arrivano a 1.5 volte: restano nei limiti di syntheticContact
+#define MAX_SYNTHETIC_INDEX 1000000000UL // Indici dei contatti sintetici: al massimo 9 cifre dopo N e S, 10 per il numero
+#define MAX_SIZES 16
+#define DEFAULT_MIN_TIME_MS 200 // Tempo minimo di misura di ogni funzione
+#define DEFAULT_OUTPUT "storageBench.csv"
+#define MATCH_SAMPLES 1024 // Contatti in memoria confrontati da matchesParameters
+
+/**
+ * Contatori di I/O del processo, da /proc/self/io
+ *
+ * Campi:
+ *  readBytes - Byte letti con read e simili (rchar)
+ *  writtenBytes - Byte scritti con write e simili (wchar)
+ *  readCalls - Syscall di lettura (syscr)
+ *  writeCalls - Syscall di scrittura (syscw)
+ */
+typedef struct {
+    unsigned long long readBytes;
+    unsigned long long writtenBytes;
+    unsigned long long readCalls;
+    unsigned long long writeCalls;
+} ioCounters;
+
+/**
+ * Funzione misurata
+ *
+ * Campi:
+ *  name - Nome della funzione di utility.c
+ *  mutating - 1 se modifica la rubrica: le iterazioni sono limitate a meta' dei contatti
+ *             e la rubrica viene rigenerata dopo la misura
+ *  prepare - Preparazione prima della misura, non misurata (puo' essere NULL)
+ *  run - Iterazione numero k della misura
+ *  finish - Pulizia dopo la misura, non misurata (puo' essere NULL)
+ */
+typedef struct {
+    const char *name;
+    int mutating;
+    void (*prepare)(void);
+    void (*run)(long k);
+    void (*finish)(void);
+} storageBenchmark;
+
+// Parametri della dimensione in corso di misura
+static long bookSize;
+static long stride;
+static int bookSegments = 1;
+
+// Stato condiviso tra le iterazioni
+static int lineFd = -1;
+static Contact samples[MATCH_SAMPLES];
+static volatile long sink; // Impedisce al compilatore di eliminare le chiamate il cui risultato non viene usato
+static long failures;
+
+/**
+ * Restituisce l'istante attuale del clock monotono in nanosecondi
+ */
+static long long nowNs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/**
+ * Legge i contatori di I/O del processo
+ * Con una sola read e senza stdio, per pesare il meno possibile sui contatori stessi
+ *
+ * Restituisce 1 in caso di successo, 0 se /proc/self/io non e' disponibile
+ */
+static int readIoCounters(ioCounters *counters) {
+    memset(counters, 0, sizeof(ioCounters));
+    int fd = open("/proc/self/io", O_RDONLY);
+    if(fd < 0)
+        return 0;
+    char text[512];
+    ssize_t length = read(fd, text, sizeof(text) - 1);
+    close(fd);
+    if(length <= 0)
+        return 0;
+    text[length] = '\0';
+
+    char *field;
+    if((field = strstr(text, "rchar:")) != NULL) counters->readBytes = strtoull(field + 6, NULL, 10);
+    if((field = strstr(text, "wchar:")) != NULL) counters->writtenBytes = strtoull(field + 6, NULL, 10);
+    if((field = strstr(text, "syscr:")) != NULL) counters->readCalls = strtoull(field + 6, NULL, 10);
+    if((field = strstr(text, "syscw:")) != NULL) counters->writeCalls = strtoull(field + 6, NULL, 10);
+    return 1;
+}
+
+/**
+ * Salva in delta la differenza tra i contatori after e before, meno quanto costa leggerli (overhead)
+ */
+static void ioDelta(const ioCounters *before, const ioCounters *after, const ioCounters *overhead, ioCounters *delta) {
+    delta->readBytes = after->readBytes - before->readBytes;
+    delta->writtenBytes = after->writtenBytes - before->writtenBytes;
+    delta->readCalls = after->readCalls - before->readCalls;
+    delta->writeCalls = after->writeCalls - before->writeCalls;
+    delta->readBytes -= delta->readBytes > overhead->readBytes ? overhead->readBytes : delta->readBytes;
+    delta->writtenBytes -= delta->writtenBytes > overhead->writtenBytes ? overhead->writtenBytes : delta->writtenBytes;
+    delta->readCalls -= delta->readCalls > overhead->readCalls ? overhead->readCalls : delta->readCalls;
+    delta->writeCalls -= delta->writeCalls > overhead->writeCalls ? overhead->writeCalls : delta->writeCalls;
+}
+
+/**
+ * Salva in cntc il contatto sintetico numero index, diverso da tutti gli altri
+ * I campi rispettano i vincoli del server: al massimo 10 lettere o cifre, numero di 10 cifre
+ */
+static void syntheticContact(long index, Contact *cntc) {
+    unsigned long id = (unsigned long)index % MAX_SYNTHETIC_INDEX;
+    createEmptyContact(cntc);
+    snprintf(cntc->name, sizeof(cntc->name), "N%lu", id);
+    snprintf(cntc->surname, sizeof(cntc->surname), "S%lu", id);
+    snprintf(cntc->phoneNumber, sizeof(cntc->phoneNumber), "%010lu", id);
+}
+
+/**
+ * Restituisce il contatto da usare all'iterazione k: gli indici sono sparsi su tutta
+ * la rubrica e, per k minore di bookSize, tutti diversi (stride e bookSize sono coprimi)
+ */
+static long pickIndex(long k) {
+    return (long)((k * (unsigned long long)stride + bookSize / 3) % bookSize);
+}
+
+/**
+ * Restituisce il massimo comun divisore di a e b
+ */
+static long gcd(long a, long b) {
+    while(b != 0) {
+        long rest = a % b;
+        a = b;
+        b = rest;
+    }
+    return a;
+}
+
+/**
+ * Rimuove tutti i file della cartella files (rubriche, segmenti, credenziali, file temporanei)
+ */
+static void clearFiles(void) {
+    DIR *dir = opendir("files");
+    if(dir == NULL)
+        return;
+    struct dirent *entry;
+    char path[PATH_MAX];
+    while((entry = readdir(dir)) != NULL) {
+        if(strcmp(entry->d_name, ".") && strcmp(entry->d_name, "..")) {
+            snprintf(path, sizeof(path), "files/%s", entry->d_name);
+            unlink(path);
+        }
+    }
+    closedir(dir);
+}
+
+/**
+ * Genera la rubrica condivisa con bookSize contatti sintetici, divisa in bookSegments segmenti
+ * Il file viene scritto direttamente, con stdio, per non pagare addContact per ogni contatto
+ *
+ * Restituisce 1 in caso di successo, 0 altrimenti
+ */
+static int generateBook(void) {
+    clearFiles();
+    FILE *book = fopen(SHARED_BOOK_PATH, "w");
+    if(book == NULL)
+        return 0;
+    Contact cntc;
+    for(long i = 0; i < bookSize; i++) {
+        syntheticContact(i, &cntc);
+        fprintf(book, "%s,%s,%s\n", cntc.name, cntc.surname, cntc.phoneNumber);
+    }
+    if(fclose(book) != 0)
+        return 0;
+    if(bookSegments > 1 && reshardContactBook(bookSegments) != bookSize)
+        return 0;
+
+    /*
+     * Il file credenziali ha tanti utenti quanti i contatti: userN con password passN
+     * Gli indici sono int (al massimo 10 cifre), quindi nomi e password stanno in AUTH_STRINGS_LENGTH caratteri
+     */
+    FILE *credentials = fopen("files/credenziali.txt", "w");
+    if(credentials == NULL)
+        return 0;
+    char username[AUTH_STRINGS_LENGTH + 1], password[AUTH_STRINGS_LENGTH + 1], hash[HASH_LENGTH + 1];
+    int users = bookSize < MAX_CONTACTS ? (int)bookSize : MAX_CONTACTS;
+    for(int i = 0; i < users; i++) {
+        snprintf(username, sizeof(username), "user%d", i);
+        snprintf(password, sizeof(password), "pass%d", i);
+        hashFunction(password, hash);
+        fprintf(credentials, "%s,%s\n", username, hash);
+    }
+    return fclose(credentials) == 0;
+}
+
+/*
+ * Iterazioni delle funzioni misurate
+ * Le chiamate che falliscono (contatto non trovato, credenziali non valide) vengono contate in failures:
+ * se succede la misura non e' significativa
+ */
+
+static void runGetContact(long k) {
+    Contact cntc;
+    createEmptyContact(&cntc);
+    if(!getContact(&cntc, (int)pickIndex(k)))
+        failures++;
+}
+
+static void prepareReadLine(void) {
+
+    // In una rubrica divisa in segmenti legge il primo
+    unsigned int generation;
+    int segments = getContactBookSegments(SHARED_BOOK_PATH, &generation);
+    char file[BOOK_PATH_LENGTH + 16];
+    getContactBookFile(SHARED_BOOK_PATH, generation, segments, 0, file);
+    lineFd = open(file, O_RDONLY);
+}
+
+static void runReadLine(long k) {
+    char line[3 * CONTACT_STRINGS_LENGTH + 2 + 1];
+    (void)k; // Legge sempre la riga successiva, qualunque sia l'iterazione
+
+    // Arrivati alla fine la lettura riparte dall'inizio della rubrica
+    if(readLine(lineFd, line) <= 0) {
+        lseek(lineFd, 0, SEEK_SET);
+        if(readLine(lineFd, line) <= 0)
+            failures++;
+    }
+}
+
+static void finishReadLine(void) {
+    if(lineFd > -1)
+        close(lineFd);
+    lineFd = -1;
+}
+
+static void prepareMatchesParameters(void) {
+    for(int i = 0; i < MATCH_SAMPLES; i++)
+        syntheticContact(pickIndex(i), &samples[i]);
+}
+
+static void runMatchesParameters(long k) {
+
+    // Come una ricerca per cognome: confronta il contatto cercato con uno della rubrica
+    Contact asked;
+    createEmptyContact(&asked);
+    strcpy(asked.surname, samples[(k * 7) % MATCH_SAMPLES].surname);
+    sink += matchesParameters(asked, samples[k % MATCH_SAMPLES]);
+}
+
+static void runCheckCredentials(long k) {
+    char username[AUTH_STRINGS_LENGTH + 1], password[AUTH_STRINGS_LENGTH + 1];
+    snprintf(username, sizeof(username), "user%d", (int)pickIndex(k));
+    snprintf(password, sizeof(password), "pass%d", (int)pickIndex(k));
+    if(!checkCredentials(username, password))
+        failures++;
+}
+
+static void runAddContact(long k) {
+    Contact cntc;
+    syntheticContact(bookSize + k, &cntc);
+    if(addContact(cntc) != 1)
+        failures++;
+}
+
+static void runRemoveContact(long k) {
+    Contact cntc;
+    syntheticContact(pickIndex(k), &cntc);
+    if(removeContact(cntc) != 1)
+        failures++;
+}
+
+static void runModifyContact(long k) {
+
+    // Cambia solo il numero di telefono, quindi il contatto resta nello stesso segmento
+    Contact old, new;
+    syntheticContact(pickIndex(k), &old);
+    new = old;
+    snprintf(new.phoneNumber, sizeof(new.phoneNumber), "%010ld", bookSize + k);
+    if(modifyContact(old, new) != 1)
+        failures++;
+}
+
+static const storageBenchmark benchmarks[] = {
+    {"readLine", 0, prepareReadLine, runReadLine, finishReadLine},
+    {"matchesParameters", 0, prepareMatchesParameters, runMatchesParameters, NULL},
+    {"getContact", 0, NULL, runGetContact, NULL},
+    {"checkCredentials", 0, NULL, runCheckCredentials, NULL},
+    {"addContact", 1, NULL, runAddContact, NULL},
+    {"removeContact", 1, NULL, runRemoveContact, NULL},
+    {"modifyContact", 1, NULL, runModifyContact, NULL},
+};
+
+/**
+ * Legge l'elenco di dimensioni list, separate da virgole, in sizes
+ *
+ * Restituisce il numero di dimensioni, 0 se l'elenco non e' valido
+ */
+static int parseSizes(const char *list, long *sizes) {
+    int count = 0;
+    const char *cursor = list;
+    while(*cursor != '\0' && count < MAX_SIZES) {
+        char *end;
+        double value = strtod(cursor, &end); // strtod accetta anche la notazione 1e6
+        if(end == cursor || value < MIN_CONTACTS || value > MAX_CONTACTS || (*end != ',' && *end != '\0'))
+            return 0;
+        sizes[count++] = (long)value;
+        cursor = *end == ',' ? end + 1 : end;
+    }
+    return *cursor == '\0' ? count : 0;
+}
+
+int main(int argc, char **argv) {
+    const char *sizeList = DEFAULT_SIZES, *output = DEFAULT_OUTPUT, *label = "", *base = "/tmp";
+    long minTimeNs = DEFAULT_MIN_TIME_MS * 1000000L;
+
+    int option;
+    while((option = getopt(argc, argv, "s:g:t:o:l:d:")) != -1) {
+        switch(option) {
+            case 's': sizeList = optarg; break;
+            case 'g': bookSegments = atoi(optarg); break;
+            case 't': minTimeNs = atol(optarg) * 1000000L; break;
+            case 'o': output = optarg; break;
+            case 'l': label = optarg; break;
+            case 'd': base = optarg; break;
+            default:
+                fprintf(stderr, "Uso: %s [-s contatti,...] [-g segmenti] [-t ms] [-o file.csv] [-l etichetta] [-d cartella]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    long sizes[MAX_SIZES];
+    int sizeCount = parseSizes(sizeList, sizes);
+    if(sizeCount == 0) {
+        fprintf(stderr, "Dimensioni non valide: %s (tra %d e %d contatti, separate da virgole)\n", sizeList, MIN_CONTACTS, MAX_CONTACTS);
+        exit(EXIT_FAILURE);
+    }
+    if(bookSegments < 1 || bookSegments > MAX_BOOK_SEGMENTS || minTimeNs <= 0 || strchr(label, ',') != NULL) {
+        fprintf(stderr, "Segmenti, tempo minimo o etichetta non validi\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Il file dei risultati resta dove e' stato chiesto, prima di spostarci nella cartella temporanea
+    int newOutput = access(output, F_OK) != 0;
+    FILE *results = fopen(output, "a");
+    if(results == NULL) {
+        perror(output);
+        exit(EXIT_FAILURE);
+    }
+    if(newOutput)
+        fprintf(results, "label,function,contacts,segments,iterations,ns_per_op,syscalls_per_op,read_bytes_per_op,written_bytes_per_op,failures\n");
+
+    // Le funzioni di utility.c usano percorsi relativi (files/...): lavoriamo in una cartella temporanea
+    char workDir[PATH_MAX];
+    snprintf(workDir, sizeof(workDir), "%s/storageBench.XXXXXX", base);
+    if(mkdtemp(workDir) == NULL || chdir(workDir) < 0 || mkdir("files", 0777) < 0) {
+        perror("cartella temporanea");
+        exit(EXIT_FAILURE);
+    }
+    selectContactBook(NULL);
+
+    // Costo della lettura dei contatori stessi, sottratto da ogni misura
+    ioCounters first, second, overhead, none = {0};
+    if(!readIoCounters(&first) || !readIoCounters(&second)) {
+        fprintf(stderr, "/proc/self/io non disponibile, i contatori di I/O saranno a zero\n");
+        memset(&overhead, 0, sizeof(overhead));
+    } else {
+        ioDelta(&first, &second, &none, &overhead);
+    }
+
+    int benchmarkCount = sizeof(benchmarks) / sizeof(benchmarks[0]);
+    for(int s = 0; s < sizeCount; s++) {
+        bookSize = sizes[s];
+        stride = 1000003;
+        while(gcd(stride, bookSize) != 1)
+            stride += 2;
+
+        if(!generateBook()) {
+            perror("generazione della rubrica");
+            exit(EXIT_FAILURE);
+        }
+        printf("Rubrica di %ld contatti in %d %s\n", bookSize, bookSegments, bookSegments == 1 ? "file" : "segmenti");
+        printf("  %-18s %10s %14s %12s %14s %14s\n", "Funzione", "Iterazioni", "ns/op", "syscall/op", "byte letti/op", "byte scritti/op");
+
+        for(int b = 0; b < benchmarkCount; b++) {
+            const storageBenchmark *benchmark = &benchmarks[b];
+            long maxIterations = benchmark->mutating ? bookSize / 2 : LONG_MAX;
+            failures = 0;
+            if(benchmark->prepare != NULL)
+                benchmark->prepare();
+
+            /*
+             * Le iterazioni vanno a blocchi di dimensione doppia ogni volta, finche' non si supera il tempo minimo:
+             * il clock viene letto solo tra un blocco e l'altro, cosi' non pesa sulle funzioni piu' rapide
+             */
+            ioCounters before, after, delta;
+            readIoCounters(&before);
+            long long start = nowNs(), elapsed = 0;
+            long iterations = 0, block = 1;
+            while(elapsed < minTimeNs && iterations < maxIterations) {
+                if(block > maxIterations - iterations)
+                    block = maxIterations - iterations;
+                for(long k = iterations; k < iterations + block; k++)
+                    benchmark->run(k);
+                iterations += block;
+                block *= 2;
+                elapsed = nowNs() - start;
+            }
+            readIoCounters(&after);
+            ioDelta(&before, &after, &overhead, &delta);
+
+            if(benchmark->finish != NULL)
+                benchmark->finish();
+
+            double nsPerOp = (double)elapsed / iterations;
+            double callsPerOp = (double)(delta.readCalls + delta.writeCalls) / iterations;
+            double readPerOp = (double)delta.readBytes / iterations;
+            double writtenPerOp = (double)delta.writtenBytes / iterations;
+            printf("  %-18s %10ld %14.1f %12.1f %14.1f %14.1f", benchmark->name, iterations, nsPerOp, callsPerOp, readPerOp, writtenPerOp);
+            if(failures > 0)
+                printf(RED " (%ld chiamate fallite)" RESET_COLOR, failures);
+            printf("\n");
+            fflush(stdout);
+            fprintf(results, "%s,%s,%ld,%d,%ld,%.1f,%.2f,%.1f,%.1f,%ld\n", label, benchmark->name, bookSize, bookSegments,
+                    iterations, nsPerOp, callsPerOp, readPerOp, writtenPerOp, failures);
+
+            // Le funzioni successive devono trovare la rubrica appena generata
+            if(benchmark->mutating && b + 1 < benchmarkCount && !generateBook()) {
+                perror("generazione della rubrica");
+                exit(EXIT_FAILURE);
+            }
+        }
+        printf("\n");
+    }
+    fclose(results);
+
+    // Rimozione della cartella temporanea
+    clearFiles();
+    rmdir("files");
+    chdir("/");
+    rmdir(workDir);
+    return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2024 Biribo' Francesco, Giannuzzi Riccardo, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "./../include/connection.h"
+#include "./../include/trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Tracciato aperto con openTrace, -1 se le richieste non vengono registrate
+static int traceFd = -1;
+
+/**
+ * Scrive in buffer i length byte meno significativi di value, dal meno significativo
+ */
+static void putNumber(unsigned char *buffer, unsigned long long value, int length) {
+    for(int i = 0; i < length; i++)
+        buffer[i] = (unsigned char)(value >> (8 * i));
+}
+
+/**
+ * Restituisce il numero di length byte salvato in buffer da putNumber
+ */
+static unsigned long long getNumber(const unsigned char *buffer, int length) {
+    unsigned long long value = 0;
+    for(int i = length - 1; i >= 0; i--)
+        value = (value << 8) | buffer[i];
+    return value;
+}
+
+/**
+ * Controlla che l'intestazione header sia quella di un tracciato di questa versione
+ */
+static int isTraceHeader(const unsigned char *header) {
+    return memcmp(header, TRACE_MAGIC, 4) == 0 && getNumber(header + 4, 4) == TRACE_FORMAT;
+}
+
+int openTrace(const char *path) {
+    // Il nuovo server avviato da un SIGHUP apre il tracciato per conto suo, non deve ereditare questo descrittore
+    int fd = open(path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if(fd < 0)
+        return 0;
+
+    // Un file vuoto riceve l'intestazione, uno esistente deve gia' essere un tracciato
+    unsigned char header[TRACE_HEADER_LENGTH];
+    ssize_t length = read(fd, header, TRACE_HEADER_LENGTH);
+    if(length == 0) {
+        memcpy(header, TRACE_MAGIC, 4);
+        putNumber(header + 4, TRACE_FORMAT, 4);
+        if(write(fd, header, TRACE_HEADER_LENGTH) != TRACE_HEADER_LENGTH) {
+            close(fd);
+            return 0;
+        }
+    } else if(length != TRACE_HEADER_LENGTH || !isTraceHeader(header)) {
+        close(fd);
+        return 0;
+    }
+    traceFd = fd;
+    return 1;
+}
+
+void traceRequest(const traceRecord *record) {
+    if(traceFd < 0)
+        return;
+    unsigned char buffer[TRACE_RECORD_LENGTH];
+    putNumber(buffer, record->arrivalUs, 8);
+    putNumber(buffer + 8, record->connection, 4);
+    putNumber(buffer + 12, record->latencyUs, 4);
+    buffer[16] = (unsigned char)record->outcome;
+    memcpy(buffer + 17, record->packet, PACKET_LENGTH);
+
+    // Un errore di scrittura (disco pieno) non deve interrompere la sessione: la richiesta non viene registrata
+    if(write(traceFd, buffer, TRACE_RECORD_LENGTH) != TRACE_RECORD_LENGTH)
+        return;
+}
+
+int readTrace(const char *path, traceRecord **records, size_t *count) {
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return 0;
+
+    struct stat info;
+    unsigned char header[TRACE_HEADER_LENGTH];
+    if(fstat(fd, &info) < 0 || read(fd, header, TRACE_HEADER_LENGTH) != TRACE_HEADER_LENGTH || !isTraceHeader(header)) {
+        close(fd);
+        return 0;
+    }
+
+    // Il numero di richieste si ricava dalla dimensione del file
+    size_t total = (info.st_size - TRACE_HEADER_LENGTH) / TRACE_RECORD_LENGTH;
+    traceRecord *loaded = malloc((total > 0 ? total : 1) * sizeof(traceRecord));
+    if(loaded == NULL) {
+        close(fd);
+        return 0;
+    }
+
+    // I record vengono letti a blocchi, per non fare una read per richiesta
+    unsigned char buffer[64 * TRACE_RECORD_LENGTH];
+    size_t done = 0;
+    while(done < total) {
+        size_t wanted = total - done < 64 ? total - done : 64;
+        ssize_t length = read(fd, buffer, wanted * TRACE_RECORD_LENGTH);
+        if(length < (ssize_t)TRACE_RECORD_LENGTH)
+            break;
+        for(size_t i = 0; i < (size_t)length / TRACE_RECORD_LENGTH; i++) {
+            const unsigned char *record = buffer + i * TRACE_RECORD_LENGTH;
+            loaded[done].arrivalUs = getNumber(record, 8);
+            loaded[done].connection = (unsigned int)getNumber(record + 8, 4);
+            loaded[done].latencyUs = (unsigned int)getNumber(record + 12, 4);
+            loaded[done].outcome = (char)record[16];
+            memcpy(loaded[done].packet, record + 17, PACKET_LENGTH);
+            done++;
+        }
+        // Una read corta puo' fermarsi a meta' record: riprendiamo dall'inizio di quello incompleto
+        if(length % TRACE_RECORD_LENGTH != 0)
+            lseek(fd, TRACE_HEADER_LENGTH + done * TRACE_RECORD_LENGTH, SEEK_SET);
+    }
+    close(fd);
+
+    *records = loaded;
+    *count = done;
+    return 1;
+}
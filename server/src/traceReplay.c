@@ -0,0 +1,495 @@
+/*
+ * Copyright (c) 2024 Biribo' Francesco, Giannuzzi Riccardo, Timour Ilyas
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose with or without fee is hereby granted, provided that the above copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Riproduce contro un server le richieste registrate in un tracciato (server avviato con -w)
+ *
+ * Ogni connessione del tracciato viene riaperta e le sue richieste vengono inviate nello stesso ordine,
+ * cosi' le sessioni si comportano come quelle originali (stessa autenticazione, stessa rubrica)
+ * Con la velocita' registrata ogni richiesta parte allo stesso istante relativo del tracciato (diviso per il
+ * fattore di velocita') e la latenza si misura da quell'istante; altrimenti le richieste partono appena
+ * arriva la risposta precedente, su al massimo un numero fissato di connessioni contemporanee
+ *
+ * Per ogni operazione vengono confrontate le latenze del tracciato (misurate dal server) con quelle del replay
+ * (misurate qui) e contate le risposte con un esito diverso dall'originale, segno che lo stato della rubrica diverge
+ * I risultati si possono salvare in CSV e confrontare con quelli di un replay precedente
+ *
+ * Esempi di avvio, supponendo che il file eseguibile si chiami "traceReplay":
+ *   ./traceReplay tracciato.dat - Velocita' registrata, contro il server locale sulla porta 50000
+ *   ./traceReplay -x 4 tracciato.dat localhost 50001 - Quattro volte piu' veloce, sulla porta 50001
+ *   ./traceReplay -f -c 32 -o nuovo.csv -b vecchio.csv tracciato.dat /tmp/rubrica.sock - Alla massima velocita', confrontato con un replay precedente
+ *
+ * Le iscrizioni, le sincronizzazioni e le repliche non vengono riprodotte: le loro risposte sono
+ * flussi di pacchetti che dipendono dalle modifiche fatte nel frattempo da altri
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "./../include/utility.h"
+#include "./../include/connection.h"
+#include "./../include/metrics.h"
+#include "./../include/trace.h"
+
+#define DEFAULT_PORT 50000 // Porta default
+#define DEFAULT_PARALLEL 64 // Connessioni contemporanee, come le sessioni ammesse di default dal server
+#define SKIPPED_OPERATIONS "syl" // SUBSCRIBE, SYNC_SINCE e REPLICATE
+
+/**
+ * Connessione del tracciato da riprodurre
+ *
+ * Campi:
+ *  first - Posizione in order della prima richiesta
+ *  count - Numero di richieste
+ */
+typedef struct {
+    size_t first;
+    size_t count;
+} replayConnection;
+
+/**
+ * Risultati di un thread di riproduzione
+ *
+ * Campi:
+ *  latencies - Latenze del replay per operazione, nelle posizioni di METRICS_OPERATIONS
+ *  mismatches - Risposte con esito diverso da quello registrato, per operazione
+ *  skipped - Richieste non riprodotte (SKIPPED_OPERATIONS)
+ *  busy - Connessioni rifiutate dal server con SERVER_BUSY
+ *  failed - Connessioni interrotte da un errore di comunicazione
+ */
+typedef struct {
+    latencyHistogram latencies[METRICS_SLOTS];
+    unsigned long mismatches[METRICS_SLOTS];
+    unsigned long skipped;
+    unsigned long busy;
+    unsigned long failed;
+} replayResults;
+
+// Tracciato e connessioni da riprodurre, in sola lettura per i thread
+static traceRecord *records;
+static size_t *order; // Posizioni dei record raggruppati per connessione, in ordine di arrivo
+static replayConnection *connections;
+static size_t connectionCount;
+
+// Parametri del replay
+static struct sockaddr_storage serverAddress;
+static socklen_t addressLength;
+static double speed = 1; // 0 per la massima velocita'
+static unsigned long long traceStartUs;
+static long long replayStartNs;
+
+// Prossima connessione da riprodurre, condivisa tra i thread
+static size_t nextConnection = 0;
+static pthread_mutex_t nextLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Restituisce l'istante attuale del clock monotono in nanosecondi
+ */
+static long long nowNs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/**
+ * Attende fino all'istante instantNs del clock monotono
+ */
+static void sleepUntil(long long instantNs) {
+    struct timespec until = {instantNs / 1000000000LL, instantNs % 1000000000LL};
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) == EINTR);
+}
+
+/**
+ * Restituisce l'istante del replay in cui inviare record, con la velocita' scelta
+ */
+static long long scheduledNs(const traceRecord *record) {
+    return replayStartNs + (long long)((record->arrivalUs - traceStartUs) * 1000.0 / speed);
+}
+
+/**
+ * Ordina le posizioni dei record per connessione, poi per arrivo e infine per posizione nel file
+ */
+static int compareRecords(const void *first, const void *second) {
+    const traceRecord *a = &records[*(const size_t *)first], *b = &records[*(const size_t *)second];
+    if(a->connection != b->connection)
+        return a->connection < b->connection ? -1 : 1;
+    if(a->arrivalUs != b->arrivalUs)
+        return a->arrivalUs < b->arrivalUs ? -1 : 1;
+    return *(const size_t *)first < *(const size_t *)second ? -1 : 1;
+}
+
+/**
+ * Ordina le connessioni per arrivo della loro prima richiesta
+ */
+static int compareConnections(const void *first, const void *second) {
+    unsigned long long a = records[order[((const replayConnection *)first)->first]].arrivalUs;
+    unsigned long long b = records[order[((const replayConnection *)second)->first]].arrivalUs;
+    return a < b ? -1 : a > b;
+}
+
+/**
+ * Raggruppa le count richieste del tracciato in connessioni
+ * L'identificativo e' il pid della sessione, che puo' essere riusato: una richiesta INT chiude la connessione
+ * e le richieste successive con lo stesso identificativo ne formano una nuova
+ *
+ * Restituisce 1 in caso di successo, 0 se manca memoria
+ */
+static int groupConnections(size_t count) {
+    order = malloc((count > 0 ? count : 1) * sizeof(size_t));
+    connections = malloc((count > 0 ? count : 1) * sizeof(replayConnection));
+    if(order == NULL || connections == NULL)
+        return 0;
+    for(size_t i = 0; i < count; i++)
+        order[i] = i;
+    qsort(order, count, sizeof(size_t), compareRecords);
+
+    connectionCount = 0;
+    for(size_t i = 0; i < count; i++) {
+        const traceRecord *record = &records[order[i]];
+        int startsNew = i == 0 || records[order[i - 1]].connection != record->connection
+            || records[order[i - 1]].packet[OPERATION_INDEX] == INT;
+        if(startsNew) {
+            connections[connectionCount].first = i;
+            connections[connectionCount].count = 0;
+            connectionCount++;
+        }
+        connections[connectionCount - 1].count++;
+    }
+    qsort(connections, connectionCount, sizeof(replayConnection), compareConnections);
+    return 1;
+}
+
+/**
+ * Apre una connessione al server del replay
+ *
+ * Restituisce il descrittore della socket, -1 in caso di errore
+ */
+static int openConnection(void) {
+    int fd = socket(serverAddress.ss_family, SOCK_STREAM, 0);
+    if(fd < 0)
+        return -1;
+    if(connect(fd, (struct sockaddr*) &serverAddress, addressLength) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Legge dalla socket fd un pacchetto intero in packet
+ *
+ * Restituisce 1 in caso di successo, 0 se la connessione si e' interrotta
+ */
+static int readPacket(int fd, char *packet) {
+    size_t done = 0;
+    while(done < PACKET_LENGTH) {
+        ssize_t length = read(fd, packet + done, PACKET_LENGTH - done);
+        if(length <= 0 && !(length < 0 && errno == EINTR))
+            return 0;
+        if(length > 0)
+            done += length;
+    }
+    return 1;
+}
+
+/**
+ * Riproduce su una nuova connessione le richieste di connection, registrandone i risultati in results
+ */
+static void replayOne(const replayConnection *connection, replayResults *results) {
+    if(speed > 0)
+        sleepUntil(scheduledNs(&records[order[connection->first]]));
+    int fd = openConnection();
+    if(fd < 0) {
+        results->failed++;
+        return;
+    }
+
+    char response[PACKET_LENGTH];
+    for(size_t i = 0; i < connection->count; i++) {
+        const traceRecord *record = &records[order[connection->first + i]];
+        char operation = record->packet[OPERATION_INDEX];
+        if(operation != '\0' && strchr(SKIPPED_OPERATIONS, operation) != NULL) {
+            results->skipped++;
+            continue;
+        }
+
+        // Con la velocita' registrata la latenza parte dall'istante previsto, anche se la richiesta parte in ritardo
+        long long start = nowNs();
+        if(speed > 0) {
+            long long scheduled = scheduledNs(record);
+            if(scheduled > start)
+                sleepUntil(scheduled);
+            start = scheduled;
+        }
+        if(write(fd, record->packet, PACKET_LENGTH) != PACKET_LENGTH || !readPacket(fd, response)) {
+            results->failed++;
+            break;
+        }
+        long long done = nowNs();
+
+        int slot = metricsSlot(operation);
+        latencyHistogram *histogram = &results->latencies[slot];
+        unsigned long latencyUs = done > start ? (unsigned long)((done - start) / 1000) : 0;
+        histogram->count++;
+        histogram->totalUs += latencyUs;
+        histogram->buckets[metricsBucket(latencyUs)]++;
+        if(latencyUs > histogram->maxUs)
+            histogram->maxUs = latencyUs;
+        if(response[OUTCOME_INDEX] != record->outcome)
+            results->mismatches[slot]++;
+
+        // Il server chiude la connessione dopo SERVER_BUSY e dopo INT
+        if(response[OUTCOME_INDEX] == SERVER_BUSY) {
+            results->busy++;
+            break;
+        }
+        if(operation == INT)
+            break;
+    }
+    close(fd);
+}
+
+/**
+ * Corpo dei thread di riproduzione: prendono una connessione alla volta, nell'ordine di arrivo
+ */
+static void *runReplay(void *argument) {
+    replayResults *results = argument;
+    while(1) {
+        pthread_mutex_lock(&nextLock);
+        size_t taken = nextConnection < connectionCount ? nextConnection++ : connectionCount;
+        pthread_mutex_unlock(&nextLock);
+        if(taken == connectionCount)
+            break;
+        replayOne(&connections[taken], results);
+    }
+    return NULL;
+}
+
+/**
+ * Imposta l'indirizzo del server dagli argomenti posizionali, come fa il client:
+ * nessuno per il server locale sulla porta di default, un percorso per la socket locale, indirizzo e porta altrimenti
+ *
+ * Restituisce 1 se l'indirizzo e' valido, 0 altrimenti
+ */
+static int parseAddress(int count, char **arguments) {
+    memset(&serverAddress, 0, sizeof(serverAddress));
+    if(count == 1) {
+        struct sockaddr_un *localAddress = (struct sockaddr_un*) &serverAddress;
+        if(strlen(arguments[0]) >= sizeof(localAddress->sun_path))
+            return 0;
+        localAddress->sun_family = AF_UNIX;
+        strcpy(localAddress->sun_path, arguments[0]);
+        addressLength = sizeof(struct sockaddr_un);
+        return 1;
+    }
+
+    struct sockaddr_in *networkAddress = (struct sockaddr_in*) &serverAddress;
+    networkAddress->sin_family = AF_INET;
+    addressLength = sizeof(struct sockaddr_in);
+    int port = DEFAULT_PORT;
+    if(count == 2) {
+        if(strcmp(arguments[0], "localhost") == 0)
+            networkAddress->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        else if(inet_pton(AF_INET, arguments[0], &networkAddress->sin_addr) <= 0)
+            return 0;
+        port = atoi(arguments[1]);
+        if(port <= 0 || port > 65535)
+            return 0;
+    } else if(count == 0) {
+        networkAddress->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    } else {
+        return 0;
+    }
+    networkAddress->sin_port = htons(port);
+    return 1;
+}
+
+/**
+ * Confronta le latenze di questo replay (latencies) con quelle di un replay precedente, salvate con -o nel file baseline
+ * Le righe hanno la forma operation,requests,mismatches,mean_us,p50_us,p90_us,p99_us,p999_us,max_us
+ */
+static void compareBaseline(const char *baseline, const latencyHistogram *latencies) {
+    FILE *file = fopen(baseline, "r");
+    if(file == NULL) {
+        perror(baseline);
+        return;
+    }
+    printf("\nConfronto con %s (p50 e p99 in ms, prima -> ora):\n", baseline);
+    char line[256], name[32];
+    unsigned long requests, mismatches, mean, p50, p90, p99, p999, max;
+    while(fgets(line, sizeof(line), file) != NULL) {
+        if(sscanf(line, "%31[^,],%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu", name, &requests, &mismatches, &mean, &p50, &p90, &p99, &p999, &max) != 9)
+            continue; // Intestazione o riga non valida
+        int slot = METRICS_INVALID;
+        for(int i = 0; i < METRICS_SLOTS; i++) {
+            if(strcmp(metricsOperationName(i), name) == 0)
+                slot = i;
+        }
+        unsigned long nowP50 = metricsPercentile(&latencies[slot], 0.50), nowP99 = metricsPercentile(&latencies[slot], 0.99);
+        printf("  %-16s p50 %9.3f -> %9.3f (%+6.1f%%)   p99 %9.3f -> %9.3f (%+6.1f%%)\n", name,
+               p50 / 1000.0, nowP50 / 1000.0, p50 > 0 ? 100.0 * ((double)nowP50 - p50) / p50 : 0.0,
+               p99 / 1000.0, nowP99 / 1000.0, p99 > 0 ? 100.0 * ((double)nowP99 - p99) / p99 : 0.0);
+    }
+    fclose(file);
+}
+
+int main(int argc, char **argv) {
+    int parallel = DEFAULT_PARALLEL;
+    const char *output = NULL, *baseline = NULL;
+
+    int option;
+    while((option = getopt(argc, argv, "fx:c:o:b:")) != -1) {
+        switch(option) {
+            case 'f': speed = 0; break;
+            case 'x': speed = atof(optarg); break;
+            case 'c': parallel = atoi(optarg); break;
+            case 'o': output = optarg; break;
+            case 'b': baseline = optarg; break;
+            default:
+                fprintf(stderr, "Uso: %s [-f | -x velocita'] [-c connessioni] [-o risultati.csv] [-b precedenti.csv] tracciato [indirizzo porta | socket]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if(optind >= argc || parallel <= 0 || speed < 0) {
+        fprintf(stderr, "Uso: %s [-f | -x velocita'] [-c connessioni] [-o risultati.csv] [-b precedenti.csv] tracciato [indirizzo porta | socket]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    const char *tracePath = argv[optind];
+    if(!parseAddress(argc - optind - 1, argv + optind + 1)) {
+        fprintf(stderr, "Indirizzo del server non valido\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t count;
+    if(!readTrace(tracePath, &records, &count)) {
+        fprintf(stderr, "%s non e' un tracciato valido\n", tracePath);
+        exit(EXIT_FAILURE);
+    }
+    if(count == 0) {
+        printf("Il tracciato non contiene richieste\n");
+        return 0;
+    }
+    if(!groupConnections(count)) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    traceStartUs = records[order[connections[0].first]].arrivalUs;
+
+    // Con la velocita' registrata i thread sono tanti quante le connessioni del tracciato, fino al limite scelto
+    if((size_t)parallel > connectionCount)
+        parallel = (int)connectionCount;
+    replayResults *results = calloc(parallel, sizeof(replayResults));
+    pthread_t *threads = calloc(parallel, sizeof(pthread_t));
+    if(results == NULL || threads == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("Riproduzione di %zu richieste su %zu connessioni, ", count, connectionCount);
+    if(speed > 0)
+        printf("velocita' %.2fx\n", speed);
+    else
+        printf("alla massima velocita' (%d connessioni contemporanee)\n", parallel);
+    fflush(stdout);
+
+    replayStartNs = nowNs() + 100000000LL; // Lasciamo partire i thread prima della prima richiesta
+    for(int i = 0; i < parallel; i++) {
+        if(pthread_create(&threads[i], NULL, runReplay, &results[i]) != 0) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Raccolta dei risultati dei thread e delle latenze registrate nel tracciato
+    static latencyHistogram latencies[METRICS_SLOTS], traced[METRICS_SLOTS];
+    unsigned long mismatches[METRICS_SLOTS] = {0}, skipped = 0, busy = 0, failed = 0, replayed = 0;
+    for(int i = 0; i < parallel; i++) {
+        pthread_join(threads[i], NULL);
+        for(int slot = 0; slot < METRICS_SLOTS; slot++) {
+            latencyHistogram *total = &latencies[slot], *partial = &results[i].latencies[slot];
+            total->count += partial->count;
+            total->totalUs += partial->totalUs;
+            if(partial->maxUs > total->maxUs)
+                total->maxUs = partial->maxUs;
+            for(int b = 0; b < METRICS_BUCKETS; b++)
+                total->buckets[b] += partial->buckets[b];
+            mismatches[slot] += results[i].mismatches[slot];
+            replayed += partial->count;
+        }
+        skipped += results[i].skipped;
+        busy += results[i].busy;
+        failed += results[i].failed;
+    }
+    double elapsed = (nowNs() - replayStartNs) / 1e9;
+    for(size_t i = 0; i < count; i++) {
+        char operation = records[i].packet[OPERATION_INDEX];
+        if(operation != '\0' && strchr(SKIPPED_OPERATIONS, operation) != NULL)
+            continue;
+        latencyHistogram *histogram = &traced[metricsSlot(operation)];
+        histogram->count++;
+        histogram->totalUs += records[i].latencyUs;
+        histogram->buckets[metricsBucket(records[i].latencyUs)]++;
+        if(records[i].latencyUs > histogram->maxUs)
+            histogram->maxUs = records[i].latencyUs;
+    }
+
+    unsigned long totalMismatches = 0;
+    for(int slot = 0; slot < METRICS_SLOTS; slot++)
+        totalMismatches += mismatches[slot];
+    printf("Richieste riprodotte: %lu in %.2f s (%.1f richieste/s), non riproducibili: %lu, esiti diversi dall'originale: %lu\n",
+           replayed, elapsed, replayed / elapsed, skipped, totalMismatches);
+    if(busy > 0 || failed > 0)
+        printf(YELLOW "Connessioni rifiutate dal server (occupato): %lu, interrotte o non riuscite: %lu\n" RESET_COLOR, busy, failed);
+    printf("  %-16s %10s %8s %14s %14s %14s %14s\n", "Op", "Richieste", "Diversi", "p50 tracciato", "p50 replay", "p99 tracciato", "p99 replay");
+    for(int slot = 0; slot < METRICS_SLOTS; slot++) {
+        if(latencies[slot].count == 0)
+            continue;
+        printf("  %-16s %10lu %8lu %11.3f ms %11.3f ms %11.3f ms %11.3f ms\n", metricsOperationName(slot), latencies[slot].count, mismatches[slot],
+               metricsPercentile(&traced[slot], 0.50) / 1000.0, metricsPercentile(&latencies[slot], 0.50) / 1000.0,
+               metricsPercentile(&traced[slot], 0.99) / 1000.0, metricsPercentile(&latencies[slot], 0.99) / 1000.0);
+    }
+    printf("Le latenze del tracciato sono misurate dal server, quelle del replay da qui (comprendono la rete)\n");
+
+    // Il confronto avviene prima di scrivere i nuovi risultati, che possono sostituire quelli precedenti
+    if(baseline != NULL)
+        compareBaseline(baseline, latencies);
+    if(output != NULL) {
+        FILE *file = fopen(output, "w");
+        if(file == NULL) {
+            perror(output);
+            exit(EXIT_FAILURE);
+        }
+        fprintf(file, "operation,requests,mismatches,mean_us,p50_us,p90_us,p99_us,p999_us,max_us\n");
+        for(int slot = 0; slot < METRICS_SLOTS; slot++) {
+            const latencyHistogram *histogram = &latencies[slot];
+            if(histogram->count == 0)
+                continue;
+            fprintf(file, "%s,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n", metricsOperationName(slot), histogram->count, mismatches[slot],
+                    histogram->totalUs / histogram->count, metricsPercentile(histogram, 0.50), metricsPercentile(histogram, 0.90),
+                    metricsPercentile(histogram, 0.99), metricsPercentile(histogram, 0.999), histogram->maxUs);
+        }
+        fclose(file);
+    }
+
+    free(records);
+    free(order);
+    free(connections);
+    free(results);
+    free(threads);
+    return 0;
+}
@@ -10,15 +10,217 @@
 #include <string.h>
 #include <stdio.h>
 #include <fcntl.h>
+#include <errno.h>
 #include <unistd.h>
 #include <termios.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/file.h>
 
-int getContact(Contact *cntc, int index) {
+/**
+ * bookPath - Rubrica su cui agiscono le operazioni di questo processo
+ * bookTmpPath - File temporaneo usato da removeContact e modifyContact per riscriverla
+ *
+ * Ogni rubrica ha il suo file temporaneo, cosi' due processi che modificano
+ * rubriche diverse non si sovrascrivono a vicenda
+ */
+static char bookPath[BOOK_PATH_LENGTH] = SHARED_BOOK_PATH;
+static char bookTmpPath[BOOK_PATH_LENGTH] = "files/tmp";
+
+int selectContactBook(const char *username) {
+
+    // Rubrica condivisa
+    if(username == NULL || username[0] == '\0') {
+        strcpy(bookPath, SHARED_BOOK_PATH);
+        strcpy(bookTmpPath, "files/tmp");
+        return 1;
+    }
+
+    // Il nome utente diventa un nome di file, quindi accettiamo solo lettere e cifre
+    if(!isUsernameValidAndNotEmpty((char *)username))
+        return 0;
+
+    // La cartella delle rubriche personali viene creata alla prima scelta
+    umask(0);
+    mkdir(USER_BOOKS_DIR, 0777);
+    sprintf(bookPath, "%s/%s.txt", USER_BOOKS_DIR, username);
+    sprintf(bookTmpPath, "%s/%s.tmp", USER_BOOKS_DIR, username);
+    return 1;
+}
+
+const char *getContactBookPath(void) {
+    return bookPath;
+}
+
+int isSharedContactBook(void) {
+    return strcmp(bookPath, SHARED_BOOK_PATH) == 0;
+}
+
+int lockContactBook(void) {
+
+    /*
+     * Il lock non puo' essere preso sulla rubrica stessa, perche' removeContact e modifyContact
+     * la sostituiscono con un altro file: usiamo un file accanto che non viene mai rinominato
+     */
+    char lockPath[BOOK_PATH_LENGTH + 8];
+    sprintf(lockPath, "%s.lock", bookPath);
+    umask(0);
+    int lock = open(lockPath, O_RDWR | O_CREAT, 0666);
+    if(lock > -1 && flock(lock, LOCK_EX) < 0) {
+        close(lock);
+        lock = -1;
+    }
+    return lock;
+}
+
+void unlockContactBook(int lock) {
+    if(lock > -1) {
+        flock(lock, LOCK_UN);
+        close(lock);
+    }
+}
+
+// Segmenti delle rubriche create da ora in poi (1: un unico file)
+static int newBookSegments = 1;
+
+void setNewBookSegments(int segments) {
+    if(segments >= 1 && segments <= MAX_BOOK_SEGMENTS)
+        newBookSegments = segments;
+}
+
+/**
+ * Legge il file <path>.seg, che descrive una rubrica divisa in segmenti
+ *
+ * Restituisce 1 se la rubrica e' divisa in segmenti, 0 se e' un unico file
+ */
+static int readManifest(const char *path, int *segments, unsigned int *generation) {
+    char manifestPath[BOOK_PATH_LENGTH + 8], line[32];
+    sprintf(manifestPath, "%s.seg", path);
+    int fd = open(manifestPath, O_RDONLY);
+    if(fd < 0)
+        return 0;
+
+    memset(line, '\0', sizeof(line));
+    int valid = read(fd, line, sizeof(line) - 1) > 0 && sscanf(line, "%d %u", segments, generation) == 2
+        && *segments > 1 && *segments <= MAX_BOOK_SEGMENTS;
+    close(fd);
+    return valid;
+}
 
-    // Apro il file rubrica.txt in lettura
-    int fd = open("files/rubrica.txt", O_RDONLY, 0666);
+/**
+ * Sostituisce il file <path>.seg con uno che descrive segments segmenti della generazione generation
+ * Viene scritto un file temporaneo poi rinominato, chi legge trova sempre il vecchio o il nuovo
+ *
+ * Restituisce 1 in caso di successo, 0 altrimenti
+ */
+static int writeManifest(const char *path, int segments, unsigned int generation) {
+    char manifestPath[BOOK_PATH_LENGTH + 8], tmpPath[BOOK_PATH_LENGTH + 12], line[32];
+    sprintf(manifestPath, "%s.seg", path);
+    sprintf(tmpPath, "%s.seg.tmp", path);
+    sprintf(line, "%d %u\n", segments, generation);
+
+    umask(0);
+    int fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if(fd < 0)
+        return 0;
+    int written = write(fd, line, strlen(line)) == (ssize_t)strlen(line);
+    close(fd);
+
+    if(written && rename(tmpPath, manifestPath) == 0)
+        return 1;
+    unlink(tmpPath);
+    return 0;
+}
+
+int getContactBookSegments(const char *path, unsigned int *generation) {
+    int segments;
+    unsigned int found;
+    if(!readManifest(path, &segments, &found)) {
+        segments = 1;
+        found = 0;
+    }
+    if(generation != NULL)
+        *generation = found;
+    return segments;
+}
+
+void getContactBookFile(const char *path, unsigned int generation, int segments, int segment, char *file) {
+    if(segments > 1)
+        sprintf(file, "%s.%u.%d", path, generation, segment);
+    else
+        strcpy(file, path);
+}
+
+/**
+ * Segmento dei contatti il cui nome e cognome, nella forma "nome,cognome", sono i primi length caratteri di key
+ */
+static int keySegment(const char *key, int length, int segments) {
+    unsigned int hash = 5381;
+    for(int i = 0; i < length; i++)
+        hash = (hash << 5) + hash + (unsigned char)key[i];
+    return hash % segments;
+}
+
+int contactSegment(Contact cntc, int segments) {
+    char key[2 * CONTACT_STRINGS_LENGTH + 2];
+    sprintf(key, "%s,%s", cntc.name, cntc.surname);
+    return keySegment(key, strlen(key), segments);
+}
+
+int statContactBook(const char *path, struct stat *info) {
+    memset(info, 0, sizeof(*info));
+    unsigned int generation;
+    int segments = getContactBookSegments(path, &generation);
+    if(segments == 1)
+        return stat(path, info) == 0;
+
+    /*
+     * Combiniamo le informazioni del file .seg e dei segmenti: la dimensione e' la somma,
+     * la data la piu' recente e l'inode cambia se uno qualsiasi dei file viene sostituito
+     * (come fanno removeContact e modifyContact con il segmento che riscrivono)
+     */
+    char file[BOOK_PATH_LENGTH + 16];
+    struct stat part;
+    sprintf(file, "%s.seg", path);
+    int valid = stat(file, &part) == 0;
+    info->st_ino = part.st_ino;
+    info->st_mtim = part.st_mtim;
+
+    for(int i = 0; i < segments && valid; i++) {
+        getContactBookFile(path, generation, segments, i, file);
+        valid = stat(file, &part) == 0;
+        info->st_ino = info->st_ino * 31 + part.st_ino;
+        info->st_size += part.st_size;
+        if(part.st_mtim.tv_sec > info->st_mtim.tv_sec || (part.st_mtim.tv_sec == info->st_mtim.tv_sec && part.st_mtim.tv_nsec > info->st_mtim.tv_nsec))
+            info->st_mtim = part.st_mtim;
+    }
+
+    if(!valid)
+        memset(info, 0, sizeof(*info));
+    return valid;
+}
+
+/**
+ * Salva in file il file della rubrica scelta che contiene (o conterra') i contatti
+ * con lo stesso nome e cognome di cntc
+ */
+static void contactFile(Contact cntc, char *file) {
+    unsigned int generation;
+    int segments = getContactBookSegments(bookPath, &generation);
+    getContactBookFile(bookPath, generation, segments, contactSegment(cntc, segments), file);
+}
+
+/**
+ * Cerca in un file della rubrica il contatto numero *index (a partire da 0)
+ * Se non lo trova sottrae a *index il numero di contatti del file, cosi' la ricerca
+ * puo' proseguire nel segmento successivo
+ *
+ * Restituisce 1 se il contatto e' stato trovato, 0 altrimenti
+ */
+static int getContactFromFile(const char *path, Contact *cntc, int *index) {
+
+    // Apro il file della rubrica in lettura
+    int fd = open(path, O_RDONLY, 0666);
     int contactIndex = 0;
 
     // Un contatto al massimo occupa tanto spazio quanto 3 campi, 2 virgole per la separazione e uno terminatore
@@ -29,7 +231,7 @@ int getContact(Contact *cntc, int index) {
 
     // Leggo una riga alla volta. Ogni riga contiene un contatto, quindi leggere 1 riga corrisponde a un contatto
     while(!done && readLine(fd, line) > 0) {
-        if(contactIndex == index) // Controlla se siamo arrivato all'n-esimo contatto della rubrica
+        if(contactIndex == *index) // Controlla se siamo arrivato all'n-esimo contatto della rubrica
             done = 1;
         else 
             memset(line, '\0', lineMaxLength);
@@ -54,17 +256,22 @@ int getContact(Contact *cntc, int index) {
 
         token = strtok(NULL, ",");
         strncpy(cntc->phoneNumber, token, strlen(token));
-    } 
+    } else {
+        *index -= contactIndex;
+    }
 
     close(fd);
     return done;
 }
 
-int addContact(Contact cntc) {
+/**
+ * Aggiunge cntc al file path della rubrica, come addContact
+ */
+static int addContactToFile(const char *path, Contact cntc) {
 
     // Apro la rubrica in lettura, append ed eventualmente la creo se non esiste
     umask(0);
-    int fd = open("files/rubrica.txt", O_RDWR | O_APPEND | O_CREAT, 0666);
+    int fd = open(path, O_RDWR | O_APPEND | O_CREAT, 0666);
     int added = 0, present = 0;
 
     // Vogliamo procedere solo se siamo riusciti ad aprire il file
@@ -104,11 +311,15 @@ int addContact(Contact cntc) {
     }
     return added;
 }
-int removeContact(Contact cntc) {
+/**
+ * Rimuove cntc dal file path della rubrica, come removeContact
+ * Il file viene riscritto in tmpPath e rinominato
+ */
+static int removeContactFromFile(const char *path, const char *tmpPath, Contact cntc) {
 
     // Apro la rubrica in lettura
     umask(0);
-    int fd = open("files/rubrica.txt", O_RDONLY, 0666);
+    int fd = open(path, O_RDONLY, 0666);
     int removed = 0, present = 0, aborted = 0;
 
     // Procediamo solo se è stato aperto il file
@@ -125,7 +336,7 @@ int removeContact(Contact cntc) {
          * originaria, tranne quello da eliminare, successivamente
          * ridenominiamo il file temporaneo, sostituendo la vecchia rubrica
          */
-        int tmpFile = open("files/tmp", O_WRONLY | O_CREAT, 0666);
+        int tmpFile = open(tmpPath, O_WRONLY | O_CREAT, 0666);
 
         char toDel[writeLen];
         memset(toDel, '\0', writeLen);
@@ -138,7 +349,7 @@ int removeContact(Contact cntc) {
                 line[strlen(line)] = '\n';
                 if(write(tmpFile, line, strlen(line)) < 0) {
                     close(tmpFile);
-                    unlink("files/tmp");
+                    unlink(tmpPath);
                     removed = 0;
                     aborted = 0;
                     break;
@@ -161,16 +372,20 @@ int removeContact(Contact cntc) {
         close(fd);
 
         // Rimpiazzo della rubrica
-        if(!aborted) rename("files/tmp", "files/rubrica.txt");
+        if(!aborted) rename(tmpPath, path);
     }
     return removed;
 }
 
-int modifyContact(Contact old, Contact new) {
+/**
+ * Modifica old in new nel file path della rubrica, come modifyContact
+ * Il file viene riscritto in tmpPath e rinominato
+ */
+static int modifyContactInFile(const char *path, const char *tmpPath, Contact old, Contact new) {
 
     // Apro la rubrica in sola lettura
     umask(0);
-    int fd = open("files/rubrica.txt", O_RDONLY, 0666);
+    int fd = open(path, O_RDONLY, 0666);
     int modified = 0, present = 0, aborted = 0;
 
     // Procediamo solo se riusciamo ad aprire il file
@@ -189,7 +404,7 @@ int modifyContact(Contact old, Contact new) {
          * successivamente ridenominiamo il file temporaneo, 
          * ottenendo una sostituzione a tutti gli effetti
          */
-        int tmpFile = open("files/tmp", O_WRONLY | O_CREAT, 0666);
+        int tmpFile = open(tmpPath, O_WRONLY | O_CREAT, 0666);
 
         char toModify[writeLen];
         memset(toModify, '\0', writeLen);
@@ -229,11 +444,197 @@ int modifyContact(Contact old, Contact new) {
         if(!present) modified = 2;
         if(!aborted) close(tmpFile);
         close(fd);
-        if(!aborted) rename("files/tmp", "files/rubrica.txt");
+        if(!aborted) rename(tmpPath, path);
+    }
+    return modified;
+}
+
+int getContact(Contact *cntc, int index) {
+    unsigned int generation;
+    int segments = getContactBookSegments(bookPath, &generation), found = 0;
+    char file[BOOK_PATH_LENGTH + 16];
+
+    // I segmenti vengono letti uno dopo l'altro, nel loro ordine
+    for(int i = 0; i < segments && !found; i++) {
+        getContactBookFile(bookPath, generation, segments, i, file);
+        found = getContactFromFile(file, cntc, &index);
     }
+    return found;
+}
+
+int addContact(Contact cntc) {
+    char file[BOOK_PATH_LENGTH + 16];
+
+    // Una rubrica nuova viene creata gia' divisa nel numero di segmenti scelto con setNewBookSegments
+    struct stat info;
+    if(newBookSegments > 1 && getContactBookSegments(bookPath, NULL) == 1 && stat(bookPath, &info) < 0) {
+        umask(0);
+        for(int i = 0; i < newBookSegments; i++) {
+            getContactBookFile(bookPath, 1, newBookSegments, i, file);
+            int fd = open(file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+            if(fd < 0)
+                return 0;
+            close(fd);
+        }
+        if(!writeManifest(bookPath, newBookSegments, 1))
+            return 0;
+    }
+
+    contactFile(cntc, file);
+    return addContactToFile(file, cntc);
+}
+
+int removeContact(Contact cntc) {
+
+    // I contatti che corrispondono hanno lo stesso nome e cognome, quindi basta riscrivere un segmento
+    char file[BOOK_PATH_LENGTH + 16];
+    contactFile(cntc, file);
+    return removeContactFromFile(file, bookTmpPath, cntc);
+}
+
+int modifyContact(Contact old, Contact new) {
+    char oldFile[BOOK_PATH_LENGTH + 16], newFile[BOOK_PATH_LENGTH + 16];
+    contactFile(old, oldFile);
+    contactFile(new, newFile);
+    if(!strcmp(oldFile, newFile))
+        return modifyContactInFile(oldFile, bookTmpPath, old, new);
+
+    /*
+     * Il nuovo nome (o cognome) appartiene a un altro segmento: aggiungiamo il contatto in fondo
+     * all'altro segmento (una sola volta, come addContact) e solo dopo lo togliamo dal suo,
+     * cosi' un errore non fa mai sparire il contatto dalla rubrica
+     * Se l'altro segmento contiene gia' il nuovo contatto non tocchiamo nulla: togliendo
+     * il vecchio i due contatti si fonderebbero in uno
+     */
+    int added = addContactToFile(newFile, new);
+    if(added != 1)
+        return added == 2 ? 3 : 0;
+    int modified = removeContactFromFile(oldFile, bookTmpPath, old);
+
+    // Se il vecchio contatto non c'era o non e' stato tolto annulliamo l'aggiunta
+    if(modified != 1)
+        removeContactFromFile(newFile, bookTmpPath, new);
     return modified;
 }
 
+int reshardContactBook(int segments) {
+    if(segments < 1 || segments > MAX_BOOK_SEGMENTS)
+        return -1;
+
+    // Le modifiche alla rubrica aspettano la fine della ripartizione, le letture continuano sui file attuali
+    int lock = lockContactBook();
+    if(lock < 0)
+        return -1;
+
+    unsigned int oldGeneration;
+    int oldSegments = getContactBookSegments(bookPath, &oldGeneration);
+    unsigned int generation = oldGeneration + 1;
+
+    // I nuovi file vengono scritti accanto a quelli attuali: i segmenti con la generazione successiva, un unico file come temporaneo
+    int out[MAX_BOOK_SEGMENTS], ok = 1, moved = 0;
+    char file[BOOK_PATH_LENGTH + 16];
+    umask(0);
+    for(int i = 0; i < segments; i++) {
+        if(segments > 1)
+            getContactBookFile(bookPath, generation, segments, i, file);
+        else
+            strcpy(file, bookTmpPath);
+        out[i] = open(file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if(out[i] < 0)
+            ok = 0;
+    }
+
+    // Copiamo ogni contatto nel nuovo segmento, che dipende da quanto precede la seconda virgola (nome e cognome)
+    int lineLen = 3 * CONTACT_STRINGS_LENGTH + 2 + 1 + 1;
+    char line[lineLen];
+    for(int i = 0; i < oldSegments && ok; i++) {
+        getContactBookFile(bookPath, oldGeneration, oldSegments, i, file);
+        int in = open(file, O_RDONLY);
+
+        // Un segmento che manca farebbe perdere i suoi contatti, solo una rubrica non divisa puo' non esistere (e' vuota)
+        if(in < 0 && (oldSegments > 1 || errno != ENOENT)) {
+            ok = 0;
+            break;
+        }
+        memset(line, '\0', lineLen);
+        while(ok && readLine(in, line) > 0) {
+            char *comma = strchr(line, ',');
+            comma = comma != NULL ? strchr(comma + 1, ',') : NULL;
+            int target = keySegment(line, comma != NULL ? (int)(comma - line) : (int)strlen(line), segments);
+            line[strlen(line)] = '\n';
+            ok = write(out[target], line, strlen(line)) == (ssize_t)strlen(line);
+            moved++;
+            memset(line, '\0', lineLen);
+        }
+        if(in > -1)
+            close(in);
+    }
+    for(int i = 0; i < segments; i++) {
+        if(out[i] > -1)
+            close(out[i]);
+    }
+
+    /*
+     * Il passaggio ai nuovi file avviene con una sola rename (del file .seg o della rubrica):
+     * chi legge la rubrica trova o tutti i vecchi file o tutti i nuovi
+     */
+    char manifestPath[BOOK_PATH_LENGTH + 8];
+    sprintf(manifestPath, "%s.seg", bookPath);
+    if(ok && segments > 1) {
+        ok = writeManifest(bookPath, segments, generation);
+        if(ok && oldSegments == 1)
+            unlink(bookPath);
+    } else if(ok) {
+        ok = rename(bookTmpPath, bookPath) == 0;
+        if(ok)
+            unlink(manifestPath);
+    }
+
+    // Rimuoviamo i file che non fanno piu' parte della rubrica: i vecchi segmenti o, in caso di errore, i nuovi
+    for(int i = 0; ok && oldSegments > 1 && i < oldSegments; i++) {
+        getContactBookFile(bookPath, oldGeneration, oldSegments, i, file);
+        unlink(file);
+    }
+    for(int i = 0; !ok && i < segments; i++) {
+        if(segments > 1)
+            getContactBookFile(bookPath, generation, segments, i, file);
+        else
+            strcpy(file, bookTmpPath);
+        unlink(file);
+    }
+
+    unlockContactBook(lock);
+    return ok ? moved : -1;
+}
+
+int replaceContactBook(const char *file) {
+    int lock = lockContactBook();
+    if(lock < 0)
+        return 0;
+
+    // Il nuovo contenuto prende il posto della rubrica con una rename, come nella ripartizione
+    unsigned int generation;
+    int segments = getContactBookSegments(bookPath, &generation);
+    int ok = rename(file, bookPath) == 0;
+
+    // I vecchi segmenti non fanno piu' parte della rubrica, che per ora e' un unico file
+    char segmentFile[BOOK_PATH_LENGTH + 16], manifestPath[BOOK_PATH_LENGTH + 8];
+    sprintf(manifestPath, "%s.seg", bookPath);
+    if(ok && segments > 1) {
+        unlink(manifestPath);
+        for(int i = 0; i < segments; i++) {
+            getContactBookFile(bookPath, generation, segments, i, segmentFile);
+            unlink(segmentFile);
+        }
+    }
+    unlockContactBook(lock);
+
+    // Ripristiniamo la divisione in segmenti che la rubrica aveva
+    if(ok && segments > 1)
+        reshardContactBook(segments);
+    return ok;
+}
+
 int matchesParameters(Contact asked, Contact found) {
     int matching = 1;
 
@@ -317,6 +718,8 @@ int checkCredentials(char *username, char *password) {
         if(strcmp(asked, found) == 0) 
             done = 1;
     }
+    if(fd > -1)
+        close(fd);
     return done;
 }
 